@@ -0,0 +1,110 @@
+#pragma once
+
+#include "FsyncPolicy.h"
+#include "PipelineStageBase.h"
+
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+
+#include <chrono>
+#include <functional>
+#include <string>
+#include <system_error>
+#include <vector>
+
+
+namespace Tools { namespace Parallel {
+
+	/*
+	 * BatchedWriterStage is a final pipeline stage that appends its inputs
+	 * to a file. Each input is serialized into an in-memory batch, and a
+	 * batch is written with a single asynchronous write once it reaches
+	 * batchBytes, or as soon as the stage runs out of inputs, so a lightly
+	 * loaded stage does not hold data back.
+	 *
+	 * There are two batch buffers, used in turn and reused for the life of
+	 * the stage: while one is being written the next is being filled, so
+	 * serialization overlaps the I/O. The FsyncPolicy decides when written
+	 * data is forced out to the device.
+	 *
+	 * flushOne and flushAll complete only once every input has been written
+	 * and, unless the policy is Never, forced out, or once writes have
+	 * failed a few times in a row during the flush, which is reported to
+	 * the error handler. The stage writes from a single worker.
+	 *
+	 * A failed write or sync is reported to the error handler rather than
+	 * thrown from processInput, so that a retry of the input at hand does
+	 * not serialize it twice. A batch that could not be written is kept and
+	 * written again, ahead of later inputs, when the next batch fills up or
+	 * the stage is flushed.
+	 */
+	template<class Input>
+	class BatchedWriterStage : public PipelineStageBase<Input>
+	{
+	public:
+#pragma region Constructors and Destructor
+
+		BatchedWriterStage(
+			int stageId,
+			const std::wstring& path,
+			const std::function<void(Input&, std::vector<char>&)>& serializeFunction);
+
+		BatchedWriterStage(
+			int stageId,
+			const std::wstring& path,
+			const std::function<void(Input&, std::vector<char>&)>& serializeFunction,
+			size_t batchBytes,
+			const FsyncPolicy& fsyncPolicy,
+			const std::function<void(int, std::exception_ptr)>& handleErrorFunction);
+
+		~BatchedWriterStage();
+
+		BatchedWriterStage(const BatchedWriterStage<Input>& other) = delete;
+
+#pragma endregion
+
+#pragma region PipelineStageBase overrides
+
+		void setWorkerCount(unsigned int workerCount) override;
+
+	protected:
+		void processInput(Input& input) override;
+		void onIdle() override;
+		void onFlushed() override;
+
+#pragma endregion
+
+	private:
+		void submitBatch();
+		void startWrite();
+		bool completeWrite();
+		void sync();
+		void close();
+		void onError(const char* message, DWORD error);
+
+		std::function<void(Input&, std::vector<char>&)> m_serialize;
+		std::function<void(int, std::exception_ptr)> m_handleError;
+		size_t m_batchBytes;
+		FsyncPolicy m_fsyncPolicy;
+
+		HANDLE m_file;
+		HANDLE m_writeEvent;
+		OVERLAPPED m_overlapped;
+		unsigned long long m_offset;
+		bool m_isWriting;
+		bool m_hasFailedWrite;
+		bool m_hasUnsyncedWrites;
+		std::chrono::steady_clock::time_point m_lastSync;
+
+		std::vector<char> m_fillingBatch;
+		std::vector<char> m_writingBatch;
+	};
+
+}}
+
+#include "BatchedWriterStage.hpp"
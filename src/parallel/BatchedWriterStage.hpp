@@ -0,0 +1,297 @@
+namespace Tools { namespace Parallel {
+
+	const size_t c_defaultBatchBytes = 1024 * 1024;
+
+	// How many failed writes a flush tolerates before it gives up
+	const unsigned int c_flushWriteAttempts = 3;
+
+	template<class Input>
+	BatchedWriterStage<Input>::BatchedWriterStage(
+		int stageId,
+		const std::wstring& path,
+		const std::function<void(Input&, std::vector<char>&)>& serializeFunction)
+		: BatchedWriterStage<Input>(
+			stageId,
+			path,
+			serializeFunction,
+			c_defaultBatchBytes,
+			FsyncPolicy(),
+			nullptr /*handleErrorFunction*/)
+	{
+	}
+
+	template<class Input>
+	BatchedWriterStage<Input>::BatchedWriterStage(
+		int stageId,
+		const std::wstring& path,
+		const std::function<void(Input&, std::vector<char>&)>& serializeFunction,
+		size_t batchBytes,
+		const FsyncPolicy& fsyncPolicy,
+		const std::function<void(int, std::exception_ptr)>& handleErrorFunction)
+		: PipelineStageBase<Input>(
+			stageId,
+			handleErrorFunction)
+		, m_serialize(serializeFunction)
+		, m_handleError(handleErrorFunction)
+		, m_batchBytes(batchBytes)
+		, m_fsyncPolicy(fsyncPolicy)
+		, m_file(INVALID_HANDLE_VALUE)
+		, m_writeEvent(nullptr)
+		, m_offset(0)
+		, m_isWriting(false)
+		, m_hasFailedWrite(false)
+		, m_hasUnsyncedWrites(false)
+		, m_lastSync(std::chrono::steady_clock::now())
+	{
+		if (m_serialize == nullptr)
+		{
+			throw std::invalid_argument("BatchedWriterStage requires a valid serialize function.");
+		}
+
+		// A batch is written with a single call, which takes a 32-bit size
+		if (m_batchBytes == 0 || m_batchBytes > MAXDWORD / 2)
+		{
+			throw std::invalid_argument("Invalid batch size.");
+		}
+
+		m_file = CreateFileW(
+			path.c_str(),
+			GENERIC_WRITE,
+			FILE_SHARE_READ,
+			nullptr,
+			OPEN_ALWAYS,
+			FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED,
+			nullptr);
+		if (m_file == INVALID_HANDLE_VALUE)
+		{
+			throw std::system_error(static_cast<int>(GetLastError()), std::system_category(), "Cannot open the file.");
+		}
+
+		LARGE_INTEGER size;
+		m_writeEvent = CreateEventW(nullptr, TRUE /*manualReset*/, FALSE /*initialState*/, nullptr);
+		if (m_writeEvent == nullptr || !GetFileSizeEx(m_file, &size))
+		{
+			auto error = GetLastError();
+			close();
+			throw std::system_error(static_cast<int>(error), std::system_category(), "Cannot prepare the file for writing.");
+		}
+
+		m_offset = static_cast<unsigned long long>(size.QuadPart);
+
+		// Leave room for the input that takes a batch past its size
+		m_fillingBatch.reserve(2 * m_batchBytes);
+		m_writingBatch.reserve(2 * m_batchBytes);
+	}
+
+	template<class Input>
+	BatchedWriterStage<Input>::~BatchedWriterStage()
+	{
+		// Stop the worker before writing out what it left behind
+		this->deactivate().wait();
+
+		try
+		{
+			onFlushed();
+		}
+		catch (...) {}
+
+		close();
+	}
+
+	template<class Input>
+	void BatchedWriterStage<Input>::setWorkerCount(unsigned int workerCount)
+	{
+		if (workerCount != 1)
+		{
+			throw std::invalid_argument("BatchedWriterStage writes from a single worker.");
+		}
+
+		PipelineStageBase<Input>::setWorkerCount(workerCount);
+	}
+
+	template<class Input>
+	void BatchedWriterStage<Input>::processInput(Input& input)
+	{
+		// A retry of this input must not find part of it already in the batch
+		size_t batchSize = m_fillingBatch.size();
+		try
+		{
+			m_serialize(input, m_fillingBatch);
+		}
+		catch (...)
+		{
+			m_fillingBatch.resize(batchSize);
+			throw;
+		}
+
+		if (m_fillingBatch.size() >= m_batchBytes)
+		{
+			submitBatch();
+		}
+	}
+
+	template<class Input>
+	void BatchedWriterStage<Input>::onIdle()
+	{
+		// A failed batch is only written again once the next one fills up or
+		// the stage is flushed, so an idle stage does not retry in a loop
+		if (!m_fillingBatch.empty() && !m_hasFailedWrite)
+		{
+			submitBatch();
+		}
+		else if (m_isWriting && WaitForSingleObject(m_writeEvent, 0) == WAIT_OBJECT_0)
+		{
+			// Reap the finished write so that a periodic sync is not held
+			// back until the next batch
+			completeWrite();
+		}
+		else if (!m_isWriting && m_hasUnsyncedWrites && m_fsyncPolicy.isDue(std::chrono::steady_clock::now() - m_lastSync))
+		{
+			sync();
+		}
+	}
+
+	template<class Input>
+	void BatchedWriterStage<Input>::onFlushed()
+	{
+		// A failed batch goes out again before the inputs held back behind
+		// it, so this may take a few rounds
+		unsigned int failedWrites = 0;
+		while (!m_fillingBatch.empty() || m_hasFailedWrite || m_isWriting)
+		{
+			submitBatch();
+			completeWrite();
+
+			if (m_hasFailedWrite && ++failedWrites == c_flushWriteAttempts)
+			{
+				onError("Cannot write every input to the file before the flush completes.", ERROR_WRITE_FAULT);
+				return;
+			}
+		}
+
+		if (m_hasUnsyncedWrites && m_fsyncPolicy.syncsOnFlush())
+		{
+			sync();
+		}
+	}
+
+	template<class Input>
+	void BatchedWriterStage<Input>::submitBatch()
+	{
+		// The buffer of the previous batch is about to be refilled, unless
+		// that batch failed and must be written again first. One that has
+		// only just failed is left until the next call.
+		if (!completeWrite())
+		{
+			return;
+		}
+
+		if (!m_hasFailedWrite)
+		{
+			if (m_fillingBatch.empty())
+			{
+				return;
+			}
+
+			m_fillingBatch.swap(m_writingBatch);
+		}
+
+		startWrite();
+	}
+
+	template<class Input>
+	void BatchedWriterStage<Input>::startWrite()
+	{
+		ZeroMemory(&m_overlapped, sizeof(m_overlapped));
+		m_overlapped.Offset = static_cast<DWORD>(m_offset);
+		m_overlapped.OffsetHigh = static_cast<DWORD>(m_offset >> 32);
+		m_overlapped.hEvent = m_writeEvent;
+		ResetEvent(m_writeEvent);
+
+		DWORD batchSize = static_cast<DWORD>(m_writingBatch.size());
+		if (!WriteFile(m_file, m_writingBatch.data(), batchSize, nullptr, &m_overlapped) && GetLastError() != ERROR_IO_PENDING)
+		{
+			m_hasFailedWrite = true;
+			onError("Cannot write to the file.", GetLastError());
+			return;
+		}
+
+		m_hasFailedWrite = false;
+		m_offset += batchSize;
+		m_isWriting = true;
+	}
+
+	template<class Input>
+	bool BatchedWriterStage<Input>::completeWrite()
+	{
+		if (!m_isWriting)
+		{
+			return true;
+		}
+
+		m_isWriting = false;
+
+		DWORD bytesWritten = 0;
+		if (!GetOverlappedResult(m_file, &m_overlapped, &bytesWritten, TRUE /*wait*/))
+		{
+			// Keep the batch, to be written again at the same offset
+			m_offset -= m_writingBatch.size();
+			m_hasFailedWrite = true;
+			onError("Cannot write to the file.", GetLastError());
+			return false;
+		}
+
+		m_writingBatch.clear();
+
+		m_hasUnsyncedWrites = true;
+		if (m_fsyncPolicy.isDue(std::chrono::steady_clock::now() - m_lastSync))
+		{
+			sync();
+		}
+
+		return true;
+	}
+
+	template<class Input>
+	void BatchedWriterStage<Input>::sync()
+	{
+		if (!FlushFileBuffers(m_file))
+		{
+			onError("Cannot flush the file.", GetLastError());
+			return;
+		}
+
+		m_hasUnsyncedWrites = false;
+		m_lastSync = std::chrono::steady_clock::now();
+	}
+
+	template<class Input>
+	void BatchedWriterStage<Input>::onError(const char* message, DWORD error)
+	{
+		try
+		{
+			if (m_handleError)
+			{
+				m_handleError(this->stageId(), std::make_exception_ptr(std::system_error(static_cast<int>(error), std::system_category(), message)));
+			}
+		}
+		catch (...) {}
+	}
+
+	template<class Input>
+	void BatchedWriterStage<Input>::close()
+	{
+		if (m_writeEvent != nullptr)
+		{
+			CloseHandle(m_writeEvent);
+			m_writeEvent = nullptr;
+		}
+
+		if (m_file != INVALID_HANDLE_VALUE)
+		{
+			CloseHandle(m_file);
+			m_file = INVALID_HANDLE_VALUE;
+		}
+	}
+
+}}
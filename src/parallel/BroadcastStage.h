@@ -0,0 +1,139 @@
+#pragma once
+
+#include "IConsumerStage.h"
+#include "IdleStrategy.h"
+
+#include <concrt.h>
+#include <ppltasks.h>
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+
+namespace Tools { namespace Parallel {
+
+	/*
+	 * BroadcastStage is a fan-out edge that hands every input to several
+	 * readers without copying it for each of them. Inputs are written once
+	 * into a preallocated ring, and every reader follows the ring with a
+	 * cursor of its own on a dedicated task, reading inputs in place and in
+	 * the order they were claimed. A reader drains everything published
+	 * since it last looked before it moves its cursor, so a reader that
+	 * falls behind catches up in batches.
+	 *
+	 * Producers are gated by the slowest reader: addInput waits while the
+	 * ring holds capacity inputs that some reader has not read yet, so the
+	 * stage must be active for a full ring to make progress. Readers must
+	 * subscribe before the stage is first activated or given an input.
+	 *
+	 * Errors thrown by a reader are passed to the error handler with the
+	 * reader's id, and the reader moves on to its next input.
+	 */
+	template<class T>
+	class BroadcastStage : public IConsumerStage<T>
+	{
+	public:
+#pragma region Constructors and Destructor
+
+		/*
+		 * capacity must be a power of two.
+		 */
+		BroadcastStage(int stageId, unsigned int capacity);
+
+		BroadcastStage(
+			int stageId,
+			unsigned int capacity,
+			const std::function<void(int, std::exception_ptr)>& handleErrorFunction);
+
+		~BroadcastStage();
+
+		BroadcastStage(const BroadcastStage<T>& other) = delete;
+
+#pragma endregion
+
+#pragma region IPipelineStage implementations
+
+		int stageId() const override;
+		bool isActive() override;
+		bool isFlushing() override;
+		void activate() override;
+		concurrency::task<void> deactivate() override;
+		concurrency::task<void> flushOne() override;
+		concurrency::task<void> flushAll() override;
+
+#pragma endregion
+
+#pragma region IConsumerStage implementations
+
+		bool hasInputs() const override;
+		void addInput(T& input) override;
+
+#pragma endregion
+
+		void subscribe(int readerId, const std::function<void(const T&)>& processInputFunction);
+
+		/*
+		 * Applies to readers that find the ring empty and to producers that
+		 * find it full. Takes effect the next time the stage is activated.
+		 */
+		void setIdleStrategy(const IdleStrategy& idleStrategy);
+
+		unsigned int capacity() const;
+		unsigned long long publishedCount() const;
+
+	private:
+		static const size_t c_cacheLineBytes = 64;
+
+		struct Slot
+		{
+			std::atomic<uint64_t> sequence;
+			T value;
+		};
+
+		struct Reader
+		{
+			// The next position to read, written only by the reader's task
+			std::atomic<uint64_t> cursor;
+			char padding[c_cacheLineBytes - sizeof(std::atomic<uint64_t>)];
+
+			int id;
+			std::function<void(const T&)> processInput;
+			bool isRunning;
+			concurrency::task<void> task;
+		};
+
+		uint64_t slowestCursor() const;
+		void startReaders();
+		void readInputs(Reader& reader, const IdleStrategy& idleStrategy);
+		bool tryStopReading(Reader& reader, uint64_t cursor);
+		concurrency::task<void> readersTask();
+		void onError(int readerId, std::exception_ptr error);
+
+		int m_stageId;
+		std::function<void(int, std::exception_ptr)> m_handleError;
+		std::unique_ptr<Slot[]> m_slots;
+		uint64_t m_mask;
+
+		// Producers contend on the claimed count; it has a cache line of
+		// its own so that they do not slow down the readers' cursors
+		char m_claimedPadding[c_cacheLineBytes];
+		std::atomic<uint64_t> m_claimed;
+		char m_gatePadding[c_cacheLineBytes - sizeof(std::atomic<uint64_t>)];
+		std::atomic<uint64_t> m_gate;
+
+		std::vector<std::unique_ptr<Reader>> m_readers;
+		std::atomic<bool> m_isScheduled;
+		std::atomic<bool> m_isFlushing;
+		std::atomic<bool> m_hasStarted;
+		std::atomic<uint64_t> m_flushTarget;
+		std::atomic<unsigned int> m_runningReaders;
+		IdleStrategy m_idleStrategy;
+		concurrency::critical_section m_readersLock;
+	};
+
+}}
+
+#include "BroadcastStage.hpp"
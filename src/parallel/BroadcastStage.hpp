@@ -0,0 +1,343 @@
+#include <algorithm>
+#include <stdexcept>
+
+
+namespace Tools { namespace Parallel {
+
+	// Readers wait as long as a pipeline stage's workers when idle, while
+	// producers look again soon, since a reader frees slots in batches
+	const unsigned int c_broadcastReaderWaitMilliseconds = 10;
+	const unsigned int c_broadcastProducerWaitMilliseconds = 1;
+
+	template<class T>
+	BroadcastStage<T>::BroadcastStage(int stageId, unsigned int capacity)
+		: BroadcastStage<T>(stageId, capacity, nullptr /*handleErrorFunction*/)
+	{
+	}
+
+	template<class T>
+	BroadcastStage<T>::BroadcastStage(
+		int stageId,
+		unsigned int capacity,
+		const std::function<void(int, std::exception_ptr)>& handleErrorFunction)
+		: m_stageId(stageId)
+		, m_handleError(handleErrorFunction)
+		, m_mask(capacity - 1)
+		, m_claimed(0)
+		, m_gate(0)
+		, m_isScheduled(false)
+		, m_isFlushing(false)
+		, m_hasStarted(false)
+		, m_flushTarget(0)
+		, m_runningReaders(0)
+	{
+		if (capacity == 0 || (capacity & (capacity - 1)) != 0)
+		{
+			throw std::invalid_argument("BroadcastStage requires a capacity that is a power of two.");
+		}
+
+		m_slots.reset(new Slot[capacity]);
+		for (unsigned int i = 0; i < capacity; ++i)
+		{
+			m_slots[i].sequence.store(0, std::memory_order_relaxed);
+		}
+	}
+
+	template<class T>
+	BroadcastStage<T>::~BroadcastStage()
+	{
+		deactivate().wait();
+	}
+
+	template<class T>
+	int BroadcastStage<T>::stageId() const
+	{
+		return m_stageId;
+	}
+
+	template<class T>
+	bool BroadcastStage<T>::isActive()
+	{
+		return m_isScheduled || m_runningReaders > 0;
+	}
+
+	template<class T>
+	bool BroadcastStage<T>::isFlushing()
+	{
+		return m_isFlushing;
+	}
+
+	template<class T>
+	void BroadcastStage<T>::activate()
+	{
+		concurrency::critical_section::scoped_lock lock(m_readersLock);
+		m_hasStarted = true;
+		m_isScheduled = true;
+
+		// Readers that are winding down see the flag again before they stop
+		startReaders();
+	}
+
+	template<class T>
+	concurrency::task<void> BroadcastStage<T>::deactivate()
+	{
+		m_isScheduled = false;
+
+		concurrency::critical_section::scoped_lock lock(m_readersLock);
+		return readersTask();
+	}
+
+	template<class T>
+	concurrency::task<void> BroadcastStage<T>::flushOne()
+	{
+		concurrency::critical_section::scoped_lock lock(m_readersLock);
+		if (m_runningReaders == 0)
+		{
+			return concurrency::task_from_result();
+		}
+
+		m_flushTarget = m_claimed.load();
+		m_isFlushing = true;
+
+		return readersTask();
+	}
+
+	template<class T>
+	concurrency::task<void> BroadcastStage<T>::flushAll()
+	{
+		// Readers are functions rather than stages, so there is nothing
+		// further to flush
+		return flushOne();
+	}
+
+	template<class T>
+	bool BroadcastStage<T>::hasInputs() const
+	{
+		return m_claimed.load(std::memory_order_acquire) > slowestCursor();
+	}
+
+	template<class T>
+	void BroadcastStage<T>::addInput(T& input)
+	{
+		if (m_isFlushing.load(std::memory_order_relaxed))
+		{
+			return;
+		}
+
+		m_hasStarted.store(true, std::memory_order_relaxed);
+		uint64_t position = m_claimed.fetch_add(1);
+		uint64_t capacity = m_mask + 1;
+
+		// The slot may only be written once every reader has read the input
+		// it held a lap ago. The gate caches the slowest cursor, so that
+		// producers only look at the readers when the ring seems full.
+		if (position >= m_gate.load(std::memory_order_acquire) + capacity)
+		{
+			IdleStrategy idleStrategy;
+			{
+				concurrency::critical_section::scoped_lock lock(m_readersLock);
+				idleStrategy = m_idleStrategy;
+			}
+
+			for (unsigned int idleAttempts = 0; ; ++idleAttempts)
+			{
+				uint64_t slowest = slowestCursor();
+				m_gate.store(slowest, std::memory_order_release);
+				if (position < slowest + capacity)
+				{
+					break;
+				}
+
+				if (!idleStrategy.pause(idleAttempts))
+				{
+					concurrency::wait(idleStrategy.parkMilliseconds(c_broadcastProducerWaitMilliseconds));
+				}
+			}
+		}
+
+		Slot& slot = m_slots[position & m_mask];
+		slot.value = input;
+		slot.sequence.store(position + 1, std::memory_order_release);
+	}
+
+	template<class T>
+	void BroadcastStage<T>::subscribe(int readerId, const std::function<void(const T&)>& processInputFunction)
+	{
+		if (processInputFunction == nullptr)
+		{
+			throw std::invalid_argument("A reader requires a valid process input function.");
+		}
+
+		std::unique_ptr<Reader> reader(new Reader());
+		reader->cursor.store(0, std::memory_order_relaxed);
+		reader->id = readerId;
+		reader->processInput = processInputFunction;
+		reader->isRunning = false;
+		reader->task = concurrency::task_from_result();
+
+		concurrency::critical_section::scoped_lock lock(m_readersLock);
+		if (m_hasStarted)
+		{
+			throw std::logic_error("Readers must subscribe before the stage is started.");
+		}
+
+		m_readers.push_back(std::move(reader));
+	}
+
+	template<class T>
+	void BroadcastStage<T>::setIdleStrategy(const IdleStrategy& idleStrategy)
+	{
+		concurrency::critical_section::scoped_lock lock(m_readersLock);
+		m_idleStrategy = idleStrategy;
+	}
+
+	template<class T>
+	unsigned int BroadcastStage<T>::capacity() const
+	{
+		return static_cast<unsigned int>(m_mask + 1);
+	}
+
+	template<class T>
+	unsigned long long BroadcastStage<T>::publishedCount() const
+	{
+		return m_claimed.load(std::memory_order_relaxed);
+	}
+
+	template<class T>
+	uint64_t BroadcastStage<T>::slowestCursor() const
+	{
+		// Readers are fixed once the stage has started, so they can be
+		// walked without the lock. With no reader nothing gates producers.
+		if (m_readers.empty())
+		{
+			return m_claimed.load(std::memory_order_acquire);
+		}
+
+		uint64_t slowest = UINT64_MAX;
+		for (auto iter = m_readers.begin(); iter != m_readers.end(); ++iter)
+		{
+			slowest = (std::min)(slowest, (*iter)->cursor.load(std::memory_order_acquire));
+		}
+
+		return slowest;
+	}
+
+	template<class T>
+	void BroadcastStage<T>::startReaders()
+	{
+		for (auto iter = m_readers.begin(); iter != m_readers.end(); ++iter)
+		{
+			Reader* reader = iter->get();
+			if (!reader->isRunning)
+			{
+				reader->isRunning = true;
+				++m_runningReaders;
+
+				IdleStrategy idleStrategy = m_idleStrategy;
+				reader->task = concurrency::create_task([this, reader, idleStrategy]() { readInputs(*reader, idleStrategy); });
+			}
+		}
+	}
+
+	template<class T>
+	void BroadcastStage<T>::readInputs(Reader& reader, const IdleStrategy& idleStrategy)
+	{
+		uint64_t cursor = reader.cursor.load(std::memory_order_relaxed);
+		unsigned int idleAttempts = 0;
+
+		while (!tryStopReading(reader, cursor))
+		{
+			uint64_t available = cursor;
+			while (m_slots[available & m_mask].sequence.load(std::memory_order_acquire) == available + 1)
+			{
+				++available;
+			}
+
+			if (available == cursor)
+			{
+				if (!idleStrategy.pause(idleAttempts++))
+				{
+					concurrency::wait(idleStrategy.parkMilliseconds(c_broadcastReaderWaitMilliseconds));
+				}
+
+				continue;
+			}
+
+			idleAttempts = 0;
+			for (; cursor < available; ++cursor)
+			{
+				try
+				{
+					reader.processInput(m_slots[cursor & m_mask].value);
+				}
+				catch (...)
+				{
+					onError(reader.id, std::current_exception());
+				}
+			}
+
+			reader.cursor.store(cursor, std::memory_order_release);
+		}
+	}
+
+	template<class T>
+	bool BroadcastStage<T>::tryStopReading(Reader& reader, uint64_t cursor)
+	{
+		auto shouldContinue = [this, cursor]()
+		{
+			return m_isFlushing ? cursor < m_flushTarget : m_isScheduled.load();
+		};
+
+		if (shouldContinue())
+		{
+			return false;
+		}
+
+		concurrency::critical_section::scoped_lock lock(m_readersLock);
+		if (shouldContinue())
+		{
+			return false;
+		}
+
+		// The last reader out ends the flush
+		reader.isRunning = false;
+		if (--m_runningReaders == 0)
+		{
+			m_isScheduled = false;
+			m_isFlushing = false;
+		}
+
+		return true;
+	}
+
+	template<class T>
+	concurrency::task<void> BroadcastStage<T>::readersTask()
+	{
+		if (m_readers.empty())
+		{
+			return concurrency::task_from_result();
+		}
+
+		std::vector<concurrency::task<void>> tasks;
+		for (auto iter = m_readers.begin(); iter != m_readers.end(); ++iter)
+		{
+			tasks.push_back((*iter)->task);
+		}
+
+		return concurrency::when_all(tasks.begin(), tasks.end());
+	}
+
+	template<class T>
+	void BroadcastStage<T>::onError(int readerId, std::exception_ptr error)
+	{
+		try
+		{
+			if (m_handleError)
+			{
+				m_handleError(readerId, error);
+			}
+		}
+		catch (...) {}
+	}
+
+}}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "HashMixing.h"
+
+#include <concrt.h>
+#include <ppltasks.h>
+
+#include <atomic>
+#include <functional>
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+
+namespace Tools { namespace Parallel {
+
+	/*
+	 * ConcurrentLruCache is a bounded cache that evicts the least recently
+	 * used value. It is split into shards, each with its own lock, so that
+	 * threads looking up different keys rarely contend.
+	 *
+	 * getOrAdd computes a missing value outside the lock and coalesces
+	 * concurrent requests for the same key: the first caller computes it and
+	 * the others wait for the result. A computation that throws is not
+	 * cached; every caller waiting for it gets the error.
+	 */
+	template<class Key, class Value, class Hash = std::hash<Key>>
+	class ConcurrentLruCache
+	{
+	public:
+		static const unsigned int DefaultShardCount = 16;
+
+#pragma region Constructors and Destructor
+
+		explicit ConcurrentLruCache(size_t capacity);
+		ConcurrentLruCache(size_t capacity, unsigned int shardCount);
+
+		ConcurrentLruCache(const ConcurrentLruCache<Key, Value, Hash>& other) = delete;
+
+#pragma endregion
+
+#pragma region Values
+
+		template<class Compute>
+		Value getOrAdd(const Key& key, Compute compute);
+
+		bool tryGet(const Key& key, Value& value);
+
+		size_t capacity() const;
+		size_t size() const;
+
+#pragma endregion
+
+#pragma region Counters
+
+		unsigned long long hits() const;
+		unsigned long long misses() const;
+		unsigned long long coalesced() const;
+		unsigned long long evictions() const;
+
+#pragma endregion
+
+	private:
+		typedef std::list<std::pair<Key, Value>> Entries;
+
+		struct Shard
+		{
+			// Most recently used first
+			Entries entries;
+			std::unordered_map<Key, typename Entries::iterator, Hash> index;
+			std::unordered_map<Key, concurrency::task_completion_event<Value>, Hash> inFlight;
+			size_t capacity;
+			mutable concurrency::critical_section lock;
+		};
+
+		Shard& shardOf(const Key& key);
+		bool tryGetLocked(Shard& shard, const Key& key, Value& value);
+		void addLocked(Shard& shard, const Key& key, const Value& value);
+
+		std::vector<std::unique_ptr<Shard>> m_shards;
+		Hash m_hash;
+		size_t m_capacity;
+		std::atomic<unsigned long long> m_hits;
+		std::atomic<unsigned long long> m_misses;
+		std::atomic<unsigned long long> m_coalesced;
+		std::atomic<unsigned long long> m_evictions;
+	};
+
+}}
+
+#include "ConcurrentLruCache.hpp"
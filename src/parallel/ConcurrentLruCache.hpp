@@ -0,0 +1,201 @@
+#include <algorithm>
+#include <stdexcept>
+
+
+namespace Tools { namespace Parallel {
+
+	template<class Key, class Value, class Hash>
+	ConcurrentLruCache<Key, Value, Hash>::ConcurrentLruCache(size_t capacity)
+		: ConcurrentLruCache(capacity, DefaultShardCount)
+	{
+	}
+
+	template<class Key, class Value, class Hash>
+	ConcurrentLruCache<Key, Value, Hash>::ConcurrentLruCache(size_t capacity, unsigned int shardCount)
+		: m_capacity(capacity)
+		, m_hits(0)
+		, m_misses(0)
+		, m_coalesced(0)
+		, m_evictions(0)
+	{
+		if (capacity == 0 || shardCount == 0)
+		{
+			throw std::invalid_argument("ConcurrentLruCache requires a capacity and a shard count of at least one.");
+		}
+
+		// Small caches get fewer shards so that every shard holds a value.
+		// The first shards take one value more each when the capacity does
+		// not divide evenly, so the shards add up to the capacity exactly.
+		size_t count = (std::min)(static_cast<size_t>(shardCount), capacity);
+		for (size_t i = 0; i < count; ++i)
+		{
+			std::unique_ptr<Shard> shard(new Shard());
+			shard->capacity = capacity / count + (i < capacity % count ? 1 : 0);
+			m_shards.push_back(std::move(shard));
+		}
+	}
+
+	template<class Key, class Value, class Hash>
+	template<class Compute>
+	Value ConcurrentLruCache<Key, Value, Hash>::getOrAdd(const Key& key, Compute compute)
+	{
+		Shard& shard = shardOf(key);
+		concurrency::task_completion_event<Value> completion;
+		bool isComputing = false;
+
+		{
+			concurrency::critical_section::scoped_lock lock(shard.lock);
+			Value value;
+			if (tryGetLocked(shard, key, value))
+			{
+				m_hits.fetch_add(1, std::memory_order_relaxed);
+				return value;
+			}
+
+			auto inFlight = shard.inFlight.find(key);
+			if (inFlight != shard.inFlight.end())
+			{
+				completion = inFlight->second;
+			}
+			else
+			{
+				shard.inFlight.emplace(key, completion);
+				isComputing = true;
+			}
+		}
+
+		if (!isComputing)
+		{
+			m_coalesced.fetch_add(1, std::memory_order_relaxed);
+			return concurrency::create_task(completion).get();
+		}
+
+		m_misses.fetch_add(1, std::memory_order_relaxed);
+
+		try
+		{
+			Value value = compute();
+			{
+				concurrency::critical_section::scoped_lock lock(shard.lock);
+				shard.inFlight.erase(key);
+				addLocked(shard, key, value);
+			}
+
+			completion.set(value);
+			return value;
+		}
+		catch (...)
+		{
+			{
+				concurrency::critical_section::scoped_lock lock(shard.lock);
+				shard.inFlight.erase(key);
+			}
+
+			completion.set_exception(std::current_exception());
+			throw;
+		}
+	}
+
+	template<class Key, class Value, class Hash>
+	bool ConcurrentLruCache<Key, Value, Hash>::tryGet(const Key& key, Value& value)
+	{
+		Shard& shard = shardOf(key);
+		concurrency::critical_section::scoped_lock lock(shard.lock);
+
+		bool isFound = tryGetLocked(shard, key, value);
+		(isFound ? m_hits : m_misses).fetch_add(1, std::memory_order_relaxed);
+
+		return isFound;
+	}
+
+	template<class Key, class Value, class Hash>
+	size_t ConcurrentLruCache<Key, Value, Hash>::capacity() const
+	{
+		return m_capacity;
+	}
+
+	template<class Key, class Value, class Hash>
+	size_t ConcurrentLruCache<Key, Value, Hash>::size() const
+	{
+		size_t size = 0;
+		for (auto& shard : m_shards)
+		{
+			concurrency::critical_section::scoped_lock lock(shard->lock);
+			size += shard->entries.size();
+		}
+
+		return size;
+	}
+
+	template<class Key, class Value, class Hash>
+	unsigned long long ConcurrentLruCache<Key, Value, Hash>::hits() const
+	{
+		return m_hits.load(std::memory_order_relaxed);
+	}
+
+	template<class Key, class Value, class Hash>
+	unsigned long long ConcurrentLruCache<Key, Value, Hash>::misses() const
+	{
+		return m_misses.load(std::memory_order_relaxed);
+	}
+
+	template<class Key, class Value, class Hash>
+	unsigned long long ConcurrentLruCache<Key, Value, Hash>::coalesced() const
+	{
+		return m_coalesced.load(std::memory_order_relaxed);
+	}
+
+	template<class Key, class Value, class Hash>
+	unsigned long long ConcurrentLruCache<Key, Value, Hash>::evictions() const
+	{
+		return m_evictions.load(std::memory_order_relaxed);
+	}
+
+	template<class Key, class Value, class Hash>
+	typename ConcurrentLruCache<Key, Value, Hash>::Shard& ConcurrentLruCache<Key, Value, Hash>::shardOf(const Key& key)
+	{
+		// A shard's index places keys by the low bits of the same hash, so
+		// shards are chosen by the high bits to keep each index evenly spread
+		uint64_t hash = Details::mixHash(static_cast<uint64_t>(m_hash(key)));
+		return *m_shards[static_cast<size_t>((hash >> 32) % m_shards.size())];
+	}
+
+	template<class Key, class Value, class Hash>
+	bool ConcurrentLruCache<Key, Value, Hash>::tryGetLocked(Shard& shard, const Key& key, Value& value)
+	{
+		auto iter = shard.index.find(key);
+		if (iter == shard.index.end())
+		{
+			return false;
+		}
+
+		// Moving the entry to the front keeps every iterator valid
+		shard.entries.splice(shard.entries.begin(), shard.entries, iter->second);
+		value = iter->second->second;
+
+		return true;
+	}
+
+	template<class Key, class Value, class Hash>
+	void ConcurrentLruCache<Key, Value, Hash>::addLocked(Shard& shard, const Key& key, const Value& value)
+	{
+		auto iter = shard.index.find(key);
+		if (iter != shard.index.end())
+		{
+			iter->second->second = value;
+			shard.entries.splice(shard.entries.begin(), shard.entries, iter->second);
+			return;
+		}
+
+		if (shard.entries.size() >= shard.capacity)
+		{
+			shard.index.erase(shard.entries.back().first);
+			shard.entries.pop_back();
+			m_evictions.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		shard.entries.emplace_front(key, value);
+		shard.index[key] = shard.entries.begin();
+	}
+
+}}
@@ -0,0 +1,161 @@
+#pragma once
+
+#include "HashMixing.h"
+#include "PipelineStage.h"
+
+#include <concrt.h>
+#include <concurrent_queue.h>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+
+
+namespace Tools { namespace Parallel {
+
+#pragma region ConflatingInputQueue<Input, Key, Hash>
+
+	/*
+	 * ConflatingInputQueue keeps at most one pending input per key. An input
+	 * whose key already has one replaces it where it stands, so the newer
+	 * value is processed at the older one's place in the queue and the
+	 * older one is never processed at all. A key is forgotten once its
+	 * input has been taken.
+	 *
+	 * The pending inputs live in a table of maxKeys entries allocated up
+	 * front. Keys are found through maps split into shards, each with its
+	 * own lock, so producers of different keys rarely meet. An input with a
+	 * new key is refused while every entry is pending; neither tryPush nor
+	 * push waits for an entry, since only the stage knows whether one will
+	 * be freed.
+	 */
+	template<class Input, class Key, class Hash = std::hash<Key>>
+	class ConflatingInputQueue
+	{
+	public:
+#pragma region Constructors
+
+		ConflatingInputQueue();
+
+		ConflatingInputQueue(const ConflatingInputQueue<Input, Key, Hash>& other) = delete;
+
+#pragma endregion
+
+		/*
+		 * Must be called once, before the first input is pushed.
+		 */
+		void initialize(const std::function<Key(Input&)>& keyFunction, unsigned int maxKeys);
+
+		unsigned int maxKeys() const;
+		unsigned long long conflatedCount() const;
+
+		enum PushResult
+		{
+			Queued,
+			Conflated,
+			Full
+		};
+
+		PushResult tryPush(Input& input);
+
+#pragma region Queue operations
+
+		/*
+		 * Returns false if input replaced a pending input of its key or was
+		 * refused because every entry is pending.
+		 */
+		bool push(Input& input);
+		bool try_pop(Input& input);
+		bool empty() const;
+
+#pragma endregion
+
+	private:
+		static const size_t c_shardCount = 64;
+
+		struct Entry
+		{
+			Key key;
+			Input input;
+		};
+
+		struct Shard
+		{
+			concurrency::critical_section lock;
+			std::unordered_map<Key, Entry*, Hash> pending;
+		};
+
+		Shard& shardOf(const Key& key);
+
+		std::function<Key(Input&)> m_key;
+		Hash m_hash;
+		unsigned int m_maxKeys;
+		std::unique_ptr<Entry[]> m_entries;
+		std::unique_ptr<Shard[]> m_shards;
+		concurrency::concurrent_queue<Entry*> m_freeEntries;
+		concurrency::concurrent_queue<Entry*> m_readyEntries;
+		std::atomic<unsigned long long> m_conflatedCount;
+	};
+
+#pragma endregion
+
+#pragma region ConflatingPipelineStage<Input, Output, Key, Hash>
+
+	/*
+	 * ConflatingPipelineStage is a PipelineStage for feeds where only the
+	 * latest input of each key matters. Its queue is a ConflatingInputQueue,
+	 * so a stage that falls behind skips stale inputs instead of working
+	 * through them, and its memory is bounded by maxKeys however fast
+	 * inputs arrive. Inputs of different keys are processed in the order
+	 * their keys were first queued. The inputs added in its statistics
+	 * leave out those counted by conflatedCount.
+	 *
+	 * A producer with a new key waits while every entry is pending, but
+	 * only for as long as the stage is active, since only a worker frees an
+	 * entry. If the stage is inactive, or becomes inactive or starts
+	 * flushing while the producer waits, the input is dropped and counted
+	 * by droppedCount instead.
+	 */
+	template<class Input, class Output, class Key, class Hash = std::hash<Key>>
+	class ConflatingPipelineStage : public PipelineStage<Input, Output, ConflatingInputQueue<Input, Key, Hash>>
+	{
+	public:
+		ConflatingPipelineStage(
+			int stageId,
+			const std::function<Key(Input&)>& keyFunction,
+			unsigned int maxKeys,
+			const std::function<Output(Input&)>& processInputFunction);
+
+		ConflatingPipelineStage(
+			int stageId,
+			const std::function<Key(Input&)>& keyFunction,
+			unsigned int maxKeys,
+			const std::function<Output(Input&)>& processInputFunction,
+			const std::function<void(int, std::exception_ptr)>& handleErrorFunction);
+
+		ConflatingPipelineStage(const ConflatingPipelineStage<Input, Output, Key, Hash>& other) = delete;
+
+		void addInput(Input& input) override;
+
+		/*
+		 * The number of inputs that replaced a pending input of their key.
+		 */
+		unsigned long long conflatedCount() const;
+
+		/*
+		 * The number of inputs with a new key that found every entry
+		 * pending while the stage was inactive, or that were still waiting
+		 * for an entry when it became inactive or started flushing.
+		 */
+		unsigned long long droppedCount() const;
+
+	private:
+		std::atomic<unsigned long long> m_droppedCount;
+	};
+
+#pragma endregion
+
+}}
+
+#include "ConflatingPipelineStage.hpp"
@@ -0,0 +1,205 @@
+#include <stdexcept>
+
+
+namespace Tools { namespace Parallel {
+
+	// How long a producer with a new key waits before looking for a free
+	// entry again
+	const unsigned int c_conflatingWaitMilliseconds = 1;
+
+#pragma region ConflatingInputQueue<Input, Key, Hash>
+
+	template<class Input, class Key, class Hash>
+	ConflatingInputQueue<Input, Key, Hash>::ConflatingInputQueue()
+		: m_maxKeys(0)
+		, m_shards(new Shard[c_shardCount])
+		, m_conflatedCount(0)
+	{
+	}
+
+	template<class Input, class Key, class Hash>
+	void ConflatingInputQueue<Input, Key, Hash>::initialize(const std::function<Key(Input&)>& keyFunction, unsigned int maxKeys)
+	{
+		if (keyFunction == nullptr || maxKeys == 0)
+		{
+			throw std::invalid_argument("A conflating queue requires a valid key function and a positive number of keys.");
+		}
+
+		m_key = keyFunction;
+		m_maxKeys = maxKeys;
+		m_entries.reset(new Entry[maxKeys]);
+		for (unsigned int i = 0; i < maxKeys; ++i)
+		{
+			m_freeEntries.push(&m_entries[i]);
+		}
+	}
+
+	template<class Input, class Key, class Hash>
+	unsigned int ConflatingInputQueue<Input, Key, Hash>::maxKeys() const
+	{
+		return m_maxKeys;
+	}
+
+	template<class Input, class Key, class Hash>
+	unsigned long long ConflatingInputQueue<Input, Key, Hash>::conflatedCount() const
+	{
+		return m_conflatedCount.load(std::memory_order_relaxed);
+	}
+
+	template<class Input, class Key, class Hash>
+	typename ConflatingInputQueue<Input, Key, Hash>::PushResult ConflatingInputQueue<Input, Key, Hash>::tryPush(Input& input)
+	{
+		Key key = m_key(input);
+		Shard& shard = shardOf(key);
+
+		concurrency::critical_section::scoped_lock lock(shard.lock);
+		auto iter = shard.pending.find(key);
+		if (iter != shard.pending.end())
+		{
+			iter->second->input = input;
+			m_conflatedCount.fetch_add(1, std::memory_order_relaxed);
+			return Conflated;
+		}
+
+		Entry* entry = nullptr;
+		if (!m_freeEntries.try_pop(entry))
+		{
+			return Full;
+		}
+
+		entry->key = key;
+		entry->input = input;
+		shard.pending.emplace(key, entry);
+
+		// Queued under the shard's lock, so that a worker cannot take the
+		// entry before it is in the map
+		m_readyEntries.push(entry);
+		return Queued;
+	}
+
+	template<class Input, class Key, class Hash>
+	bool ConflatingInputQueue<Input, Key, Hash>::push(Input& input)
+	{
+		return tryPush(input) == Queued;
+	}
+
+	template<class Input, class Key, class Hash>
+	bool ConflatingInputQueue<Input, Key, Hash>::try_pop(Input& input)
+	{
+		Entry* entry = nullptr;
+		if (!m_readyEntries.try_pop(entry))
+		{
+			return false;
+		}
+
+		Shard& shard = shardOf(entry->key);
+		{
+			concurrency::critical_section::scoped_lock lock(shard.lock);
+			input = entry->input;
+			shard.pending.erase(entry->key);
+		}
+
+		m_freeEntries.push(entry);
+		return true;
+	}
+
+	template<class Input, class Key, class Hash>
+	bool ConflatingInputQueue<Input, Key, Hash>::empty() const
+	{
+		return m_readyEntries.empty();
+	}
+
+	template<class Input, class Key, class Hash>
+	typename ConflatingInputQueue<Input, Key, Hash>::Shard& ConflatingInputQueue<Input, Key, Hash>::shardOf(const Key& key)
+	{
+		return m_shards[Details::mixHash(m_hash(key)) % c_shardCount];
+	}
+
+#pragma endregion
+
+#pragma region ConflatingPipelineStage<Input, Output, Key, Hash>
+
+	template<class Input, class Output, class Key, class Hash>
+	ConflatingPipelineStage<Input, Output, Key, Hash>::ConflatingPipelineStage(
+		int stageId,
+		const std::function<Key(Input&)>& keyFunction,
+		unsigned int maxKeys,
+		const std::function<Output(Input&)>& processInputFunction)
+		: ConflatingPipelineStage<Input, Output, Key, Hash>(
+			stageId,
+			keyFunction,
+			maxKeys,
+			processInputFunction,
+			nullptr /*handleErrorFunction*/)
+	{
+	}
+
+	template<class Input, class Output, class Key, class Hash>
+	ConflatingPipelineStage<Input, Output, Key, Hash>::ConflatingPipelineStage(
+		int stageId,
+		const std::function<Key(Input&)>& keyFunction,
+		unsigned int maxKeys,
+		const std::function<Output(Input&)>& processInputFunction,
+		const std::function<void(int, std::exception_ptr)>& handleErrorFunction)
+		: PipelineStage<Input, Output, ConflatingInputQueue<Input, Key, Hash>>(
+			stageId,
+			processInputFunction,
+			handleErrorFunction)
+		, m_droppedCount(0)
+	{
+		this->inputQueue().initialize(keyFunction, maxKeys);
+	}
+
+	template<class Input, class Output, class Key, class Hash>
+	void ConflatingPipelineStage<Input, Output, Key, Hash>::addInput(Input& input)
+	{
+		bool isWaiting = false;
+		while (this->isAcceptingInputs())
+		{
+			auto result = this->inputQueue().tryPush(input);
+			if (result == ConflatingInputQueue<Input, Key, Hash>::Queued)
+			{
+				// Only an input that took an entry of its own is announced, so
+				// that the stage's statistics count the inputs that are still
+				// to be processed
+				this->onInputAdded();
+				return;
+			}
+			else if (result == ConflatingInputQueue<Input, Key, Hash>::Conflated)
+			{
+				return;
+			}
+
+			// Every entry is pending, and only a worker frees one
+			if (!this->isActive())
+			{
+				m_droppedCount.fetch_add(1, std::memory_order_relaxed);
+				return;
+			}
+
+			isWaiting = true;
+			concurrency::wait(c_conflatingWaitMilliseconds);
+		}
+
+		// The stage started flushing while the input waited for an entry
+		if (isWaiting)
+		{
+			m_droppedCount.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+
+	template<class Input, class Output, class Key, class Hash>
+	unsigned long long ConflatingPipelineStage<Input, Output, Key, Hash>::conflatedCount() const
+	{
+		return this->inputQueue().conflatedCount();
+	}
+
+	template<class Input, class Output, class Key, class Hash>
+	unsigned long long ConflatingPipelineStage<Input, Output, Key, Hash>::droppedCount() const
+	{
+		return m_droppedCount.load(std::memory_order_relaxed);
+	}
+
+#pragma endregion
+
+}}
@@ -0,0 +1,144 @@
+#pragma once
+
+#include "DeliveryFailure.h"
+#include "IConnectable.h"
+
+#include <concrt.h>
+#include <ppl.h>
+#include <ppltasks.h>
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <vector>
+
+
+namespace Tools { namespace Parallel {
+
+	/*
+	 * ConnectableBase keeps the set of consumers of anything that produces
+	 * values of type T, whether a pipeline stage or a source, and provides
+	 * the helpers to activate them, pass a value to all of them and flush
+	 * them.
+	 *
+	 * The consumers are held in an immutable snapshot that is replaced as a
+	 * whole whenever they change, and every change bumps a version. Each
+	 * thread that passes values caches the snapshot it last used, and only
+	 * goes back to the shared one, under the update lock, once the version
+	 * has moved on. While passing a value a thread announces the version it
+	 * is using; a replaced snapshot is released, and swapAsync completes,
+	 * once no thread announces an older version. Passing a value therefore
+	 * takes no lock and writes nothing shared, connecting, disconnecting or
+	 * swapping consumers never stalls the data path, and each value goes to
+	 * the consumers of exactly one snapshot.
+	 *
+	 * A value is passed to every consumer even if some of them refuse it;
+	 * pushToConsumers then throws a DeliveryFailure that passes the value
+	 * again to only those that refused it.
+	 */
+	template<class T>
+	class ConnectableBase : public IConnectable<T>
+	{
+	public:
+		ConnectableBase();
+		virtual ~ConnectableBase();
+
+#pragma region IConnectable implementations
+
+		void connect(const std::shared_ptr<IConsumerStage<T>>& consumer) override;
+		void disconnect(const std::shared_ptr<IConsumerStage<T>>& consumer) override;
+		void disconnectAll() override;
+		void swap(
+			const std::shared_ptr<IConsumerStage<T>>& current,
+			const std::shared_ptr<IConsumerStage<T>>& replacement) override;
+		concurrency::task<void> swapAsync(
+			const std::shared_ptr<IConsumerStage<T>>& current,
+			const std::shared_ptr<IConsumerStage<T>>& replacement,
+			bool drainCurrent) override;
+
+#pragma endregion
+
+	protected:
+		std::vector<std::shared_ptr<IPipelineStage>> consumerStages();
+		void activateConsumers();
+		void pushToConsumers(T& value);
+		concurrency::task<void> flushConsumers();
+
+	private:
+		typedef std::map<int, std::shared_ptr<IConsumerStage<T>>> ConsumerMap;
+
+		// A thread that passes values, and the snapshot it last used
+		struct Reader
+		{
+			Reader();
+
+			unsigned long long version;
+			const ConsumerMap* consumers;
+
+			// The version the thread is passing a value with, or zero
+			std::atomic<unsigned long long> activeVersion;
+			unsigned int depth;
+		};
+
+		// A replaced snapshot, kept until every thread is past version
+		struct RetiredConsumers
+		{
+			unsigned long long version;
+			std::shared_ptr<const ConsumerMap> consumers;
+			concurrency::task_completion_event<void> released;
+		};
+
+		// Announces the calling thread's version for as long as it lives
+		class ReadScope
+		{
+		public:
+			explicit ReadScope(ConnectableBase<T>& connectable);
+			~ReadScope();
+
+			const ConsumerMap& consumers() const;
+
+		private:
+			ConnectableBase<T>& m_connectable;
+			Reader& m_reader;
+		};
+
+		static void redeliver(const std::vector<std::shared_ptr<IConsumerStage<T>>>& consumers, T& value);
+		static void throwIfRefused(
+			const std::vector<std::shared_ptr<IConsumerStage<T>>>& refusingConsumers,
+			T& value,
+			std::exception_ptr firstError);
+
+		static bool replaceConsumer(
+			ConsumerMap& consumers,
+			const std::shared_ptr<IConsumerStage<T>>& current,
+			const std::shared_ptr<IConsumerStage<T>>& replacement);
+
+		std::shared_ptr<const ConsumerMap> loadConsumers();
+		Reader& threadReader();
+
+		/*
+		 * Applies update to a copy of the current consumers and publishes
+		 * the copy. Returns the task that completes once no thread can pass
+		 * a value to the replaced consumers any more.
+		 */
+		template<class Update>
+		concurrency::task<void> updateConsumers(Update update);
+
+		/*
+		 * Releases the replaced snapshots that no thread can still be
+		 * using, and completes the tasks waiting for them.
+		 */
+		void releaseRetiredConsumers();
+
+		std::shared_ptr<const ConsumerMap> m_consumers;
+		std::atomic<unsigned long long> m_version;
+		std::vector<RetiredConsumers> m_retiredConsumers;
+		std::atomic<size_t> m_retiredCount;
+		std::vector<std::unique_ptr<Reader>> m_readers;
+		concurrency::combinable<Reader*> m_threadReaders;
+		concurrency::critical_section m_updateLock;
+	};
+
+}}
+
+#include "ConnectableBase.hpp"
@@ -0,0 +1,398 @@
+#include <algorithm>
+#include <limits>
+
+
+namespace Tools { namespace Parallel {
+
+	template<class T>
+	ConnectableBase<T>::ConnectableBase()
+		: m_consumers(std::make_shared<const ConsumerMap>())
+		, m_version(1)
+		, m_retiredCount(0)
+	{
+	}
+
+	template<class T>
+	ConnectableBase<T>::~ConnectableBase()
+	{
+		// No value can be passed any more, so nothing still uses a replaced
+		// snapshot
+		for (auto iter = m_retiredConsumers.begin(); iter != m_retiredConsumers.end(); ++iter)
+		{
+			iter->released.set();
+		}
+	}
+
+	template<class T>
+	ConnectableBase<T>::Reader::Reader()
+		: version(0)
+		, consumers(nullptr)
+		, activeVersion(0)
+		, depth(0)
+	{
+	}
+
+	template<class T>
+	ConnectableBase<T>::ReadScope::ReadScope(ConnectableBase<T>& connectable)
+		: m_connectable(connectable)
+		, m_reader(connectable.threadReader())
+	{
+		// A value passed while passing another keeps the outer snapshot
+		if (m_reader.depth++ > 0)
+		{
+			return;
+		}
+
+		for (;;)
+		{
+			unsigned long long version = m_connectable.m_version.load(std::memory_order_acquire);
+			m_reader.activeVersion.store(version);
+
+			// Either updateConsumers sees this announcement when it looks for
+			// the threads still using its replaced snapshot, or this thread
+			// sees the version it published
+			if (m_connectable.m_version.load() != version)
+			{
+				continue;
+			}
+
+			if (m_reader.version != version)
+			{
+				concurrency::critical_section::scoped_lock lock(m_connectable.m_updateLock);
+				m_reader.consumers = m_connectable.m_consumers.get();
+				m_reader.version = m_connectable.m_version.load(std::memory_order_relaxed);
+			}
+
+			return;
+		}
+	}
+
+	template<class T>
+	ConnectableBase<T>::ReadScope::~ReadScope()
+	{
+		if (--m_reader.depth > 0)
+		{
+			return;
+		}
+
+		m_reader.activeVersion.store(0);
+		if (m_connectable.m_retiredCount.load() > 0)
+		{
+			m_connectable.releaseRetiredConsumers();
+		}
+	}
+
+	template<class T>
+	const typename ConnectableBase<T>::ConsumerMap& ConnectableBase<T>::ReadScope::consumers() const
+	{
+		return *m_reader.consumers;
+	}
+
+	template<class T>
+	void ConnectableBase<T>::connect(const std::shared_ptr<IConsumerStage<T>>& consumer)
+	{
+		if (consumer == nullptr)
+		{
+			throw std::invalid_argument("Invalid consumer.");
+		}
+
+		updateConsumers([&consumer](ConsumerMap& consumers)
+		{
+			int id = consumer->stageId();
+			if (consumers.count(id) == 0)
+			{
+				consumers[id] = consumer;
+			}
+		});
+	}
+
+	template<class T>
+	void ConnectableBase<T>::disconnect(const std::shared_ptr<IConsumerStage<T>>& consumer)
+	{
+		if (consumer == nullptr)
+		{
+			throw std::invalid_argument("Invalid consumer.");
+		}
+
+		updateConsumers([&consumer](ConsumerMap& consumers)
+		{
+			consumers.erase(consumer->stageId());
+		});
+	}
+
+	template<class T>
+	void ConnectableBase<T>::disconnectAll()
+	{
+		updateConsumers([](ConsumerMap& consumers)
+		{
+			consumers.clear();
+		});
+	}
+
+	template<class T>
+	void ConnectableBase<T>::swap(
+		const std::shared_ptr<IConsumerStage<T>>& current,
+		const std::shared_ptr<IConsumerStage<T>>& replacement)
+	{
+		if (current == nullptr || replacement == nullptr)
+		{
+			throw std::invalid_argument("Invalid consumer.");
+		}
+
+		updateConsumers([&current, &replacement](ConsumerMap& consumers)
+		{
+			replaceConsumer(consumers, current, replacement);
+		});
+	}
+
+	template<class T>
+	concurrency::task<void> ConnectableBase<T>::swapAsync(
+		const std::shared_ptr<IConsumerStage<T>>& current,
+		const std::shared_ptr<IConsumerStage<T>>& replacement,
+		bool drainCurrent)
+	{
+		if (current == nullptr || replacement == nullptr)
+		{
+			throw std::invalid_argument("Invalid consumer.");
+		}
+
+		bool isSwapped = false;
+		auto previousConsumersReleased = updateConsumers([&current, &replacement, &isSwapped](ConsumerMap& consumers)
+		{
+			isSwapped = replaceConsumer(consumers, current, replacement);
+		});
+
+		if (!isSwapped)
+		{
+			return concurrency::task_from_result();
+		}
+
+		// Once the previous snapshot is released, no thread is passing a
+		// value to current any more
+		auto consumer = current;
+		return previousConsumersReleased.then([consumer, drainCurrent]()
+		{
+			if (drainCurrent)
+			{
+				// Only current's own inputs: its consumers may still be
+				// receiving values through replacement
+				consumer->flushOne().wait();
+			}
+		});
+	}
+
+	template<class T>
+	std::vector<std::shared_ptr<IPipelineStage>> ConnectableBase<T>::consumerStages()
+	{
+		std::vector<std::shared_ptr<IPipelineStage>> consumerStages;
+		auto consumers = loadConsumers();
+
+		for (auto iter = consumers->begin(); iter != consumers->end(); ++iter)
+		{
+			consumerStages.push_back(iter->second);
+		}
+
+		return consumerStages;
+	}
+
+	template<class T>
+	void ConnectableBase<T>::activateConsumers()
+	{
+		auto consumers = loadConsumers();
+		for (auto iter = consumers->begin(); iter != consumers->end(); ++iter)
+		{
+			auto& consumer = iter->second;
+			consumer->activate();
+		}
+	}
+
+	template<class T>
+	void ConnectableBase<T>::pushToConsumers(T& value)
+	{
+		std::vector<std::shared_ptr<IConsumerStage<T>>> refusingConsumers;
+		std::exception_ptr firstError;
+
+		ReadScope scope(*this);
+		const ConsumerMap& consumers = scope.consumers();
+		for (auto iter = consumers.begin(); iter != consumers.end(); ++iter)
+		{
+			// Pass value to each of the consumers, even after one refuses it
+			auto& consumer = iter->second;
+			try
+			{
+				consumer->addInput(value);
+			}
+			catch (...)
+			{
+				firstError = firstError ? firstError : std::current_exception();
+				refusingConsumers.push_back(consumer);
+			}
+		}
+
+		throwIfRefused(refusingConsumers, value, firstError);
+	}
+
+	template<class T>
+	concurrency::task<void> ConnectableBase<T>::flushConsumers()
+	{
+		std::vector<concurrency::task<void>> flushConsumersTasks;
+		auto consumers = loadConsumers();
+
+		for (auto iter = consumers->begin(); iter != consumers->end(); ++iter)
+		{
+			auto& consumer = iter->second;
+			flushConsumersTasks.push_back(consumer->flushAll());
+		}
+
+		return concurrency::when_all(flushConsumersTasks.begin(), flushConsumersTasks.end());
+	}
+
+	template<class T>
+	void ConnectableBase<T>::redeliver(const std::vector<std::shared_ptr<IConsumerStage<T>>>& consumers, T& value)
+	{
+		std::vector<std::shared_ptr<IConsumerStage<T>>> refusingConsumers;
+		std::exception_ptr firstError;
+
+		for (auto iter = consumers.begin(); iter != consumers.end(); ++iter)
+		{
+			try
+			{
+				(*iter)->addInput(value);
+			}
+			catch (...)
+			{
+				firstError = firstError ? firstError : std::current_exception();
+				refusingConsumers.push_back(*iter);
+			}
+		}
+
+		throwIfRefused(refusingConsumers, value, firstError);
+	}
+
+	template<class T>
+	void ConnectableBase<T>::throwIfRefused(
+		const std::vector<std::shared_ptr<IConsumerStage<T>>>& refusingConsumers,
+		T& value,
+		std::exception_ptr firstError)
+	{
+		if (refusingConsumers.empty())
+		{
+			return;
+		}
+
+		// The failure keeps its own copy of value, since the caller's may be
+		// gone by the time the failure is retried
+		T kept = value;
+		throw DeliveryFailure(firstError, [refusingConsumers, kept]() mutable
+		{
+			redeliver(refusingConsumers, kept);
+		});
+	}
+
+	template<class T>
+	bool ConnectableBase<T>::replaceConsumer(
+		ConsumerMap& consumers,
+		const std::shared_ptr<IConsumerStage<T>>& current,
+		const std::shared_ptr<IConsumerStage<T>>& replacement)
+	{
+		int currentId = current->stageId();
+		int replacementId = replacement->stageId();
+
+		if (consumers.count(currentId) > 0)
+		{
+			if (currentId == replacementId)
+			{
+				consumers[currentId] = replacement;
+				return true;
+			}
+			else if (consumers.count(replacementId) == 0)
+			{
+				consumers.erase(currentId);
+				consumers[replacementId] = replacement;
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	template<class T>
+	std::shared_ptr<const typename ConnectableBase<T>::ConsumerMap> ConnectableBase<T>::loadConsumers()
+	{
+		concurrency::critical_section::scoped_lock lock(m_updateLock);
+		return m_consumers;
+	}
+
+	template<class T>
+	typename ConnectableBase<T>::Reader& ConnectableBase<T>::threadReader()
+	{
+		Reader*& reader = m_threadReaders.local();
+		if (reader == nullptr)
+		{
+			std::unique_ptr<Reader> newReader(new Reader());
+			concurrency::critical_section::scoped_lock lock(m_updateLock);
+			m_readers.push_back(std::move(newReader));
+			reader = m_readers.back().get();
+		}
+
+		return *reader;
+	}
+
+	template<class T>
+	template<class Update>
+	concurrency::task<void> ConnectableBase<T>::updateConsumers(Update update)
+	{
+		concurrency::task_completion_event<void> previousConsumersReleased;
+		{
+			concurrency::critical_section::scoped_lock lock(m_updateLock);
+			auto consumers = std::make_shared<ConsumerMap>(*m_consumers);
+			update(*consumers);
+
+			RetiredConsumers retired;
+			retired.consumers = m_consumers;
+			retired.released = previousConsumersReleased;
+			m_consumers = consumers;
+			retired.version = m_version.fetch_add(1) + 1;
+
+			m_retiredConsumers.push_back(retired);
+			m_retiredCount.store(m_retiredConsumers.size());
+		}
+
+		releaseRetiredConsumers();
+		return concurrency::create_task(previousConsumersReleased);
+	}
+
+	template<class T>
+	void ConnectableBase<T>::releaseRetiredConsumers()
+	{
+		std::vector<RetiredConsumers> released;
+		{
+			concurrency::critical_section::scoped_lock lock(m_updateLock);
+			unsigned long long oldestVersion = (std::numeric_limits<unsigned long long>::max)();
+			for (auto iter = m_readers.begin(); iter != m_readers.end(); ++iter)
+			{
+				unsigned long long version = (*iter)->activeVersion.load();
+				if (version != 0)
+				{
+					oldestVersion = (std::min)(oldestVersion, version);
+				}
+			}
+
+			auto firstKept = std::stable_partition(
+				m_retiredConsumers.begin(),
+				m_retiredConsumers.end(),
+				[oldestVersion](const RetiredConsumers& retired) { return retired.version <= oldestVersion; });
+			released.assign(m_retiredConsumers.begin(), firstKept);
+			m_retiredConsumers.erase(m_retiredConsumers.begin(), firstKept);
+			m_retiredCount.store(m_retiredConsumers.size());
+		}
+
+		// Outside the lock, since the last reference to a consumer may go
+		// with its snapshot
+		for (auto iter = released.begin(); iter != released.end(); ++iter)
+		{
+			iter->released.set();
+		}
+	}
+
+}}
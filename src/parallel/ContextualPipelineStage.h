@@ -0,0 +1,155 @@
+#pragma once
+
+#include "PipelineStageBase.h"
+#include "ConnectableBase.h"
+
+#include <concrt.h>
+#include <ppl.h>
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+
+namespace Tools { namespace Parallel {
+
+#pragma region ContextualPipelineStageBase<Input, Context>
+
+	/*
+	 * ContextualPipelineStageBase gives each worker of a stage a Context of
+	 * its own, for scratch state such as parse buffers that would otherwise
+	 * be allocated for every input. A worker creates its context with the
+	 * factory the first time it processes an input. When the worker stops,
+	 * its context is kept for the next worker, so a stage creates at most
+	 * as many contexts as it runs workers at once. Deactivating or flushing
+	 * the stage destroys them, so the next input starts from a fresh one.
+	 */
+	template<class Input, class Context>
+	class ContextualPipelineStageBase : public PipelineStageBase<Input>
+	{
+	public:
+#pragma region Constructors and Destructor
+
+		ContextualPipelineStageBase(
+			int stageId,
+			const std::function<Context()>& createContextFunction,
+			const std::function<void(int, std::exception_ptr)>& handleErrorFunction);
+
+		~ContextualPipelineStageBase();
+
+		ContextualPipelineStageBase(const ContextualPipelineStageBase<Input, Context>& other) = delete;
+
+#pragma endregion
+
+#pragma region PipelineStageBase overrides
+
+		concurrency::task<void> deactivate() override;
+		concurrency::task<void> flushOne() override;
+
+	protected:
+		void onWorkerStopped() override;
+
+#pragma endregion
+
+		/*
+		 * The calling worker's context, created on first use.
+		 */
+		Context& workerContext();
+
+	private:
+		struct IdleContexts
+		{
+			std::vector<std::unique_ptr<Context>> contexts;
+			concurrency::critical_section lock;
+		};
+
+		static concurrency::task<void> discardIdleContexts(
+			const concurrency::task<void>& stopTask,
+			const std::shared_ptr<IdleContexts>& idleContexts);
+
+		std::function<Context()> m_createContext;
+		concurrency::combinable<Context*> m_workerContexts;
+		std::shared_ptr<IdleContexts> m_idleContexts;
+	};
+
+#pragma endregion
+
+#pragma region ContextualPipelineStage<Input, Output, Context>
+
+	/*
+	 * A PipelineStage whose process function also receives the calling
+	 * worker's Context.
+	 */
+	template<class Input, class Output, class Context>
+	class ContextualPipelineStage
+		: public ContextualPipelineStageBase<Input, Context>
+		, public ConnectableBase<Output>
+		, public std::enable_shared_from_this<ContextualPipelineStage<Input, Output, Context>>
+	{
+	public:
+#pragma region Constructors and Destructor
+
+		ContextualPipelineStage(
+			int stageId,
+			const std::function<Context()>& createContextFunction,
+			const std::function<Output(Input&, Context&)>& processInputFunction);
+
+		ContextualPipelineStage(
+			int stageId,
+			const std::function<Context()>& createContextFunction,
+			const std::function<Output(Input&, Context&)>& processInputFunction,
+			const std::function<void(int, std::exception_ptr)>& handleErrorFunction);
+
+		ContextualPipelineStage(const ContextualPipelineStage<Input, Output, Context>& other) = delete;
+
+#pragma endregion
+
+#pragma region PipelineStageBase overrides
+
+		concurrency::task<void> flushAll() override;
+		std::vector<std::shared_ptr<IPipelineStage>> consumerStages() override;
+		protected: void processInput(Input& input) override;
+
+#pragma endregion
+
+	private:
+		std::function<Output(Input&, Context&)> m_processInput;
+	};
+
+#pragma endregion
+
+#pragma region ContextualPipelineStage<Input, void, Context>
+
+	/*
+	 * Partial template specialization of ContextualPipelineStage with a void
+	 * output type, for a final stage.
+	 */
+	template<class Input, class Context>
+	class ContextualPipelineStage<Input, void, Context> : public ContextualPipelineStageBase<Input, Context>
+	{
+	public:
+		ContextualPipelineStage(
+			int stageId,
+			const std::function<Context()>& createContextFunction,
+			const std::function<void(Input&, Context&)>& processInputFunction);
+
+		ContextualPipelineStage(
+			int stageId,
+			const std::function<Context()>& createContextFunction,
+			const std::function<void(Input&, Context&)>& processInputFunction,
+			const std::function<void(int, std::exception_ptr)>& handleErrorFunction);
+
+		ContextualPipelineStage(const ContextualPipelineStage<Input, void, Context>& other) = delete;
+
+	protected:
+		void processInput(Input& input) override;
+
+	private:
+		std::function<void(Input&, Context&)> m_processInput;
+	};
+
+#pragma endregion
+
+}}
+
+#include "ContextualPipelineStage.hpp"
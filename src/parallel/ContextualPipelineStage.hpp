@@ -0,0 +1,211 @@
+#include <stdexcept>
+
+
+namespace Tools { namespace Parallel {
+
+#pragma region ContextualPipelineStageBase<Input, Context>
+
+	template<class Input, class Context>
+	ContextualPipelineStageBase<Input, Context>::ContextualPipelineStageBase(
+		int stageId,
+		const std::function<Context()>& createContextFunction,
+		const std::function<void(int, std::exception_ptr)>& handleErrorFunction)
+		: PipelineStageBase<Input>(
+			stageId,
+			handleErrorFunction)
+		, m_createContext(createContextFunction)
+		, m_idleContexts(std::make_shared<IdleContexts>())
+	{
+		if (m_createContext == nullptr)
+		{
+			throw std::invalid_argument("ContextualPipelineStage requires a valid create context function.");
+		}
+	}
+
+	template<class Input, class Context>
+	ContextualPipelineStageBase<Input, Context>::~ContextualPipelineStageBase()
+	{
+		// Workers return their contexts through onWorkerStopped, which must
+		// not outlive this class
+		PipelineStageBase<Input>::deactivate().wait();
+	}
+
+	template<class Input, class Context>
+	concurrency::task<void> ContextualPipelineStageBase<Input, Context>::deactivate()
+	{
+		return discardIdleContexts(PipelineStageBase<Input>::deactivate(), m_idleContexts);
+	}
+
+	template<class Input, class Context>
+	concurrency::task<void> ContextualPipelineStageBase<Input, Context>::flushOne()
+	{
+		return discardIdleContexts(PipelineStageBase<Input>::flushOne(), m_idleContexts);
+	}
+
+	template<class Input, class Context>
+	void ContextualPipelineStageBase<Input, Context>::onWorkerStopped()
+	{
+		Context*& context = m_workerContexts.local();
+		if (context != nullptr)
+		{
+			concurrency::critical_section::scoped_lock lock(m_idleContexts->lock);
+			m_idleContexts->contexts.push_back(std::unique_ptr<Context>(context));
+			context = nullptr;
+		}
+	}
+
+	template<class Input, class Context>
+	Context& ContextualPipelineStageBase<Input, Context>::workerContext()
+	{
+		Context*& context = m_workerContexts.local();
+		if (context != nullptr)
+		{
+			return *context;
+		}
+
+		{
+			concurrency::critical_section::scoped_lock lock(m_idleContexts->lock);
+			if (!m_idleContexts->contexts.empty())
+			{
+				context = m_idleContexts->contexts.back().release();
+				m_idleContexts->contexts.pop_back();
+				return *context;
+			}
+		}
+
+		// A factory that throws fails the input like any other error
+		context = new Context(m_createContext());
+		return *context;
+	}
+
+	template<class Input, class Context>
+	concurrency::task<void> ContextualPipelineStageBase<Input, Context>::discardIdleContexts(
+		const concurrency::task<void>& stopTask,
+		const std::shared_ptr<IdleContexts>& idleContexts)
+	{
+		// Every worker has stopped, and so has returned its context, once
+		// stopTask completes. The contexts are shared with the continuation
+		// so that it is safe even if the stage is gone by then.
+		return stopTask.then([idleContexts]()
+		{
+			std::vector<std::unique_ptr<Context>> contexts;
+			{
+				concurrency::critical_section::scoped_lock lock(idleContexts->lock);
+				contexts.swap(idleContexts->contexts);
+			}
+		});
+	}
+
+#pragma endregion
+
+#pragma region ContextualPipelineStage<Input, Output, Context>
+
+	template<class Input, class Output, class Context>
+	ContextualPipelineStage<Input, Output, Context>::ContextualPipelineStage(
+		int stageId,
+		const std::function<Context()>& createContextFunction,
+		const std::function<Output(Input&, Context&)>& processInputFunction)
+		: ContextualPipelineStage<Input, Output, Context>(
+			stageId,
+			createContextFunction,
+			processInputFunction,
+			nullptr /*handleErrorFunction*/)
+	{
+	}
+
+	template<class Input, class Output, class Context>
+	ContextualPipelineStage<Input, Output, Context>::ContextualPipelineStage(
+		int stageId,
+		const std::function<Context()>& createContextFunction,
+		const std::function<Output(Input&, Context&)>& processInputFunction,
+		const std::function<void(int, std::exception_ptr)>& handleErrorFunction)
+		: ContextualPipelineStageBase<Input, Context>(
+			stageId,
+			createContextFunction,
+			handleErrorFunction)
+		, m_processInput(processInputFunction)
+	{
+		if (m_processInput == nullptr)
+		{
+			throw std::invalid_argument("ContextualPipelineStage requires a valid process input function.");
+		}
+	}
+
+	template<class Input, class Output, class Context>
+	concurrency::task<void> ContextualPipelineStage<Input, Output, Context>::flushAll()
+	{
+		auto flushOneTask = this->flushOne();
+		std::weak_ptr<ContextualPipelineStage<Input, Output, Context>> wpThis(this->shared_from_this());
+
+		return flushOneTask.then([wpThis]()
+		{
+			auto spThis = wpThis.lock();
+			if (spThis != nullptr)
+			{
+				std::vector<concurrency::task<void>> flushTasks { spThis->flushConsumers(), spThis->flushDeadLetterStage() };
+				return concurrency::when_all(flushTasks.begin(), flushTasks.end());
+			}
+			else
+			{
+				return concurrency::task_from_result();
+			}
+		});
+	}
+
+	template<class Input, class Output, class Context>
+	std::vector<std::shared_ptr<IPipelineStage>> ContextualPipelineStage<Input, Output, Context>::consumerStages()
+	{
+		return ConnectableBase<Output>::consumerStages();
+	}
+
+	template<class Input, class Output, class Context>
+	void ContextualPipelineStage<Input, Output, Context>::processInput(Input& input)
+	{
+		Output output = m_processInput(input, this->workerContext());
+		this->pushToConsumers(output);
+	}
+
+#pragma endregion
+
+#pragma region ContextualPipelineStage<Input, void, Context>
+
+	template<class Input, class Context>
+	ContextualPipelineStage<Input, void, Context>::ContextualPipelineStage(
+		int stageId,
+		const std::function<Context()>& createContextFunction,
+		const std::function<void(Input&, Context&)>& processInputFunction)
+		: ContextualPipelineStage<Input, void, Context>(
+			stageId,
+			createContextFunction,
+			processInputFunction,
+			nullptr /*handleErrorFunction*/)
+	{
+	}
+
+	template<class Input, class Context>
+	ContextualPipelineStage<Input, void, Context>::ContextualPipelineStage(
+		int stageId,
+		const std::function<Context()>& createContextFunction,
+		const std::function<void(Input&, Context&)>& processInputFunction,
+		const std::function<void(int, std::exception_ptr)>& handleErrorFunction)
+		: ContextualPipelineStageBase<Input, Context>(
+			stageId,
+			createContextFunction,
+			handleErrorFunction)
+		, m_processInput(processInputFunction)
+	{
+		if (m_processInput == nullptr)
+		{
+			throw std::invalid_argument("ContextualPipelineStage requires a valid process input function.");
+		}
+	}
+
+	template<class Input, class Context>
+	void ContextualPipelineStage<Input, void, Context>::processInput(Input& input)
+	{
+		m_processInput(input, this->workerContext());
+	}
+
+#pragma endregion
+
+}}
@@ -0,0 +1,191 @@
+#pragma once
+
+#include "IConsumerStage.h"
+#include "PipelineStage.h"
+
+#include <ppltasks.h>
+
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <utility>
+
+
+namespace Tools { namespace Parallel {
+
+	namespace Details
+	{
+		/*
+		 * Where the result of one submitted input is delivered. Every copy
+		 * of the envelope holds a reference to it, and the first of respond
+		 * or fail to claim isAnswered answers it. If the last reference goes
+		 * without an answer, the caller fails instead of waiting forever.
+		 */
+		template<class Result>
+		struct ResponseSlot
+		{
+			ResponseSlot();
+			~ResponseSlot();
+
+			// Both accept null, the response of an envelope that has none
+			static void retain(ResponseSlot<Result>* slot);
+			static void release(ResponseSlot<Result>* slot);
+
+			std::atomic<unsigned int> references;
+			std::atomic<bool> isAnswered;
+			concurrency::task_completion_event<Result> completion;
+		};
+	}
+
+	/*
+	 * An envelope that carries a value through a pipeline together with the
+	 * response its caller is waiting for. The response travels with the
+	 * value, so no table is needed to match results to callers, and it adds
+	 * a single pointer to each input. The response counts its references
+	 * itself, so copying an envelope touches that count only.
+	 *
+	 * Copies of an envelope, such as those a stage fans out to several
+	 * consumers, share its response, which is answered once: the first
+	 * respond or fail wins, and the others are ignored. An envelope without
+	 * a response is processed as usual but its result goes nowhere. A
+	 * stage's failure is answered only once the stage gives up on the
+	 * input, so a retry that succeeds still responds. An input that never
+	 * reaches the responding stage, because a stage refused, deduplicated,
+	 * conflated or otherwise dropped it, fails its caller once the last
+	 * copy of its envelope is gone.
+	 */
+	template<class T, class Result>
+	struct Correlated
+	{
+		Correlated()
+			: value()
+			, response(nullptr)
+		{
+		}
+
+		Correlated(const Correlated<T, Result>& other)
+			: value(other.value)
+			, response(other.response)
+		{
+			Details::ResponseSlot<Result>::retain(response);
+		}
+
+		Correlated(Correlated<T, Result>&& other)
+			: value(std::move(other.value))
+			, response(other.response)
+		{
+			other.response = nullptr;
+		}
+
+		~Correlated()
+		{
+			Details::ResponseSlot<Result>::release(response);
+		}
+
+		Correlated<T, Result>& operator=(const Correlated<T, Result>& other)
+		{
+			// Retained first, in case other is this envelope
+			Details::ResponseSlot<Result>::retain(other.response);
+			Details::ResponseSlot<Result>::release(response);
+
+			value = other.value;
+			response = other.response;
+			return *this;
+		}
+
+		Correlated<T, Result>& operator=(Correlated<T, Result>&& other)
+		{
+			if (this != &other)
+			{
+				Details::ResponseSlot<Result>::release(response);
+
+				value = std::move(other.value);
+				response = other.response;
+				other.response = nullptr;
+			}
+
+			return *this;
+		}
+
+		T value;
+		Details::ResponseSlot<Result>* response;
+	};
+
+	/*
+	 * Fails the response of an input that a stage gave up on.
+	 */
+	template<class T, class Result>
+	void onInputAbandoned(Correlated<T, Result>& correlated, std::exception_ptr error);
+
+#pragma region Calls
+
+	/*
+	 * Adds input to the entry stage of a pipeline of correlated stages and
+	 * returns a task that completes with the result that reaches the
+	 * responding stage, or fails with the exception that a stage's process
+	 * function threw.
+	 */
+	template<class Input, class Result>
+	concurrency::task<Result> submit(
+		const std::shared_ptr<IConsumerStage<Correlated<Input, Result>>>& entryStage,
+		const Input& input);
+
+	template<class T, class Result>
+	void respond(Correlated<T, Result>& correlated, const Result& result);
+
+	template<class T, class Result>
+	void fail(Correlated<T, Result>& correlated, std::exception_ptr error);
+
+#pragma endregion
+
+#pragma region Stages
+
+	/*
+	 * Wraps a process function so that it takes and returns Correlated
+	 * envelopes. An exception goes to the stage's error handling, which
+	 * fails the caller's response once it gives up on the input.
+	 */
+	template<class Input, class Output, class Result>
+	class CorrelatingFunction
+	{
+	public:
+		explicit CorrelatingFunction(const std::function<Output(Input&)>& processInputFunction);
+
+		Correlated<Output, Result> operator()(Correlated<Input, Result>& input) const;
+
+	private:
+		std::function<Output(Input&)> m_processInput;
+	};
+
+	template<class Input, class Output, class Result>
+	std::shared_ptr<PipelineStage<Correlated<Input, Result>, Correlated<Output, Result>>> makeCorrelatedStage(
+		int stageId,
+		const std::function<Output(Input&)>& processInputFunction);
+
+	template<class Input, class Output, class Result>
+	std::shared_ptr<PipelineStage<Correlated<Input, Result>, Correlated<Output, Result>>> makeCorrelatedStage(
+		int stageId,
+		const std::function<Output(Input&)>& processInputFunction,
+		const std::function<void(int, std::exception_ptr)>& handleErrorFunction);
+
+	/*
+	 * Creates the final stage of a correlated pipeline, which answers each
+	 * caller with the result that reaches it. The optional process function
+	 * runs first, as in any final stage; if it throws and the stage gives
+	 * up on the input, the caller gets the exception instead.
+	 */
+	template<class Result>
+	std::shared_ptr<PipelineStage<Correlated<Result, Result>, void>> makeRespondingStage(int stageId);
+
+	template<class Result>
+	std::shared_ptr<PipelineStage<Correlated<Result, Result>, void>> makeRespondingStage(
+		int stageId,
+		const std::function<void(Result&)>& processInputFunction,
+		const std::function<void(int, std::exception_ptr)>& handleErrorFunction);
+
+#pragma endregion
+
+}}
+
+#include "Correlated.hpp"
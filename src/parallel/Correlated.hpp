@@ -0,0 +1,177 @@
+#include <stdexcept>
+
+
+namespace Tools { namespace Parallel {
+
+	namespace Details
+	{
+		template<class Result>
+		ResponseSlot<Result>::ResponseSlot()
+			: references(1)
+			, isAnswered(false)
+		{
+		}
+
+		template<class Result>
+		ResponseSlot<Result>::~ResponseSlot()
+		{
+			if (!isAnswered.exchange(true))
+			{
+				completion.set_exception(std::make_exception_ptr(std::runtime_error("The input was dropped before it was answered.")));
+			}
+		}
+
+		template<class Result>
+		void ResponseSlot<Result>::retain(ResponseSlot<Result>* slot)
+		{
+			if (slot != nullptr)
+			{
+				slot->references.fetch_add(1, std::memory_order_relaxed);
+			}
+		}
+
+		template<class Result>
+		void ResponseSlot<Result>::release(ResponseSlot<Result>* slot)
+		{
+			if (slot != nullptr && slot->references.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			{
+				delete slot;
+			}
+		}
+	}
+
+	template<class Input, class Result>
+	concurrency::task<Result> submit(
+		const std::shared_ptr<IConsumerStage<Correlated<Input, Result>>>& entryStage,
+		const Input& input)
+	{
+		if (entryStage == nullptr)
+		{
+			throw std::invalid_argument("Invalid entry stage.");
+		}
+
+		// The envelope owns the slot's first reference
+		Correlated<Input, Result> correlated;
+		correlated.value = input;
+		correlated.response = new Details::ResponseSlot<Result>();
+		auto result = concurrency::create_task(correlated.response->completion);
+
+		try
+		{
+			entryStage->addInput(correlated);
+		}
+		catch (...)
+		{
+			// The caller gets the exception from submit, not from the task
+			correlated.response->isAnswered = true;
+			throw;
+		}
+
+		return result;
+	}
+
+	template<class T, class Result>
+	void respond(Correlated<T, Result>& correlated, const Result& result)
+	{
+		auto response = correlated.response;
+		correlated.response = nullptr;
+
+		if (response != nullptr && !response->isAnswered.exchange(true))
+		{
+			response->completion.set(result);
+		}
+
+		Details::ResponseSlot<Result>::release(response);
+	}
+
+	template<class T, class Result>
+	void fail(Correlated<T, Result>& correlated, std::exception_ptr error)
+	{
+		auto response = correlated.response;
+		correlated.response = nullptr;
+
+		if (response != nullptr && !response->isAnswered.exchange(true))
+		{
+			response->completion.set_exception(error);
+		}
+
+		Details::ResponseSlot<Result>::release(response);
+	}
+
+	template<class T, class Result>
+	void onInputAbandoned(Correlated<T, Result>& correlated, std::exception_ptr error)
+	{
+		fail(correlated, error);
+	}
+
+	template<class Input, class Output, class Result>
+	CorrelatingFunction<Input, Output, Result>::CorrelatingFunction(const std::function<Output(Input&)>& processInputFunction)
+		: m_processInput(processInputFunction)
+	{
+		if (m_processInput == nullptr)
+		{
+			throw std::invalid_argument("A correlated stage requires a valid process input function.");
+		}
+	}
+
+	template<class Input, class Output, class Result>
+	Correlated<Output, Result> CorrelatingFunction<Input, Output, Result>::operator()(Correlated<Input, Result>& input) const
+	{
+		Correlated<Output, Result> output;
+		output.value = m_processInput(input.value);
+
+		// The input keeps its reference, so that its response can still be
+		// failed if the output is refused until the stage gives up
+		output.response = input.response;
+		Details::ResponseSlot<Result>::retain(output.response);
+		return output;
+	}
+
+	template<class Input, class Output, class Result>
+	std::shared_ptr<PipelineStage<Correlated<Input, Result>, Correlated<Output, Result>>> makeCorrelatedStage(
+		int stageId,
+		const std::function<Output(Input&)>& processInputFunction)
+	{
+		return makeCorrelatedStage<Input, Output, Result>(stageId, processInputFunction, nullptr /*handleErrorFunction*/);
+	}
+
+	template<class Input, class Output, class Result>
+	std::shared_ptr<PipelineStage<Correlated<Input, Result>, Correlated<Output, Result>>> makeCorrelatedStage(
+		int stageId,
+		const std::function<Output(Input&)>& processInputFunction,
+		const std::function<void(int, std::exception_ptr)>& handleErrorFunction)
+	{
+		return std::make_shared<PipelineStage<Correlated<Input, Result>, Correlated<Output, Result>>>(
+			stageId,
+			CorrelatingFunction<Input, Output, Result>(processInputFunction),
+			handleErrorFunction);
+	}
+
+	template<class Result>
+	std::shared_ptr<PipelineStage<Correlated<Result, Result>, void>> makeRespondingStage(int stageId)
+	{
+		return makeRespondingStage<Result>(stageId, [](Result&) { }, nullptr /*handleErrorFunction*/);
+	}
+
+	template<class Result>
+	std::shared_ptr<PipelineStage<Correlated<Result, Result>, void>> makeRespondingStage(
+		int stageId,
+		const std::function<void(Result&)>& processInputFunction,
+		const std::function<void(int, std::exception_ptr)>& handleErrorFunction)
+	{
+		if (processInputFunction == nullptr)
+		{
+			throw std::invalid_argument("A responding stage requires a valid process input function.");
+		}
+
+		return std::make_shared<PipelineStage<Correlated<Result, Result>, void>>(
+			stageId,
+			[processInputFunction](Correlated<Result, Result>& input)
+			{
+				processInputFunction(input.value);
+				respond(input, input.value);
+			},
+			handleErrorFunction);
+	}
+
+}}
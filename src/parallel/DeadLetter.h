@@ -0,0 +1,36 @@
+#pragma once
+
+#include <exception>
+
+
+namespace Tools { namespace Parallel {
+
+	/*
+	 * An input that a pipeline stage failed to process, together with the
+	 * error from its final attempt. Stages route dead letters to the stage
+	 * set with setDeadLetterStage.
+	 */
+	template<class Input>
+	struct DeadLetter
+	{
+		DeadLetter()
+			: stageId(0)
+			, attempts(0)
+		{
+		}
+
+		DeadLetter(int stageId, const Input& input, std::exception_ptr error, unsigned int attempts)
+			: stageId(stageId)
+			, input(input)
+			, error(error)
+			, attempts(attempts)
+		{
+		}
+
+		int stageId;
+		Input input;
+		std::exception_ptr error;
+		unsigned int attempts;
+	};
+
+}}
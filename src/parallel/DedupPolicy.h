@@ -0,0 +1,111 @@
+#pragma once
+
+#include <chrono>
+#include <stdexcept>
+
+
+namespace Tools { namespace Parallel {
+
+	/*
+	 * Describes how a DeduplicatingStage remembers keys: over the last so
+	 * many inputs or the last so much time, and either exactly or in
+	 * rotating Bloom filters of bounded size that may drop an input whose
+	 * key was not seen, at the given false positive rate.
+	 *
+	 * The approximate mode takes about 2 bytes per expected key at a 1%
+	 * false positive rate, whatever the size of the keys: a billion keys
+	 * an hour fit in about 2 GB.
+	 */
+	class DedupPolicy
+	{
+	public:
+		enum HorizonMode
+		{
+			LastInputs,
+			LastPeriod
+		};
+
+		enum Mode
+		{
+			Exact,
+			Approximate
+		};
+
+		static DedupPolicy exact(HorizonMode horizonMode, unsigned long long horizon)
+		{
+			return DedupPolicy(horizonMode, horizon, Exact, 0, 0.0);
+		}
+
+		/*
+		 * expectedKeys is the number of distinct keys expected within one
+		 * horizon.
+		 */
+		static DedupPolicy approximate(
+			HorizonMode horizonMode,
+			unsigned long long horizon,
+			unsigned long long expectedKeys,
+			double falsePositiveRate)
+		{
+			if (expectedKeys == 0 || falsePositiveRate <= 0.0 || falsePositiveRate >= 1.0)
+			{
+				throw std::invalid_argument("An approximate dedup policy requires expected keys and a false positive rate between zero and one.");
+			}
+
+			return DedupPolicy(horizonMode, horizon, Approximate, expectedKeys, falsePositiveRate);
+		}
+
+		HorizonMode horizonMode() const
+		{
+			return m_horizonMode;
+		}
+
+		/*
+		 * The horizon in inputs, or in milliseconds for LastPeriod.
+		 */
+		unsigned long long horizon() const
+		{
+			return m_horizon;
+		}
+
+		Mode mode() const
+		{
+			return m_mode;
+		}
+
+		unsigned long long expectedKeys() const
+		{
+			return m_expectedKeys;
+		}
+
+		double falsePositiveRate() const
+		{
+			return m_falsePositiveRate;
+		}
+
+	private:
+		DedupPolicy(
+			HorizonMode horizonMode,
+			unsigned long long horizon,
+			Mode mode,
+			unsigned long long expectedKeys,
+			double falsePositiveRate)
+			: m_horizonMode(horizonMode)
+			, m_horizon(horizon)
+			, m_mode(mode)
+			, m_expectedKeys(expectedKeys)
+			, m_falsePositiveRate(falsePositiveRate)
+		{
+			if (horizon == 0)
+			{
+				throw std::invalid_argument("A dedup policy requires a horizon of at least one.");
+			}
+		}
+
+		HorizonMode m_horizonMode;
+		unsigned long long m_horizon;
+		Mode m_mode;
+		unsigned long long m_expectedKeys;
+		double m_falsePositiveRate;
+	};
+
+}}
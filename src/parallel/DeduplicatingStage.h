@@ -0,0 +1,88 @@
+#pragma once
+
+#include "ConnectableBase.h"
+#include "DedupPolicy.h"
+#include "ExactKeySet.h"
+#include "HashMixing.h"
+#include "PipelineStageBase.h"
+#include "RotatingBloomFilter.h"
+
+#include <concrt.h>
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <vector>
+
+
+namespace Tools { namespace Parallel {
+
+	/*
+	 * DeduplicatingStage passes its inputs on unchanged, except for those
+	 * whose key it has already seen within the horizon of its DedupPolicy,
+	 * which it drops. Keys are spread over shards by hash, each with its
+	 * own lock, so the stage scales with its workers.
+	 */
+	template<class Input, class Key, class Hash = std::hash<Key>>
+	class DeduplicatingStage
+		: public PipelineStageBase<Input>
+		, public ConnectableBase<Input>
+		, public std::enable_shared_from_this<DeduplicatingStage<Input, Key, Hash>>
+	{
+	public:
+		static const unsigned int ShardCount = 16;
+
+#pragma region Constructors and Destructor
+
+		DeduplicatingStage(
+			int stageId,
+			const std::function<Key(Input&)>& keyFunction,
+			const DedupPolicy& policy);
+
+		DeduplicatingStage(
+			int stageId,
+			const std::function<Key(Input&)>& keyFunction,
+			const DedupPolicy& policy,
+			const std::function<void(int, std::exception_ptr)>& handleErrorFunction);
+
+		DeduplicatingStage(const DeduplicatingStage<Input, Key, Hash>& other) = delete;
+
+#pragma endregion
+
+#pragma region PipelineStageBase overrides
+
+		concurrency::task<void> flushAll() override;
+		std::vector<std::shared_ptr<IPipelineStage>> consumerStages() override;
+		protected: void processInput(Input& input) override;
+
+#pragma endregion
+
+	public:
+		unsigned long long passedCount() const;
+		unsigned long long droppedCount() const;
+
+	private:
+		struct Shard
+		{
+			std::unique_ptr<ExactKeySet<Key>> exactKeys;
+			std::unique_ptr<RotatingBloomFilter> approximateKeys;
+			concurrency::critical_section lock;
+		};
+
+		bool isFirstSeen(const Key& key);
+		unsigned long long nextStamp();
+
+		std::function<Key(Input&)> m_key;
+		DedupPolicy m_policy;
+		Hash m_hash;
+		std::vector<std::unique_ptr<Shard>> m_shards;
+		std::chrono::steady_clock::time_point m_startTime;
+		std::atomic<unsigned long long> m_inputsSeen;
+		std::atomic<unsigned long long> m_passed;
+		std::atomic<unsigned long long> m_dropped;
+	};
+
+}}
+
+#include "DeduplicatingStage.hpp"
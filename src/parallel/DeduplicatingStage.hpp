@@ -0,0 +1,135 @@
+namespace Tools { namespace Parallel {
+
+	template<class Input, class Key, class Hash>
+	DeduplicatingStage<Input, Key, Hash>::DeduplicatingStage(
+		int stageId,
+		const std::function<Key(Input&)>& keyFunction,
+		const DedupPolicy& policy)
+		: DeduplicatingStage<Input, Key, Hash>(
+			stageId,
+			keyFunction,
+			policy,
+			nullptr /*handleErrorFunction*/)
+	{
+	}
+
+	template<class Input, class Key, class Hash>
+	DeduplicatingStage<Input, Key, Hash>::DeduplicatingStage(
+		int stageId,
+		const std::function<Key(Input&)>& keyFunction,
+		const DedupPolicy& policy,
+		const std::function<void(int, std::exception_ptr)>& handleErrorFunction)
+		: PipelineStageBase<Input>(
+			stageId,
+			handleErrorFunction)
+		, m_key(keyFunction)
+		, m_policy(policy)
+		, m_startTime(std::chrono::steady_clock::now())
+		, m_inputsSeen(0)
+		, m_passed(0)
+		, m_dropped(0)
+	{
+		if (m_key == nullptr)
+		{
+			throw std::invalid_argument("DeduplicatingStage requires a valid key function.");
+		}
+
+		for (unsigned int i = 0; i < ShardCount; ++i)
+		{
+			std::unique_ptr<Shard> shard(new Shard());
+			if (m_policy.mode() == DedupPolicy::Exact)
+			{
+				shard->exactKeys.reset(new ExactKeySet<Key>(m_policy.horizon()));
+			}
+			else
+			{
+				unsigned long long expectedKeys = (m_policy.expectedKeys() + ShardCount - 1) / ShardCount;
+				shard->approximateKeys.reset(new RotatingBloomFilter(m_policy.horizon(), expectedKeys, m_policy.falsePositiveRate()));
+			}
+
+			m_shards.push_back(std::move(shard));
+		}
+	}
+
+	template<class Input, class Key, class Hash>
+	concurrency::task<void> DeduplicatingStage<Input, Key, Hash>::flushAll()
+	{
+		auto flushOneTask = this->flushOne();
+		std::weak_ptr<DeduplicatingStage<Input, Key, Hash>> wpThis(this->shared_from_this());
+
+		return flushOneTask.then([wpThis]()
+		{
+			auto spThis = wpThis.lock();
+			if (spThis != nullptr)
+			{
+				std::vector<concurrency::task<void>> flushTasks { spThis->flushConsumers(), spThis->flushDeadLetterStage() };
+				return concurrency::when_all(flushTasks.begin(), flushTasks.end());
+			}
+			else
+			{
+				return concurrency::task_from_result();
+			}
+		});
+	}
+
+	template<class Input, class Key, class Hash>
+	std::vector<std::shared_ptr<IPipelineStage>> DeduplicatingStage<Input, Key, Hash>::consumerStages()
+	{
+		return ConnectableBase<Input>::consumerStages();
+	}
+
+	template<class Input, class Key, class Hash>
+	void DeduplicatingStage<Input, Key, Hash>::processInput(Input& input)
+	{
+		if (isFirstSeen(m_key(input)))
+		{
+			m_passed.fetch_add(1, std::memory_order_relaxed);
+			this->pushToConsumers(input);
+		}
+		else
+		{
+			m_dropped.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+
+	template<class Input, class Key, class Hash>
+	unsigned long long DeduplicatingStage<Input, Key, Hash>::passedCount() const
+	{
+		return m_passed.load(std::memory_order_relaxed);
+	}
+
+	template<class Input, class Key, class Hash>
+	unsigned long long DeduplicatingStage<Input, Key, Hash>::droppedCount() const
+	{
+		return m_dropped.load(std::memory_order_relaxed);
+	}
+
+	template<class Input, class Key, class Hash>
+	bool DeduplicatingStage<Input, Key, Hash>::isFirstSeen(const Key& key)
+	{
+		uint64_t hash = Details::mixHash(static_cast<uint64_t>(m_hash(key)));
+		unsigned long long stamp = nextStamp();
+
+		// The low bits choose the slot in an exact key set, so the shard is
+		// taken from the high bits
+		Shard& shard = *m_shards[static_cast<size_t>(hash >> 60) % ShardCount];
+		concurrency::critical_section::scoped_lock lock(shard.lock);
+
+		return shard.exactKeys != nullptr
+			? shard.exactKeys->insert(key, hash, stamp)
+			: shard.approximateKeys->insert(hash, stamp);
+	}
+
+	template<class Input, class Key, class Hash>
+	unsigned long long DeduplicatingStage<Input, Key, Hash>::nextStamp()
+	{
+		if (m_policy.horizonMode() == DedupPolicy::LastInputs)
+		{
+			return m_inputsSeen.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		auto elapsed = std::chrono::steady_clock::now() - m_startTime;
+		return static_cast<unsigned long long>(std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count());
+	}
+
+}}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <exception>
+#include <functional>
+#include <stdexcept>
+
+
+namespace Tools { namespace Parallel {
+
+	/*
+	 * Thrown when an output was computed but some of the consumers it was
+	 * passed to refused it. The others have already received it, so a stage
+	 * that retries must not process the input again; it calls redeliver,
+	 * which passes the same output to the consumers that refused it and
+	 * throws a new DeliveryFailure for those that refuse it again.
+	 */
+	class DeliveryFailure : public std::runtime_error
+	{
+	public:
+		DeliveryFailure(std::exception_ptr error, const std::function<void()>& redeliverFunction)
+			: std::runtime_error("An output could not be passed to every consumer.")
+			, m_error(error)
+			, m_redeliver(redeliverFunction)
+		{
+		}
+
+		/*
+		 * The error of the first consumer that refused the output.
+		 */
+		std::exception_ptr error() const
+		{
+			return m_error;
+		}
+
+		const std::function<void()>& redeliverFunction() const
+		{
+			return m_redeliver;
+		}
+
+	private:
+		std::exception_ptr m_error;
+		std::function<void()> m_redeliver;
+	};
+
+}}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+
+namespace Tools { namespace Parallel {
+
+	/*
+	 * ExactKeySet remembers the keys recorded within the last horizon stamps
+	 * in an open-addressing table with linear probing. Each slot keeps the
+	 * key, its hash and the stamp it was recorded at; expired slots are
+	 * reused in place and dropped whenever the table is rebuilt, so the
+	 * table stays proportional to the keys that are still live.
+	 *
+	 * Stamps are input sequence numbers or clock ticks; they may arrive
+	 * slightly out of order. ExactKeySet is not thread-safe.
+	 */
+	template<class Key>
+	class ExactKeySet
+	{
+	public:
+		explicit ExactKeySet(unsigned long long horizon);
+
+		/*
+		 * Records key at stamp. Returns false if the key was already
+		 * recorded within the horizon, in which case its original stamp is
+		 * kept.
+		 */
+		bool insert(const Key& key, uint64_t hash, unsigned long long stamp);
+
+		size_t capacity() const;
+
+	private:
+		struct Slot
+		{
+			Slot()
+				: key()
+				, hash(0)
+				, stamp(0)
+				, isOccupied(false)
+			{
+			}
+
+			Key key;
+			uint64_t hash;
+			unsigned long long stamp;
+			bool isOccupied;
+		};
+
+		bool isLive(const Slot& slot, unsigned long long stamp) const;
+		void rebuild(unsigned long long stamp);
+
+		std::vector<Slot> m_slots;
+		size_t m_occupied;
+		unsigned long long m_horizon;
+	};
+
+}}
+
+#include "ExactKeySet.hpp"
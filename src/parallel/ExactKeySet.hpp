@@ -0,0 +1,106 @@
+namespace Tools { namespace Parallel {
+
+	const size_t c_minimumKeySetSlots = 16;
+
+	template<class Key>
+	ExactKeySet<Key>::ExactKeySet(unsigned long long horizon)
+		: m_slots(c_minimumKeySetSlots)
+		, m_occupied(0)
+		, m_horizon(horizon)
+	{
+	}
+
+	template<class Key>
+	bool ExactKeySet<Key>::insert(const Key& key, uint64_t hash, unsigned long long stamp)
+	{
+		// Keep at least half of the slots empty so that probes stay short
+		if ((m_occupied + 1) * 2 > m_slots.size())
+		{
+			rebuild(stamp);
+		}
+
+		size_t mask = m_slots.size() - 1;
+		size_t index = static_cast<size_t>(hash) & mask;
+		Slot* expiredSlot = nullptr;
+
+		for (; m_slots[index].isOccupied; index = (index + 1) & mask)
+		{
+			Slot& slot = m_slots[index];
+			if (!isLive(slot, stamp))
+			{
+				if (expiredSlot == nullptr)
+				{
+					expiredSlot = &slot;
+				}
+			}
+			else if (slot.hash == hash && slot.key == key)
+			{
+				return false;
+			}
+		}
+
+		Slot* target = expiredSlot;
+		if (target == nullptr)
+		{
+			target = &m_slots[index];
+			++m_occupied;
+		}
+
+		target->key = key;
+		target->hash = hash;
+		target->stamp = stamp;
+		target->isOccupied = true;
+
+		return true;
+	}
+
+	template<class Key>
+	size_t ExactKeySet<Key>::capacity() const
+	{
+		return m_slots.size();
+	}
+
+	template<class Key>
+	bool ExactKeySet<Key>::isLive(const Slot& slot, unsigned long long stamp) const
+	{
+		// Written so that a slot stamped after stamp counts as live
+		return slot.stamp + m_horizon > stamp;
+	}
+
+	template<class Key>
+	void ExactKeySet<Key>::rebuild(unsigned long long stamp)
+	{
+		std::vector<Slot> liveSlots;
+		for (auto& slot : m_slots)
+		{
+			if (slot.isOccupied && isLive(slot, stamp))
+			{
+				liveSlots.push_back(slot);
+			}
+		}
+
+		// Leave the live keys a quarter of the table, so that it does not
+		// need rebuilding again until they have doubled
+		size_t slotsCount = c_minimumKeySetSlots;
+		while (slotsCount < liveSlots.size() * 4)
+		{
+			slotsCount *= 2;
+		}
+
+		m_slots.assign(slotsCount, Slot());
+		m_occupied = liveSlots.size();
+
+		size_t mask = slotsCount - 1;
+		for (auto& liveSlot : liveSlots)
+		{
+			size_t index = static_cast<size_t>(liveSlot.hash) & mask;
+			while (m_slots[index].isOccupied)
+			{
+				index = (index + 1) & mask;
+			}
+
+			m_slots[index] = liveSlot;
+		}
+	}
+
+}}
@@ -0,0 +1,179 @@
+#pragma once
+
+#include "IConsumerStage.h"
+#include "PipelineStage.h"
+
+#include <concrt.h>
+#include <concurrent_queue.h>
+#include <ppl.h>
+#include <ppltasks.h>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+
+
+namespace Tools { namespace Parallel {
+
+#pragma region FairInputLanes<Input>
+
+	/*
+	 * FairInputLanes is an input queue with one lane per upstream source.
+	 * Producers only push to their own lane, so sources never contend with
+	 * each other. Workers take inputs by deficit round-robin: on its turn a
+	 * lane earns credit equal to its share and gives one input per unit of
+	 * credit, and a lane that runs dry forfeits what it has left. Over time
+	 * each busy source gets a fraction of the stage proportional to its
+	 * share, however much the other sources send.
+	 *
+	 * Each worker thread keeps its own place in the round and its own
+	 * credit, and the lanes form a list that is only ever appended to, so
+	 * workers pick lanes without a lock. Every lane counts its inputs, so
+	 * empty and the lanes that ran dry are checked without touching the
+	 * queues.
+	 *
+	 * Inputs added to the stage itself go to a lane of share one.
+	 */
+	template<class Input>
+	class FairInputLanes
+	{
+	public:
+		struct Lane
+		{
+			int sourceId;
+			unsigned int share;
+			std::atomic<long long> inputCount;
+			std::atomic<Lane*> next;
+			concurrency::concurrent_queue<Input> inputs;
+		};
+
+#pragma region Constructors
+
+		FairInputLanes();
+
+		FairInputLanes(const FairInputLanes<Input>& other) = delete;
+
+#pragma endregion
+
+		/*
+		 * Adds a lane for the given source. The lane stays valid for the
+		 * lifetime of the queue.
+		 */
+		Lane& addLane(int sourceId, unsigned int share);
+
+#pragma region Queue operations
+
+		void push(const Input& input);
+		void push(Lane& lane, const Input& input);
+		bool try_pop(Input& input);
+		bool empty() const;
+
+#pragma endregion
+
+	private:
+		// A worker thread's place in the round
+		struct Cursor
+		{
+			Lane* lane;
+			unsigned int deficit;
+		};
+
+		Lane* nextLane(const Lane& lane) const;
+
+		std::vector<std::unique_ptr<Lane>> m_lanes;
+		Lane* m_stageLane;
+		Lane* m_lastLane;
+		std::atomic<size_t> m_laneCount;
+		concurrency::combinable<Cursor> m_cursors;
+		concurrency::critical_section m_lanesLock;
+	};
+
+#pragma endregion
+
+#pragma region FairMergeStage<Input, Output>
+
+	/*
+	 * FairMergeStage is a PipelineStage that several upstream stages feed
+	 * fairly. Each upstream connects to a lane of its own, made with
+	 * makeSourceLane, instead of to the stage, and the stage's workers
+	 * drain the lanes as described for FairInputLanes. A chatty source can
+	 * then no longer hold back a quiet one.
+	 */
+	template<class Input, class Output>
+	class FairMergeStage : public PipelineStage<Input, Output, FairInputLanes<Input>>
+	{
+	public:
+		typedef typename FairInputLanes<Input>::Lane Lane;
+
+		FairMergeStage(
+			int stageId,
+			const std::function<Output(Input&)>& processInputFunction);
+
+		FairMergeStage(
+			int stageId,
+			const std::function<Output(Input&)>& processInputFunction,
+			const std::function<void(int, std::exception_ptr)>& handleErrorFunction);
+
+		FairMergeStage(const FairMergeStage<Input, Output>& other) = delete;
+
+		Lane& addLane(int sourceId, unsigned int share);
+		void addLaneInput(Lane& lane, Input& input);
+	};
+
+#pragma endregion
+
+#pragma region SourceLane<Input, Output>
+
+	/*
+	 * The consumer an upstream stage connects to in order to feed a
+	 * FairMergeStage through its own lane. Lifetime calls go to the merge
+	 * stage, which the lane keeps alive.
+	 */
+	template<class Input, class Output>
+	class SourceLane : public IConsumerStage<Input>
+	{
+	public:
+		SourceLane(const std::shared_ptr<FairMergeStage<Input, Output>>& stage, int sourceId, unsigned int share);
+
+		SourceLane(const SourceLane<Input, Output>& other) = delete;
+
+#pragma region IPipelineStage implementations
+
+		int stageId() const override;
+		bool isActive() override;
+		bool isFlushing() override;
+		void activate() override;
+		concurrency::task<void> deactivate() override;
+		concurrency::task<void> flushOne() override;
+		concurrency::task<void> flushAll() override;
+
+#pragma endregion
+
+#pragma region IConsumerStage implementations
+
+		bool hasInputs() const override;
+		void addInput(Input& input) override;
+
+#pragma endregion
+
+	private:
+		std::shared_ptr<FairMergeStage<Input, Output>> m_stage;
+		typename FairMergeStage<Input, Output>::Lane* m_lane;
+	};
+
+	/*
+	 * Creates the lane through which the source with the given id feeds
+	 * stage, weighted by share.
+	 */
+	template<class Input, class Output>
+	std::shared_ptr<SourceLane<Input, Output>> makeSourceLane(
+		const std::shared_ptr<FairMergeStage<Input, Output>>& stage,
+		int sourceId,
+		unsigned int share);
+
+#pragma endregion
+
+}}
+
+#include "FairMergeStage.hpp"
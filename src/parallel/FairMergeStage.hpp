@@ -0,0 +1,251 @@
+#include <stdexcept>
+
+
+namespace Tools { namespace Parallel {
+
+	// The lane that inputs added to a FairMergeStage itself go to
+	const int c_stageLaneSourceId = -1;
+
+#pragma region FairInputLanes<Input>
+
+	template<class Input>
+	FairInputLanes<Input>::FairInputLanes()
+		: m_stageLane(nullptr)
+		, m_lastLane(nullptr)
+		, m_laneCount(0)
+	{
+		m_stageLane = &addLane(c_stageLaneSourceId, 1 /*share*/);
+	}
+
+	template<class Input>
+	typename FairInputLanes<Input>::Lane& FairInputLanes<Input>::addLane(int sourceId, unsigned int share)
+	{
+		if (share == 0)
+		{
+			throw std::invalid_argument("A lane requires a positive share.");
+		}
+
+		std::unique_ptr<Lane> lane(new Lane());
+		lane->sourceId = sourceId;
+		lane->share = share;
+		lane->inputCount = 0;
+		lane->next = nullptr;
+
+		// Only lanes being added take this lock; workers walk the list
+		// without it, so a lane is linked in only once it is complete
+		concurrency::critical_section::scoped_lock lock(m_lanesLock);
+		for (auto iter = m_lanes.begin(); iter != m_lanes.end(); ++iter)
+		{
+			if ((*iter)->sourceId == sourceId)
+			{
+				throw std::invalid_argument("A source can only have one lane.");
+			}
+		}
+
+		Lane* added = lane.get();
+		m_lanes.push_back(std::move(lane));
+		if (m_lastLane != nullptr)
+		{
+			m_lastLane->next.store(added, std::memory_order_release);
+		}
+
+		m_lastLane = added;
+		m_laneCount.fetch_add(1, std::memory_order_release);
+		return *added;
+	}
+
+	template<class Input>
+	void FairInputLanes<Input>::push(const Input& input)
+	{
+		push(*m_stageLane, input);
+	}
+
+	template<class Input>
+	void FairInputLanes<Input>::push(Lane& lane, const Input& input)
+	{
+		lane.inputs.push(input);
+		lane.inputCount.fetch_add(1, std::memory_order_release);
+	}
+
+	template<class Input>
+	bool FairInputLanes<Input>::try_pop(Input& input)
+	{
+		Cursor& cursor = m_cursors.local();
+		if (cursor.lane == nullptr)
+		{
+			cursor.lane = m_stageLane;
+			cursor.deficit = m_stageLane->share;
+		}
+
+		// Every lane earns credit within one round, so one round past the
+		// current lane finds any input there is
+		size_t laneCount = m_laneCount.load(std::memory_order_acquire);
+		for (size_t visits = 0; visits <= laneCount; ++visits)
+		{
+			Lane& lane = *cursor.lane;
+			if (cursor.deficit > 0
+				&& lane.inputCount.load(std::memory_order_acquire) > 0
+				&& lane.inputs.try_pop(input))
+			{
+				lane.inputCount.fetch_sub(1, std::memory_order_relaxed);
+				--cursor.deficit;
+				return true;
+			}
+
+			cursor.lane = nextLane(lane);
+			cursor.deficit = cursor.lane->share;
+		}
+
+		return false;
+	}
+
+	template<class Input>
+	bool FairInputLanes<Input>::empty() const
+	{
+		for (const Lane* lane = m_stageLane; lane != nullptr; lane = lane->next.load(std::memory_order_acquire))
+		{
+			if (lane->inputCount.load(std::memory_order_acquire) > 0)
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	template<class Input>
+	typename FairInputLanes<Input>::Lane* FairInputLanes<Input>::nextLane(const Lane& lane) const
+	{
+		Lane* next = lane.next.load(std::memory_order_acquire);
+		return next != nullptr ? next : m_stageLane;
+	}
+
+#pragma endregion
+
+#pragma region FairMergeStage<Input, Output>
+
+	template<class Input, class Output>
+	FairMergeStage<Input, Output>::FairMergeStage(
+		int stageId,
+		const std::function<Output(Input&)>& processInputFunction)
+		: FairMergeStage<Input, Output>(
+			stageId,
+			processInputFunction,
+			nullptr /*handleErrorFunction*/)
+	{
+	}
+
+	template<class Input, class Output>
+	FairMergeStage<Input, Output>::FairMergeStage(
+		int stageId,
+		const std::function<Output(Input&)>& processInputFunction,
+		const std::function<void(int, std::exception_ptr)>& handleErrorFunction)
+		: PipelineStage<Input, Output, FairInputLanes<Input>>(
+			stageId,
+			processInputFunction,
+			handleErrorFunction)
+	{
+	}
+
+	template<class Input, class Output>
+	typename FairMergeStage<Input, Output>::Lane& FairMergeStage<Input, Output>::addLane(int sourceId, unsigned int share)
+	{
+		return this->inputQueue().addLane(sourceId, share);
+	}
+
+	template<class Input, class Output>
+	void FairMergeStage<Input, Output>::addLaneInput(Lane& lane, Input& input)
+	{
+		if (this->isAcceptingInputs())
+		{
+			this->inputQueue().push(lane, input);
+			this->onInputAdded();
+		}
+	}
+
+#pragma endregion
+
+#pragma region SourceLane<Input, Output>
+
+	template<class Input, class Output>
+	SourceLane<Input, Output>::SourceLane(
+		const std::shared_ptr<FairMergeStage<Input, Output>>& stage,
+		int sourceId,
+		unsigned int share)
+		: m_stage(stage)
+		, m_lane(nullptr)
+	{
+		if (m_stage == nullptr)
+		{
+			throw std::invalid_argument("SourceLane requires a valid stage.");
+		}
+
+		m_lane = &m_stage->addLane(sourceId, share);
+	}
+
+	template<class Input, class Output>
+	int SourceLane<Input, Output>::stageId() const
+	{
+		return m_stage->stageId();
+	}
+
+	template<class Input, class Output>
+	bool SourceLane<Input, Output>::isActive()
+	{
+		return m_stage->isActive();
+	}
+
+	template<class Input, class Output>
+	bool SourceLane<Input, Output>::isFlushing()
+	{
+		return m_stage->isFlushing();
+	}
+
+	template<class Input, class Output>
+	void SourceLane<Input, Output>::activate()
+	{
+		m_stage->activate();
+	}
+
+	template<class Input, class Output>
+	concurrency::task<void> SourceLane<Input, Output>::deactivate()
+	{
+		return m_stage->deactivate();
+	}
+
+	template<class Input, class Output>
+	concurrency::task<void> SourceLane<Input, Output>::flushOne()
+	{
+		return m_stage->flushOne();
+	}
+
+	template<class Input, class Output>
+	concurrency::task<void> SourceLane<Input, Output>::flushAll()
+	{
+		return m_stage->flushAll();
+	}
+
+	template<class Input, class Output>
+	bool SourceLane<Input, Output>::hasInputs() const
+	{
+		return m_stage->hasInputs();
+	}
+
+	template<class Input, class Output>
+	void SourceLane<Input, Output>::addInput(Input& input)
+	{
+		m_stage->addLaneInput(*m_lane, input);
+	}
+
+	template<class Input, class Output>
+	std::shared_ptr<SourceLane<Input, Output>> makeSourceLane(
+		const std::shared_ptr<FairMergeStage<Input, Output>>& stage,
+		int sourceId,
+		unsigned int share)
+	{
+		return std::make_shared<SourceLane<Input, Output>>(stage, sourceId, share);
+	}
+
+#pragma endregion
+
+}}
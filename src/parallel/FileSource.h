@@ -0,0 +1,128 @@
+#pragma once
+
+#include "ConnectableBase.h"
+#include "IInspectableStage.h"
+#include "IPipelineStage.h"
+#include "RecordFraming.h"
+#include "RecordView.h"
+
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+
+#include <concrt.h>
+#include <ppltasks.h>
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <typeinfo>
+#include <system_error>
+
+
+namespace Tools { namespace Parallel {
+
+	/*
+	 * FileSource feeds the records of a local file to its consumers. The
+	 * file is mapped into memory, and the pages ahead of the reader are
+	 * prefetched, so reading it costs no copies and no read calls. The
+	 * Framing (NewlineFraming, LengthPrefixedFraming or FixedSizeFraming)
+	 * splits the mapping into records, and each record is passed on as a
+	 * Record: a RecordView into the mapping costs nothing, while a
+	 * std::string copies it. A RecordView stays valid until the source is
+	 * destroyed.
+	 *
+	 * activate activates the consumers and starts reading on a task of its
+	 * own. At the end of the file the source flushes its consumers and
+	 * deactivates; whenComplete returns that task. deactivate pauses reading
+	 * and a later activate resumes it.
+	 *
+	 * A record that the framing rejects is reported to the error handler and
+	 * is treated as the end of the file.
+	 */
+	template<class Record, class Framing = NewlineFraming>
+	class FileSource
+		: public IPipelineStage
+		, public IInspectableStage
+		, public ConnectableBase<Record>
+		, public std::enable_shared_from_this<FileSource<Record, Framing>>
+	{
+	public:
+#pragma region Constructors and Destructor
+
+		FileSource(
+			int stageId,
+			const std::wstring& path);
+
+		FileSource(
+			int stageId,
+			const std::wstring& path,
+			const Framing& framing,
+			const std::function<void(int, std::exception_ptr)>& handleErrorFunction);
+
+		~FileSource();
+
+		FileSource(const FileSource<Record, Framing>& other) = delete;
+
+#pragma endregion
+
+#pragma region IPipelineStage implementations
+
+		int stageId() const override;
+		bool isActive() override;
+		bool isFlushing() override;
+		void activate() override;
+		concurrency::task<void> deactivate() override;
+		concurrency::task<void> flushOne() override;
+		concurrency::task<void> flushAll() override;
+
+#pragma endregion
+
+#pragma region IInspectableStage implementations
+
+		StageSnapshot snapshot() override;
+		std::vector<std::shared_ptr<IPipelineStage>> consumerStages() override;
+
+#pragma endregion
+
+		concurrency::task<void> whenComplete();
+		bool isAtEndOfFile() const;
+
+	private:
+		void readRecords();
+		bool tryStopReading();
+		bool tryFrameRecord(Record& record);
+		void prefetch();
+		void onEndOfFile();
+		void onError(std::exception_ptr error);
+		void close();
+
+		int m_stageId;
+		std::function<void(int, std::exception_ptr)> m_handleError;
+		Framing m_framing;
+
+		HANDLE m_file;
+		HANDLE m_mapping;
+		const char* m_data;
+		size_t m_size;
+		size_t m_position;
+		size_t m_prefetchedTo;
+
+		std::atomic<bool> m_isScheduled;
+		std::atomic<bool> m_isReading;
+		std::atomic<bool> m_isAtEndOfFile;
+		concurrency::task<void> m_readerTask;
+		concurrency::critical_section m_readerTaskLock;
+	};
+
+}}
+
+#include "FileSource.hpp"
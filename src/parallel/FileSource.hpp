@@ -0,0 +1,341 @@
+namespace Tools { namespace Parallel {
+
+	// How far ahead of the reader the mapped pages are prefetched
+	const size_t c_readaheadBytes = 8 * 1024 * 1024;
+
+	template<class Record, class Framing>
+	FileSource<Record, Framing>::FileSource(
+		int stageId,
+		const std::wstring& path)
+		: FileSource<Record, Framing>(
+			stageId,
+			path,
+			Framing(),
+			nullptr /*handleErrorFunction*/)
+	{
+	}
+
+	template<class Record, class Framing>
+	FileSource<Record, Framing>::FileSource(
+		int stageId,
+		const std::wstring& path,
+		const Framing& framing,
+		const std::function<void(int, std::exception_ptr)>& handleErrorFunction)
+		: m_stageId(stageId)
+		, m_handleError(handleErrorFunction)
+		, m_framing(framing)
+		, m_file(INVALID_HANDLE_VALUE)
+		, m_mapping(nullptr)
+		, m_data(nullptr)
+		, m_size(0)
+		, m_position(0)
+		, m_prefetchedTo(0)
+		, m_isScheduled(false)
+		, m_isReading(false)
+		, m_isAtEndOfFile(false)
+		, m_readerTask(concurrency::task_from_result())
+	{
+		m_file = CreateFileW(
+			path.c_str(),
+			GENERIC_READ,
+			FILE_SHARE_READ,
+			nullptr,
+			OPEN_EXISTING,
+			FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+			nullptr);
+		if (m_file == INVALID_HANDLE_VALUE)
+		{
+			throw std::system_error(static_cast<int>(GetLastError()), std::system_category(), "Cannot open the file.");
+		}
+
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(m_file, &size))
+		{
+			auto error = GetLastError();
+			close();
+			throw std::system_error(static_cast<int>(error), std::system_category(), "Cannot get the size of the file.");
+		}
+
+		// The whole file is mapped at once, which a 32-bit process cannot do
+		// for a file of 4 GB or more
+		if (static_cast<unsigned long long>(size.QuadPart) > (std::numeric_limits<size_t>::max)())
+		{
+			close();
+			throw std::invalid_argument("The file is too large to be mapped by this process.");
+		}
+
+		m_size = static_cast<size_t>(size.QuadPart);
+
+		// An empty file cannot be mapped, and has no records anyway
+		if (m_size > 0)
+		{
+			m_mapping = CreateFileMappingW(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			m_data = m_mapping != nullptr
+				? static_cast<const char*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0))
+				: nullptr;
+
+			if (m_data == nullptr)
+			{
+				auto error = GetLastError();
+				close();
+				throw std::system_error(static_cast<int>(error), std::system_category(), "Cannot map the file.");
+			}
+		}
+	}
+
+	template<class Record, class Framing>
+	FileSource<Record, Framing>::~FileSource()
+	{
+		deactivate().wait();
+		close();
+	}
+
+	template<class Record, class Framing>
+	int FileSource<Record, Framing>::stageId() const
+	{
+		return m_stageId;
+	}
+
+	template<class Record, class Framing>
+	bool FileSource<Record, Framing>::isActive()
+	{
+		return m_isReading.load();
+	}
+
+	template<class Record, class Framing>
+	bool FileSource<Record, Framing>::isFlushing()
+	{
+		return false;
+	}
+
+	template<class Record, class Framing>
+	void FileSource<Record, Framing>::activate()
+	{
+		if (m_isAtEndOfFile)
+		{
+			return;
+		}
+
+		this->activateConsumers();
+
+		concurrency::critical_section::scoped_lock lock(m_readerTaskLock);
+		m_isScheduled = true;
+
+		// A reader that is winding down sees the flag again before it stops
+		if (!m_isReading)
+		{
+			m_isReading = true;
+			m_readerTask = concurrency::create_task([this]() { readRecords(); });
+		}
+	}
+
+	template<class Record, class Framing>
+	concurrency::task<void> FileSource<Record, Framing>::deactivate()
+	{
+		m_isScheduled = false;
+		return whenComplete();
+	}
+
+	template<class Record, class Framing>
+	concurrency::task<void> FileSource<Record, Framing>::flushOne()
+	{
+		// The source has no buffered inputs; reading to the end of the file
+		// is what flushes it
+		return whenComplete();
+	}
+
+	template<class Record, class Framing>
+	concurrency::task<void> FileSource<Record, Framing>::flushAll()
+	{
+		auto flushOneTask = flushOne();
+		std::weak_ptr<FileSource<Record, Framing>> wpThis(this->shared_from_this());
+
+		auto flushAllTask = flushOneTask.then([wpThis]()
+		{
+			auto spThis = wpThis.lock();
+			if (spThis != nullptr)
+			{
+				return spThis->flushConsumers();
+			}
+			else
+			{
+				return concurrency::task_from_result();
+			}
+		});
+
+		return flushAllTask;
+	}
+
+	template<class Record, class Framing>
+	StageSnapshot FileSource<Record, Framing>::snapshot()
+	{
+		StageSnapshot snapshot;
+		snapshot.stageId = m_stageId;
+		snapshot.type = typeid(*this).name();
+		snapshot.isActive = isActive();
+		snapshot.isFlushing = isFlushing();
+		snapshot.workerCount = 1;
+		snapshot.runningWorkers = snapshot.isActive ? 1 : 0;
+
+		return snapshot;
+	}
+
+	template<class Record, class Framing>
+	std::vector<std::shared_ptr<IPipelineStage>> FileSource<Record, Framing>::consumerStages()
+	{
+		return ConnectableBase<Record>::consumerStages();
+	}
+
+	template<class Record, class Framing>
+	concurrency::task<void> FileSource<Record, Framing>::whenComplete()
+	{
+		concurrency::critical_section::scoped_lock lock(m_readerTaskLock);
+		return m_readerTask;
+	}
+
+	template<class Record, class Framing>
+	bool FileSource<Record, Framing>::isAtEndOfFile() const
+	{
+		return m_isAtEndOfFile.load();
+	}
+
+	template<class Record, class Framing>
+	void FileSource<Record, Framing>::readRecords()
+	{
+		while (!tryStopReading())
+		{
+			Record record;
+			bool isFramed = false;
+
+			try
+			{
+				isFramed = tryFrameRecord(record);
+			}
+			catch (...)
+			{
+				// Whatever follows a record that cannot be framed cannot be
+				// trusted, so the rest of the file is skipped
+				m_position = m_size;
+				onError(std::current_exception());
+			}
+
+			try
+			{
+				if (isFramed)
+				{
+					this->pushToConsumers(record);
+				}
+				else
+				{
+					onEndOfFile();
+				}
+			}
+			catch (const DeliveryFailure& failure)
+			{
+				// A source does not retry, so only the consumer's error is reported
+				onError(failure.error());
+			}
+			catch (...)
+			{
+				onError(std::current_exception());
+			}
+		}
+	}
+
+	template<class Record, class Framing>
+	bool FileSource<Record, Framing>::tryStopReading()
+	{
+		if (m_isScheduled.load(std::memory_order_relaxed))
+		{
+			return false;
+		}
+
+		concurrency::critical_section::scoped_lock lock(m_readerTaskLock);
+		if (m_isScheduled)
+		{
+			return false;
+		}
+
+		m_isReading = false;
+		return true;
+	}
+
+	template<class Record, class Framing>
+	bool FileSource<Record, Framing>::tryFrameRecord(Record& record)
+	{
+		prefetch();
+
+		RecordView view;
+		size_t consumed = 0;
+		if (!m_framing.next(m_data + m_position, m_size - m_position, view, consumed))
+		{
+			return false;
+		}
+
+		m_position += consumed;
+		assignRecord(record, view.data, view.size);
+
+		return true;
+	}
+
+	template<class Record, class Framing>
+	void FileSource<Record, Framing>::prefetch()
+	{
+		// Ask for the next window once the reader is halfway through the
+		// current one, so that its pages are read while these are framed.
+		// Prefetching is only a hint, so a failure is ignored.
+		if (m_prefetchedTo < m_size && m_position + c_readaheadBytes / 2 >= m_prefetchedTo)
+		{
+			WIN32_MEMORY_RANGE_ENTRY range;
+			range.VirtualAddress = const_cast<char*>(m_data + m_prefetchedTo);
+			range.NumberOfBytes = (std::min)(c_readaheadBytes, m_size - m_prefetchedTo);
+
+			PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0 /*flags*/);
+			m_prefetchedTo += range.NumberOfBytes;
+		}
+	}
+
+	template<class Record, class Framing>
+	void FileSource<Record, Framing>::onEndOfFile()
+	{
+		m_isAtEndOfFile = true;
+		m_isScheduled = false;
+		this->flushConsumers().wait();
+	}
+
+	template<class Record, class Framing>
+	void FileSource<Record, Framing>::onError(std::exception_ptr error)
+	{
+		try
+		{
+			if (m_handleError)
+			{
+				m_handleError(m_stageId, error);
+			}
+		}
+		catch (...) {}
+	}
+
+	template<class Record, class Framing>
+	void FileSource<Record, Framing>::close()
+	{
+		if (m_data != nullptr)
+		{
+			UnmapViewOfFile(m_data);
+			m_data = nullptr;
+		}
+
+		if (m_mapping != nullptr)
+		{
+			CloseHandle(m_mapping);
+			m_mapping = nullptr;
+		}
+
+		if (m_file != INVALID_HANDLE_VALUE)
+		{
+			CloseHandle(m_file);
+			m_file = INVALID_HANDLE_VALUE;
+		}
+	}
+
+}}
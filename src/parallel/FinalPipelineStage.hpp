@@ -1,22 +1,22 @@
 namespace Tools { namespace Parallel {
 
-	template<class Input>
-	PipelineStage<Input, void>::PipelineStage(
+	template<class Input, class InputQueue>
+	PipelineStage<Input, void, InputQueue>::PipelineStage(
 		int stageId,
 		const std::function<void(Input&)>& processInputFunction)
-		: PipelineStage<Input, void>(
+		: PipelineStage<Input, void, InputQueue>(
 			stageId,
 			processInputFunction,
 			nullptr /*handleErrorFunction*/)
 	{
 	}
 
-	template<class Input>
-	PipelineStage<Input, void>::PipelineStage(
+	template<class Input, class InputQueue>
+	PipelineStage<Input, void, InputQueue>::PipelineStage(
 		int stageId,
 		const std::function<void(Input&)>& processInputFunction,
 		const std::function<void(int, std::exception_ptr)>& handleErrorFunction)
-		: PipelineStageBase<Input>(
+		: PipelineStageBase<Input, InputQueue>(
 			stageId,
 			handleErrorFunction)
 		, m_processInput(processInputFunction)
@@ -27,8 +27,8 @@ namespace Tools { namespace Parallel {
 		}
 	}
 
-	template<class Input>
-	void PipelineStage<Input, void>::processInput(Input& input)
+	template<class Input, class InputQueue>
+	void PipelineStage<Input, void, InputQueue>::processInput(Input& input)
 	{
 		m_processInput(input);
 	}
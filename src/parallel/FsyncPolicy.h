@@ -0,0 +1,67 @@
+#pragma once
+
+#include <chrono>
+#include <stdexcept>
+
+
+namespace Tools { namespace Parallel {
+
+	/*
+	 * Describes when a writer forces the data it has written out to the
+	 * storage device: never, after every batch, or at most once per
+	 * interval. Unless the policy is Never, a flush of the writer also
+	 * forces out whatever it has written.
+	 *
+	 * The default policy never forces data out and leaves it to the
+	 * operating system.
+	 */
+	class FsyncPolicy
+	{
+	public:
+		enum Mode
+		{
+			Never,
+			EveryBatch,
+			Periodic
+		};
+
+		FsyncPolicy()
+			: FsyncPolicy(Never, std::chrono::milliseconds::zero())
+		{
+		}
+
+		FsyncPolicy(Mode mode, std::chrono::milliseconds interval)
+			: m_mode(mode)
+			, m_interval(interval)
+		{
+			if (mode == Periodic && interval.count() <= 0)
+			{
+				throw std::invalid_argument("A periodic fsync policy requires a positive interval.");
+			}
+		}
+
+		Mode mode() const
+		{
+			return m_mode;
+		}
+
+		/*
+		 * Returns whether a batch that has just been written must be forced
+		 * out, given how long ago data was last forced out.
+		 */
+		bool isDue(std::chrono::steady_clock::duration sinceLastSync) const
+		{
+			return m_mode == EveryBatch || (m_mode == Periodic && sinceLastSync >= m_interval);
+		}
+
+		bool syncsOnFlush() const
+		{
+			return m_mode != Never;
+		}
+
+	private:
+		Mode m_mode;
+		std::chrono::milliseconds m_interval;
+	};
+
+}}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdint>
+
+
+namespace Tools { namespace Parallel {
+
+	namespace Details
+	{
+		/*
+		 * Spreads the bits of a key's hash, which std::hash leaves as they
+		 * are for integers, over the whole word (the splitmix64 finalizer).
+		 */
+		inline uint64_t mixHash(uint64_t hash)
+		{
+			hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ULL;
+			hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebULL;
+			return hash ^ (hash >> 31);
+		}
+	}
+
+}}
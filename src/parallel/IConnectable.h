@@ -20,6 +20,16 @@ namespace Tools { namespace Parallel {
 		virtual void swap(
 			const std::shared_ptr<IConsumerStage<T>>& current,
 			const std::shared_ptr<IConsumerStage<T>>& replacement) = 0;
+
+		/*
+		 * Swaps current for replacement like swap. The task completes once no
+		 * value can reach current any more and, if drainCurrent is set, once
+		 * current has also processed every value it had received.
+		 */
+		virtual concurrency::task<void> swapAsync(
+			const std::shared_ptr<IConsumerStage<T>>& current,
+			const std::shared_ptr<IConsumerStage<T>>& replacement,
+			bool drainCurrent) = 0;
 	};
 
 }}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "IPipelineStage.h"
+#include "StageSnapshot.h"
+
+#include <memory>
+#include <vector>
+
+
+namespace Tools { namespace Parallel {
+
+	/*
+	 * Represents a pipeline stage that can describe its state and the stages
+	 * it is connected to. Both calls must be cheap and safe to make from any
+	 * thread while the stage is processing.
+	 */
+	class IInspectableStage
+	{
+	public:
+		virtual ~IInspectableStage() { }
+
+		virtual StageSnapshot snapshot() = 0;
+		virtual std::vector<std::shared_ptr<IPipelineStage>> consumerStages() = 0;
+	};
+
+}}
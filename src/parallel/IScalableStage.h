@@ -0,0 +1,23 @@
+#pragma once
+
+#include "StageStatistics.h"
+
+
+namespace Tools { namespace Parallel {
+
+	/*
+	 * Represents a pipeline stage whose inputs can be processed by a variable
+	 * number of concurrent workers.
+	 */
+	class IScalableStage
+	{
+	public:
+		virtual ~IScalableStage() { }
+
+		virtual int stageId() const = 0;
+		virtual unsigned int workerCount() = 0;
+		virtual void setWorkerCount(unsigned int workerCount) = 0;
+		virtual StageStatistics statistics() = 0;
+	};
+
+}}
@@ -0,0 +1,119 @@
+#pragma once
+
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+
+#include <algorithm>
+
+
+namespace Tools { namespace Parallel {
+
+	/*
+	 * Describes what a stage's worker does when it finds no input. By
+	 * default it waits up to 10 ms before looking again, which costs
+	 * nothing while the stage is idle but adds up to that much latency.
+	 * The other modes trade processor time for latency:
+	 *
+	 *   BusySpin        spins with a pause instruction, never giving up
+	 *                   the processor
+	 *   SpinThenYield   spins, then yields the rest of its time slice on
+	 *                   every further attempt
+	 *   SpinThenPark    spins, yields, then waits parkMilliseconds at a
+	 *                   time
+	 *
+	 * A spinning worker should have a processor of its own; see
+	 * ProcessorAffinity.
+	 */
+	class IdleStrategy
+	{
+	public:
+		enum Mode
+		{
+			Wait,
+			BusySpin,
+			SpinThenYield,
+			SpinThenPark
+		};
+
+		IdleStrategy()
+			: IdleStrategy(Wait, 0, 0, 0)
+		{
+		}
+
+		static IdleStrategy busySpin()
+		{
+			return IdleStrategy(BusySpin, 0, 0, 0);
+		}
+
+		static IdleStrategy spinThenYield(unsigned int spins)
+		{
+			return IdleStrategy(SpinThenYield, spins, 0, 0);
+		}
+
+		static IdleStrategy spinThenPark(unsigned int spins, unsigned int yields, unsigned int parkMilliseconds)
+		{
+			return IdleStrategy(SpinThenPark, spins, yields, parkMilliseconds);
+		}
+
+		Mode mode() const
+		{
+			return m_mode;
+		}
+
+		/*
+		 * Pauses briefly for the given consecutive idle attempt, without
+		 * giving up the thread. Returns false once the worker should wait
+		 * instead, for parkMilliseconds.
+		 */
+		bool pause(unsigned int idleAttempts) const
+		{
+			if (m_mode == Wait)
+			{
+				return false;
+			}
+
+			if (m_mode == BusySpin || idleAttempts < m_spins)
+			{
+				YieldProcessor();
+				return true;
+			}
+
+			if (m_mode == SpinThenYield || idleAttempts - m_spins < m_yields)
+			{
+				SwitchToThread();
+				return true;
+			}
+
+			return false;
+		}
+
+		/*
+		 * How long to wait, given the longest wait the stage allows before
+		 * it must look again, for example for a retry that falls due.
+		 */
+		unsigned int parkMilliseconds(unsigned int maximumMilliseconds) const
+		{
+			return m_mode == SpinThenPark ? (std::min)(m_parkMilliseconds, maximumMilliseconds) : maximumMilliseconds;
+		}
+
+	private:
+		IdleStrategy(Mode mode, unsigned int spins, unsigned int yields, unsigned int parkMilliseconds)
+			: m_mode(mode)
+			, m_spins(spins)
+			, m_yields(yields)
+			, m_parkMilliseconds(parkMilliseconds)
+		{
+		}
+
+		Mode m_mode;
+		unsigned int m_spins;
+		unsigned int m_yields;
+		unsigned int m_parkMilliseconds;
+	};
+
+}}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include "RecordView.h"
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+
+namespace Tools { namespace Parallel {
+
+	/*
+	 * A journal is an append-only file of the inputs a stage received. Each
+	 * record is the input's arrival time, as a 64-bit little-endian count of
+	 * nanoseconds since the system clock's epoch, followed by the size of
+	 * its serialized form as a 32-bit little-endian integer and then the
+	 * serialized form itself.
+	 */
+	const size_t c_journalHeaderBytes = sizeof(int64_t) + sizeof(uint32_t);
+
+	/*
+	 * An input on its way to the journal, stamped with its arrival time.
+	 */
+	template<class Input>
+	struct Journaled
+	{
+		Journaled()
+			: arrivalNanoseconds(0)
+			, input()
+		{
+		}
+
+		long long arrivalNanoseconds;
+		Input input;
+	};
+
+	/*
+	 * A record framed out of a journal. The payload is a view into the
+	 * journal's mapping.
+	 */
+	struct JournalRecord
+	{
+		long long arrivalNanoseconds;
+		RecordView payload;
+	};
+
+	inline void assignRecord(JournalRecord& record, const char* data, size_t size)
+	{
+		int64_t arrivalNanoseconds = 0;
+		std::memcpy(&arrivalNanoseconds, data, sizeof(arrivalNanoseconds));
+
+		record.arrivalNanoseconds = arrivalNanoseconds;
+		record.payload.data = data + c_journalHeaderBytes;
+		record.payload.size = size - c_journalHeaderBytes;
+	}
+
+	/*
+	 * Frames whole journal records, header included, for assignRecord to
+	 * split into a JournalRecord.
+	 */
+	class JournalFraming
+	{
+	public:
+		bool next(const char* data, size_t available, RecordView& record, size_t& consumed) const
+		{
+			if (available == 0)
+			{
+				return false;
+			}
+
+			uint32_t size = 0;
+			if (available < c_journalHeaderBytes)
+			{
+				throw std::runtime_error("Truncated journal record header.");
+			}
+
+			std::memcpy(&size, data + sizeof(int64_t), sizeof(size));
+			if (available - c_journalHeaderBytes < size)
+			{
+				throw std::runtime_error("Truncated journal record.");
+			}
+
+			consumed = c_journalHeaderBytes + size;
+			record.data = data;
+			record.size = consumed;
+			return true;
+		}
+	};
+
+	namespace Details
+	{
+		/*
+		 * Appends a journal record to buffer, with the payload written by
+		 * serialize(input, buffer).
+		 */
+		template<class Input, class Serialize>
+		void appendJournalRecord(long long arrivalNanoseconds, Input& input, const Serialize& serialize, std::vector<char>& buffer)
+		{
+			size_t headerOffset = buffer.size();
+			buffer.resize(headerOffset + c_journalHeaderBytes);
+
+			try
+			{
+				serialize(input, buffer);
+			}
+			catch (...)
+			{
+				// Leave no partial record behind in the batch
+				buffer.resize(headerOffset);
+				throw;
+			}
+
+			size_t payloadSize = buffer.size() - headerOffset - c_journalHeaderBytes;
+			if (payloadSize > UINT32_MAX)
+			{
+				buffer.resize(headerOffset);
+				throw std::length_error("A journaled input must serialize to less than 4 GB.");
+			}
+
+			int64_t arrival = arrivalNanoseconds;
+			uint32_t size = static_cast<uint32_t>(payloadSize);
+			std::memcpy(&buffer[headerOffset], &arrival, sizeof(arrival));
+			std::memcpy(&buffer[headerOffset + sizeof(arrival)], &size, sizeof(size));
+		}
+	}
+
+}}
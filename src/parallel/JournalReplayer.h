@@ -0,0 +1,90 @@
+#pragma once
+
+#include "FileSource.h"
+#include "IConsumerStage.h"
+#include "Journal.h"
+#include "LatencyHistogram.h"
+#include "PipelineStage.h"
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+
+
+namespace Tools { namespace Parallel {
+
+	/*
+	 * The outcome of replaying a journal. elapsed runs from the first input
+	 * until the target has been flushed, so throughput includes draining the
+	 * pipeline. lateness records how far behind the recorded schedule each
+	 * input was added; it stays near zero unless the replayer cannot keep
+	 * up, and is zero throughout when replaying as fast as possible.
+	 */
+	struct ReplayReport
+	{
+		ReplayReport()
+			: inputsReplayed(0)
+			, elapsed(std::chrono::nanoseconds::zero())
+			, lateness(std::make_shared<LatencyHistogram>())
+		{
+		}
+
+		double throughput() const
+		{
+			return elapsed > std::chrono::nanoseconds::zero()
+				? inputsReplayed / std::chrono::duration<double>(elapsed).count()
+				: 0.0;
+		}
+
+		unsigned long long inputsReplayed;
+		std::chrono::nanoseconds elapsed;
+		std::shared_ptr<LatencyHistogram> lateness;
+	};
+
+	/*
+	 * JournalReplayer feeds the inputs recorded by a JournalingStage into a
+	 * pipeline, in order, either at the recorded inter-arrival times or as
+	 * fast as the pipeline takes them. deserializeFunction rebuilds an input
+	 * from the bytes that the journal's serializer wrote.
+	 *
+	 * The journal is read by a FileSource into a single-worker stage that
+	 * paces the inputs and adds them to the target, so the file is mapped
+	 * rather than read, and pacing never waits on the disk. For end-to-end
+	 * latencies, replay into a pipeline of tracked stages: the deserializer
+	 * can wrap each input with an IngestSampler.
+	 */
+	template<class Input>
+	class JournalReplayer
+	{
+	public:
+		enum Pace
+		{
+			Recorded,
+			AsFastAsPossible
+		};
+
+#pragma region Constructors and Destructor
+
+		JournalReplayer(
+			const std::wstring& path,
+			const std::function<Input(const RecordView&)>& deserializeFunction);
+
+		JournalReplayer(const JournalReplayer<Input>& other) = delete;
+
+#pragma endregion
+
+		/*
+		 * Activates the target, replays the whole journal into it, flushes
+		 * it and reports. A journal can be replayed more than once.
+		 */
+		concurrency::task<ReplayReport> replay(const std::shared_ptr<IConsumerStage<Input>>& target, Pace pace);
+
+	private:
+		std::wstring m_path;
+		std::function<Input(const RecordView&)> m_deserialize;
+	};
+
+}}
+
+#include "JournalReplayer.hpp"
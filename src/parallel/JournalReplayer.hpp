@@ -0,0 +1,133 @@
+#include <algorithm>
+#include <stdexcept>
+
+
+namespace Tools { namespace Parallel {
+
+	namespace Details
+	{
+		/*
+		 * Adds the journal's records to the target on the schedule they were
+		 * recorded on, shifted to start now. Waits of a millisecond or more
+		 * block; the rest is spent yielding, so that short gaps are kept.
+		 */
+		template<class Input>
+		class ReplayPacer
+		{
+		public:
+			ReplayPacer(
+				const std::shared_ptr<IConsumerStage<Input>>& target,
+				const std::function<Input(const RecordView&)>& deserialize,
+				bool isPaced,
+				const std::shared_ptr<ReplayReport>& report)
+				: m_target(target)
+				, m_deserialize(deserialize)
+				, m_isPaced(isPaced)
+				, m_report(report)
+				, m_firstArrivalNanoseconds(0)
+			{
+			}
+
+			void operator()(JournalRecord& record)
+			{
+				auto now = std::chrono::steady_clock::now();
+				if (m_report->inputsReplayed == 0)
+				{
+					m_start = now;
+					m_firstArrivalNanoseconds = record.arrivalNanoseconds;
+				}
+
+				if (m_isPaced)
+				{
+					// An arrival earlier than the first, as when a journal was
+					// appended to after the clock was set back, is due at once
+					auto offset = std::chrono::nanoseconds((std::max)(0LL, record.arrivalNanoseconds - m_firstArrivalNanoseconds));
+					auto dueTime = m_start + offset;
+
+					while (now < dueTime)
+					{
+						auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(dueTime - now);
+						if (remaining.count() > 0)
+						{
+							concurrency::wait(static_cast<unsigned int>(remaining.count()));
+						}
+						else
+						{
+							SwitchToThread();
+						}
+
+						now = std::chrono::steady_clock::now();
+					}
+
+					m_report->lateness->record(std::chrono::duration_cast<std::chrono::nanoseconds>(now - dueTime));
+				}
+
+				Input input = m_deserialize(record.payload);
+				m_target->addInput(input);
+				++m_report->inputsReplayed;
+			}
+
+			std::chrono::steady_clock::time_point start() const
+			{
+				return m_start;
+			}
+
+		private:
+			std::shared_ptr<IConsumerStage<Input>> m_target;
+			std::function<Input(const RecordView&)> m_deserialize;
+			bool m_isPaced;
+			std::shared_ptr<ReplayReport> m_report;
+			std::chrono::steady_clock::time_point m_start;
+			long long m_firstArrivalNanoseconds;
+		};
+	}
+
+	template<class Input>
+	JournalReplayer<Input>::JournalReplayer(
+		const std::wstring& path,
+		const std::function<Input(const RecordView&)>& deserializeFunction)
+		: m_path(path)
+		, m_deserialize(deserializeFunction)
+	{
+		if (m_deserialize == nullptr)
+		{
+			throw std::invalid_argument("JournalReplayer requires a valid deserialize function.");
+		}
+	}
+
+	template<class Input>
+	concurrency::task<ReplayReport> JournalReplayer<Input>::replay(const std::shared_ptr<IConsumerStage<Input>>& target, Pace pace)
+	{
+		if (target == nullptr)
+		{
+			throw std::invalid_argument("Invalid target stage.");
+		}
+
+		auto report = std::make_shared<ReplayReport>();
+		auto pacer = std::make_shared<Details::ReplayPacer<Input>>(target, m_deserialize, pace == Recorded, report);
+
+		// The pacer is the source's only consumer and runs on one worker,
+		// which keeps the journal's order
+		auto source = std::make_shared<FileSource<JournalRecord, JournalFraming>>(target->stageId(), m_path);
+		auto pacingStage = std::make_shared<PipelineStage<JournalRecord, void>>(
+			target->stageId(),
+			[pacer](JournalRecord& record) { (*pacer)(record); });
+		source->connect(pacingStage);
+
+		target->activate();
+		source->activate();
+
+		return source->whenComplete().then([source, pacingStage, target]()
+		{
+			return target->flushAll();
+		}).then([source, pacer, report]()
+		{
+			report->elapsed = report->inputsReplayed > 0
+				? std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - pacer->start())
+				: std::chrono::nanoseconds::zero();
+
+			return *report;
+		});
+	}
+
+}}
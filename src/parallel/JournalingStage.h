@@ -0,0 +1,82 @@
+#pragma once
+
+#include "BatchedWriterStage.h"
+#include "IConsumerStage.h"
+#include "Journal.h"
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+namespace Tools { namespace Parallel {
+
+	/*
+	 * JournalingStage records the inputs of any consumer stage in a journal
+	 * and passes them on to it unchanged. It stands in for the stage it
+	 * wraps: producers add inputs to the journaling stage, which stamps each
+	 * one with its arrival time and hands a copy to a BatchedWriterStage, so
+	 * the producer never waits for the file. serializeFunction appends an
+	 * input's bytes to a buffer, as for BatchedWriterStage.
+	 *
+	 * Lifetime calls go to both the wrapped stage and the writer; a flush
+	 * completes once both have flushed. A JournalReplayer feeds a journal
+	 * back into a pipeline.
+	 */
+	template<class Input>
+	class JournalingStage : public IConsumerStage<Input>
+	{
+	public:
+#pragma region Constructors and Destructor
+
+		JournalingStage(
+			const std::shared_ptr<IConsumerStage<Input>>& stage,
+			const std::wstring& path,
+			const std::function<void(Input&, std::vector<char>&)>& serializeFunction);
+
+		JournalingStage(
+			const std::shared_ptr<IConsumerStage<Input>>& stage,
+			const std::wstring& path,
+			const std::function<void(Input&, std::vector<char>&)>& serializeFunction,
+			const FsyncPolicy& fsyncPolicy,
+			const std::function<void(int, std::exception_ptr)>& handleErrorFunction);
+
+		JournalingStage(const JournalingStage<Input>& other) = delete;
+
+#pragma endregion
+
+#pragma region IPipelineStage implementations
+
+		int stageId() const override;
+		bool isActive() override;
+		bool isFlushing() override;
+		void activate() override;
+		concurrency::task<void> deactivate() override;
+		concurrency::task<void> flushOne() override;
+		concurrency::task<void> flushAll() override;
+
+#pragma endregion
+
+#pragma region IConsumerStage implementations
+
+		bool hasInputs() const override;
+		void addInput(Input& input) override;
+
+#pragma endregion
+
+		unsigned long long journaledCount() const;
+
+	private:
+		static concurrency::task<void> whenBoth(const concurrency::task<void>& first, const concurrency::task<void>& second);
+
+		std::shared_ptr<IConsumerStage<Input>> m_stage;
+		std::shared_ptr<BatchedWriterStage<Journaled<Input>>> m_writer;
+		std::atomic<unsigned long long> m_journaledCount;
+	};
+
+}}
+
+#include "JournalingStage.hpp"
@@ -0,0 +1,129 @@
+#include <stdexcept>
+
+
+namespace Tools { namespace Parallel {
+
+	// Journals are written in smaller batches than BatchedWriterStage's
+	// default, so that a lightly loaded stage's journal keeps up
+	const size_t c_journalBatchBytes = 256 * 1024;
+
+	template<class Input>
+	JournalingStage<Input>::JournalingStage(
+		const std::shared_ptr<IConsumerStage<Input>>& stage,
+		const std::wstring& path,
+		const std::function<void(Input&, std::vector<char>&)>& serializeFunction)
+		: JournalingStage<Input>(
+			stage,
+			path,
+			serializeFunction,
+			FsyncPolicy(),
+			nullptr /*handleErrorFunction*/)
+	{
+	}
+
+	template<class Input>
+	JournalingStage<Input>::JournalingStage(
+		const std::shared_ptr<IConsumerStage<Input>>& stage,
+		const std::wstring& path,
+		const std::function<void(Input&, std::vector<char>&)>& serializeFunction,
+		const FsyncPolicy& fsyncPolicy,
+		const std::function<void(int, std::exception_ptr)>& handleErrorFunction)
+		: m_stage(stage)
+		, m_journaledCount(0)
+	{
+		if (m_stage == nullptr || serializeFunction == nullptr)
+		{
+			throw std::invalid_argument("JournalingStage requires a valid stage and serialize function.");
+		}
+
+		m_writer = std::make_shared<BatchedWriterStage<Journaled<Input>>>(
+			m_stage->stageId(),
+			path,
+			[serializeFunction](Journaled<Input>& journaled, std::vector<char>& buffer)
+			{
+				Details::appendJournalRecord(journaled.arrivalNanoseconds, journaled.input, serializeFunction, buffer);
+			},
+			c_journalBatchBytes,
+			fsyncPolicy,
+			handleErrorFunction);
+	}
+
+	template<class Input>
+	int JournalingStage<Input>::stageId() const
+	{
+		return m_stage->stageId();
+	}
+
+	template<class Input>
+	bool JournalingStage<Input>::isActive()
+	{
+		return m_stage->isActive();
+	}
+
+	template<class Input>
+	bool JournalingStage<Input>::isFlushing()
+	{
+		return m_stage->isFlushing();
+	}
+
+	template<class Input>
+	void JournalingStage<Input>::activate()
+	{
+		m_writer->activate();
+		m_stage->activate();
+	}
+
+	template<class Input>
+	concurrency::task<void> JournalingStage<Input>::deactivate()
+	{
+		return whenBoth(m_stage->deactivate(), m_writer->deactivate());
+	}
+
+	template<class Input>
+	concurrency::task<void> JournalingStage<Input>::flushOne()
+	{
+		return whenBoth(m_stage->flushOne(), m_writer->flushOne());
+	}
+
+	template<class Input>
+	concurrency::task<void> JournalingStage<Input>::flushAll()
+	{
+		return whenBoth(m_stage->flushAll(), m_writer->flushOne());
+	}
+
+	template<class Input>
+	bool JournalingStage<Input>::hasInputs() const
+	{
+		return m_stage->hasInputs();
+	}
+
+	template<class Input>
+	void JournalingStage<Input>::addInput(Input& input)
+	{
+		Journaled<Input> journaled;
+		journaled.arrivalNanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::system_clock::now().time_since_epoch()).count();
+		journaled.input = input;
+
+		m_writer->addInput(journaled);
+		m_stage->addInput(input);
+		m_journaledCount.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	template<class Input>
+	unsigned long long JournalingStage<Input>::journaledCount() const
+	{
+		return m_journaledCount.load(std::memory_order_relaxed);
+	}
+
+	template<class Input>
+	concurrency::task<void> JournalingStage<Input>::whenBoth(const concurrency::task<void>& first, const concurrency::task<void>& second)
+	{
+		std::vector<concurrency::task<void>> tasks;
+		tasks.push_back(first);
+		tasks.push_back(second);
+
+		return concurrency::when_all(tasks.begin(), tasks.end());
+	}
+
+}}
@@ -0,0 +1,155 @@
+#pragma once
+
+#include "ConnectableBase.h"
+#include "HashMixing.h"
+#include "IInspectableStage.h"
+#include "KeyedStateStore.h"
+#include "PipelineStageBase.h"
+
+#include <concurrent_queue.h>
+#include <ppltasks.h>
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+
+namespace Tools { namespace Parallel {
+
+	/*
+	 * KeyedPipelineStage is a stateful pipeline stage. It passes each input
+	 * to processInputFunction together with the State kept for the input's
+	 * key, so a stage such as a sessionizer or a counter needs no map or
+	 * lock of its own.
+	 *
+	 * Inputs are routed by the hash of their key to a fixed number of
+	 * partitions, each with its own queue, a single worker and a
+	 * KeyedStateStore that only that worker touches. All inputs of a key
+	 * are therefore processed in order, and state is reached without locks.
+	 * The key function runs once when an input is routed and again in its
+	 * partition, so it should be cheap.
+	 */
+	template<class Input, class Output, class Key, class State, class Hash = std::hash<Key>>
+	class KeyedPipelineStage
+		: public IConsumerStage<Input>
+		, public IInspectableStage
+		, public ConnectableBase<Output>
+		, public std::enable_shared_from_this<KeyedPipelineStage<Input, Output, Key, State, Hash>>
+	{
+	public:
+		typedef std::vector<std::pair<Key, State>> StateSnapshot;
+
+#pragma region Constructors and Destructor
+
+		KeyedPipelineStage(
+			int stageId,
+			const std::function<Key(Input&)>& keyFunction,
+			const std::function<Output(Input&, State&)>& processInputFunction,
+			unsigned int partitionCount);
+
+		/*
+		 * A non-zero stateTimeToLive evicts the state of a key that has not
+		 * had an input for that long.
+		 */
+		KeyedPipelineStage(
+			int stageId,
+			const std::function<Key(Input&)>& keyFunction,
+			const std::function<Output(Input&, State&)>& processInputFunction,
+			unsigned int partitionCount,
+			std::chrono::milliseconds stateTimeToLive,
+			const std::function<void(int, std::exception_ptr)>& handleErrorFunction);
+
+		KeyedPipelineStage(const KeyedPipelineStage<Input, Output, Key, State, Hash>& other) = delete;
+
+#pragma endregion
+
+#pragma region IPipelineStage implementations
+
+		int stageId() const override;
+		bool isActive() override;
+		bool isFlushing() override;
+		void activate() override;
+		concurrency::task<void> deactivate() override;
+		concurrency::task<void> flushOne() override;
+		concurrency::task<void> flushAll() override;
+
+#pragma endregion
+
+#pragma region IConsumerStage implementations
+
+		bool hasInputs() const override;
+		void addInput(Input& input) override;
+
+#pragma endregion
+
+#pragma region IInspectableStage implementations
+
+		StageSnapshot snapshot() override;
+		std::vector<std::shared_ptr<IPipelineStage>> consumerStages() override;
+
+#pragma endregion
+
+		unsigned int partitionCount() const;
+
+		/*
+		 * Collects the state of every key. An active partition copies its
+		 * state between two inputs, or when it is idle, so the task may
+		 * complete only after the inputs ahead of the request.
+		 */
+		concurrency::task<StateSnapshot> snapshotState();
+
+	private:
+		class Partition;
+
+		static concurrency::task<void> whenAll(std::vector<concurrency::task<void>>& tasks);
+
+		int m_stageId;
+		std::function<Key(Input&)> m_key;
+		std::function<Output(Input&, State&)> m_processInput;
+		Hash m_hash;
+		std::vector<std::shared_ptr<Partition>> m_partitions;
+	};
+
+#pragma region KeyedPipelineStage::Partition
+
+	/*
+	 * One partition of a KeyedPipelineStage: a single-worker stage that owns
+	 * the state of the keys routed to it.
+	 */
+	template<class Input, class Output, class Key, class State, class Hash>
+	class KeyedPipelineStage<Input, Output, Key, State, Hash>::Partition
+		: public PipelineStageBase<Input>
+		, public std::enable_shared_from_this<typename KeyedPipelineStage<Input, Output, Key, State, Hash>::Partition>
+	{
+	public:
+		Partition(
+			KeyedPipelineStage<Input, Output, Key, State, Hash>& owner,
+			std::chrono::milliseconds stateTimeToLive,
+			const std::function<void(int, std::exception_ptr)>& handleErrorFunction);
+
+		~Partition();
+
+		void setWorkerCount(unsigned int workerCount) override;
+
+		concurrency::task<StateSnapshot> snapshotState();
+
+	protected:
+		void processInput(Input& input) override;
+		void onIdle() override;
+		void onFlushed() override;
+
+	private:
+		void completeSnapshots();
+
+		KeyedPipelineStage<Input, Output, Key, State, Hash>& m_owner;
+		KeyedStateStore<Key, State, Hash> m_states;
+		concurrency::concurrent_queue<concurrency::task_completion_event<StateSnapshot>> m_snapshotRequests;
+	};
+
+#pragma endregion
+
+}}
+
+#include "KeyedPipelineStage.hpp"
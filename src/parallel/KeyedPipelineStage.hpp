@@ -0,0 +1,344 @@
+#include <stdexcept>
+
+
+namespace Tools { namespace Parallel {
+
+#pragma region KeyedPipelineStage
+
+	template<class Input, class Output, class Key, class State, class Hash>
+	KeyedPipelineStage<Input, Output, Key, State, Hash>::KeyedPipelineStage(
+		int stageId,
+		const std::function<Key(Input&)>& keyFunction,
+		const std::function<Output(Input&, State&)>& processInputFunction,
+		unsigned int partitionCount)
+		: KeyedPipelineStage<Input, Output, Key, State, Hash>(
+			stageId,
+			keyFunction,
+			processInputFunction,
+			partitionCount,
+			std::chrono::milliseconds::zero(),
+			nullptr /*handleErrorFunction*/)
+	{
+	}
+
+	template<class Input, class Output, class Key, class State, class Hash>
+	KeyedPipelineStage<Input, Output, Key, State, Hash>::KeyedPipelineStage(
+		int stageId,
+		const std::function<Key(Input&)>& keyFunction,
+		const std::function<Output(Input&, State&)>& processInputFunction,
+		unsigned int partitionCount,
+		std::chrono::milliseconds stateTimeToLive,
+		const std::function<void(int, std::exception_ptr)>& handleErrorFunction)
+		: m_stageId(stageId)
+		, m_key(keyFunction)
+		, m_processInput(processInputFunction)
+	{
+		if (m_key == nullptr || m_processInput == nullptr)
+		{
+			throw std::invalid_argument("KeyedPipelineStage requires a valid key function and process input function.");
+		}
+
+		if (partitionCount == 0)
+		{
+			throw std::invalid_argument("KeyedPipelineStage requires at least one partition.");
+		}
+
+		for (unsigned int i = 0; i < partitionCount; ++i)
+		{
+			m_partitions.push_back(std::make_shared<Partition>(*this, stateTimeToLive, handleErrorFunction));
+		}
+	}
+
+	template<class Input, class Output, class Key, class State, class Hash>
+	int KeyedPipelineStage<Input, Output, Key, State, Hash>::stageId() const
+	{
+		return m_stageId;
+	}
+
+	template<class Input, class Output, class Key, class State, class Hash>
+	bool KeyedPipelineStage<Input, Output, Key, State, Hash>::isActive()
+	{
+		for (auto& partition : m_partitions)
+		{
+			if (partition->isActive())
+			{
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	template<class Input, class Output, class Key, class State, class Hash>
+	bool KeyedPipelineStage<Input, Output, Key, State, Hash>::isFlushing()
+	{
+		for (auto& partition : m_partitions)
+		{
+			if (partition->isFlushing())
+			{
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	template<class Input, class Output, class Key, class State, class Hash>
+	void KeyedPipelineStage<Input, Output, Key, State, Hash>::activate()
+	{
+		this->activateConsumers();
+		for (auto& partition : m_partitions)
+		{
+			partition->activate();
+		}
+	}
+
+	template<class Input, class Output, class Key, class State, class Hash>
+	concurrency::task<void> KeyedPipelineStage<Input, Output, Key, State, Hash>::deactivate()
+	{
+		std::vector<concurrency::task<void>> deactivateTasks;
+		for (auto& partition : m_partitions)
+		{
+			deactivateTasks.push_back(partition->deactivate());
+		}
+
+		return whenAll(deactivateTasks);
+	}
+
+	template<class Input, class Output, class Key, class State, class Hash>
+	concurrency::task<void> KeyedPipelineStage<Input, Output, Key, State, Hash>::flushOne()
+	{
+		std::vector<concurrency::task<void>> flushTasks;
+		for (auto& partition : m_partitions)
+		{
+			flushTasks.push_back(partition->flushOne());
+		}
+
+		return whenAll(flushTasks);
+	}
+
+	template<class Input, class Output, class Key, class State, class Hash>
+	concurrency::task<void> KeyedPipelineStage<Input, Output, Key, State, Hash>::flushAll()
+	{
+		auto flushOneTask = flushOne();
+		std::weak_ptr<KeyedPipelineStage<Input, Output, Key, State, Hash>> wpThis(this->shared_from_this());
+
+		return flushOneTask.then([wpThis]()
+		{
+			auto spThis = wpThis.lock();
+			if (spThis != nullptr)
+			{
+				return spThis->flushConsumers();
+			}
+			else
+			{
+				return concurrency::task_from_result();
+			}
+		});
+	}
+
+	template<class Input, class Output, class Key, class State, class Hash>
+	bool KeyedPipelineStage<Input, Output, Key, State, Hash>::hasInputs() const
+	{
+		for (auto& partition : m_partitions)
+		{
+			if (partition->hasInputs())
+			{
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	template<class Input, class Output, class Key, class State, class Hash>
+	void KeyedPipelineStage<Input, Output, Key, State, Hash>::addInput(Input& input)
+	{
+		// The partition's store places keys by the low bits of the same hash,
+		// so partitions are chosen by the high bits to keep each store evenly
+		// spread
+		uint64_t hash = Details::mixHash(static_cast<uint64_t>(m_hash(m_key(input))));
+		m_partitions[static_cast<size_t>((hash >> 32) % m_partitions.size())]->addInput(input);
+	}
+
+	template<class Input, class Output, class Key, class State, class Hash>
+	StageSnapshot KeyedPipelineStage<Input, Output, Key, State, Hash>::snapshot()
+	{
+		StageSnapshot snapshot;
+		snapshot.stageId = m_stageId;
+		snapshot.type = typeid(*this).name();
+
+		// The partitions appear together as one stage with one worker each
+		for (auto& partition : m_partitions)
+		{
+			auto partitionSnapshot = partition->snapshot();
+			snapshot.isActive = snapshot.isActive || partitionSnapshot.isActive;
+			snapshot.isFlushing = snapshot.isFlushing || partitionSnapshot.isFlushing;
+			snapshot.queueDepth += partitionSnapshot.queueDepth;
+			snapshot.workerCount += partitionSnapshot.workerCount;
+			snapshot.runningWorkers += partitionSnapshot.runningWorkers;
+		}
+
+		return snapshot;
+	}
+
+	template<class Input, class Output, class Key, class State, class Hash>
+	std::vector<std::shared_ptr<IPipelineStage>> KeyedPipelineStage<Input, Output, Key, State, Hash>::consumerStages()
+	{
+		return ConnectableBase<Output>::consumerStages();
+	}
+
+	template<class Input, class Output, class Key, class State, class Hash>
+	unsigned int KeyedPipelineStage<Input, Output, Key, State, Hash>::partitionCount() const
+	{
+		return static_cast<unsigned int>(m_partitions.size());
+	}
+
+	template<class Input, class Output, class Key, class State, class Hash>
+	concurrency::task<typename KeyedPipelineStage<Input, Output, Key, State, Hash>::StateSnapshot>
+		KeyedPipelineStage<Input, Output, Key, State, Hash>::snapshotState()
+	{
+		auto snapshots = std::make_shared<std::vector<StateSnapshot>>(m_partitions.size());
+		std::vector<concurrency::task<void>> snapshotTasks;
+
+		for (size_t i = 0; i < m_partitions.size(); ++i)
+		{
+			snapshotTasks.push_back(m_partitions[i]->snapshotState().then([snapshots, i](StateSnapshot partitionSnapshot)
+			{
+				(*snapshots)[i] = std::move(partitionSnapshot);
+			}));
+		}
+
+		return whenAll(snapshotTasks).then([snapshots]()
+		{
+			StateSnapshot states;
+			for (auto& partitionSnapshot : *snapshots)
+			{
+				states.insert(states.end(), partitionSnapshot.begin(), partitionSnapshot.end());
+			}
+
+			return states;
+		});
+	}
+
+	template<class Input, class Output, class Key, class State, class Hash>
+	concurrency::task<void> KeyedPipelineStage<Input, Output, Key, State, Hash>::whenAll(std::vector<concurrency::task<void>>& tasks)
+	{
+		return concurrency::when_all(tasks.begin(), tasks.end());
+	}
+
+#pragma endregion
+
+#pragma region KeyedPipelineStage::Partition
+
+	template<class Input, class Output, class Key, class State, class Hash>
+	KeyedPipelineStage<Input, Output, Key, State, Hash>::Partition::Partition(
+		KeyedPipelineStage<Input, Output, Key, State, Hash>& owner,
+		std::chrono::milliseconds stateTimeToLive,
+		const std::function<void(int, std::exception_ptr)>& handleErrorFunction)
+		: PipelineStageBase<Input>(
+			owner.m_stageId,
+			handleErrorFunction)
+		, m_owner(owner)
+		, m_states(stateTimeToLive)
+	{
+	}
+
+	template<class Input, class Output, class Key, class State, class Hash>
+	KeyedPipelineStage<Input, Output, Key, State, Hash>::Partition::~Partition()
+	{
+		// The worker must stop before the states go
+		this->deactivate().wait();
+		completeSnapshots();
+	}
+
+	template<class Input, class Output, class Key, class State, class Hash>
+	void KeyedPipelineStage<Input, Output, Key, State, Hash>::Partition::setWorkerCount(unsigned int workerCount)
+	{
+		if (workerCount != 1)
+		{
+			throw std::invalid_argument("A partition of a KeyedPipelineStage owns its state through a single worker.");
+		}
+	}
+
+	template<class Input, class Output, class Key, class State, class Hash>
+	concurrency::task<typename KeyedPipelineStage<Input, Output, Key, State, Hash>::StateSnapshot>
+		KeyedPipelineStage<Input, Output, Key, State, Hash>::Partition::snapshotState()
+	{
+		concurrency::task_completion_event<StateSnapshot> snapshotCompleted;
+		m_snapshotRequests.push(snapshotCompleted);
+		std::weak_ptr<Partition> wpThis(this->shared_from_this());
+
+		return concurrency::create_task([wpThis, snapshotCompleted]()
+		{
+			// A running worker answers between two inputs. Without one, this
+			// task answers in the worker's place, which keeps a worker from
+			// starting on the states meanwhile; this also covers a worker
+			// that retires or parks before answering.
+			auto snapshotTask = concurrency::create_task(snapshotCompleted);
+			while (!snapshotTask.is_done())
+			{
+				auto spThis = wpThis.lock();
+				if (spThis == nullptr)
+				{
+					break;
+				}
+
+				if (!spThis->tryRunInPlaceOfWorker([&spThis]() { spThis->completeSnapshots(); }))
+				{
+					concurrency::wait(c_waitMilliseconds);
+				}
+			}
+
+			return snapshotTask.get();
+		});
+	}
+
+	template<class Input, class Output, class Key, class State, class Hash>
+	void KeyedPipelineStage<Input, Output, Key, State, Hash>::Partition::processInput(Input& input)
+	{
+		if (!m_snapshotRequests.empty())
+		{
+			completeSnapshots();
+		}
+
+		Output output = m_owner.m_processInput(input, m_states.get(m_owner.m_key(input)));
+		m_owner.pushToConsumers(output);
+	}
+
+	template<class Input, class Output, class Key, class State, class Hash>
+	void KeyedPipelineStage<Input, Output, Key, State, Hash>::Partition::onIdle()
+	{
+		if (!m_snapshotRequests.empty())
+		{
+			completeSnapshots();
+		}
+	}
+
+	template<class Input, class Output, class Key, class State, class Hash>
+	void KeyedPipelineStage<Input, Output, Key, State, Hash>::Partition::onFlushed()
+	{
+		onIdle();
+	}
+
+	template<class Input, class Output, class Key, class State, class Hash>
+	void KeyedPipelineStage<Input, Output, Key, State, Hash>::Partition::completeSnapshots()
+	{
+		concurrency::task_completion_event<StateSnapshot> snapshotCompleted;
+		if (!m_snapshotRequests.try_pop(snapshotCompleted))
+		{
+			return;
+		}
+
+		// Requests that arrived together share one copy of the states
+		auto states = m_states.snapshot();
+		do
+		{
+			snapshotCompleted.set(states);
+		}
+		while (m_snapshotRequests.try_pop(snapshotCompleted));
+	}
+
+#pragma endregion
+
+}}
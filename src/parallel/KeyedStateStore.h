@@ -0,0 +1,93 @@
+#pragma once
+
+#include "HashMixing.h"
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+
+namespace Tools { namespace Parallel {
+
+	/*
+	 * KeyedStateStore holds a State per key in a flat open-addressing table
+	 * with linear probing, so a lookup touches one or two adjacent slots
+	 * instead of chasing the nodes of a std::unordered_map. Small states
+	 * live in the slots themselves.
+	 *
+	 * With a time to live, a state that has not been accessed for that long
+	 * is evicted. Expired states are swept at most once per time to live,
+	 * during an access.
+	 *
+	 * KeyedStateStore is not thread-safe: each one is meant to be owned by
+	 * a single worker.
+	 */
+	template<class Key, class State, class Hash = std::hash<Key>>
+	class KeyedStateStore
+	{
+	public:
+#pragma region Constructors and Destructor
+
+		KeyedStateStore();
+
+		/*
+		 * A zero time to live keeps states until they are erased.
+		 */
+		explicit KeyedStateStore(std::chrono::milliseconds timeToLive);
+
+#pragma endregion
+
+#pragma region States
+
+		/*
+		 * Returns the state of key, default-constructing it if there is
+		 * none. The reference is valid until the next call that changes the
+		 * store.
+		 */
+		State& get(const Key& key);
+
+		State* tryGet(const Key& key);
+		bool erase(const Key& key);
+		size_t size() const;
+
+		size_t evictExpired();
+
+		std::vector<std::pair<Key, State>> snapshot() const;
+
+#pragma endregion
+
+	private:
+		struct Slot
+		{
+			Slot()
+				: key()
+				, state()
+				, hash(0)
+				, isOccupied(false)
+			{
+			}
+
+			Key key;
+			State state;
+			uint64_t hash;
+			std::chrono::steady_clock::time_point lastAccess;
+			bool isOccupied;
+		};
+
+		bool hasTimeToLive() const;
+		size_t find(const Key& key, uint64_t hash) const;
+		void removeAt(size_t index);
+		void resize(size_t slotsCount);
+
+		std::vector<Slot> m_slots;
+		size_t m_size;
+		Hash m_hash;
+		std::chrono::milliseconds m_timeToLive;
+		std::chrono::steady_clock::time_point m_lastEviction;
+	};
+
+}}
+
+#include "KeyedStateStore.hpp"
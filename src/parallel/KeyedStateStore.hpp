@@ -0,0 +1,204 @@
+#include <stdexcept>
+
+
+namespace Tools { namespace Parallel {
+
+	const size_t c_minimumStateStoreSlots = 16;
+
+	template<class Key, class State, class Hash>
+	KeyedStateStore<Key, State, Hash>::KeyedStateStore()
+		: KeyedStateStore(std::chrono::milliseconds::zero())
+	{
+	}
+
+	template<class Key, class State, class Hash>
+	KeyedStateStore<Key, State, Hash>::KeyedStateStore(std::chrono::milliseconds timeToLive)
+		: m_slots(c_minimumStateStoreSlots)
+		, m_size(0)
+		, m_timeToLive(timeToLive)
+		, m_lastEviction(std::chrono::steady_clock::now())
+	{
+		if (timeToLive.count() < 0)
+		{
+			throw std::invalid_argument("KeyedStateStore requires a time to live that is not negative.");
+		}
+	}
+
+	template<class Key, class State, class Hash>
+	State& KeyedStateStore<Key, State, Hash>::get(const Key& key)
+	{
+		std::chrono::steady_clock::time_point now;
+		if (hasTimeToLive())
+		{
+			now = std::chrono::steady_clock::now();
+			if (now - m_lastEviction >= m_timeToLive)
+			{
+				evictExpired();
+			}
+		}
+
+		uint64_t hash = Details::mixHash(static_cast<uint64_t>(m_hash(key)));
+		size_t index = find(key, hash);
+
+		if (!m_slots[index].isOccupied)
+		{
+			// Keep at least half of the slots empty so that probes stay short
+			if ((m_size + 1) * 2 > m_slots.size())
+			{
+				resize(m_slots.size() * 2);
+				index = find(key, hash);
+			}
+
+			Slot& slot = m_slots[index];
+			slot.key = key;
+			slot.state = State();
+			slot.hash = hash;
+			slot.isOccupied = true;
+			++m_size;
+		}
+
+		Slot& slot = m_slots[index];
+		slot.lastAccess = now;
+
+		return slot.state;
+	}
+
+	template<class Key, class State, class Hash>
+	State* KeyedStateStore<Key, State, Hash>::tryGet(const Key& key)
+	{
+		size_t index = find(key, Details::mixHash(static_cast<uint64_t>(m_hash(key))));
+		return m_slots[index].isOccupied ? &m_slots[index].state : nullptr;
+	}
+
+	template<class Key, class State, class Hash>
+	bool KeyedStateStore<Key, State, Hash>::erase(const Key& key)
+	{
+		size_t index = find(key, Details::mixHash(static_cast<uint64_t>(m_hash(key))));
+		if (!m_slots[index].isOccupied)
+		{
+			return false;
+		}
+
+		removeAt(index);
+		return true;
+	}
+
+	template<class Key, class State, class Hash>
+	size_t KeyedStateStore<Key, State, Hash>::size() const
+	{
+		return m_size;
+	}
+
+	template<class Key, class State, class Hash>
+	size_t KeyedStateStore<Key, State, Hash>::evictExpired()
+	{
+		if (!hasTimeToLive())
+		{
+			return 0;
+		}
+
+		auto now = std::chrono::steady_clock::now();
+		m_lastEviction = now;
+
+		size_t sizeBefore = m_size;
+		for (size_t index = 0; index < m_slots.size();)
+		{
+			Slot& slot = m_slots[index];
+			if (slot.isOccupied && now - slot.lastAccess >= m_timeToLive)
+			{
+				// Removing shifts a later slot into this one, which must be
+				// examined in turn
+				removeAt(index);
+			}
+			else
+			{
+				++index;
+			}
+		}
+
+		return sizeBefore - m_size;
+	}
+
+	template<class Key, class State, class Hash>
+	std::vector<std::pair<Key, State>> KeyedStateStore<Key, State, Hash>::snapshot() const
+	{
+		std::vector<std::pair<Key, State>> states;
+		states.reserve(m_size);
+
+		for (auto& slot : m_slots)
+		{
+			if (slot.isOccupied)
+			{
+				states.emplace_back(slot.key, slot.state);
+			}
+		}
+
+		return states;
+	}
+
+	template<class Key, class State, class Hash>
+	bool KeyedStateStore<Key, State, Hash>::hasTimeToLive() const
+	{
+		return m_timeToLive.count() > 0;
+	}
+
+	template<class Key, class State, class Hash>
+	size_t KeyedStateStore<Key, State, Hash>::find(const Key& key, uint64_t hash) const
+	{
+		// Returns the slot of key, or the empty slot where it would go
+		size_t mask = m_slots.size() - 1;
+		size_t index = static_cast<size_t>(hash) & mask;
+
+		while (m_slots[index].isOccupied && !(m_slots[index].hash == hash && m_slots[index].key == key))
+		{
+			index = (index + 1) & mask;
+		}
+
+		return index;
+	}
+
+	template<class Key, class State, class Hash>
+	void KeyedStateStore<Key, State, Hash>::removeAt(size_t index)
+	{
+		// Shift later slots of the same probe run back into the hole, so
+		// that lookups never need tombstones
+		size_t mask = m_slots.size() - 1;
+		size_t hole = index;
+
+		for (size_t next = (hole + 1) & mask; m_slots[next].isOccupied; next = (next + 1) & mask)
+		{
+			size_t home = static_cast<size_t>(m_slots[next].hash) & mask;
+			if (((next - home) & mask) >= ((next - hole) & mask))
+			{
+				m_slots[hole] = std::move(m_slots[next]);
+				hole = next;
+			}
+		}
+
+		m_slots[hole] = Slot();
+		--m_size;
+	}
+
+	template<class Key, class State, class Hash>
+	void KeyedStateStore<Key, State, Hash>::resize(size_t slotsCount)
+	{
+		std::vector<Slot> slots(slotsCount);
+		std::swap(m_slots, slots);
+
+		size_t mask = slotsCount - 1;
+		for (auto& slot : slots)
+		{
+			if (slot.isOccupied)
+			{
+				size_t index = static_cast<size_t>(slot.hash) & mask;
+				while (m_slots[index].isOccupied)
+				{
+					index = (index + 1) & mask;
+				}
+
+				m_slots[index] = std::move(slot);
+			}
+		}
+	}
+
+}}
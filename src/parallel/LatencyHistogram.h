@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+
+
+namespace Tools { namespace Parallel {
+
+	/*
+	 * LatencyHistogram counts latencies in log-linear buckets, in the manner
+	 * of an HDR histogram: every power of two is split into 32 buckets, so
+	 * a reported percentile is within about 3% of the true value, from
+	 * nanoseconds up to centuries, in a fixed 15 KB of counters.
+	 *
+	 * Recording is a few relaxed atomic increments and never blocks, so any
+	 * number of threads can record at once. Queries may run concurrently
+	 * with recording; they see each count as of some recent moment.
+	 */
+	class LatencyHistogram
+	{
+	public:
+		static const unsigned int SubBucketBits = 5;
+		static const unsigned int SubBucketCount = 1 << SubBucketBits;
+		static const unsigned int BucketCount = (64 - SubBucketBits + 1) * SubBucketCount;
+
+#pragma region Constructors and Destructor
+
+		LatencyHistogram();
+
+		LatencyHistogram(const LatencyHistogram& other) = delete;
+
+#pragma endregion
+
+		void record(std::chrono::nanoseconds latency);
+
+		unsigned long long count() const;
+		std::chrono::nanoseconds mean() const;
+		std::chrono::nanoseconds maximum() const;
+
+		/*
+		 * Returns the latency that the given percentage (0 to 100) of the
+		 * recorded latencies do not exceed, or zero if nothing was recorded.
+		 */
+		std::chrono::nanoseconds percentile(double percentage) const;
+
+	private:
+		static unsigned int mostSignificantBit(unsigned long long value);
+		static size_t bucketIndex(unsigned long long value);
+		static unsigned long long bucketUpperBound(size_t index);
+
+		std::atomic<unsigned long long> m_buckets[BucketCount];
+		std::atomic<unsigned long long> m_count;
+		std::atomic<unsigned long long> m_totalNanoseconds;
+		std::atomic<unsigned long long> m_maximum;
+	};
+
+}}
+
+#include "LatencyHistogram.hpp"
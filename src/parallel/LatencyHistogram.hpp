@@ -0,0 +1,133 @@
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+
+namespace Tools { namespace Parallel {
+
+	inline LatencyHistogram::LatencyHistogram()
+		: m_count(0)
+		, m_totalNanoseconds(0)
+		, m_maximum(0)
+	{
+		for (size_t i = 0; i < BucketCount; ++i)
+		{
+			m_buckets[i].store(0, std::memory_order_relaxed);
+		}
+	}
+
+	inline void LatencyHistogram::record(std::chrono::nanoseconds latency)
+	{
+		unsigned long long value = latency.count() > 0 ? static_cast<unsigned long long>(latency.count()) : 0;
+
+		m_buckets[bucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+		m_count.fetch_add(1, std::memory_order_relaxed);
+		m_totalNanoseconds.fetch_add(value, std::memory_order_relaxed);
+
+		unsigned long long maximum = m_maximum.load(std::memory_order_relaxed);
+		while (value > maximum && !m_maximum.compare_exchange_weak(maximum, value, std::memory_order_relaxed));
+	}
+
+	inline unsigned long long LatencyHistogram::count() const
+	{
+		return m_count.load(std::memory_order_relaxed);
+	}
+
+	inline std::chrono::nanoseconds LatencyHistogram::mean() const
+	{
+		unsigned long long count = m_count.load(std::memory_order_relaxed);
+		if (count == 0)
+		{
+			return std::chrono::nanoseconds::zero();
+		}
+
+		return std::chrono::nanoseconds(m_totalNanoseconds.load(std::memory_order_relaxed) / count);
+	}
+
+	inline std::chrono::nanoseconds LatencyHistogram::maximum() const
+	{
+		return std::chrono::nanoseconds(m_maximum.load(std::memory_order_relaxed));
+	}
+
+	inline std::chrono::nanoseconds LatencyHistogram::percentile(double percentage) const
+	{
+		if (percentage < 0.0 || percentage > 100.0)
+		{
+			throw std::invalid_argument("A percentile must be between 0 and 100.");
+		}
+
+		// Rank against the buckets themselves rather than m_count, which
+		// may already include a latency whose bucket has not been counted
+		unsigned long long counts[BucketCount];
+		unsigned long long total = 0;
+		for (size_t i = 0; i < BucketCount; ++i)
+		{
+			counts[i] = m_buckets[i].load(std::memory_order_relaxed);
+			total += counts[i];
+		}
+
+		if (total == 0)
+		{
+			return std::chrono::nanoseconds::zero();
+		}
+
+		auto rank = static_cast<unsigned long long>(std::ceil(percentage / 100.0 * total));
+		rank = (std::max)(rank, 1ULL);
+
+		unsigned long long seen = 0;
+		for (size_t i = 0; i < BucketCount; ++i)
+		{
+			seen += counts[i];
+			if (seen >= rank)
+			{
+				unsigned long long value = (std::min)(bucketUpperBound(i), m_maximum.load(std::memory_order_relaxed));
+				return std::chrono::nanoseconds(value);
+			}
+		}
+
+		return maximum();
+	}
+
+	inline unsigned int LatencyHistogram::mostSignificantBit(unsigned long long value)
+	{
+		unsigned int bit = 0;
+		for (unsigned int shift = 32; shift > 0; shift /= 2)
+		{
+			if (value >> shift)
+			{
+				value >>= shift;
+				bit += shift;
+			}
+		}
+
+		return bit;
+	}
+
+	inline size_t LatencyHistogram::bucketIndex(unsigned long long value)
+	{
+		// Values below two powers of the sub-bucket count get a bucket each;
+		// above that, each power of two [2^k, 2^(k+1)) is split evenly into
+		// SubBucketCount buckets by the bits that follow the leading one.
+		if (value < 2 * SubBucketCount)
+		{
+			return static_cast<size_t>(value);
+		}
+
+		unsigned int shift = mostSignificantBit(value) - SubBucketBits;
+		return (shift + 1) * SubBucketCount + static_cast<size_t>((value >> shift) & (SubBucketCount - 1));
+	}
+
+	inline unsigned long long LatencyHistogram::bucketUpperBound(size_t index)
+	{
+		if (index < 2 * SubBucketCount)
+		{
+			return index;
+		}
+
+		unsigned int shift = static_cast<unsigned int>(index / SubBucketCount) - 1;
+		unsigned long long lowerBound = static_cast<unsigned long long>(SubBucketCount + index % SubBucketCount) << shift;
+
+		return lowerBound + ((1ULL << shift) - 1);
+	}
+
+}}
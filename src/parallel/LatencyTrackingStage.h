@@ -0,0 +1,85 @@
+#pragma once
+
+#include "PipelineStage.h"
+#include "Tracked.h"
+
+#include <chrono>
+#include <functional>
+#include <memory>
+
+
+namespace Tools { namespace Parallel {
+
+	/*
+	 * The output type of a tracked stage: a Tracked envelope, or nothing for
+	 * a final stage.
+	 */
+	template<class Output>
+	struct TrackedOutput
+	{
+		typedef Tracked<Output> type;
+	};
+
+	template<>
+	struct TrackedOutput<void>
+	{
+		typedef void type;
+	};
+
+	/*
+	 * Wraps a process function so that it takes and returns Tracked
+	 * envelopes. For sampled inputs it records the time spent in the queue
+	 * and in the function, and stamps the output with the time it is handed
+	 * on. The final-stage form also records the end-to-end latency.
+	 */
+	template<class Input, class Output>
+	class LatencyTrackingFunction
+	{
+	public:
+		LatencyTrackingFunction(
+			const std::function<Output(Input&)>& processInputFunction,
+			const std::shared_ptr<StageLatency>& latency);
+
+		Tracked<Output> operator()(Tracked<Input>& input) const;
+
+	private:
+		std::function<Output(Input&)> m_processInput;
+		std::shared_ptr<StageLatency> m_latency;
+	};
+
+	template<class Input>
+	class LatencyTrackingFunction<Input, void>
+	{
+	public:
+		LatencyTrackingFunction(
+			const std::function<void(Input&)>& processInputFunction,
+			const std::shared_ptr<StageLatency>& latency);
+
+		void operator()(Tracked<Input>& input) const;
+
+	private:
+		std::function<void(Input&)> m_processInput;
+		std::shared_ptr<StageLatency> m_latency;
+	};
+
+	/*
+	 * Creates a PipelineStage that carries Tracked envelopes and records its
+	 * latencies into the given StageLatency, which can be queried at any
+	 * time while the stage runs. Inputs are wrapped by an IngestSampler.
+	 */
+	template<class Input, class Output>
+	std::shared_ptr<PipelineStage<Tracked<Input>, typename TrackedOutput<Output>::type>> makeTrackedStage(
+		int stageId,
+		const std::function<Output(Input&)>& processInputFunction,
+		const std::shared_ptr<StageLatency>& latency);
+
+	template<class Input, class Output>
+	std::shared_ptr<PipelineStage<Tracked<Input>, typename TrackedOutput<Output>::type>> makeTrackedStage(
+		int stageId,
+		const std::function<Output(Input&)>& processInputFunction,
+		const std::shared_ptr<StageLatency>& latency,
+		const std::function<void(int, std::exception_ptr)>& handleErrorFunction);
+
+}}
+
+#include "LatencyTrackingStage.hpp"
@@ -0,0 +1,95 @@
+namespace Tools { namespace Parallel {
+
+	template<class Input, class Output>
+	LatencyTrackingFunction<Input, Output>::LatencyTrackingFunction(
+		const std::function<Output(Input&)>& processInputFunction,
+		const std::shared_ptr<StageLatency>& latency)
+		: m_processInput(processInputFunction)
+		, m_latency(latency)
+	{
+		if (m_processInput == nullptr || m_latency == nullptr)
+		{
+			throw std::invalid_argument("A tracked stage requires a valid process input function and latency.");
+		}
+	}
+
+	template<class Input, class Output>
+	Tracked<Output> LatencyTrackingFunction<Input, Output>::operator()(Tracked<Input>& input) const
+	{
+		Tracked<Output> output;
+
+		if (!input.isSampled)
+		{
+			output.value = m_processInput(input.value);
+			return output;
+		}
+
+		auto startTime = std::chrono::steady_clock::now();
+		m_latency->queueWait.record(startTime - input.enqueueTime);
+
+		output.value = m_processInput(input.value);
+		output.isSampled = true;
+		output.ingestTime = input.ingestTime;
+
+		// PipelineStage passes the output on as soon as this returns
+		output.enqueueTime = std::chrono::steady_clock::now();
+		m_latency->processing.record(output.enqueueTime - startTime);
+
+		return output;
+	}
+
+	template<class Input>
+	LatencyTrackingFunction<Input, void>::LatencyTrackingFunction(
+		const std::function<void(Input&)>& processInputFunction,
+		const std::shared_ptr<StageLatency>& latency)
+		: m_processInput(processInputFunction)
+		, m_latency(latency)
+	{
+		if (m_processInput == nullptr || m_latency == nullptr)
+		{
+			throw std::invalid_argument("A tracked stage requires a valid process input function and latency.");
+		}
+	}
+
+	template<class Input>
+	void LatencyTrackingFunction<Input, void>::operator()(Tracked<Input>& input) const
+	{
+		if (!input.isSampled)
+		{
+			m_processInput(input.value);
+			return;
+		}
+
+		auto startTime = std::chrono::steady_clock::now();
+		m_latency->queueWait.record(startTime - input.enqueueTime);
+
+		m_processInput(input.value);
+
+		auto endTime = std::chrono::steady_clock::now();
+		m_latency->processing.record(endTime - startTime);
+		m_latency->endToEnd.record(endTime - input.ingestTime);
+	}
+
+	template<class Input, class Output>
+	std::shared_ptr<PipelineStage<Tracked<Input>, typename TrackedOutput<Output>::type>> makeTrackedStage(
+		int stageId,
+		const std::function<Output(Input&)>& processInputFunction,
+		const std::shared_ptr<StageLatency>& latency)
+	{
+		return makeTrackedStage<Input, Output>(stageId, processInputFunction, latency, nullptr /*handleErrorFunction*/);
+	}
+
+	template<class Input, class Output>
+	std::shared_ptr<PipelineStage<Tracked<Input>, typename TrackedOutput<Output>::type>> makeTrackedStage(
+		int stageId,
+		const std::function<Output(Input&)>& processInputFunction,
+		const std::shared_ptr<StageLatency>& latency,
+		const std::function<void(int, std::exception_ptr)>& handleErrorFunction)
+	{
+		return std::make_shared<PipelineStage<Tracked<Input>, typename TrackedOutput<Output>::type>>(
+			stageId,
+			LatencyTrackingFunction<Input, Output>(processInputFunction, latency),
+			handleErrorFunction);
+	}
+
+}}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "ConcurrentLruCache.h"
+#include "PipelineStage.h"
+
+#include <functional>
+#include <memory>
+
+
+namespace Tools { namespace Parallel {
+
+	/*
+	 * Wraps a pure process function so that its outputs are looked up in a
+	 * ConcurrentLruCache by a key taken from the input. The function only
+	 * runs for keys that are not cached or already being computed.
+	 */
+	template<class Input, class Output, class Key>
+	class MemoizingFunction
+	{
+	public:
+		MemoizingFunction(
+			const std::function<Key(Input&)>& keyFunction,
+			const std::function<Output(Input&)>& processInputFunction,
+			const std::shared_ptr<ConcurrentLruCache<Key, Output>>& cache);
+
+		Output operator()(Input& input) const;
+
+	private:
+		std::function<Key(Input&)> m_key;
+		std::function<Output(Input&)> m_processInput;
+		std::shared_ptr<ConcurrentLruCache<Key, Output>> m_cache;
+	};
+
+	/*
+	 * Creates a PipelineStage that memoizes processInputFunction in the
+	 * given cache, whose counters can be queried at any time while the
+	 * stage runs. The cache may be shared by several stages that run the
+	 * same function.
+	 */
+	template<class Input, class Output, class Key>
+	std::shared_ptr<PipelineStage<Input, Output>> makeMemoizingStage(
+		int stageId,
+		const std::function<Key(Input&)>& keyFunction,
+		const std::function<Output(Input&)>& processInputFunction,
+		const std::shared_ptr<ConcurrentLruCache<Key, Output>>& cache);
+
+	template<class Input, class Output, class Key>
+	std::shared_ptr<PipelineStage<Input, Output>> makeMemoizingStage(
+		int stageId,
+		const std::function<Key(Input&)>& keyFunction,
+		const std::function<Output(Input&)>& processInputFunction,
+		const std::shared_ptr<ConcurrentLruCache<Key, Output>>& cache,
+		const std::function<void(int, std::exception_ptr)>& handleErrorFunction);
+
+}}
+
+#include "MemoizingStage.hpp"
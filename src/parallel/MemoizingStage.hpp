@@ -0,0 +1,51 @@
+namespace Tools { namespace Parallel {
+
+	template<class Input, class Output, class Key>
+	MemoizingFunction<Input, Output, Key>::MemoizingFunction(
+		const std::function<Key(Input&)>& keyFunction,
+		const std::function<Output(Input&)>& processInputFunction,
+		const std::shared_ptr<ConcurrentLruCache<Key, Output>>& cache)
+		: m_key(keyFunction)
+		, m_processInput(processInputFunction)
+		, m_cache(cache)
+	{
+		if (m_key == nullptr || m_processInput == nullptr || m_cache == nullptr)
+		{
+			throw std::invalid_argument("A memoizing stage requires a valid key function, process input function and cache.");
+		}
+	}
+
+	template<class Input, class Output, class Key>
+	Output MemoizingFunction<Input, Output, Key>::operator()(Input& input) const
+	{
+		return m_cache->getOrAdd(m_key(input), [this, &input]()
+		{
+			return m_processInput(input);
+		});
+	}
+
+	template<class Input, class Output, class Key>
+	std::shared_ptr<PipelineStage<Input, Output>> makeMemoizingStage(
+		int stageId,
+		const std::function<Key(Input&)>& keyFunction,
+		const std::function<Output(Input&)>& processInputFunction,
+		const std::shared_ptr<ConcurrentLruCache<Key, Output>>& cache)
+	{
+		return makeMemoizingStage<Input, Output, Key>(stageId, keyFunction, processInputFunction, cache, nullptr /*handleErrorFunction*/);
+	}
+
+	template<class Input, class Output, class Key>
+	std::shared_ptr<PipelineStage<Input, Output>> makeMemoizingStage(
+		int stageId,
+		const std::function<Key(Input&)>& keyFunction,
+		const std::function<Output(Input&)>& processInputFunction,
+		const std::shared_ptr<ConcurrentLruCache<Key, Output>>& cache,
+		const std::function<void(int, std::exception_ptr)>& handleErrorFunction)
+	{
+		return std::make_shared<PipelineStage<Input, Output>>(
+			stageId,
+			MemoizingFunction<Input, Output, Key>(keyFunction, processInputFunction, cache),
+			handleErrorFunction);
+	}
+
+}}
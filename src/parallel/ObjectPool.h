@@ -0,0 +1,141 @@
+#pragma once
+
+#include <concrt.h>
+#include <ppl.h>
+
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+
+namespace Tools { namespace Parallel {
+
+	template<class T>
+	class ObjectPool;
+
+	/*
+	 * A handle to an object borrowed from an ObjectPool. Handles are copied
+	 * as they move through stage queues, so they do not own the object:
+	 * exactly one copy, usually the one reaching the final stage, must be
+	 * released, after which every copy is stale.
+	 */
+	template<class T>
+	class Pooled
+	{
+	public:
+		Pooled()
+			: m_object(nullptr)
+			, m_pool(nullptr)
+		{
+		}
+
+		T* get() const
+		{
+			return m_object;
+		}
+
+		T& operator*() const
+		{
+			return *m_object;
+		}
+
+		T* operator->() const
+		{
+			return m_object;
+		}
+
+		explicit operator bool() const
+		{
+			return m_object != nullptr;
+		}
+
+		/*
+		 * Returns the object to the pool it came from.
+		 */
+		void release();
+
+	private:
+		friend class ObjectPool<T>;
+
+		Pooled(T* object, ObjectPool<T>* pool)
+			: m_object(object)
+			, m_pool(pool)
+		{
+		}
+
+		T* m_object;
+		ObjectPool<T>* m_pool;
+	};
+
+	/*
+	 * ObjectPool recycles objects whose heap buffers are costly to allocate
+	 * on one thread and free on another, as when a source creates inputs
+	 * that a final stage completes.
+	 *
+	 * Each thread keeps a batch of free objects to acquire from and a batch
+	 * of released objects. Whole batches are exchanged with a shared depot,
+	 * so the lock is taken once per batchSize objects and a thread that
+	 * only releases feeds a thread that only acquires. New objects are only
+	 * created while the depot is empty; once enough are in flight the pool
+	 * allocates nothing. Up to one partial batch per releasing thread is
+	 * held back until that thread releases more.
+	 *
+	 * Recycled objects keep their contents, including the capacity of their
+	 * buffers; the caller overwrites them. The pool owns every object it
+	 * created and must outlive the handles it gave out.
+	 */
+	template<class T>
+	class ObjectPool
+	{
+	public:
+		static const unsigned int DefaultBatchSize = 64;
+
+#pragma region Constructors and Destructor
+
+		ObjectPool();
+		explicit ObjectPool(unsigned int batchSize);
+
+		ObjectPool(const ObjectPool<T>& other) = delete;
+
+#pragma endregion
+
+#pragma region Objects
+
+		Pooled<T> acquire();
+		void release(Pooled<T>& object);
+
+		unsigned int batchSize() const;
+
+		/*
+		 * How many objects the pool has created so far.
+		 */
+		size_t size() const;
+
+#pragma endregion
+
+	private:
+		typedef std::vector<T*> Batch;
+
+		struct ThreadCache
+		{
+			Batch free;
+			Batch released;
+		};
+
+		Batch makeBatch() const;
+		void exchangeForFull(Batch& batch);
+		void exchangeForEmpty(Batch& batch);
+
+		unsigned int m_batchSize;
+		concurrency::combinable<ThreadCache> m_caches;
+		std::vector<Batch> m_fullBatches;
+		std::vector<Batch> m_emptyBatches;
+		std::vector<std::unique_ptr<T>> m_objects;
+		std::atomic<size_t> m_size;
+		concurrency::critical_section m_depotLock;
+	};
+
+}}
+
+#include "ObjectPool.hpp"
@@ -0,0 +1,136 @@
+#include <utility>
+
+
+namespace Tools { namespace Parallel {
+
+	template<class T>
+	void Pooled<T>::release()
+	{
+		if (m_pool == nullptr)
+		{
+			throw std::logic_error("Only an object acquired from a pool can be released.");
+		}
+
+		m_pool->release(*this);
+	}
+
+	template<class T>
+	ObjectPool<T>::ObjectPool()
+		: ObjectPool<T>(DefaultBatchSize)
+	{
+	}
+
+	template<class T>
+	ObjectPool<T>::ObjectPool(unsigned int batchSize)
+		: m_batchSize(batchSize)
+		, m_caches([this]()
+		{
+			ThreadCache cache;
+			cache.free = makeBatch();
+			cache.released = makeBatch();
+			return cache;
+		})
+		, m_size(0)
+	{
+		if (batchSize == 0)
+		{
+			throw std::invalid_argument("ObjectPool requires a batch size of at least one.");
+		}
+	}
+
+	template<class T>
+	Pooled<T> ObjectPool<T>::acquire()
+	{
+		ThreadCache& cache = m_caches.local();
+		if (cache.free.empty())
+		{
+			exchangeForFull(cache.free);
+		}
+
+		T* object = cache.free.back();
+		cache.free.pop_back();
+
+		return Pooled<T>(object, this);
+	}
+
+	template<class T>
+	void ObjectPool<T>::release(Pooled<T>& object)
+	{
+		if (object.m_pool != this)
+		{
+			throw std::invalid_argument("An object can only be released to the pool it was acquired from.");
+		}
+
+		ThreadCache& cache = m_caches.local();
+		cache.released.push_back(object.m_object);
+		object = Pooled<T>();
+
+		if (cache.released.size() == m_batchSize)
+		{
+			exchangeForEmpty(cache.released);
+		}
+	}
+
+	template<class T>
+	unsigned int ObjectPool<T>::batchSize() const
+	{
+		return m_batchSize;
+	}
+
+	template<class T>
+	size_t ObjectPool<T>::size() const
+	{
+		return m_size.load(std::memory_order_relaxed);
+	}
+
+	template<class T>
+	typename ObjectPool<T>::Batch ObjectPool<T>::makeBatch() const
+	{
+		Batch batch;
+		batch.reserve(m_batchSize);
+		return batch;
+	}
+
+	template<class T>
+	void ObjectPool<T>::exchangeForFull(Batch& batch)
+	{
+		concurrency::critical_section::scoped_lock lock(m_depotLock);
+
+		if (!m_fullBatches.empty())
+		{
+			// Keep the empty vector for a later release, so that batches
+			// change hands without being allocated again
+			m_emptyBatches.push_back(std::move(batch));
+			batch = std::move(m_fullBatches.back());
+			m_fullBatches.pop_back();
+			return;
+		}
+
+		m_objects.reserve(m_objects.size() + m_batchSize);
+		for (unsigned int i = 0; i < m_batchSize; ++i)
+		{
+			m_objects.push_back(std::unique_ptr<T>(new T()));
+			batch.push_back(m_objects.back().get());
+		}
+
+		m_size.store(m_objects.size(), std::memory_order_relaxed);
+	}
+
+	template<class T>
+	void ObjectPool<T>::exchangeForEmpty(Batch& batch)
+	{
+		concurrency::critical_section::scoped_lock lock(m_depotLock);
+
+		m_fullBatches.push_back(std::move(batch));
+		if (!m_emptyBatches.empty())
+		{
+			batch = std::move(m_emptyBatches.back());
+			m_emptyBatches.pop_back();
+		}
+		else
+		{
+			batch = makeBatch();
+		}
+	}
+
+}}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "IScalableStage.h"
+
+#include <concrt.h>
+#include <ppltasks.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+
+namespace Tools { namespace Parallel {
+
+	/*
+	 * PipelineAutoscaler grows and shrinks the worker counts of a set of
+	 * stages to match their load. Every sample interval it reads each stage's
+	 * statistics and estimates how many workers the stage needs from its
+	 * arrival rate, its mean service time and the backlog in its queue.
+	 *
+	 * To keep worker counts from oscillating, a stage is only resized after
+	 * its utilization has stayed above the scale-up threshold (or below the
+	 * scale-down threshold) for several consecutive samples, and then it is
+	 * resized to the target utilization rather than to the threshold.
+	 *
+	 * The sum of all worker counts never exceeds the core budget. Every stage
+	 * is guaranteed its minimum, so addStage refuses a stage whose minimum
+	 * would take the sum of minimums past the budget; the rest of the budget
+	 * goes to the stages under the most pressure first, so cores released
+	 * by idle stages are handed to hot ones.
+	 */
+	class PipelineAutoscaler
+	{
+	public:
+#pragma region Constructors and Destructor
+
+		PipelineAutoscaler(unsigned int coreBudget, std::chrono::milliseconds sampleInterval);
+
+		~PipelineAutoscaler();
+
+		PipelineAutoscaler(const PipelineAutoscaler& other) = delete;
+
+#pragma endregion
+
+		void addStage(const std::shared_ptr<IScalableStage>& stage, unsigned int minWorkers, unsigned int maxWorkers);
+		void removeStage(const std::shared_ptr<IScalableStage>& stage);
+
+		void start();
+		concurrency::task<void> stop();
+		void sample();
+
+	private:
+		struct ScaledStage
+		{
+			std::weak_ptr<IScalableStage> stage;
+			unsigned int minWorkers;
+			unsigned int maxWorkers;
+			StageStatistics lastStatistics;
+			std::chrono::steady_clock::time_point lastSampleTime;
+			double serviceSeconds;
+			unsigned int samplesAboveThreshold;
+			unsigned int samplesBelowThreshold;
+			unsigned int desiredWorkers;
+			double pressure;
+		};
+
+		void updateDesiredWorkers(
+			ScaledStage& scaledStage,
+			const StageStatistics& statistics,
+			std::chrono::steady_clock::time_point now);
+		std::vector<unsigned int> allocateCores();
+		void sampleUntilStopped();
+
+		unsigned int m_coreBudget;
+		std::chrono::milliseconds m_sampleInterval;
+		std::vector<ScaledStage> m_stages;
+		std::atomic<bool> m_isRunning;
+		concurrency::task<void> m_samplingTask;
+		concurrency::critical_section m_stagesLock;
+	};
+
+}}
+
+#include "PipelineAutoscaler.hpp"
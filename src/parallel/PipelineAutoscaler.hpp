@@ -0,0 +1,248 @@
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
+
+
+namespace Tools { namespace Parallel {
+
+	// A stage is resized towards this utilization of its workers
+	const double c_targetUtilization = 0.75;
+	const double c_scaleUpUtilization = 0.9;
+	const double c_scaleDownUtilization = 0.5;
+
+	// Consecutive samples beyond a threshold before a stage is resized.
+	// Shrinking waits longer than growing so that a brief lull does not
+	// give away workers that are needed again a moment later.
+	const unsigned int c_scaleUpSamples = 2;
+	const unsigned int c_scaleDownSamples = 5;
+
+	// A backlog is sized to drain within this many sample intervals
+	const unsigned int c_backlogDrainSamples = 4;
+
+	inline PipelineAutoscaler::PipelineAutoscaler(unsigned int coreBudget, std::chrono::milliseconds sampleInterval)
+		: m_coreBudget(coreBudget)
+		, m_sampleInterval(sampleInterval)
+		, m_isRunning(false)
+		, m_samplingTask(concurrency::task_from_result())
+	{
+		if (coreBudget == 0 || sampleInterval.count() <= 0)
+		{
+			throw std::invalid_argument("Invalid core budget or sample interval.");
+		}
+	}
+
+	inline PipelineAutoscaler::~PipelineAutoscaler()
+	{
+		stop().wait();
+	}
+
+	inline void PipelineAutoscaler::addStage(
+		const std::shared_ptr<IScalableStage>& stage,
+		unsigned int minWorkers,
+		unsigned int maxWorkers)
+	{
+		if (stage == nullptr)
+		{
+			throw std::invalid_argument("Invalid stage.");
+		}
+
+		if (minWorkers == 0 || maxWorkers < minWorkers)
+		{
+			throw std::invalid_argument("Invalid worker bounds.");
+		}
+
+		ScaledStage scaledStage;
+		scaledStage.stage = stage;
+		scaledStage.minWorkers = minWorkers;
+		scaledStage.maxWorkers = maxWorkers;
+		scaledStage.lastStatistics = stage->statistics();
+		scaledStage.lastSampleTime = std::chrono::steady_clock::now();
+		scaledStage.serviceSeconds = 0.0;
+		scaledStage.samplesAboveThreshold = 0;
+		scaledStage.samplesBelowThreshold = 0;
+		scaledStage.desiredWorkers = (std::max)(minWorkers, (std::min)(maxWorkers, scaledStage.lastStatistics.workerCount));
+		scaledStage.pressure = 0.0;
+
+		concurrency::critical_section::scoped_lock lock(m_stagesLock);
+		unsigned int reservedWorkers = 0;
+		for (auto& other : m_stages)
+		{
+			reservedWorkers += other.minWorkers;
+		}
+
+		if (minWorkers > m_coreBudget - reservedWorkers)
+		{
+			throw std::invalid_argument("The stages' minimum worker counts would exceed the core budget.");
+		}
+
+		m_stages.push_back(scaledStage);
+	}
+
+	inline void PipelineAutoscaler::removeStage(const std::shared_ptr<IScalableStage>& stage)
+	{
+		concurrency::critical_section::scoped_lock lock(m_stagesLock);
+		m_stages.erase(
+			std::remove_if(m_stages.begin(), m_stages.end(), [&stage](const ScaledStage& scaledStage)
+			{
+				return scaledStage.stage.lock() == stage;
+			}),
+			m_stages.end());
+	}
+
+	inline void PipelineAutoscaler::start()
+	{
+		if (m_isRunning.exchange(true))
+		{
+			return;
+		}
+
+		m_samplingTask = concurrency::create_task([this](){ sampleUntilStopped(); });
+	}
+
+	inline concurrency::task<void> PipelineAutoscaler::stop()
+	{
+		m_isRunning = false;
+		return m_samplingTask;
+	}
+
+	inline void PipelineAutoscaler::sample()
+	{
+		concurrency::critical_section::scoped_lock lock(m_stagesLock);
+		auto now = std::chrono::steady_clock::now();
+
+		// Each stage is locked once, so one that is destroyed meanwhile is
+		// either sampled and kept alive until resized, or forgotten
+		std::vector<std::shared_ptr<IScalableStage>> stages;
+		auto scaledStage = m_stages.begin();
+		while (scaledStage != m_stages.end())
+		{
+			auto stage = scaledStage->stage.lock();
+			if (stage == nullptr)
+			{
+				scaledStage = m_stages.erase(scaledStage);
+				continue;
+			}
+
+			updateDesiredWorkers(*scaledStage, stage->statistics(), now);
+			stages.push_back(stage);
+			++scaledStage;
+		}
+
+		auto allocations = allocateCores();
+		for (size_t i = 0; i < stages.size(); ++i)
+		{
+			if (allocations[i] != m_stages[i].lastStatistics.workerCount)
+			{
+				stages[i]->setWorkerCount(allocations[i]);
+			}
+		}
+	}
+
+	inline void PipelineAutoscaler::updateDesiredWorkers(
+		ScaledStage& scaledStage,
+		const StageStatistics& statistics,
+		std::chrono::steady_clock::time_point now)
+	{
+		double elapsedSeconds = std::chrono::duration<double>(now - scaledStage.lastSampleTime).count();
+		const StageStatistics& lastStatistics = scaledStage.lastStatistics;
+
+		unsigned long long processed = statistics.inputsProcessed - lastStatistics.inputsProcessed;
+		if (processed > 0)
+		{
+			// Keep the last known service time through samples with no work
+			auto processingTime = std::chrono::duration<double>(statistics.processingTime - lastStatistics.processingTime);
+			scaledStage.serviceSeconds = processingTime.count() / processed;
+		}
+
+		double arrivalRate = elapsedSeconds > 0.0
+			? (statistics.inputsAdded - lastStatistics.inputsAdded) / elapsedSeconds
+			: 0.0;
+		double drainSeconds = c_backlogDrainSamples * std::chrono::duration<double>(m_sampleInterval).count();
+
+		// The number of workers that would be busy all the time keeping up
+		// with arrivals and draining the backlog
+		double load = arrivalRate * scaledStage.serviceSeconds
+			+ statistics.queueDepth * scaledStage.serviceSeconds / drainSeconds;
+
+		unsigned int currentWorkers = (std::max)(1u, statistics.workerCount);
+		double utilization = load / currentWorkers;
+
+		scaledStage.samplesAboveThreshold = utilization > c_scaleUpUtilization ? scaledStage.samplesAboveThreshold + 1 : 0;
+		scaledStage.samplesBelowThreshold = utilization < c_scaleDownUtilization ? scaledStage.samplesBelowThreshold + 1 : 0;
+
+		double targetWorkers = std::ceil(load / c_targetUtilization);
+		unsigned int boundedTargetWorkers = static_cast<unsigned int>((std::max)(
+			static_cast<double>(scaledStage.minWorkers),
+			(std::min)(static_cast<double>(scaledStage.maxWorkers), targetWorkers)));
+
+		bool shouldGrow = scaledStage.samplesAboveThreshold >= c_scaleUpSamples && boundedTargetWorkers > currentWorkers;
+		bool shouldShrink = scaledStage.samplesBelowThreshold >= c_scaleDownSamples && boundedTargetWorkers < currentWorkers;
+
+		if (shouldGrow || shouldShrink)
+		{
+			scaledStage.desiredWorkers = boundedTargetWorkers;
+			scaledStage.samplesAboveThreshold = 0;
+			scaledStage.samplesBelowThreshold = 0;
+		}
+		else if (scaledStage.desiredWorkers < currentWorkers)
+		{
+			// The stage was grown by someone else; hold its current size. A
+			// stage that wants more than the budget gave it keeps asking.
+			scaledStage.desiredWorkers = currentWorkers;
+		}
+
+		scaledStage.desiredWorkers = (std::max)(scaledStage.minWorkers, (std::min)(scaledStage.maxWorkers, scaledStage.desiredWorkers));
+		scaledStage.pressure = utilization;
+		scaledStage.lastStatistics = statistics;
+		scaledStage.lastSampleTime = now;
+	}
+
+	inline std::vector<unsigned int> PipelineAutoscaler::allocateCores()
+	{
+		// Every stage is guaranteed its minimum, which addStage keeps within
+		// the budget
+		std::vector<unsigned int> allocations;
+		unsigned int allocated = 0;
+		for (auto& scaledStage : m_stages)
+		{
+			allocations.push_back(scaledStage.minWorkers);
+			allocated += scaledStage.minWorkers;
+		}
+
+		unsigned int remaining = allocated < m_coreBudget ? m_coreBudget - allocated : 0;
+
+		std::vector<size_t> byPressure(m_stages.size());
+		std::iota(byPressure.begin(), byPressure.end(), 0);
+		std::stable_sort(byPressure.begin(), byPressure.end(), [this](size_t lhs, size_t rhs)
+		{
+			return m_stages[lhs].pressure > m_stages[rhs].pressure;
+		});
+
+		for (size_t index : byPressure)
+		{
+			unsigned int wanted = m_stages[index].desiredWorkers - allocations[index];
+			unsigned int granted = (std::min)(wanted, remaining);
+
+			allocations[index] += granted;
+			remaining -= granted;
+		}
+
+		return allocations;
+	}
+
+	inline void PipelineAutoscaler::sampleUntilStopped()
+	{
+		while (m_isRunning)
+		{
+			concurrency::wait(static_cast<unsigned int>(m_sampleInterval.count()));
+
+			try
+			{
+				sample();
+			}
+			catch (...) {}
+		}
+	}
+
+}}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "IInspectableStage.h"
+#include "IPipelineStage.h"
+#include "StageSnapshot.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+
+namespace Tools { namespace Parallel {
+
+	/*
+	 * Walks a pipeline from its root stage and returns a snapshot of every
+	 * stage it reaches, each stage once, in breadth-first order. Stages that
+	 * are not IInspectableStage are reported with their id and activity only,
+	 * and their consumers are not followed.
+	 *
+	 * Snapshots are taken one stage at a time without pausing the pipeline,
+	 * so they are consistent per stage rather than across the pipeline. That
+	 * keeps the walk cheap enough to run every second from a monitoring
+	 * thread.
+	 */
+	std::vector<StageSnapshot> inspectPipeline(const std::shared_ptr<IPipelineStage>& root);
+
+	/*
+	 * Serializes snapshots as a JSON object with a "stages" array.
+	 */
+	std::string toJson(const std::vector<StageSnapshot>& snapshots);
+
+	/*
+	 * Serializes snapshots as a Graphviz digraph, with an edge from every
+	 * stage to each of its consumers.
+	 */
+	std::string toGraphviz(const std::vector<StageSnapshot>& snapshots);
+
+}}
+
+#include "PipelineInspector.hpp"
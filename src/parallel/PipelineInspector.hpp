@@ -0,0 +1,147 @@
+#include <deque>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <typeinfo>
+
+
+namespace Tools { namespace Parallel {
+
+	namespace Details
+	{
+		inline std::string escapeString(const std::string& value)
+		{
+			std::ostringstream escaped;
+			for (auto iter = value.begin(); iter != value.end(); ++iter)
+			{
+				char c = *iter;
+				if (c == '"' || c == '\\')
+				{
+					escaped << '\\' << c;
+				}
+				else if (static_cast<unsigned char>(c) < 0x20)
+				{
+					escaped << ' ';
+				}
+				else
+				{
+					escaped << c;
+				}
+			}
+
+			return escaped.str();
+		}
+	}
+
+	inline std::vector<StageSnapshot> inspectPipeline(const std::shared_ptr<IPipelineStage>& root)
+	{
+		if (root == nullptr)
+		{
+			throw std::invalid_argument("Invalid root stage.");
+		}
+
+		std::vector<StageSnapshot> snapshots;
+		std::set<IPipelineStage*> visitedStages;
+		std::deque<std::shared_ptr<IPipelineStage>> pendingStages(1, root);
+		visitedStages.insert(root.get());
+
+		while (!pendingStages.empty())
+		{
+			auto stage = pendingStages.front();
+			pendingStages.pop_front();
+
+			StageSnapshot snapshot;
+			auto inspectableStage = std::dynamic_pointer_cast<IInspectableStage>(stage);
+
+			if (inspectableStage != nullptr)
+			{
+				snapshot = inspectableStage->snapshot();
+				auto consumers = inspectableStage->consumerStages();
+
+				for (auto iter = consumers.begin(); iter != consumers.end(); ++iter)
+				{
+					snapshot.consumerIds.push_back((*iter)->stageId());
+					if (visitedStages.insert(iter->get()).second)
+					{
+						pendingStages.push_back(*iter);
+					}
+				}
+			}
+			else
+			{
+				snapshot.stageId = stage->stageId();
+				snapshot.type = typeid(*stage).name();
+				snapshot.isActive = stage->isActive();
+				snapshot.isFlushing = stage->isFlushing();
+			}
+
+			snapshots.push_back(snapshot);
+		}
+
+		return snapshots;
+	}
+
+	inline std::string toJson(const std::vector<StageSnapshot>& snapshots)
+	{
+		std::ostringstream json;
+		json << "{\"stages\":[";
+
+		for (auto iter = snapshots.begin(); iter != snapshots.end(); ++iter)
+		{
+			if (iter != snapshots.begin())
+			{
+				json << ",";
+			}
+
+			json << "{\"id\":" << iter->stageId
+				<< ",\"type\":\"" << Details::escapeString(iter->type) << "\""
+				<< ",\"active\":" << (iter->isActive ? "true" : "false")
+				<< ",\"flushing\":" << (iter->isFlushing ? "true" : "false")
+				<< ",\"queueDepth\":" << iter->queueDepth
+				<< ",\"workerCount\":" << iter->workerCount
+				<< ",\"runningWorkers\":" << iter->runningWorkers
+				<< ",\"consumers\":[";
+
+			for (auto consumer = iter->consumerIds.begin(); consumer != iter->consumerIds.end(); ++consumer)
+			{
+				json << (consumer != iter->consumerIds.begin() ? "," : "") << *consumer;
+			}
+
+			json << "]}";
+		}
+
+		json << "]}";
+		return json.str();
+	}
+
+	inline std::string toGraphviz(const std::vector<StageSnapshot>& snapshots)
+	{
+		std::ostringstream dot;
+		dot << "digraph pipeline {\n";
+
+		for (auto iter = snapshots.begin(); iter != snapshots.end(); ++iter)
+		{
+			// A backed-up stage stands out in red, an idle one in grey
+			const char* color = iter->queueDepth > 0 ? "red" : (iter->isActive ? "black" : "grey");
+
+			dot << "\t" << iter->stageId
+				<< " [label=\"" << iter->stageId << "\\n" << Details::escapeString(iter->type)
+				<< "\\nqueue " << iter->queueDepth
+				<< ", workers " << iter->runningWorkers << "/" << iter->workerCount
+				<< (iter->isFlushing ? ", flushing" : "")
+				<< "\", color=" << color << "];\n";
+		}
+
+		for (auto iter = snapshots.begin(); iter != snapshots.end(); ++iter)
+		{
+			for (auto consumer = iter->consumerIds.begin(); consumer != iter->consumerIds.end(); ++consumer)
+			{
+				dot << "\t" << iter->stageId << " -> " << *consumer << ";\n";
+			}
+		}
+
+		dot << "}\n";
+		return dot.str();
+	}
+
+}}
@@ -1,26 +1,26 @@
 #pragma once
 
 #include "PipelineStageBase.h"
-#include "IConnectable.h"
+#include "ConnectableBase.h"
 
 #include <functional>
-#include <map>
 
 
 namespace Tools { namespace Parallel {
 
-#pragma region PipelineStage<Input, Output>
+#pragma region PipelineStage<Input, Output, InputQueue>
 
 	/*
 	 * PipelineStage is a concurrent data structure ideal for constructing
 	 * a data pipeline. Each PipelineStage is templated on an input and
 	 * output type and represents one stage of execution in the pipeline.
+	 * InputQueue replaces the FIFO input queue; see PipelineStageCore.
 	 */
-	template<class Input, class Output>
+	template<class Input, class Output, class InputQueue = concurrency::concurrent_queue<Input>>
 	class PipelineStage
-		: public PipelineStageBase<Input>
-		, public IConnectable<Output>
-		, public std::enable_shared_from_this<PipelineStage<Input, Output>>
+		: public PipelineStageBase<Input, InputQueue>
+		, public ConnectableBase<Output>
+		, public std::enable_shared_from_this<PipelineStage<Input, Output, InputQueue>>
 	{
 	public:
 #pragma region Constructors and Destructor
@@ -34,47 +34,32 @@ namespace Tools { namespace Parallel {
 			const std::function<Output(Input&)>& processInputFunction,
 			const std::function<void(int, std::exception_ptr)>& handleErrorFunction);
 
-		PipelineStage(const PipelineStage<Input, Output>& other) = delete;
+		PipelineStage(const PipelineStage<Input, Output, InputQueue>& other) = delete;
 
 #pragma endregion
 
 #pragma region PipelineStageBase overrides
 
 		concurrency::task<void> flushAll() override;
+		std::vector<std::shared_ptr<IPipelineStage>> consumerStages() override;
 		protected: void processInput(Input& input) override;
 
-#pragma endregion
-
-	public:
-#pragma region IConnectable implementations
-
-		void connect(const std::shared_ptr<IConsumerStage<Output>>& consumer) override;
-		void disconnect(const std::shared_ptr<IConsumerStage<Output>>& consumer) override;
-		void disconnectAll() override;
-		void swap(
-			const std::shared_ptr<IConsumerStage<Output>>& current,
-			const std::shared_ptr<IConsumerStage<Output>>& replacement) override;
-
 #pragma endregion
 
 	private:
-		concurrency::task<void> flushConsumers();
-
 		std::function<Output(Input&)> m_processInput;
-		std::map<int, std::shared_ptr<IConsumerStage<Output>>> m_consumers;
-		concurrency::reader_writer_lock m_consumersLock;
 	};
 
 #pragma endregion
 
-#pragma region PipelineStage<Input, void>
+#pragma region PipelineStage<Input, void, InputQueue>
 
 	/*
 	 * Partial template specialization of PipelineStage with a void output type.
 	 * This is known as a final pipeline stage.
 	 */
-	template<class Input>
-	class PipelineStage<Input, void> : public PipelineStageBase<Input>
+	template<class Input, class InputQueue>
+	class PipelineStage<Input, void, InputQueue> : public PipelineStageBase<Input, InputQueue>
 	{
 	public:
 		PipelineStage(
@@ -86,7 +71,7 @@ namespace Tools { namespace Parallel {
 			const std::function<void(Input&)>& processInputFunction,
 			const std::function<void(int, std::exception_ptr)>& handleErrorFunction);
 
-		PipelineStage(const PipelineStage<Input, void>& other) = delete;
+		PipelineStage(const PipelineStage<Input, void, InputQueue>& other) = delete;
 
 	protected:
 		void processInput(Input& input) override;
@@ -1,21 +1,31 @@
 #pragma once
 
 #include "IConsumerStage.h"
+#include "IInspectableStage.h"
+#include "IScalableStage.h"
+#include "PipelineStageCore.h"
 
-#include <concrt.h>
-#include <concurrent_queue.h>
+#include <typeinfo>
 
 
 namespace Tools { namespace Parallel {
 
 	/*
 	 * PipelineStageBase is the base class of every template instantiation of
-	 * PipelineStage. It encapsulates most of the core logic and functionality
-	 * of a pipeline stage.
+	 * PipelineStage. It exposes the queue and worker machinery of
+	 * PipelineStageCore through the IConsumerStage interface, dispatching to
+	 * processInput virtually. InputQueue is passed on to PipelineStageCore.
 	 */
-	template<class Input>
-	class PipelineStageBase : public IConsumerStage<Input>
+	template<class Input, class InputQueue = concurrency::concurrent_queue<Input>>
+	class PipelineStageBase
+		: public IConsumerStage<Input>
+		, public IScalableStage
+		, public IInspectableStage
+		, private PipelineStageCore<PipelineStageBase<Input, InputQueue>, Input, InputQueue>
 	{
+		typedef PipelineStageCore<PipelineStageBase<Input, InputQueue>, Input, InputQueue> Core;
+		friend class PipelineStageCore<PipelineStageBase<Input, InputQueue>, Input, InputQueue>;
+
 	public:
 #pragma region Constructors and Destructor
 
@@ -25,7 +35,7 @@ namespace Tools { namespace Parallel {
 
 		virtual ~PipelineStageBase();
 
-		PipelineStageBase(const PipelineStageBase<Input>& other) = delete;
+		PipelineStageBase(const PipelineStageBase<Input, InputQueue>& other) = delete;
 
 #pragma endregion
 
@@ -46,31 +56,52 @@ namespace Tools { namespace Parallel {
 		bool hasInputs() const override;
 		void addInput(Input& input) override;
 
+#pragma endregion
+
+#pragma region IScalableStage implementations
+
+		virtual unsigned int workerCount() override;
+		virtual void setWorkerCount(unsigned int workerCount) override;
+		StageStatistics statistics() override;
+
+		using Core::setIdleTimeout;
+		using Core::setIdleStrategy;
+		using Core::setProcessorAffinity;
+		using Core::setTracer;
+		using Core::setProcessorCounters;
+
+#pragma endregion
+
+#pragma region IInspectableStage implementations
+
+		StageSnapshot snapshot() override;
+		virtual std::vector<std::shared_ptr<IPipelineStage>> consumerStages() override;
+
+#pragma endregion
+
+#pragma region Failure handling
+
+		using Core::setRetryPolicy;
+		using Core::setDeadLetterStage;
+
 #pragma endregion
 
 	protected:
 		virtual void processInput(Input& input) = 0;
-
-	private:
-		bool isRunningOrScheduled();
-		bool shouldTaskContinue();
-		void processInputs();
-		void initializeTask();
-		void setIsTaskRunning();
-		void onError(std::exception_ptr error);
-		void cleanupTask();
-		void resetIsRunningAndShouldContinue();
-		void resetIsFlushing();
-
-		int m_stageId;
-		bool m_isTaskRunning;
-		bool m_shouldTaskContinue;
-		bool m_isFlushing;
-		std::function<void(int, std::exception_ptr)> m_handleError;
-		concurrency::task<void> m_processInputsTask;
-		concurrency::concurrent_queue<Input> m_inputQueue;
-		concurrency::reader_writer_lock m_taskLifetimeLock;
-		concurrency::reader_writer_lock m_isFlushingLock;
+		virtual void onIdle() { }
+		virtual void onFlushed() { }
+		virtual void onWorkerStopped() { }
+
+		/*
+		 * Flushes the dead-letter stage, if there is one. A stage whose
+		 * flushAll also flushes its consumers calls this alongside.
+		 */
+		concurrency::task<void> flushDeadLetterStage();
+
+		using Core::inputQueue;
+		using Core::isAcceptingInputs;
+		using Core::onInputAdded;
+		using Core::tryRunInPlaceOfWorker;
 	};
 
 }}
@@ -1,187 +1,131 @@
 namespace Tools { namespace Parallel {
 
-	const unsigned int c_waitMilliseconds = 10;
-
-	template<class Input>
-	PipelineStageBase<Input>::PipelineStageBase(
+	template<class Input, class InputQueue>
+	PipelineStageBase<Input, InputQueue>::PipelineStageBase(
 		int stageId,
 		const std::function<void(int, std::exception_ptr)>& handleErrorFunction)
-		: m_stageId(stageId)
-		, m_handleError(handleErrorFunction)
-		, m_isTaskRunning(false)
-		, m_shouldTaskContinue(false)
-		, m_isFlushing(false)
-		, m_processInputsTask(concurrency::task_from_result())
+		: Core(stageId, handleErrorFunction)
 	{
 	}
 
-	template<class Input>
-	PipelineStageBase<Input>::~PipelineStageBase()
+	template<class Input, class InputQueue>
+	PipelineStageBase<Input, InputQueue>::~PipelineStageBase()
 	{
 		deactivate().wait();
 	}
 
-	template<class Input>
-	int PipelineStageBase<Input>::stageId() const
-	{
-		return m_stageId;
-	}
-
-	template<class Input>
-	bool PipelineStageBase<Input>::isActive()
+	template<class Input, class InputQueue>
+	int PipelineStageBase<Input, InputQueue>::stageId() const
 	{
-		concurrency::reader_writer_lock::scoped_lock_read readerLock(m_taskLifetimeLock);
-		return isRunningOrScheduled();
+		return Core::stageId();
 	}
 
-	template<class Input>
-	bool PipelineStageBase<Input>::isFlushing()
+	template<class Input, class InputQueue>
+	bool PipelineStageBase<Input, InputQueue>::isActive()
 	{
-		concurrency::reader_writer_lock::scoped_lock_read readerLock(m_isFlushingLock);
-		return m_isFlushing;
+		return Core::isActive();
 	}
 
-	template<class Input>
-	bool PipelineStageBase<Input>::hasInputs() const
+	template<class Input, class InputQueue>
+	bool PipelineStageBase<Input, InputQueue>::isFlushing()
 	{
-		return !m_inputQueue.empty();
+		return Core::isFlushing();
 	}
 
-	template<class Input>
-	bool PipelineStageBase<Input>::isRunningOrScheduled()
+	template<class Input, class InputQueue>
+	void PipelineStageBase<Input, InputQueue>::activate()
 	{
-		return m_isTaskRunning || m_shouldTaskContinue;
-	}
-
-	template<class Input>
-	bool PipelineStageBase<Input>::shouldTaskContinue()
-	{
-		concurrency::reader_writer_lock::scoped_lock_read readerLock(m_taskLifetimeLock);
-		return m_shouldTaskContinue;
-	}
-
-	template<class Input>
-	void PipelineStageBase<Input>::activate()
-	{
-		concurrency::reader_writer_lock::scoped_lock writerLock(m_taskLifetimeLock);
-		if (isRunningOrScheduled())
+		auto deadLetterStage = Core::deadLetterStage();
+		if (deadLetterStage != nullptr)
 		{
-			return;
+			deadLetterStage->activate();
 		}
 
-		m_shouldTaskContinue = true;
-		m_processInputsTask = concurrency::create_task([this](){ processInputs(); });
+		Core::activate();
 	}
 
-	template<class Input>
-	concurrency::task<void> PipelineStageBase<Input>::deactivate()
+	template<class Input, class InputQueue>
+	concurrency::task<void> PipelineStageBase<Input, InputQueue>::deactivate()
 	{
-		concurrency::reader_writer_lock::scoped_lock writerLock(m_taskLifetimeLock);
-		m_shouldTaskContinue = false;
-		return m_processInputsTask;
+		return Core::deactivate();
 	}
 
-	template<class Input>
-	concurrency::task<void> PipelineStageBase<Input>::flushOne()
+	template<class Input, class InputQueue>
+	concurrency::task<void> PipelineStageBase<Input, InputQueue>::flushOne()
 	{
-		concurrency::reader_writer_lock::scoped_lock writerLock(m_isFlushingLock);
-		m_isFlushing = true;
-		return m_processInputsTask;
+		return Core::flushOne();
 	}
 
-	template<class Input>
-	concurrency::task<void> PipelineStageBase<Input>::flushAll()
+	template<class Input, class InputQueue>
+	concurrency::task<void> PipelineStageBase<Input, InputQueue>::flushAll()
 	{
-		return flushOne();
+		// The dead-letter stage is flushed once this stage has drained, since
+		// its last inputs may still fail
+		auto deadLetterStage = Core::deadLetterStage();
+		return flushOne().then([deadLetterStage]()
+		{
+			return deadLetterStage != nullptr ? deadLetterStage->flushAll() : concurrency::task_from_result();
+		});
 	}
 
-	template<class Input>
-	void PipelineStageBase<Input>::addInput(Input& input)
+	template<class Input, class InputQueue>
+	concurrency::task<void> PipelineStageBase<Input, InputQueue>::flushDeadLetterStage()
 	{
-		if (!isFlushing())
-		{
-			m_inputQueue.push(input);
-		}
+		auto deadLetterStage = Core::deadLetterStage();
+		return deadLetterStage != nullptr ? deadLetterStage->flushAll() : concurrency::task_from_result();
 	}
 
-	template<class Input>
-	void PipelineStageBase<Input>::processInputs()
+	template<class Input, class InputQueue>
+	unsigned int PipelineStageBase<Input, InputQueue>::workerCount()
 	{
-		initializeTask();
-
-		while (shouldTaskContinue())
-		{
-			try
-			{
-				Input input;
-				if (m_inputQueue.try_pop(input))
-				{
-					processInput(input);
-				}
-				else if (isFlushing() && !hasInputs())
-				{
-					break;
-				}
-				else
-				{
-					concurrency::wait(c_waitMilliseconds);
-				}
-			}
-			catch (...)
-			{
-				onError(std::current_exception());
-			}
-		}
-
-		cleanupTask();
+		return Core::workerCount();
 	}
 
-	template<class Input>
-	void PipelineStageBase<Input>::initializeTask()
+	template<class Input, class InputQueue>
+	void PipelineStageBase<Input, InputQueue>::setWorkerCount(unsigned int workerCount)
 	{
-		setIsTaskRunning();
+		Core::setWorkerCount(workerCount);
 	}
 
-	template<class Input>
-	void PipelineStageBase<Input>::setIsTaskRunning()
+	template<class Input, class InputQueue>
+	StageStatistics PipelineStageBase<Input, InputQueue>::statistics()
 	{
-		concurrency::reader_writer_lock::scoped_lock writerLock(m_taskLifetimeLock);
-		m_isTaskRunning = true;
+		return Core::statistics();
 	}
 
-	template<class Input>
-	void PipelineStageBase<Input>::onError(std::exception_ptr error)
+	template<class Input, class InputQueue>
+	StageSnapshot PipelineStageBase<Input, InputQueue>::snapshot()
 	{
-		try
-		{
-			if (m_handleError)
-			{
-				m_handleError(m_stageId, error);
-			}
-		}
-		catch (...) {}
+		auto statistics = Core::statistics();
+
+		StageSnapshot snapshot;
+		snapshot.stageId = statistics.stageId;
+		snapshot.type = typeid(*this).name();
+		snapshot.isActive = Core::isActive();
+		snapshot.isFlushing = Core::isFlushing();
+		snapshot.queueDepth = statistics.queueDepth;
+		snapshot.workerCount = statistics.workerCount;
+		snapshot.runningWorkers = statistics.runningWorkers;
+
+		return snapshot;
 	}
 
-	template<class Input>
-	void PipelineStageBase<Input>::cleanupTask()
+	template<class Input, class InputQueue>
+	std::vector<std::shared_ptr<IPipelineStage>> PipelineStageBase<Input, InputQueue>::consumerStages()
 	{
-		resetIsRunningAndShouldContinue();
-		resetIsFlushing();
+		return std::vector<std::shared_ptr<IPipelineStage>>();
 	}
 
-	template<class Input>
-	void PipelineStageBase<Input>::resetIsRunningAndShouldContinue()
+	template<class Input, class InputQueue>
+	bool PipelineStageBase<Input, InputQueue>::hasInputs() const
 	{
-		concurrency::reader_writer_lock::scoped_lock writerLock(m_taskLifetimeLock);
-		m_isTaskRunning = false;
-		m_shouldTaskContinue = false;
+		return Core::hasInputs();
 	}
 
-	template<class Input>
-	void PipelineStageBase<Input>::resetIsFlushing()
+	template<class Input, class InputQueue>
+	void PipelineStageBase<Input, InputQueue>::addInput(Input& input)
 	{
-		concurrency::reader_writer_lock::scoped_lock writerLock(m_isFlushingLock);
-		m_isFlushing = false;
+		Core::addInput(input);
 	}
 
 }}
@@ -0,0 +1,295 @@
+#pragma once
+
+#include "DeadLetter.h"
+#include "DeliveryFailure.h"
+#include "IConsumerStage.h"
+#include "IdleStrategy.h"
+#include "PipelineTracer.h"
+#include "ProcessorCounters.h"
+#include "ProcessorAffinity.h"
+#include "RetryPolicy.h"
+#include "StageLifecycle.h"
+#include "StageStatistics.h"
+
+#include <concrt.h>
+#include <concurrent_queue.h>
+#include <ppltasks.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <queue>
+#include <random>
+#include <system_error>
+#include <vector>
+
+
+namespace Tools { namespace Parallel {
+
+	const size_t c_cacheLineSize = 64;
+
+	/*
+	 * Called with an input that a stage gives up on, after its last attempt
+	 * and before it goes to the dead-letter stage or the error handler.
+	 * Envelopes that owe someone an answer, such as Correlated, overload it.
+	 */
+	template<class Input>
+	void onInputAbandoned(Input&, std::exception_ptr)
+	{
+	}
+
+	/*
+	 * PipelineStageCore holds the queue and worker machinery shared by every
+	 * kind of pipeline stage. It is parameterized on the concrete stage type
+	 * (CRTP) and calls Derived::processInput directly, so it adds no virtual
+	 * dispatch of its own. Derived must grant friendship to PipelineStageCore
+	 * if its processInput is not public.
+	 *
+	 * An input whose processing throws is retried according to the stage's
+	 * RetryPolicy. Retries are kept in a schedule ordered by due time and are
+	 * picked up by the worker loop between other inputs, so waiting for a
+	 * backoff never blocks the worker. Once an input runs out of attempts it
+	 * is passed to onInputAbandoned and then to the dead-letter stage, if
+	 * there is one, and otherwise to the error handler. An input whose
+	 * output was computed but refused by some consumers (a DeliveryFailure)
+	 * is not processed again; its retries only pass the kept output to the
+	 * consumers that refused it.
+	 *
+	 * A stage may run several workers, all draining the same queue. The
+	 * worker count can be changed while the stage is active: new workers are
+	 * started right away, and surplus workers retire after their current
+	 * input. processInput must be safe to call concurrently whenever the
+	 * worker count is greater than one.
+	 *
+	 * The lifecycle (whether the stage is scheduled or flushing, and how many
+	 * workers it runs) is a single atomic StageLifecycle word, so querying it
+	 * never takes a lock.
+	 *
+	 * A stage with an idle timeout is lazy: a worker that has found no input
+	 * for that long parks, leaving the stage scheduled, and the next input
+	 * starts the workers again, so an idle stage costs no wake-ups. A lazy
+	 * stage also starts no workers on activate until it has an input.
+	 *
+	 * Derived may also hide onIdle, which a worker calls whenever it finds no
+	 * input to process, onFlushed, which a worker calls when a flush has
+	 * drained the stage, just before it retires, and onWorkerStopped, which a
+	 * worker calls last whenever it stops, whether it retires or parks. All
+	 * three run on the worker.
+	 *
+	 * With a PipelineTracer set, the stage records when sampled inputs are
+	 * added and processed. Without one, tracing costs a load and a branch
+	 * per input.
+	 *
+	 * InputQueue is the queue that holds inputs between addInput and the
+	 * workers. It needs push, try_pop and empty like the default
+	 * concurrent_queue, and must be safe for concurrent producers and
+	 * workers. A queue that orders or merges inputs differently is reached
+	 * through inputQueue; an input added straight to it must be accepted
+	 * with isAcceptingInputs and announced with onInputAdded. The queue
+	 * depth in statistics is the announced inputs less those taken, so an
+	 * input merged into one already queued must not be announced.
+	 */
+	template<class Derived, class Input, class InputQueue = concurrency::concurrent_queue<Input>>
+	class PipelineStageCore
+	{
+	public:
+#pragma region Constructors and Destructor
+
+		PipelineStageCore(
+			int stageId,
+			const std::function<void(int, std::exception_ptr)>& handleErrorFunction);
+
+		PipelineStageCore(const PipelineStageCore<Derived, Input, InputQueue>& other) = delete;
+
+#pragma endregion
+
+#pragma region Stage lifetime
+
+		int stageId() const;
+		bool isActive();
+		bool isFlushing();
+		void activate();
+		concurrency::task<void> deactivate();
+		concurrency::task<void> flushOne();
+		unsigned int workerCount();
+		void setWorkerCount(unsigned int workerCount);
+
+		/*
+		 * Sets how long a worker waits for an input before it parks. Zero,
+		 * the default, keeps workers running until the stage is deactivated.
+		 */
+		void setIdleTimeout(std::chrono::milliseconds idleTimeout);
+
+		/*
+		 * Set how workers wait for inputs and where they run. Both apply to
+		 * workers started after the call, so they are best set before the
+		 * stage is activated.
+		 */
+		void setIdleStrategy(const IdleStrategy& idleStrategy);
+		void setProcessorAffinity(const ProcessorAffinity& processorAffinity);
+
+#pragma endregion
+
+#pragma region Input buffering
+
+		bool hasInputs() const;
+		void addInput(Input& input);
+
+#pragma endregion
+
+#pragma region Failure handling
+
+		void setRetryPolicy(const RetryPolicy& retryPolicy);
+		void setDeadLetterStage(const std::shared_ptr<IConsumerStage<DeadLetter<Input>>>& deadLetterStage);
+
+#pragma endregion
+
+#pragma region Statistics
+
+		StageStatistics statistics();
+
+		/*
+		 * Sets the tracer that records this stage's inputs, or stops tracing
+		 * if null. A stage keeps every tracer it has been given alive, so
+		 * that producers and workers can use it without a lock. Inputs
+		 * being taken as tracing starts may be recorded a position off.
+		 */
+		void setTracer(const std::shared_ptr<PipelineTracer>& tracer);
+
+		/*
+		 * Makes workers started after the call read their thread's processor
+		 * counters around each run of inputs, so that the stage's statistics
+		 * show the cycles and processor time its inputs took. A worker that
+		 * cannot read the counters carries on without them.
+		 */
+		void setProcessorCounters(bool isEnabled);
+
+#pragma endregion
+
+	protected:
+		void onIdle() { }
+		void onFlushed() { }
+		void onWorkerStopped() { }
+
+		InputQueue& inputQueue();
+		const InputQueue& inputQueue() const;
+		bool isAcceptingInputs() const;
+		void onInputAdded();
+		std::shared_ptr<IConsumerStage<DeadLetter<Input>>> deadLetterStage();
+
+		/*
+		 * Runs action on the calling thread in the place of a worker, so
+		 * that it never overlaps one: no worker can start until it returns.
+		 * Returns false without running it if every worker is running.
+		 */
+		bool tryRunInPlaceOfWorker(const std::function<void()>& action);
+
+	private:
+		struct PendingRetry
+		{
+			std::chrono::steady_clock::time_point dueTime;
+			unsigned int attempts;
+			Input input;
+			std::function<void()> redeliver;
+		};
+
+		struct IsDueLater
+		{
+			bool operator()(const PendingRetry& lhs, const PendingRetry& rhs) const
+			{
+				return lhs.dueTime > rhs.dueTime;
+			}
+		};
+
+		// Written only by the worker that owns them, so counting an input
+		// costs no read-modify-write; statistics sums them under the lock
+		struct WorkerCounters
+		{
+			WorkerCounters() : inputsTaken(0) { }
+
+			std::atomic<unsigned long long> inputsTaken;
+		};
+
+		Derived& derived();
+		StageLifecycle loadLifecycle(std::memory_order order) const;
+		bool tryUpdateLifecycle(StageLifecycle& expected, StageLifecycle desired);
+		bool shouldTaskContinue();
+		void startWorkers();
+		concurrency::task<void> whenAllWorkersComplete();
+		void processInputs();
+		void tryProcessInput(Input& input, unsigned int previousAttempts);
+		void tryProcessTakenInput(Input& input);
+		void tryRedeliver(Input& input, unsigned int previousAttempts, const std::function<void()>& redeliver);
+		void recordProcessingTime(std::chrono::steady_clock::time_point startTime);
+		void registerWorkerCounters(WorkerCounters& counters);
+		void retireWorkerCounters(WorkerCounters& counters);
+		unsigned long long inputsTaken();
+		void recordProcessorCounters(const ProcessorCounterSample& runStart, unsigned int runInputs);
+		bool tryPopDueRetry(Input& input, unsigned int& attempts, std::function<void()>& redeliver);
+		unsigned int waitMilliseconds();
+		void onInputFailed(Input& input, unsigned int attempts, std::exception_ptr error, const std::function<void()>& redeliver);
+		void onError(std::exception_ptr error);
+		bool isLazy() const;
+		void startWorkersIfParked();
+		bool tryParkWorker();
+		bool tryRetireWorker();
+		void retireFlushedWorker();
+		void returnWorkerPlace();
+
+		int m_stageId;
+		std::function<void(int, std::exception_ptr)> m_handleError;
+		std::vector<concurrency::task<void>> m_workerTasks;
+		concurrency::critical_section m_workerTasksLock;
+		IdleStrategy m_idleStrategy;
+		ProcessorAffinity m_processorAffinity;
+		bool m_hasProcessorCounters;
+		concurrency::critical_section m_workerSettingsLock;
+
+		// Every producer reads the lifecycle on every addInput and every
+		// worker reads it on every iteration, so it gets a cache line of its
+		// own, apart from the queue indices that those same threads write.
+		// It is padded rather than aligned: a full line before and the rest
+		// of one after keep it alone on its line wherever the stage lands,
+		// and stages are allocated with make_shared, which does not honor
+		// an extended alignment.
+		//
+		// Those per-item reads are relaxed: the lifecycle publishes no other
+		// data, and an input that races with flushOne may be accepted or
+		// refused either way. Transitions are acquire-release
+		// compare-and-swaps, so a worker's retirement is ordered after all of
+		// its work and activate, setWorkerCount and retiring workers always
+		// agree on how many workers are running.
+		char m_lifecyclePaddingBefore[c_cacheLineSize];
+		std::atomic<StageLifecycle::Word> m_lifecycle;
+		char m_lifecyclePaddingAfter[c_cacheLineSize - sizeof(std::atomic<StageLifecycle::Word>)];
+
+		InputQueue m_inputQueue;
+		std::atomic<long long> m_idleTimeoutMilliseconds;
+
+		RetryPolicy m_retryPolicy;
+		std::shared_ptr<IConsumerStage<DeadLetter<Input>>> m_deadLetterStage;
+		std::priority_queue<PendingRetry, std::vector<PendingRetry>, IsDueLater> m_pendingRetries;
+		std::atomic<size_t> m_pendingRetriesCount;
+		std::minstd_rand m_jitterGenerator;
+		concurrency::critical_section m_retriesLock;
+
+		std::atomic<unsigned long long> m_inputsAdded;
+		std::atomic<unsigned long long> m_inputsTaken;
+		std::vector<WorkerCounters*> m_workerCounters;
+		unsigned long long m_retiredInputsTaken;
+		concurrency::critical_section m_workerCountersLock;
+		std::atomic<unsigned long long> m_inputsProcessed;
+		std::atomic<long long> m_processingNanoseconds;
+		std::atomic<unsigned long long> m_countedInputs;
+		std::atomic<unsigned long long> m_processorCycles;
+		std::atomic<long long> m_processorNanoseconds;
+
+		std::atomic<PipelineTracer*> m_tracer;
+		std::vector<std::shared_ptr<PipelineTracer>> m_tracers;
+	};
+
+}}
+
+#include "PipelineStageCore.hpp"
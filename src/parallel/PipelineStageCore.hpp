@@ -0,0 +1,823 @@
+namespace Tools { namespace Parallel {
+
+	const unsigned int c_waitMilliseconds = 10;
+
+	// Processor counters are read around runs of up to this many inputs,
+	// which keeps the two system calls per read off the per-input path
+	const unsigned int c_processorCounterRunInputs = 64;
+
+	template<class Derived, class Input, class InputQueue>
+	PipelineStageCore<Derived, Input, InputQueue>::PipelineStageCore(
+		int stageId,
+		const std::function<void(int, std::exception_ptr)>& handleErrorFunction)
+		: m_stageId(stageId)
+		, m_handleError(handleErrorFunction)
+		, m_hasProcessorCounters(false)
+		, m_lifecycle(StageLifecycle::initial(1 /*workerCount*/).word())
+		, m_idleTimeoutMilliseconds(0)
+		, m_pendingRetriesCount(0)
+		, m_jitterGenerator(static_cast<unsigned int>(stageId))
+		, m_inputsAdded(0)
+		, m_inputsTaken(0)
+		, m_retiredInputsTaken(0)
+		, m_inputsProcessed(0)
+		, m_processingNanoseconds(0)
+		, m_countedInputs(0)
+		, m_processorCycles(0)
+		, m_processorNanoseconds(0)
+		, m_tracer(nullptr)
+	{
+	}
+
+	template<class Derived, class Input, class InputQueue>
+	int PipelineStageCore<Derived, Input, InputQueue>::stageId() const
+	{
+		return m_stageId;
+	}
+
+	template<class Derived, class Input, class InputQueue>
+	bool PipelineStageCore<Derived, Input, InputQueue>::isActive()
+	{
+		return loadLifecycle(std::memory_order_acquire).isActive();
+	}
+
+	template<class Derived, class Input, class InputQueue>
+	bool PipelineStageCore<Derived, Input, InputQueue>::isFlushing()
+	{
+		return loadLifecycle(std::memory_order_acquire).isFlushing();
+	}
+
+	template<class Derived, class Input, class InputQueue>
+	bool PipelineStageCore<Derived, Input, InputQueue>::hasInputs() const
+	{
+		return !m_inputQueue.empty() || m_pendingRetriesCount.load() > 0;
+	}
+
+	template<class Derived, class Input, class InputQueue>
+	Derived& PipelineStageCore<Derived, Input, InputQueue>::derived()
+	{
+		return static_cast<Derived&>(*this);
+	}
+
+	template<class Derived, class Input, class InputQueue>
+	StageLifecycle PipelineStageCore<Derived, Input, InputQueue>::loadLifecycle(std::memory_order order) const
+	{
+		return StageLifecycle(m_lifecycle.load(order));
+	}
+
+	template<class Derived, class Input, class InputQueue>
+	bool PipelineStageCore<Derived, Input, InputQueue>::tryUpdateLifecycle(StageLifecycle& expected, StageLifecycle desired)
+	{
+		// On success expected becomes desired; on failure it is refreshed
+		// with the current lifecycle so the caller can re-evaluate.
+		StageLifecycle::Word word = expected.word();
+		if (m_lifecycle.compare_exchange_weak(word, desired.word(), std::memory_order_acq_rel, std::memory_order_acquire))
+		{
+			expected = desired;
+			return true;
+		}
+
+		expected = StageLifecycle(word);
+		return false;
+	}
+
+	template<class Derived, class Input, class InputQueue>
+	bool PipelineStageCore<Derived, Input, InputQueue>::shouldTaskContinue()
+	{
+		return loadLifecycle(std::memory_order_relaxed).shouldWorkerContinue();
+	}
+
+	template<class Derived, class Input, class InputQueue>
+	void PipelineStageCore<Derived, Input, InputQueue>::activate()
+	{
+		auto lifecycle = loadLifecycle(std::memory_order_acquire);
+		do
+		{
+			if (lifecycle.isScheduled())
+			{
+				return;
+			}
+		}
+		while (!tryUpdateLifecycle(lifecycle, lifecycle.withScheduled(true)));
+
+		// Workers that are still winding down from a deactivate see the flag
+		// again before they retire, so they carry on instead.
+		if (!isLazy())
+		{
+			startWorkers();
+		}
+		else
+		{
+			startWorkersIfParked();
+		}
+	}
+
+	template<class Derived, class Input, class InputQueue>
+	concurrency::task<void> PipelineStageCore<Derived, Input, InputQueue>::deactivate()
+	{
+		auto lifecycle = loadLifecycle(std::memory_order_acquire);
+		while (!tryUpdateLifecycle(lifecycle, lifecycle.withScheduled(false)));
+
+		return whenAllWorkersComplete();
+	}
+
+	template<class Derived, class Input, class InputQueue>
+	concurrency::task<void> PipelineStageCore<Derived, Input, InputQueue>::flushOne()
+	{
+		auto lifecycle = loadLifecycle(std::memory_order_acquire);
+		while (!tryUpdateLifecycle(lifecycle, lifecycle.withFlushing(true)));
+
+		// Only a worker can complete the flush and return the stage to idle
+		if (isLazy())
+		{
+			startWorkers();
+		}
+
+		return whenAllWorkersComplete();
+	}
+
+	template<class Derived, class Input, class InputQueue>
+	unsigned int PipelineStageCore<Derived, Input, InputQueue>::workerCount()
+	{
+		return loadLifecycle(std::memory_order_relaxed).workerCount();
+	}
+
+	template<class Derived, class Input, class InputQueue>
+	void PipelineStageCore<Derived, Input, InputQueue>::setWorkerCount(unsigned int workerCount)
+	{
+		if (workerCount == 0)
+		{
+			throw std::invalid_argument("A stage requires at least one worker.");
+		}
+
+		auto lifecycle = loadLifecycle(std::memory_order_acquire);
+		while (!tryUpdateLifecycle(lifecycle, lifecycle.withWorkerCount(workerCount)));
+
+		startWorkers();
+	}
+
+	template<class Derived, class Input, class InputQueue>
+	void PipelineStageCore<Derived, Input, InputQueue>::setIdleTimeout(std::chrono::milliseconds idleTimeout)
+	{
+		if (idleTimeout.count() < 0)
+		{
+			throw std::invalid_argument("A stage requires an idle timeout that is not negative.");
+		}
+
+		m_idleTimeoutMilliseconds.store(idleTimeout.count());
+		startWorkersIfParked();
+	}
+
+	template<class Derived, class Input, class InputQueue>
+	void PipelineStageCore<Derived, Input, InputQueue>::setIdleStrategy(const IdleStrategy& idleStrategy)
+	{
+		concurrency::critical_section::scoped_lock lock(m_workerSettingsLock);
+		m_idleStrategy = idleStrategy;
+	}
+
+	template<class Derived, class Input, class InputQueue>
+	void PipelineStageCore<Derived, Input, InputQueue>::setProcessorAffinity(const ProcessorAffinity& processorAffinity)
+	{
+		concurrency::critical_section::scoped_lock lock(m_workerSettingsLock);
+		m_processorAffinity = processorAffinity;
+	}
+
+	template<class Derived, class Input, class InputQueue>
+	void PipelineStageCore<Derived, Input, InputQueue>::setTracer(const std::shared_ptr<PipelineTracer>& tracer)
+	{
+		concurrency::critical_section::scoped_lock lock(m_workerSettingsLock);
+		if (tracer != nullptr)
+		{
+			m_tracers.push_back(tracer);
+
+			// Catch up with the inputs taken while untraced, so that taken
+			// positions match added ones again
+			m_inputsTaken.store(inputsTaken(), std::memory_order_relaxed);
+		}
+
+		m_tracer.store(tracer.get(), std::memory_order_release);
+	}
+
+	template<class Derived, class Input, class InputQueue>
+	void PipelineStageCore<Derived, Input, InputQueue>::setProcessorCounters(bool isEnabled)
+	{
+		concurrency::critical_section::scoped_lock lock(m_workerSettingsLock);
+		m_hasProcessorCounters = isEnabled;
+	}
+
+	template<class Derived, class Input, class InputQueue>
+	StageStatistics PipelineStageCore<Derived, Input, InputQueue>::statistics()
+	{
+		StageStatistics statistics;
+		statistics.stageId = m_stageId;
+
+		// The queue's own size is not safe to read beside producers. An input
+		// is counted as added only after it is pushed, so a worker may count
+		// it as taken first and the difference can briefly go negative.
+		unsigned long long taken = inputsTaken();
+		statistics.inputsAdded = m_inputsAdded.load(std::memory_order_relaxed);
+		statistics.queueDepth = static_cast<size_t>(statistics.inputsAdded > taken ? statistics.inputsAdded - taken : 0)
+			+ m_pendingRetriesCount.load(std::memory_order_relaxed);
+		statistics.inputsProcessed = m_inputsProcessed.load(std::memory_order_relaxed);
+		statistics.processingTime = std::chrono::nanoseconds(m_processingNanoseconds.load(std::memory_order_relaxed));
+		statistics.countedInputs = m_countedInputs.load(std::memory_order_relaxed);
+		statistics.processorCycles = m_processorCycles.load(std::memory_order_relaxed);
+		statistics.processorTime = std::chrono::nanoseconds(m_processorNanoseconds.load(std::memory_order_relaxed));
+
+		auto lifecycle = loadLifecycle(std::memory_order_relaxed);
+		statistics.workerCount = lifecycle.workerCount();
+		statistics.runningWorkers = lifecycle.runningWorkers();
+
+		return statistics;
+	}
+
+	template<class Derived, class Input, class InputQueue>
+	void PipelineStageCore<Derived, Input, InputQueue>::startWorkers()
+	{
+		concurrency::critical_section::scoped_lock lock(m_workerTasksLock);
+
+		// Forget workers that have already retired
+		m_workerTasks.erase(
+			std::remove_if(m_workerTasks.begin(), m_workerTasks.end(), [](const concurrency::task<void>& workerTask)
+			{
+				return workerTask.is_done();
+			}),
+			m_workerTasks.end());
+
+		auto lifecycle = loadLifecycle(std::memory_order_acquire);
+		while (lifecycle.isScheduled() && lifecycle.runningWorkers() < lifecycle.workerCount())
+		{
+			if (tryUpdateLifecycle(lifecycle, lifecycle.withRunningWorkers(lifecycle.runningWorkers() + 1)))
+			{
+				m_workerTasks.push_back(concurrency::create_task([this](){ processInputs(); }));
+			}
+		}
+	}
+
+	template<class Derived, class Input, class InputQueue>
+	concurrency::task<void> PipelineStageCore<Derived, Input, InputQueue>::whenAllWorkersComplete()
+	{
+		concurrency::critical_section::scoped_lock lock(m_workerTasksLock);
+		if (m_workerTasks.empty())
+		{
+			return concurrency::task_from_result();
+		}
+
+		return concurrency::when_all(m_workerTasks.begin(), m_workerTasks.end());
+	}
+
+	template<class Derived, class Input, class InputQueue>
+	void PipelineStageCore<Derived, Input, InputQueue>::addInput(Input& input)
+	{
+		if (isAcceptingInputs())
+		{
+			m_inputQueue.push(input);
+			onInputAdded();
+		}
+	}
+
+	template<class Derived, class Input, class InputQueue>
+	void PipelineStageCore<Derived, Input, InputQueue>::setRetryPolicy(const RetryPolicy& retryPolicy)
+	{
+		concurrency::critical_section::scoped_lock lock(m_retriesLock);
+		m_retryPolicy = retryPolicy;
+	}
+
+	template<class Derived, class Input, class InputQueue>
+	void PipelineStageCore<Derived, Input, InputQueue>::setDeadLetterStage(
+		const std::shared_ptr<IConsumerStage<DeadLetter<Input>>>& deadLetterStage)
+	{
+		concurrency::critical_section::scoped_lock lock(m_retriesLock);
+		m_deadLetterStage = deadLetterStage;
+	}
+
+	template<class Derived, class Input, class InputQueue>
+	std::shared_ptr<IConsumerStage<DeadLetter<Input>>> PipelineStageCore<Derived, Input, InputQueue>::deadLetterStage()
+	{
+		concurrency::critical_section::scoped_lock lock(m_retriesLock);
+		return m_deadLetterStage;
+	}
+
+	template<class Derived, class Input, class InputQueue>
+	bool PipelineStageCore<Derived, Input, InputQueue>::tryRunInPlaceOfWorker(const std::function<void()>& action)
+	{
+		// Taking a running worker's place keeps activate and setWorkerCount
+		// from starting one meanwhile
+		auto lifecycle = loadLifecycle(std::memory_order_acquire);
+		do
+		{
+			if (lifecycle.runningWorkers() >= lifecycle.workerCount())
+			{
+				return false;
+			}
+		}
+		while (!tryUpdateLifecycle(lifecycle, lifecycle.withRunningWorkers(lifecycle.runningWorkers() + 1)));
+
+		try
+		{
+			action();
+		}
+		catch (...)
+		{
+			returnWorkerPlace();
+			throw;
+		}
+
+		returnWorkerPlace();
+		return true;
+	}
+
+	template<class Derived, class Input, class InputQueue>
+	InputQueue& PipelineStageCore<Derived, Input, InputQueue>::inputQueue()
+	{
+		return m_inputQueue;
+	}
+
+	template<class Derived, class Input, class InputQueue>
+	const InputQueue& PipelineStageCore<Derived, Input, InputQueue>::inputQueue() const
+	{
+		return m_inputQueue;
+	}
+
+	template<class Derived, class Input, class InputQueue>
+	bool PipelineStageCore<Derived, Input, InputQueue>::isAcceptingInputs() const
+	{
+		return !loadLifecycle(std::memory_order_relaxed).isFlushing();
+	}
+
+	template<class Derived, class Input, class InputQueue>
+	void PipelineStageCore<Derived, Input, InputQueue>::onInputAdded()
+	{
+		unsigned long long position = m_inputsAdded.fetch_add(1, std::memory_order_relaxed);
+
+		PipelineTracer* tracer = m_tracer.load(std::memory_order_acquire);
+		if (tracer != nullptr && tracer->isSampled(position))
+		{
+			tracer->recordEnqueued(m_stageId, position);
+		}
+
+		if (isLazy())
+		{
+			startWorkersIfParked();
+		}
+	}
+
+	template<class Derived, class Input, class InputQueue>
+	void PipelineStageCore<Derived, Input, InputQueue>::processInputs()
+	{
+		IdleStrategy idleStrategy;
+		ProcessorAffinity processorAffinity;
+		bool hasProcessorCounters = false;
+		{
+			concurrency::critical_section::scoped_lock lock(m_workerSettingsLock);
+			idleStrategy = m_idleStrategy;
+			processorAffinity = m_processorAffinity;
+			hasProcessorCounters = m_hasProcessorCounters;
+		}
+
+		ScopedProcessorAffinity pinning(processorAffinity);
+		if (processorAffinity.isPinned() && !pinning.isPinned())
+		{
+			onError(std::make_exception_ptr(std::system_error(static_cast<int>(pinning.error()), std::system_category(), "Cannot pin the worker to its processors.")));
+		}
+
+		WorkerCounters counters;
+		registerWorkerCounters(counters);
+
+		unsigned int idleAttempts = 0;
+		std::chrono::steady_clock::time_point idleSince;
+
+		// A run of inputs lasts until the worker goes idle or stops, or
+		// reaches c_processorCounterRunInputs
+		ProcessorCounterSample runStart;
+		unsigned int runInputs = 0;
+
+		for (;;)
+		{
+			if (runInputs == c_processorCounterRunInputs)
+			{
+				recordProcessorCounters(runStart, runInputs);
+				runInputs = 0;
+			}
+
+			if (!shouldTaskContinue() && tryRetireWorker())
+			{
+				break;
+			}
+
+			bool isFlushed = false;
+
+			try
+			{
+				Input input;
+				unsigned int attempts = 0;
+				std::function<void()> redeliver;
+
+				bool isRetry = tryPopDueRetry(input, attempts, redeliver);
+				if (isRetry || m_inputQueue.try_pop(input))
+				{
+					idleAttempts = 0;
+					if (hasProcessorCounters && runInputs == 0 && !runStart.read())
+					{
+						hasProcessorCounters = false;
+					}
+
+					if (redeliver)
+					{
+						tryRedeliver(input, attempts, redeliver);
+					}
+					else if (isRetry)
+					{
+						tryProcessInput(input, attempts);
+					}
+					else
+					{
+						counters.inputsTaken.store(counters.inputsTaken.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+						tryProcessTakenInput(input);
+					}
+
+					runInputs += hasProcessorCounters ? 1 : 0;
+				}
+				else if (isFlushing() && !hasInputs())
+				{
+					isFlushed = true;
+					derived().onFlushed();
+				}
+				else
+				{
+					if (runInputs > 0)
+					{
+						recordProcessorCounters(runStart, runInputs);
+						runInputs = 0;
+					}
+
+					derived().onIdle();
+
+					if (isLazy())
+					{
+						if (idleAttempts == 0)
+						{
+							idleSince = std::chrono::steady_clock::now();
+						}
+						else if (std::chrono::steady_clock::now() - idleSince >= std::chrono::milliseconds(m_idleTimeoutMilliseconds.load(std::memory_order_relaxed)) &&
+							tryParkWorker())
+						{
+							break;
+						}
+					}
+
+					if (!idleStrategy.pause(idleAttempts++))
+					{
+						concurrency::wait(idleStrategy.parkMilliseconds(waitMilliseconds()));
+					}
+				}
+			}
+			catch (...)
+			{
+				onError(std::current_exception());
+			}
+
+			if (isFlushed)
+			{
+				retireFlushedWorker();
+				break;
+			}
+		}
+
+		if (runInputs > 0)
+		{
+			recordProcessorCounters(runStart, runInputs);
+		}
+
+		retireWorkerCounters(counters);
+		derived().onWorkerStopped();
+	}
+
+	template<class Derived, class Input, class InputQueue>
+	void PipelineStageCore<Derived, Input, InputQueue>::tryProcessInput(Input& input, unsigned int previousAttempts)
+	{
+		auto startTime = std::chrono::steady_clock::now();
+
+		try
+		{
+			derived().processInput(input);
+			recordProcessingTime(startTime);
+		}
+		catch (const DeliveryFailure& failure)
+		{
+			recordProcessingTime(startTime);
+			onInputFailed(input, previousAttempts + 1, failure.error(), failure.redeliverFunction());
+		}
+		catch (...)
+		{
+			recordProcessingTime(startTime);
+			onInputFailed(input, previousAttempts + 1, std::current_exception(), nullptr /*redeliver*/);
+		}
+	}
+
+	template<class Derived, class Input, class InputQueue>
+	void PipelineStageCore<Derived, Input, InputQueue>::tryRedeliver(
+		Input& input,
+		unsigned int previousAttempts,
+		const std::function<void()>& redeliver)
+	{
+		// The input was processed already, so this is not counted as processing
+		try
+		{
+			redeliver();
+		}
+		catch (const DeliveryFailure& failure)
+		{
+			onInputFailed(input, previousAttempts + 1, failure.error(), failure.redeliverFunction());
+		}
+		catch (...)
+		{
+			onInputFailed(input, previousAttempts + 1, std::current_exception(), nullptr /*redeliver*/);
+		}
+	}
+
+	template<class Derived, class Input, class InputQueue>
+	void PipelineStageCore<Derived, Input, InputQueue>::tryProcessTakenInput(Input& input)
+	{
+		// Only first attempts are traced; a retry has no position in the queue.
+		// The shared position is only counted while tracing, so an untraced
+		// stage takes inputs without a read-modify-write.
+		PipelineTracer* tracer = m_tracer.load(std::memory_order_acquire);
+		if (tracer == nullptr)
+		{
+			tryProcessInput(input, 0 /*previousAttempts*/);
+			return;
+		}
+
+		unsigned long long position = m_inputsTaken.fetch_add(1, std::memory_order_relaxed);
+		if (!tracer->isSampled(position))
+		{
+			tryProcessInput(input, 0 /*previousAttempts*/);
+			return;
+		}
+
+		auto startTime = std::chrono::steady_clock::now();
+		tryProcessInput(input, 0 /*previousAttempts*/);
+		tracer->recordProcessed(m_stageId, position, startTime, std::chrono::steady_clock::now());
+	}
+
+	template<class Derived, class Input, class InputQueue>
+	void PipelineStageCore<Derived, Input, InputQueue>::recordProcessingTime(std::chrono::steady_clock::time_point startTime)
+	{
+		auto processingTime = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime);
+		m_processingNanoseconds.fetch_add(processingTime.count(), std::memory_order_relaxed);
+		m_inputsProcessed.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	template<class Derived, class Input, class InputQueue>
+	void PipelineStageCore<Derived, Input, InputQueue>::registerWorkerCounters(WorkerCounters& counters)
+	{
+		concurrency::critical_section::scoped_lock lock(m_workerCountersLock);
+		m_workerCounters.push_back(&counters);
+	}
+
+	template<class Derived, class Input, class InputQueue>
+	void PipelineStageCore<Derived, Input, InputQueue>::retireWorkerCounters(WorkerCounters& counters)
+	{
+		concurrency::critical_section::scoped_lock lock(m_workerCountersLock);
+		m_retiredInputsTaken += counters.inputsTaken.load(std::memory_order_relaxed);
+		m_workerCounters.erase(std::find(m_workerCounters.begin(), m_workerCounters.end(), &counters));
+	}
+
+	template<class Derived, class Input, class InputQueue>
+	unsigned long long PipelineStageCore<Derived, Input, InputQueue>::inputsTaken()
+	{
+		concurrency::critical_section::scoped_lock lock(m_workerCountersLock);
+
+		unsigned long long inputsTaken = m_retiredInputsTaken;
+		for (auto counters : m_workerCounters)
+		{
+			inputsTaken += counters->inputsTaken.load(std::memory_order_relaxed);
+		}
+
+		return inputsTaken;
+	}
+
+	template<class Derived, class Input, class InputQueue>
+	void PipelineStageCore<Derived, Input, InputQueue>::recordProcessorCounters(const ProcessorCounterSample& runStart, unsigned int runInputs)
+	{
+		ProcessorCounterSample runEnd;
+		if (runEnd.read())
+		{
+			m_countedInputs.fetch_add(runInputs, std::memory_order_relaxed);
+			m_processorCycles.fetch_add(runEnd.cycles - runStart.cycles, std::memory_order_relaxed);
+			m_processorNanoseconds.fetch_add(runEnd.processorNanoseconds - runStart.processorNanoseconds, std::memory_order_relaxed);
+		}
+	}
+
+	template<class Derived, class Input, class InputQueue>
+	bool PipelineStageCore<Derived, Input, InputQueue>::tryPopDueRetry(
+		Input& input,
+		unsigned int& attempts,
+		std::function<void()>& redeliver)
+	{
+		if (m_pendingRetriesCount.load(std::memory_order_relaxed) == 0)
+		{
+			return false;
+		}
+
+		concurrency::critical_section::scoped_lock lock(m_retriesLock);
+		if (m_pendingRetries.empty() || m_pendingRetries.top().dueTime > std::chrono::steady_clock::now())
+		{
+			return false;
+		}
+
+		input = m_pendingRetries.top().input;
+		attempts = m_pendingRetries.top().attempts;
+		redeliver = m_pendingRetries.top().redeliver;
+		m_pendingRetries.pop();
+		--m_pendingRetriesCount;
+
+		return true;
+	}
+
+	template<class Derived, class Input, class InputQueue>
+	unsigned int PipelineStageCore<Derived, Input, InputQueue>::waitMilliseconds()
+	{
+		if (m_pendingRetriesCount.load(std::memory_order_relaxed) == 0)
+		{
+			return c_waitMilliseconds;
+		}
+
+		concurrency::critical_section::scoped_lock lock(m_retriesLock);
+		if (m_pendingRetries.empty())
+		{
+			return c_waitMilliseconds;
+		}
+
+		auto untilDue = std::chrono::duration_cast<std::chrono::milliseconds>(
+			m_pendingRetries.top().dueTime - std::chrono::steady_clock::now());
+
+		return static_cast<unsigned int>((std::max)(0LL, (std::min)(static_cast<long long>(untilDue.count()), static_cast<long long>(c_waitMilliseconds))));
+	}
+
+	template<class Derived, class Input, class InputQueue>
+	void PipelineStageCore<Derived, Input, InputQueue>::onInputFailed(
+		Input& input,
+		unsigned int attempts,
+		std::exception_ptr error,
+		const std::function<void()>& redeliver)
+	{
+		std::shared_ptr<IConsumerStage<DeadLetter<Input>>> deadLetterStage;
+
+		try
+		{
+			concurrency::critical_section::scoped_lock lock(m_retriesLock);
+			if (m_retryPolicy.shouldRetry(attempts))
+			{
+				double random = std::uniform_real_distribution<double>(0.0, 1.0)(m_jitterGenerator);
+
+				PendingRetry retry;
+				retry.dueTime = std::chrono::steady_clock::now() + m_retryPolicy.backoff(attempts, random);
+				retry.attempts = attempts;
+				retry.input = input;
+				retry.redeliver = redeliver;
+
+				m_pendingRetries.push(retry);
+				++m_pendingRetriesCount;
+				return;
+			}
+
+			deadLetterStage = m_deadLetterStage;
+		}
+		catch (...) {}
+
+		try
+		{
+			onInputAbandoned(input, error);
+		}
+		catch (...) {}
+
+		if (deadLetterStage != nullptr)
+		{
+			try
+			{
+				DeadLetter<Input> deadLetter(m_stageId, input, error, attempts);
+				deadLetterStage->addInput(deadLetter);
+				return;
+			}
+			catch (...) {}
+		}
+
+		onError(error);
+	}
+
+	template<class Derived, class Input, class InputQueue>
+	void PipelineStageCore<Derived, Input, InputQueue>::onError(std::exception_ptr error)
+	{
+		try
+		{
+			if (m_handleError)
+			{
+				m_handleError(m_stageId, error);
+			}
+		}
+		catch (...) {}
+	}
+
+	template<class Derived, class Input, class InputQueue>
+	bool PipelineStageCore<Derived, Input, InputQueue>::isLazy() const
+	{
+		return m_idleTimeoutMilliseconds.load(std::memory_order_relaxed) > 0;
+	}
+
+	template<class Derived, class Input, class InputQueue>
+	void PipelineStageCore<Derived, Input, InputQueue>::startWorkersIfParked()
+	{
+		// Pairs with the fence in tryParkWorker: either this thread sees
+		// the last worker gone and starts the workers again, or that worker
+		// sees the input pushed before the fence and stays.
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+
+		auto lifecycle = loadLifecycle(std::memory_order_relaxed);
+		if (lifecycle.isScheduled() && lifecycle.runningWorkers() == 0 && hasInputs())
+		{
+			startWorkers();
+		}
+	}
+
+	template<class Derived, class Input, class InputQueue>
+	bool PipelineStageCore<Derived, Input, InputQueue>::tryParkWorker()
+	{
+		// Deactivating and flushing are left to the worker loop
+		auto lifecycle = loadLifecycle(std::memory_order_acquire);
+		do
+		{
+			if (!lifecycle.shouldWorkerContinue() || lifecycle.isFlushing() || hasInputs())
+			{
+				return false;
+			}
+		}
+		while (!tryUpdateLifecycle(lifecycle, lifecycle.withWorkerParked()));
+
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (!hasInputs())
+		{
+			return true;
+		}
+
+		// An input arrived as the worker parked; take the worker back unless
+		// the stage was deactivated or another worker has been started
+		lifecycle = loadLifecycle(std::memory_order_acquire);
+		do
+		{
+			if (!lifecycle.isScheduled() || lifecycle.runningWorkers() >= lifecycle.workerCount())
+			{
+				return true;
+			}
+		}
+		while (!tryUpdateLifecycle(lifecycle, lifecycle.withRunningWorkers(lifecycle.runningWorkers() + 1)));
+
+		return false;
+	}
+
+	template<class Derived, class Input, class InputQueue>
+	bool PipelineStageCore<Derived, Input, InputQueue>::tryRetireWorker()
+	{
+		// The worker saw a relaxed lifecycle telling it to stop; confirm with
+		// the compare-and-swap so that a concurrent activate or
+		// setWorkerCount cannot lose a worker it is counting on.
+		auto lifecycle = loadLifecycle(std::memory_order_acquire);
+		do
+		{
+			if (lifecycle.shouldWorkerContinue())
+			{
+				return false;
+			}
+		}
+		while (!tryUpdateLifecycle(lifecycle, lifecycle.withWorkerRetired()));
+
+		return true;
+	}
+
+	template<class Derived, class Input, class InputQueue>
+	void PipelineStageCore<Derived, Input, InputQueue>::returnWorkerPlace()
+	{
+		// Like parking, this leaves the stage scheduled; any workers that the
+		// stage was denied while the place was taken are started now
+		auto lifecycle = loadLifecycle(std::memory_order_acquire);
+		while (!tryUpdateLifecycle(lifecycle, lifecycle.withWorkerParked()));
+
+		if (!isLazy())
+		{
+			startWorkers();
+		}
+		else
+		{
+			startWorkersIfParked();
+		}
+	}
+
+	template<class Derived, class Input, class InputQueue>
+	void PipelineStageCore<Derived, Input, InputQueue>::retireFlushedWorker()
+	{
+		auto lifecycle = loadLifecycle(std::memory_order_acquire);
+		while (!tryUpdateLifecycle(lifecycle, lifecycle.withWorkerRetired()));
+	}
+
+}}
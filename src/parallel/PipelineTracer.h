@@ -0,0 +1,141 @@
+#pragma once
+
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+
+#include <concrt.h>
+#include <ppl.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+namespace Tools { namespace Parallel {
+
+	/*
+	 * One traced moment in the life of an input at a stage. Positions count
+	 * the inputs added to the stage; the input added at a position is taken
+	 * to be the one processed at the same position, which is exact for a
+	 * stage with one producer and one worker and close otherwise.
+	 */
+	struct TraceEvent
+	{
+		enum Kind
+		{
+			Enqueued,
+			Processed
+		};
+
+		Kind kind;
+		int stageId;
+		unsigned long threadId;
+		unsigned long long position;
+		long long startNanoseconds;
+		long long durationNanoseconds;
+	};
+
+	namespace Details
+	{
+		/*
+		 * A flight recorder written by one thread and read by any: once full,
+		 * each event overwrites the oldest. Every slot carries a version that
+		 * is odd while the slot is being written, so a reader can skip the
+		 * events it would otherwise see half-written.
+		 */
+		class TraceRing
+		{
+		public:
+			explicit TraceRing(unsigned int capacity);
+
+			TraceRing(const TraceRing& other) = delete;
+
+			void write(const TraceEvent& event);
+			void read(std::vector<TraceEvent>& events) const;
+
+		private:
+			struct Slot
+			{
+				std::atomic<unsigned long long> version;
+				TraceEvent event;
+			};
+
+			std::unique_ptr<Slot[]> m_slots;
+			unsigned int m_capacity;
+			std::atomic<unsigned long long> m_written;
+		};
+	}
+
+	/*
+	 * PipelineTracer records when sampled inputs are added to a stage and
+	 * when, and on which worker thread, they are processed, and exports them
+	 * as Chrome trace event JSON, which chrome://tracing and the Perfetto UI
+	 * both open.
+	 *
+	 * Stages record into a ring of their own per thread, so recording takes
+	 * no lock and never allocates once a thread has its ring; the rings keep
+	 * the most recent eventsPerThread events each. One input in every
+	 * samplingInterval is traced at each stage, and the others cost a
+	 * single modulo.
+	 */
+	class PipelineTracer
+	{
+	public:
+		static const unsigned int DefaultEventsPerThread = 64 * 1024;
+
+#pragma region Constructors and Destructor
+
+		explicit PipelineTracer(unsigned int samplingInterval);
+		PipelineTracer(unsigned int samplingInterval, unsigned int eventsPerThread);
+
+		PipelineTracer(const PipelineTracer& other) = delete;
+
+#pragma endregion
+
+#pragma region Recording
+
+		bool isSampled(unsigned long long position) const;
+
+		void recordEnqueued(int stageId, unsigned long long position);
+		void recordProcessed(
+			int stageId,
+			unsigned long long position,
+			std::chrono::steady_clock::time_point startTime,
+			std::chrono::steady_clock::time_point endTime);
+
+#pragma endregion
+
+#pragma region Export
+
+		/*
+		 * The events still held by the rings, in time order. Recording may
+		 * go on meanwhile.
+		 */
+		std::vector<TraceEvent> events() const;
+
+		std::string toChromeTrace() const;
+
+#pragma endregion
+
+	private:
+		long long sinceOrigin(std::chrono::steady_clock::time_point time) const;
+		Details::TraceRing& threadRing();
+
+		unsigned int m_samplingInterval;
+		unsigned int m_eventsPerThread;
+		std::chrono::steady_clock::time_point m_origin;
+		concurrency::combinable<Details::TraceRing*> m_threadRings;
+		std::vector<std::unique_ptr<Details::TraceRing>> m_rings;
+		mutable concurrency::critical_section m_ringsLock;
+	};
+
+}}
+
+#include "PipelineTracer.hpp"
@@ -0,0 +1,205 @@
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+
+
+namespace Tools { namespace Parallel {
+
+	namespace Details
+	{
+		inline TraceRing::TraceRing(unsigned int capacity)
+			: m_slots(new Slot[capacity])
+			, m_capacity(capacity)
+			, m_written(0)
+		{
+			for (unsigned int i = 0; i < capacity; ++i)
+			{
+				m_slots[i].version.store(0, std::memory_order_relaxed);
+			}
+		}
+
+		inline void TraceRing::write(const TraceEvent& event)
+		{
+			unsigned long long written = m_written.load(std::memory_order_relaxed);
+			Slot& slot = m_slots[written % m_capacity];
+
+			// Versions start at zero for an empty slot; writing lap n moves
+			// the slot through 2n + 1 to 2n + 2
+			unsigned long long lap = written / m_capacity;
+			slot.version.store(2 * lap + 1, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+			slot.event = event;
+			slot.version.store(2 * lap + 2, std::memory_order_release);
+
+			m_written.store(written + 1, std::memory_order_release);
+		}
+
+		inline void TraceRing::read(std::vector<TraceEvent>& events) const
+		{
+			unsigned long long written = m_written.load(std::memory_order_acquire);
+			unsigned long long first = written > m_capacity ? written - m_capacity : 0;
+
+			for (unsigned long long position = first; position < written; ++position)
+			{
+				const Slot& slot = m_slots[position % m_capacity];
+				unsigned long long expectedVersion = 2 * (position / m_capacity) + 2;
+
+				if (slot.version.load(std::memory_order_acquire) != expectedVersion)
+				{
+					continue;
+				}
+
+				TraceEvent event = slot.event;
+				std::atomic_thread_fence(std::memory_order_acquire);
+
+				if (slot.version.load(std::memory_order_relaxed) == expectedVersion)
+				{
+					events.push_back(event);
+				}
+			}
+		}
+	}
+
+	inline PipelineTracer::PipelineTracer(unsigned int samplingInterval)
+		: PipelineTracer(samplingInterval, DefaultEventsPerThread)
+	{
+	}
+
+	inline PipelineTracer::PipelineTracer(unsigned int samplingInterval, unsigned int eventsPerThread)
+		: m_samplingInterval(samplingInterval)
+		, m_eventsPerThread(eventsPerThread)
+		, m_origin(std::chrono::steady_clock::now())
+	{
+		if (samplingInterval == 0)
+		{
+			throw std::invalid_argument("PipelineTracer requires a sampling interval of at least one.");
+		}
+
+		if (eventsPerThread == 0)
+		{
+			throw std::invalid_argument("PipelineTracer requires room for at least one event per thread.");
+		}
+	}
+
+	inline bool PipelineTracer::isSampled(unsigned long long position) const
+	{
+		return position % m_samplingInterval == 0;
+	}
+
+	inline void PipelineTracer::recordEnqueued(int stageId, unsigned long long position)
+	{
+		TraceEvent event;
+		event.kind = TraceEvent::Enqueued;
+		event.stageId = stageId;
+		event.threadId = GetCurrentThreadId();
+		event.position = position;
+		event.startNanoseconds = sinceOrigin(std::chrono::steady_clock::now());
+		event.durationNanoseconds = 0;
+
+		threadRing().write(event);
+	}
+
+	inline void PipelineTracer::recordProcessed(
+		int stageId,
+		unsigned long long position,
+		std::chrono::steady_clock::time_point startTime,
+		std::chrono::steady_clock::time_point endTime)
+	{
+		TraceEvent event;
+		event.kind = TraceEvent::Processed;
+		event.stageId = stageId;
+		event.threadId = GetCurrentThreadId();
+		event.position = position;
+		event.startNanoseconds = sinceOrigin(startTime);
+		event.durationNanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(endTime - startTime).count();
+
+		threadRing().write(event);
+	}
+
+	inline std::vector<TraceEvent> PipelineTracer::events() const
+	{
+		std::vector<TraceEvent> events;
+		{
+			concurrency::critical_section::scoped_lock lock(m_ringsLock);
+			for (auto iter = m_rings.begin(); iter != m_rings.end(); ++iter)
+			{
+				(*iter)->read(events);
+			}
+		}
+
+		std::stable_sort(events.begin(), events.end(), [](const TraceEvent& lhs, const TraceEvent& rhs)
+		{
+			return lhs.startNanoseconds < rhs.startNanoseconds;
+		});
+
+		return events;
+	}
+
+	inline std::string PipelineTracer::toChromeTrace() const
+	{
+		auto events = this->events();
+		DWORD processId = GetCurrentProcessId();
+
+		// Timestamps are in microseconds. Each enqueue starts a flow that
+		// the matching processing slice ends, so the viewer draws an arrow
+		// from the producer to the worker.
+		std::ostringstream json;
+		json << std::fixed << std::setprecision(3);
+		json << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+
+		for (size_t i = 0; i < events.size(); ++i)
+		{
+			const TraceEvent& event = events[i];
+			double start = event.startNanoseconds / 1000.0;
+			std::ostringstream flowId;
+			flowId << event.stageId << ':' << event.position;
+
+			if (i > 0)
+			{
+				json << ",";
+			}
+
+			json << "{\"pid\":" << processId << ",\"tid\":" << event.threadId << ",\"ts\":" << start;
+
+			if (event.kind == TraceEvent::Enqueued)
+			{
+				json << ",\"ph\":\"i\",\"s\":\"t\",\"name\":\"enqueue " << event.stageId << "\"";
+			}
+			else
+			{
+				json << ",\"ph\":\"X\",\"dur\":" << event.durationNanoseconds / 1000.0 << ",\"name\":\"stage " << event.stageId << "\"";
+			}
+
+			json << ",\"cat\":\"pipeline\",\"args\":{\"stage\":" << event.stageId << ",\"position\":" << event.position << "}}";
+
+			json << ",{\"pid\":" << processId << ",\"tid\":" << event.threadId << ",\"ts\":" << start
+				<< ",\"ph\":\"" << (event.kind == TraceEvent::Enqueued ? "s" : "f") << "\""
+				<< (event.kind == TraceEvent::Enqueued ? "" : ",\"bp\":\"e\"")
+				<< ",\"name\":\"input\",\"cat\":\"pipeline\",\"id\":\"" << flowId.str() << "\"}";
+		}
+
+		json << "]}";
+		return json.str();
+	}
+
+	inline long long PipelineTracer::sinceOrigin(std::chrono::steady_clock::time_point time) const
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(time - m_origin).count();
+	}
+
+	inline Details::TraceRing& PipelineTracer::threadRing()
+	{
+		Details::TraceRing*& ring = m_threadRings.local();
+		if (ring == nullptr)
+		{
+			std::unique_ptr<Details::TraceRing> newRing(new Details::TraceRing(m_eventsPerThread));
+			concurrency::critical_section::scoped_lock lock(m_ringsLock);
+			m_rings.push_back(std::move(newRing));
+			ring = m_rings.back().get();
+		}
+
+		return *ring;
+	}
+
+}}
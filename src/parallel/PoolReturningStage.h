@@ -0,0 +1,47 @@
+#pragma once
+
+#include "ObjectPool.h"
+#include "PipelineStage.h"
+
+#include <functional>
+#include <memory>
+
+
+namespace Tools { namespace Parallel {
+
+	/*
+	 * Wraps a final stage's process function so that each input goes back
+	 * to its pool once the function has completed it. An input whose
+	 * function throws is not released, since it may still be retried or
+	 * sent to a dead-letter stage, which should release it.
+	 */
+	template<class Input>
+	class PoolReturningFunction
+	{
+	public:
+		explicit PoolReturningFunction(const std::function<void(Input&)>& processInputFunction);
+
+		void operator()(Pooled<Input>& input) const;
+
+	private:
+		std::function<void(Input&)> m_processInput;
+	};
+
+	/*
+	 * Creates a final PipelineStage that completes pooled inputs and
+	 * returns them to the pools they were acquired from.
+	 */
+	template<class Input>
+	std::shared_ptr<PipelineStage<Pooled<Input>, void>> makePoolReturningStage(
+		int stageId,
+		const std::function<void(Input&)>& processInputFunction);
+
+	template<class Input>
+	std::shared_ptr<PipelineStage<Pooled<Input>, void>> makePoolReturningStage(
+		int stageId,
+		const std::function<void(Input&)>& processInputFunction,
+		const std::function<void(int, std::exception_ptr)>& handleErrorFunction);
+
+}}
+
+#include "PoolReturningStage.hpp"
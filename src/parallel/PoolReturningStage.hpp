@@ -0,0 +1,40 @@
+namespace Tools { namespace Parallel {
+
+	template<class Input>
+	PoolReturningFunction<Input>::PoolReturningFunction(const std::function<void(Input&)>& processInputFunction)
+		: m_processInput(processInputFunction)
+	{
+		if (m_processInput == nullptr)
+		{
+			throw std::invalid_argument("A pool-returning stage requires a valid process input function.");
+		}
+	}
+
+	template<class Input>
+	void PoolReturningFunction<Input>::operator()(Pooled<Input>& input) const
+	{
+		m_processInput(*input);
+		input.release();
+	}
+
+	template<class Input>
+	std::shared_ptr<PipelineStage<Pooled<Input>, void>> makePoolReturningStage(
+		int stageId,
+		const std::function<void(Input&)>& processInputFunction)
+	{
+		return makePoolReturningStage<Input>(stageId, processInputFunction, nullptr /*handleErrorFunction*/);
+	}
+
+	template<class Input>
+	std::shared_ptr<PipelineStage<Pooled<Input>, void>> makePoolReturningStage(
+		int stageId,
+		const std::function<void(Input&)>& processInputFunction,
+		const std::function<void(int, std::exception_ptr)>& handleErrorFunction)
+	{
+		return std::make_shared<PipelineStage<Pooled<Input>, void>>(
+			stageId,
+			PoolReturningFunction<Input>(processInputFunction),
+			handleErrorFunction);
+	}
+
+}}
@@ -0,0 +1,134 @@
+#pragma once
+
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+
+#include <stdexcept>
+#include <system_error>
+
+
+namespace Tools { namespace Parallel {
+
+	/*
+	 * The processors a stage's workers may run on: any processor, by
+	 * default, or a set of processors within one processor group, such as
+	 * a single core or the processors of one NUMA node.
+	 */
+	class ProcessorAffinity
+	{
+	public:
+		ProcessorAffinity()
+			: m_group(0)
+			, m_mask(0)
+		{
+		}
+
+		ProcessorAffinity(unsigned short group, unsigned long long mask)
+			: m_group(group)
+			, m_mask(mask)
+		{
+			if (mask == 0)
+			{
+				throw std::invalid_argument("A processor affinity requires at least one processor.");
+			}
+		}
+
+		/*
+		 * The processor with the given number, counting across groups of
+		 * 64 processors.
+		 */
+		static ProcessorAffinity processor(unsigned int processorNumber)
+		{
+			return ProcessorAffinity(static_cast<unsigned short>(processorNumber / 64), 1ULL << (processorNumber % 64));
+		}
+
+		static ProcessorAffinity numaNode(unsigned short node)
+		{
+			GROUP_AFFINITY affinity = {};
+			if (!GetNumaNodeProcessorMaskEx(node, &affinity))
+			{
+				throw std::system_error(static_cast<int>(GetLastError()), std::system_category(), "Cannot get the processors of the NUMA node.");
+			}
+
+			return ProcessorAffinity(affinity.Group, affinity.Mask);
+		}
+
+		bool isPinned() const
+		{
+			return m_mask != 0;
+		}
+
+		unsigned short group() const
+		{
+			return m_group;
+		}
+
+		unsigned long long mask() const
+		{
+			return m_mask;
+		}
+
+	private:
+		unsigned short m_group;
+		unsigned long long m_mask;
+	};
+
+	/*
+	 * Pins the calling thread to a ProcessorAffinity for as long as it
+	 * lives and then restores the thread's previous affinity, since workers
+	 * run on threads borrowed from the scheduler.
+	 */
+	class ScopedProcessorAffinity
+	{
+	public:
+		explicit ScopedProcessorAffinity(const ProcessorAffinity& affinity)
+			: m_isPinned(false)
+			, m_error(0)
+			, m_previousAffinity()
+		{
+			if (affinity.isPinned())
+			{
+				GROUP_AFFINITY groupAffinity = {};
+				groupAffinity.Group = affinity.group();
+				groupAffinity.Mask = static_cast<KAFFINITY>(affinity.mask());
+
+				m_isPinned = SetThreadGroupAffinity(GetCurrentThread(), &groupAffinity, &m_previousAffinity) != FALSE;
+				m_error = m_isPinned ? 0 : GetLastError();
+			}
+		}
+
+		~ScopedProcessorAffinity()
+		{
+			if (m_isPinned)
+			{
+				SetThreadGroupAffinity(GetCurrentThread(), &m_previousAffinity, nullptr);
+			}
+		}
+
+		ScopedProcessorAffinity(const ScopedProcessorAffinity& other) = delete;
+
+		bool isPinned() const
+		{
+			return m_isPinned;
+		}
+
+		/*
+		 * Why pinning failed, or zero.
+		 */
+		DWORD error() const
+		{
+			return m_error;
+		}
+
+	private:
+		bool m_isPinned;
+		DWORD m_error;
+		GROUP_AFFINITY m_previousAffinity;
+	};
+
+}}
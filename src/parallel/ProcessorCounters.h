@@ -0,0 +1,60 @@
+#pragma once
+
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+
+
+namespace Tools { namespace Parallel {
+
+	/*
+	 * What the calling thread has consumed of its processor so far: the
+	 * cycles it has run for, as counted by the processor's time-stamp
+	 * counter, and the user and kernel time the scheduler has charged to
+	 * it. The difference between two samples taken on the same thread
+	 * covers the work in between, unlike wall-clock time, which also counts
+	 * time the thread spent preempted or blocked.
+	 */
+	struct ProcessorCounterSample
+	{
+		ProcessorCounterSample()
+			: cycles(0)
+			, processorNanoseconds(0)
+		{
+		}
+
+		/*
+		 * Takes a sample on the calling thread. Returns false if the
+		 * counters cannot be read, for example in a restricted sandbox.
+		 */
+		bool read()
+		{
+			ULONG64 threadCycles = 0;
+			FILETIME creationTime, exitTime, kernelTime, userTime;
+
+			if (!QueryThreadCycleTime(GetCurrentThread(), &threadCycles) ||
+				!GetThreadTimes(GetCurrentThread(), &creationTime, &exitTime, &kernelTime, &userTime))
+			{
+				return false;
+			}
+
+			cycles = threadCycles;
+			processorNanoseconds = 100 * static_cast<long long>(toTicks(kernelTime) + toTicks(userTime));
+			return true;
+		}
+
+		unsigned long long cycles;
+		long long processorNanoseconds;
+
+	private:
+		static unsigned long long toTicks(const FILETIME& time)
+		{
+			return (static_cast<unsigned long long>(time.dwHighDateTime) << 32) | time.dwLowDateTime;
+		}
+	};
+
+}}
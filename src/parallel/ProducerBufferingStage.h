@@ -0,0 +1,133 @@
+#pragma once
+
+#include "IConsumerStage.h"
+#include "PipelineStage.h"
+
+#include <concrt.h>
+#include <ppl.h>
+#include <ppltasks.h>
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <vector>
+
+
+namespace Tools { namespace Parallel {
+
+	/*
+	 * A batch of inputs published by one producer thread. Batches are shared
+	 * rather than copied, so that queueing one costs the same as queueing a
+	 * single input.
+	 */
+	template<class Input>
+	using InputBatch = std::shared_ptr<std::vector<Input>>;
+
+	/*
+	 * ProducerBufferingStage stands in for a stage that many threads add
+	 * inputs to. Each producer thread appends to a buffer of its own, and
+	 * the buffer is published to the wrapped stage as one InputBatch when it
+	 * reaches the batch size, when its oldest input has waited for the
+	 * maximum delay, or when the stage is flushed. The wrapped stage's queue
+	 * and counters are then touched once per batch rather than once per
+	 * input.
+	 *
+	 * Inputs from one producer thread reach the wrapped stage in the order
+	 * they were added. Buffered inputs are only published on a deadline
+	 * while the stage is active; a stage that is deactivated keeps them
+	 * until it is activated or flushed again. Whatever is still buffered
+	 * when the stage is destroyed is published to the wrapped stage.
+	 */
+	template<class Input>
+	class ProducerBufferingStage : public IConsumerStage<Input>
+	{
+	public:
+#pragma region Constructors and Destructor
+
+		ProducerBufferingStage(
+			const std::shared_ptr<IConsumerStage<InputBatch<Input>>>& batchStage,
+			size_t batchSize,
+			std::chrono::milliseconds maxDelay);
+
+		~ProducerBufferingStage();
+
+		ProducerBufferingStage(const ProducerBufferingStage<Input>& other) = delete;
+
+#pragma endregion
+
+#pragma region IPipelineStage implementations
+
+		int stageId() const override;
+		bool isActive() override;
+		bool isFlushing() override;
+		void activate() override;
+		concurrency::task<void> deactivate() override;
+		concurrency::task<void> flushOne() override;
+		concurrency::task<void> flushAll() override;
+
+#pragma endregion
+
+#pragma region IConsumerStage implementations
+
+		bool hasInputs() const override;
+		void addInput(Input& input) override;
+
+#pragma endregion
+
+		unsigned long long publishedBatches() const;
+
+	private:
+		struct ProducerBuffer
+		{
+			concurrency::critical_section lock;
+			InputBatch<Input> inputs;
+			std::chrono::steady_clock::time_point firstInputTime;
+		};
+
+		ProducerBuffer& producerBuffer();
+		std::vector<ProducerBuffer*> producerBuffers() const;
+		void publish(ProducerBuffer& buffer);
+		void publishAll();
+		void publishUntilStopped(const std::atomic<bool>& isStopped);
+		concurrency::task<void> stopPublishing();
+
+		std::shared_ptr<IConsumerStage<InputBatch<Input>>> m_stage;
+		size_t m_batchSize;
+		std::chrono::milliseconds m_maxDelay;
+
+		concurrency::combinable<ProducerBuffer*> m_threadBuffers;
+		std::vector<std::unique_ptr<ProducerBuffer>> m_buffers;
+		mutable concurrency::critical_section m_buffersLock;
+
+		std::atomic<unsigned long long> m_publishedBatches;
+
+		// Each publishing loop has a stop token of its own, so that a loop
+		// stopped by deactivate still ends if activate starts another
+		// before it has noticed
+		std::shared_ptr<std::atomic<bool>> m_publishingStopped;
+		std::vector<concurrency::task<void>> m_publishingTasks;
+		concurrency::critical_section m_publishingLock;
+	};
+
+	/*
+	 * Creates the final stage behind a ProducerBufferingStage: it drains each
+	 * batch by calling processInputFunction for every input in it. An input
+	 * that fails does not stop the rest of its batch. Once the batch is done
+	 * only the inputs that failed are left in it and its first error is
+	 * thrown, so a retry, or the dead-letter stage, gets just those.
+	 */
+	template<class Input>
+	std::shared_ptr<PipelineStage<InputBatch<Input>, void>> makeBatchDrainingStage(
+		int stageId,
+		const std::function<void(Input&)>& processInputFunction);
+
+	template<class Input>
+	std::shared_ptr<PipelineStage<InputBatch<Input>, void>> makeBatchDrainingStage(
+		int stageId,
+		const std::function<void(Input&)>& processInputFunction,
+		const std::function<void(int, std::exception_ptr)>& handleErrorFunction);
+
+}}
+
+#include "ProducerBufferingStage.hpp"
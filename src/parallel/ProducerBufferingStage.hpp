@@ -0,0 +1,324 @@
+#include <algorithm>
+#include <stdexcept>
+
+
+namespace Tools { namespace Parallel {
+
+#pragma region ProducerBufferingStage<Input>
+
+	template<class Input>
+	ProducerBufferingStage<Input>::ProducerBufferingStage(
+		const std::shared_ptr<IConsumerStage<InputBatch<Input>>>& batchStage,
+		size_t batchSize,
+		std::chrono::milliseconds maxDelay)
+		: m_stage(batchStage)
+		, m_batchSize(batchSize)
+		, m_maxDelay(maxDelay)
+		, m_publishedBatches(0)
+	{
+		if (m_stage == nullptr)
+		{
+			throw std::invalid_argument("ProducerBufferingStage requires a valid batch stage.");
+		}
+
+		if (m_batchSize == 0 || m_maxDelay.count() <= 0)
+		{
+			throw std::invalid_argument("ProducerBufferingStage requires a positive batch size and maximum delay.");
+		}
+	}
+
+	template<class Input>
+	ProducerBufferingStage<Input>::~ProducerBufferingStage()
+	{
+		stopPublishing().wait();
+
+		try
+		{
+			publishAll();
+		}
+		catch (...) {}
+	}
+
+	template<class Input>
+	int ProducerBufferingStage<Input>::stageId() const
+	{
+		return m_stage->stageId();
+	}
+
+	template<class Input>
+	bool ProducerBufferingStage<Input>::isActive()
+	{
+		return m_stage->isActive();
+	}
+
+	template<class Input>
+	bool ProducerBufferingStage<Input>::isFlushing()
+	{
+		return m_stage->isFlushing();
+	}
+
+	template<class Input>
+	void ProducerBufferingStage<Input>::activate()
+	{
+		m_stage->activate();
+
+		concurrency::critical_section::scoped_lock lock(m_publishingLock);
+		if (m_publishingStopped != nullptr)
+		{
+			return;
+		}
+
+		// Forget loops that have already ended
+		m_publishingTasks.erase(
+			std::remove_if(m_publishingTasks.begin(), m_publishingTasks.end(), [](const concurrency::task<void>& publishingTask)
+			{
+				return publishingTask.is_done();
+			}),
+			m_publishingTasks.end());
+
+		auto isStopped = std::make_shared<std::atomic<bool>>(false);
+		m_publishingStopped = isStopped;
+		m_publishingTasks.push_back(concurrency::create_task([this, isStopped](){ publishUntilStopped(*isStopped); }));
+	}
+
+	template<class Input>
+	concurrency::task<void> ProducerBufferingStage<Input>::deactivate()
+	{
+		std::vector<concurrency::task<void>> tasks;
+		tasks.push_back(stopPublishing());
+		tasks.push_back(m_stage->deactivate());
+
+		return concurrency::when_all(tasks.begin(), tasks.end());
+	}
+
+	template<class Input>
+	concurrency::task<void> ProducerBufferingStage<Input>::flushOne()
+	{
+		// The wrapped stage drops inputs once it is flushing
+		publishAll();
+		return m_stage->flushOne();
+	}
+
+	template<class Input>
+	concurrency::task<void> ProducerBufferingStage<Input>::flushAll()
+	{
+		publishAll();
+		return m_stage->flushAll();
+	}
+
+	template<class Input>
+	bool ProducerBufferingStage<Input>::hasInputs() const
+	{
+		if (m_stage->hasInputs())
+		{
+			return true;
+		}
+
+		auto buffers = producerBuffers();
+		for (auto iter = buffers.begin(); iter != buffers.end(); ++iter)
+		{
+			concurrency::critical_section::scoped_lock lock((*iter)->lock);
+			if ((*iter)->inputs != nullptr)
+			{
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	template<class Input>
+	void ProducerBufferingStage<Input>::addInput(Input& input)
+	{
+		ProducerBuffer& buffer = producerBuffer();
+
+		// Only the deadline publisher and flushes take this lock besides
+		// its own producer, so it is almost never contended
+		concurrency::critical_section::scoped_lock lock(buffer.lock);
+		if (buffer.inputs == nullptr)
+		{
+			buffer.inputs = std::make_shared<std::vector<Input>>();
+			buffer.inputs->reserve(m_batchSize);
+			buffer.firstInputTime = std::chrono::steady_clock::now();
+		}
+
+		buffer.inputs->push_back(input);
+		if (buffer.inputs->size() >= m_batchSize)
+		{
+			publish(buffer);
+		}
+	}
+
+	template<class Input>
+	unsigned long long ProducerBufferingStage<Input>::publishedBatches() const
+	{
+		return m_publishedBatches.load(std::memory_order_relaxed);
+	}
+
+	template<class Input>
+	typename ProducerBufferingStage<Input>::ProducerBuffer& ProducerBufferingStage<Input>::producerBuffer()
+	{
+		ProducerBuffer*& buffer = m_threadBuffers.local();
+		if (buffer == nullptr)
+		{
+			std::unique_ptr<ProducerBuffer> newBuffer(new ProducerBuffer());
+			concurrency::critical_section::scoped_lock lock(m_buffersLock);
+			m_buffers.push_back(std::move(newBuffer));
+			buffer = m_buffers.back().get();
+		}
+
+		return *buffer;
+	}
+
+	template<class Input>
+	std::vector<typename ProducerBufferingStage<Input>::ProducerBuffer*> ProducerBufferingStage<Input>::producerBuffers() const
+	{
+		std::vector<ProducerBuffer*> buffers;
+		concurrency::critical_section::scoped_lock lock(m_buffersLock);
+		buffers.reserve(m_buffers.size());
+		for (auto iter = m_buffers.begin(); iter != m_buffers.end(); ++iter)
+		{
+			buffers.push_back(iter->get());
+		}
+
+		return buffers;
+	}
+
+	template<class Input>
+	void ProducerBufferingStage<Input>::publish(ProducerBuffer& buffer)
+	{
+		// Called with the buffer's lock held, so that a producer's batches
+		// are queued in the order they were filled
+		InputBatch<Input> batch;
+		batch.swap(buffer.inputs);
+
+		m_stage->addInput(batch);
+		m_publishedBatches.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	template<class Input>
+	void ProducerBufferingStage<Input>::publishAll()
+	{
+		auto buffers = producerBuffers();
+		for (auto iter = buffers.begin(); iter != buffers.end(); ++iter)
+		{
+			concurrency::critical_section::scoped_lock lock((*iter)->lock);
+			if ((*iter)->inputs != nullptr)
+			{
+				publish(**iter);
+			}
+		}
+	}
+
+	template<class Input>
+	void ProducerBufferingStage<Input>::publishUntilStopped(const std::atomic<bool>& isStopped)
+	{
+		// Checking twice per delay keeps an input from waiting much longer
+		// than the maximum delay
+		auto interval = (std::max)(m_maxDelay / 2, std::chrono::milliseconds(1));
+
+		for (;;)
+		{
+			concurrency::wait(static_cast<unsigned int>(interval.count()));
+			if (isStopped)
+			{
+				break;
+			}
+
+			auto now = std::chrono::steady_clock::now();
+			auto buffers = producerBuffers();
+			for (auto iter = buffers.begin(); iter != buffers.end(); ++iter)
+			{
+				concurrency::critical_section::scoped_lock lock((*iter)->lock);
+				if ((*iter)->inputs != nullptr && now - (*iter)->firstInputTime >= m_maxDelay)
+				{
+					publish(**iter);
+				}
+			}
+		}
+	}
+
+	template<class Input>
+	concurrency::task<void> ProducerBufferingStage<Input>::stopPublishing()
+	{
+		concurrency::critical_section::scoped_lock lock(m_publishingLock);
+		if (m_publishingStopped != nullptr)
+		{
+			*m_publishingStopped = true;
+			m_publishingStopped.reset();
+		}
+
+		if (m_publishingTasks.empty())
+		{
+			return concurrency::task_from_result();
+		}
+
+		return concurrency::when_all(m_publishingTasks.begin(), m_publishingTasks.end());
+	}
+
+#pragma endregion
+
+#pragma region makeBatchDrainingStage<Input>
+
+	template<class Input>
+	std::shared_ptr<PipelineStage<InputBatch<Input>, void>> makeBatchDrainingStage(
+		int stageId,
+		const std::function<void(Input&)>& processInputFunction)
+	{
+		return makeBatchDrainingStage<Input>(stageId, processInputFunction, nullptr /*handleErrorFunction*/);
+	}
+
+	template<class Input>
+	std::shared_ptr<PipelineStage<InputBatch<Input>, void>> makeBatchDrainingStage(
+		int stageId,
+		const std::function<void(Input&)>& processInputFunction,
+		const std::function<void(int, std::exception_ptr)>& handleErrorFunction)
+	{
+		if (processInputFunction == nullptr)
+		{
+			throw std::invalid_argument("A batch draining stage requires a valid process input function.");
+		}
+
+		return std::make_shared<PipelineStage<InputBatch<Input>, void>>(
+			stageId,
+			[processInputFunction](InputBatch<Input>& batch)
+			{
+				// The failed inputs are moved to the front of the batch, which a
+				// retry shares, and the rest is cut off
+				std::exception_ptr firstError;
+				auto failed = batch->begin();
+				for (auto iter = batch->begin(); iter != batch->end(); ++iter)
+				{
+					try
+					{
+						processInputFunction(*iter);
+					}
+					catch (...)
+					{
+						if (!firstError)
+						{
+							firstError = std::current_exception();
+						}
+
+						if (failed != iter)
+						{
+							*failed = std::move(*iter);
+						}
+
+						++failed;
+					}
+				}
+
+				batch->erase(failed, batch->end());
+
+				if (firstError)
+				{
+					std::rethrow_exception(firstError);
+				}
+			},
+			handleErrorFunction);
+	}
+
+#pragma endregion
+
+}}
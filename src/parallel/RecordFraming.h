@@ -0,0 +1,114 @@
+#pragma once
+
+#include "RecordView.h"
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+
+namespace Tools { namespace Parallel {
+
+	/*
+	 * A framing splits a buffer into records. next is given the bytes that
+	 * remain after the previous record and returns the next record and how
+	 * many bytes it took up, or false if no bytes remain. It throws
+	 * std::runtime_error if the remaining bytes do not form a record.
+	 */
+
+	/*
+	 * One record per line. The line break ('\n' or "\r\n") is not part of
+	 * the record, and the last line need not have one.
+	 */
+	class NewlineFraming
+	{
+	public:
+		bool next(const char* data, size_t available, RecordView& record, size_t& consumed) const
+		{
+			if (available == 0)
+			{
+				return false;
+			}
+
+			auto lineEnd = static_cast<const char*>(std::memchr(data, '\n', available));
+			size_t size = lineEnd != nullptr ? static_cast<size_t>(lineEnd - data) : available;
+			consumed = lineEnd != nullptr ? size + 1 : size;
+
+			if (size > 0 && data[size - 1] == '\r')
+			{
+				--size;
+			}
+
+			assignRecord(record, data, size);
+			return true;
+		}
+	};
+
+	/*
+	 * Each record is preceded by its size as a 32-bit little-endian integer.
+	 */
+	class LengthPrefixedFraming
+	{
+	public:
+		bool next(const char* data, size_t available, RecordView& record, size_t& consumed) const
+		{
+			if (available == 0)
+			{
+				return false;
+			}
+
+			uint32_t size = 0;
+			if (available < sizeof(size))
+			{
+				throw std::runtime_error("Truncated record length.");
+			}
+
+			std::memcpy(&size, data, sizeof(size));
+			if (available - sizeof(size) < size)
+			{
+				throw std::runtime_error("Truncated record.");
+			}
+
+			assignRecord(record, data + sizeof(size), size);
+			consumed = sizeof(size) + size;
+			return true;
+		}
+	};
+
+	/*
+	 * Every record has the same size.
+	 */
+	class FixedSizeFraming
+	{
+	public:
+		explicit FixedSizeFraming(size_t recordSize)
+			: m_recordSize(recordSize)
+		{
+			if (m_recordSize == 0)
+			{
+				throw std::invalid_argument("FixedSizeFraming requires a record size greater than zero.");
+			}
+		}
+
+		bool next(const char* data, size_t available, RecordView& record, size_t& consumed) const
+		{
+			if (available == 0)
+			{
+				return false;
+			}
+
+			if (available < m_recordSize)
+			{
+				throw std::runtime_error("Truncated record.");
+			}
+
+			assignRecord(record, data, m_recordSize);
+			consumed = m_recordSize;
+			return true;
+		}
+
+	private:
+		size_t m_recordSize;
+	};
+
+}}
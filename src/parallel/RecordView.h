@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+
+namespace Tools { namespace Parallel {
+
+	/*
+	 * A record framed out of a buffer that someone else owns, such as the
+	 * mapped file of a FileSource. It is only valid for as long as that
+	 * buffer is.
+	 */
+	struct RecordView
+	{
+		const char* data;
+		size_t size;
+	};
+
+	/*
+	 * A source that frames records out of a buffer calls assignRecord to
+	 * turn each one into the type its consumers take. A view costs no copy;
+	 * other record types can be supported by adding an overload.
+	 */
+	inline void assignRecord(RecordView& record, const char* data, size_t size)
+	{
+		record.data = data;
+		record.size = size;
+	}
+
+	inline void assignRecord(std::string& record, const char* data, size_t size)
+	{
+		record.assign(data, size);
+	}
+
+}}
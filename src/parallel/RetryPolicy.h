@@ -0,0 +1,87 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <stdexcept>
+
+
+namespace Tools { namespace Parallel {
+
+	/*
+	 * Describes how many times a pipeline stage attempts to process an input
+	 * that throws, and how long it waits between attempts. The delay grows
+	 * exponentially from initialBackoff up to maxBackoff, and jitter (between
+	 * 0 and 1) randomly shortens each delay by up to that fraction so that
+	 * retries of a burst of failures do not all fire together.
+	 *
+	 * The default policy makes a single attempt, i.e. it never retries.
+	 */
+	class RetryPolicy
+	{
+	public:
+		RetryPolicy()
+			: RetryPolicy(1 /*maxAttempts*/, std::chrono::milliseconds::zero(), std::chrono::milliseconds::zero(), 1.0, 0.0)
+		{
+		}
+
+		RetryPolicy(
+			unsigned int maxAttempts,
+			std::chrono::milliseconds initialBackoff,
+			std::chrono::milliseconds maxBackoff,
+			double backoffMultiplier,
+			double jitter)
+			: m_maxAttempts(maxAttempts)
+			, m_initialBackoff(initialBackoff)
+			, m_maxBackoff(maxBackoff)
+			, m_backoffMultiplier(backoffMultiplier)
+			, m_jitter(jitter)
+		{
+			if (maxAttempts == 0)
+			{
+				throw std::invalid_argument("A retry policy must allow at least one attempt.");
+			}
+
+			if (initialBackoff.count() < 0 || maxBackoff < initialBackoff)
+			{
+				throw std::invalid_argument("Invalid backoff range.");
+			}
+
+			if (backoffMultiplier < 1.0 || jitter < 0.0 || jitter > 1.0)
+			{
+				throw std::invalid_argument("Invalid backoff multiplier or jitter.");
+			}
+		}
+
+		unsigned int maxAttempts() const
+		{
+			return m_maxAttempts;
+		}
+
+		bool shouldRetry(unsigned int attempts) const
+		{
+			return attempts < m_maxAttempts;
+		}
+
+		/*
+		 * Returns the delay before the next attempt, given the number of
+		 * attempts made so far and a uniformly distributed value in [0, 1).
+		 */
+		std::chrono::milliseconds backoff(unsigned int attempts, double random) const
+		{
+			double backoff = m_initialBackoff.count() * std::pow(m_backoffMultiplier, attempts > 0 ? attempts - 1 : 0);
+			backoff = (std::min)(backoff, static_cast<double>(m_maxBackoff.count()));
+			backoff *= 1.0 - m_jitter * random;
+
+			return std::chrono::milliseconds(static_cast<long long>(backoff));
+		}
+
+	private:
+		unsigned int m_maxAttempts;
+		std::chrono::milliseconds m_initialBackoff;
+		std::chrono::milliseconds m_maxBackoff;
+		double m_backoffMultiplier;
+		double m_jitter;
+	};
+
+}}
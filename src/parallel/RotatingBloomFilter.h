@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+
+namespace Tools { namespace Parallel {
+
+	/*
+	 * RotatingBloomFilter remembers the hashes recorded within the last
+	 * horizon stamps in a fixed amount of memory. It keeps GenerationCount
+	 * blocked Bloom filters, each covering a third of the horizon: the
+	 * oldest is cleared and reused as stamps move on, so a hash is
+	 * remembered for at least the horizon and at most a third longer.
+	 *
+	 * A blocked filter sets all the bits of a hash within one 64-byte block,
+	 * so checking a generation touches a single cache line. The filter
+	 * never forgets a hash within the horizon, but may report a hash that
+	 * was never recorded at about the given false positive rate.
+	 *
+	 * RotatingBloomFilter is not thread-safe.
+	 */
+	class RotatingBloomFilter
+	{
+	public:
+		static const unsigned int GenerationCount = 4;
+
+		/*
+		 * expectedKeys is the number of distinct hashes expected within one
+		 * horizon.
+		 */
+		RotatingBloomFilter(unsigned long long horizon, unsigned long long expectedKeys, double falsePositiveRate);
+
+		/*
+		 * Records hash at stamp. Returns false if the hash was, or appears
+		 * to have been, recorded within the horizon.
+		 */
+		bool insert(uint64_t hash, unsigned long long stamp);
+
+		size_t memoryBytes() const;
+
+	private:
+		static const unsigned int WordsPerBlock = 8;
+		static const unsigned int BitsPerBlock = WordsPerBlock * 64;
+
+		struct Block
+		{
+			uint64_t words[WordsPerBlock];
+		};
+
+		void advance(unsigned long long epoch);
+		Block& blockOf(unsigned int generation, uint64_t hash);
+		bool contains(const Block& block, uint64_t hash) const;
+		void add(Block& block, uint64_t hash);
+
+		unsigned long long m_span;
+		unsigned long long m_epoch;
+		size_t m_blocksPerGeneration;
+		unsigned int m_hashCount;
+		std::vector<Block> m_blocks;
+	};
+
+}}
+
+#include "RotatingBloomFilter.hpp"
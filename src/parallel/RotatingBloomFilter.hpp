@@ -0,0 +1,110 @@
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+
+namespace Tools { namespace Parallel {
+
+	inline RotatingBloomFilter::RotatingBloomFilter(
+		unsigned long long horizon,
+		unsigned long long expectedKeys,
+		double falsePositiveRate)
+		: m_span((std::max)(horizon / (GenerationCount - 1), 1ULL))
+		, m_epoch(0)
+		, m_blocksPerGeneration(1)
+		, m_hashCount(1)
+	{
+		if (horizon == 0 || expectedKeys == 0 || falsePositiveRate <= 0.0 || falsePositiveRate >= 1.0)
+		{
+			throw std::invalid_argument("RotatingBloomFilter requires a horizon, expected keys and a false positive rate between zero and one.");
+		}
+
+		// A lookup checks every generation, so each one gets a share of the
+		// false positive rate
+		double keysPerGeneration = static_cast<double>(expectedKeys) / (GenerationCount - 1);
+		double generationRate = falsePositiveRate / GenerationCount;
+		double ln2 = std::log(2.0);
+		double bitsPerKey = -std::log(generationRate) / (ln2 * ln2);
+
+		double bits = std::ceil(keysPerGeneration * bitsPerKey);
+		m_blocksPerGeneration = (std::max)(static_cast<size_t>(std::ceil(bits / BitsPerBlock)), static_cast<size_t>(1));
+		m_hashCount = (std::min)((std::max)(static_cast<unsigned int>(std::round(bitsPerKey * ln2)), 1U), 16U);
+
+		m_blocks.resize(GenerationCount * m_blocksPerGeneration, Block());
+	}
+
+	inline bool RotatingBloomFilter::insert(uint64_t hash, unsigned long long stamp)
+	{
+		unsigned long long epoch = stamp / m_span;
+		if (epoch > m_epoch)
+		{
+			advance(epoch);
+		}
+
+		for (unsigned int generation = 0; generation < GenerationCount; ++generation)
+		{
+			if (contains(blockOf(generation, hash), hash))
+			{
+				return false;
+			}
+		}
+
+		add(blockOf(static_cast<unsigned int>(m_epoch % GenerationCount), hash), hash);
+		return true;
+	}
+
+	inline size_t RotatingBloomFilter::memoryBytes() const
+	{
+		return m_blocks.size() * sizeof(Block);
+	}
+
+	inline void RotatingBloomFilter::advance(unsigned long long epoch)
+	{
+		// Each epoch reuses the generation of the epoch GenerationCount
+		// before it; after a long pause every generation is stale
+		unsigned long long first = (std::max)(m_epoch + 1, epoch >= GenerationCount ? epoch - GenerationCount + 1 : 0ULL);
+		for (unsigned long long stale = first; stale <= epoch; ++stale)
+		{
+			auto begin = m_blocks.begin() + static_cast<size_t>(stale % GenerationCount) * m_blocksPerGeneration;
+			std::fill(begin, begin + m_blocksPerGeneration, Block());
+		}
+
+		m_epoch = epoch;
+	}
+
+	inline RotatingBloomFilter::Block& RotatingBloomFilter::blockOf(unsigned int generation, uint64_t hash)
+	{
+		return m_blocks[generation * m_blocksPerGeneration + static_cast<size_t>((hash >> 32) % m_blocksPerGeneration)];
+	}
+
+	inline bool RotatingBloomFilter::contains(const Block& block, uint64_t hash) const
+	{
+		// Double hashing over the low half of the hash picks the bits
+		uint32_t position = static_cast<uint32_t>(hash);
+		uint32_t step = static_cast<uint32_t>(hash >> 16) | 1;
+
+		for (unsigned int i = 0; i < m_hashCount; ++i, position += step)
+		{
+			unsigned int bit = position % BitsPerBlock;
+			if ((block.words[bit / 64] & (1ULL << (bit % 64))) == 0)
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	inline void RotatingBloomFilter::add(Block& block, uint64_t hash)
+	{
+		uint32_t position = static_cast<uint32_t>(hash);
+		uint32_t step = static_cast<uint32_t>(hash >> 16) | 1;
+
+		for (unsigned int i = 0; i < m_hashCount; ++i, position += step)
+		{
+			unsigned int bit = position % BitsPerBlock;
+			block.words[bit / 64] |= 1ULL << (bit % 64);
+		}
+	}
+
+}}
@@ -0,0 +1,169 @@
+#pragma once
+
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+
+#include <concrt.h>
+
+#include <atomic>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+
+
+namespace Tools { namespace Parallel {
+
+	/*
+	 * SharedMemoryRing is a bounded ring buffer in a named shared-memory
+	 * section. It connects a pipeline in one process to a pipeline in
+	 * another: any number of threads in the producing process may push, and
+	 * a single thread in the consuming process pops. Values are copied into
+	 * the section as they are, so T must be trivially copyable and must not
+	 * refer to memory in either process.
+	 *
+	 * A side that has to wait parks on its own named event and on the other
+	 * process's handle, so it wakes when the other side makes progress or
+	 * when the other process exits. The other side only signals the event
+	 * when it sees a waiter, so neither side makes a system call while data
+	 * keeps flowing.
+	 *
+	 * A ring connects one producing and one consuming process for its whole
+	 * lifetime. Once either side has gone, the ring must be recreated under a
+	 * new name.
+	 */
+	template<class T>
+	class SharedMemoryRing
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "SharedMemoryRing requires a trivially copyable type.");
+
+	public:
+		enum Role
+		{
+			Producer,
+			Consumer
+		};
+
+		enum WaitResult
+		{
+			Ready,
+			NotReady,
+			PeerClosed,
+			PeerExited
+		};
+
+#pragma region Constructors and Destructor
+
+		/*
+		 * Creates the section, or opens it if the other side created it
+		 * first. Both sides must agree on the name, the capacity (a power of
+		 * two greater than one) and T.
+		 */
+		SharedMemoryRing(const std::wstring& name, unsigned int capacity, Role role);
+
+		~SharedMemoryRing();
+
+		SharedMemoryRing(const SharedMemoryRing<T>& other) = delete;
+
+#pragma endregion
+
+#pragma region Values
+
+		unsigned int capacity() const;
+		size_t size() const;
+		bool isEmpty() const;
+
+		bool tryPush(const T& value);
+		bool tryPop(T& value);
+
+#pragma endregion
+
+#pragma region Flushing across processes
+
+		/*
+		 * The producer requests a flush and waits until isFlushComplete; the
+		 * consumer sees it through pendingFlush once it has drained the ring
+		 * and answers with completeFlush.
+		 */
+		unsigned long long requestFlush();
+		bool isFlushComplete(unsigned long long flush) const;
+		unsigned long long pendingFlush() const;
+		void completeFlush(unsigned long long flush);
+
+#pragma endregion
+
+#pragma region Waiting
+
+		bool hasPeer() const;
+
+		/*
+		 * Parks until isReady returns true, the other side signals, the
+		 * other side goes away or the timeout elapses.
+		 */
+		template<class Predicate>
+		WaitResult waitUntil(Predicate isReady, unsigned int timeoutMilliseconds);
+
+		/*
+		 * Wakes a thread of this side that is parked in waitUntil, so that it
+		 * can re-evaluate its own state.
+		 */
+		void wake();
+
+#pragma endregion
+
+	private:
+		struct Header
+		{
+			std::atomic<uint32_t> state;
+			uint32_t capacity;
+			uint32_t valueSize;
+			std::atomic<uint32_t> processIds[2];
+			std::atomic<uint32_t> isClosed[2];
+			std::atomic<uint32_t> waiters[2];
+			std::atomic<uint64_t> flushesRequested;
+			std::atomic<uint64_t> flushesCompleted;
+
+			// Producers contend on the tail and the consumer owns the head,
+			// so each has a cache line of its own.
+			alignas(64) std::atomic<uint64_t> tail;
+			alignas(64) std::atomic<uint64_t> head;
+		};
+
+		struct Slot
+		{
+			std::atomic<uint64_t> sequence;
+			T value;
+		};
+
+		static std::wstring eventName(const std::wstring& name, Role role);
+		static void throwLastError(const char* message);
+
+		Role peerRole() const;
+		void initialize(unsigned int capacity);
+		void attach();
+		void release();
+		bool isPeerClosed() const;
+		WaitResult waitForPeer(unsigned int timeoutMilliseconds);
+		void wakePeer();
+
+		Role m_role;
+		HANDLE m_section;
+		Header* m_header;
+		Slot* m_slots;
+		uint64_t m_mask;
+		HANDLE m_event;
+		HANDLE m_peerEvent;
+		HANDLE m_peerProcess;
+		bool m_hasPeerExited;
+		concurrency::critical_section m_peerProcessLock;
+	};
+
+}}
+
+#include "SharedMemoryRing.hpp"
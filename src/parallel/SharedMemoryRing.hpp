@@ -0,0 +1,392 @@
+namespace Tools { namespace Parallel {
+
+	const uint32_t c_sectionInitializing = 1;
+	const uint32_t c_sectionReady = 2;
+
+	// Waits in the adapters are bounded so that they re-check their own
+	// state even if a wake-up was absorbed by another waiting thread
+	const unsigned int c_sharedMemoryWaitMilliseconds = 100;
+
+	template<class T>
+	SharedMemoryRing<T>::SharedMemoryRing(const std::wstring& name, unsigned int capacity, Role role)
+		: m_role(role)
+		, m_section(nullptr)
+		, m_header(nullptr)
+		, m_slots(nullptr)
+		, m_mask(capacity - 1)
+		, m_event(nullptr)
+		, m_peerEvent(nullptr)
+		, m_peerProcess(nullptr)
+		, m_hasPeerExited(false)
+	{
+		if (name.empty())
+		{
+			throw std::invalid_argument("SharedMemoryRing requires a name.");
+		}
+
+		// A slot's sequence number cannot tell a published value from a free
+		// slot of the next lap if the ring has only one slot
+		if (capacity < 2 || (capacity & (capacity - 1)) != 0)
+		{
+			throw std::invalid_argument("SharedMemoryRing requires a capacity that is a power of two greater than one.");
+		}
+
+		try
+		{
+			unsigned long long sectionSize = sizeof(Header) + static_cast<unsigned long long>(capacity) * sizeof(Slot);
+			m_section = CreateFileMappingW(
+				INVALID_HANDLE_VALUE,
+				nullptr,
+				PAGE_READWRITE,
+				static_cast<DWORD>(sectionSize >> 32),
+				static_cast<DWORD>(sectionSize),
+				name.c_str());
+			if (m_section == nullptr)
+			{
+				throwLastError("Cannot create the shared-memory section.");
+			}
+
+			m_header = static_cast<Header*>(MapViewOfFile(m_section, FILE_MAP_ALL_ACCESS, 0, 0, static_cast<SIZE_T>(sectionSize)));
+			if (m_header == nullptr)
+			{
+				throwLastError("Cannot map the shared-memory section.");
+			}
+
+			m_slots = reinterpret_cast<Slot*>(m_header + 1);
+			m_event = CreateEventW(nullptr, FALSE /*manualReset*/, FALSE /*initialState*/, eventName(name, m_role).c_str());
+			m_peerEvent = CreateEventW(nullptr, FALSE /*manualReset*/, FALSE /*initialState*/, eventName(name, peerRole()).c_str());
+			if (m_event == nullptr || m_peerEvent == nullptr)
+			{
+				throwLastError("Cannot create the shared-memory ring events.");
+			}
+
+			initialize(capacity);
+			attach();
+		}
+		catch (...)
+		{
+			release();
+			throw;
+		}
+	}
+
+	template<class T>
+	SharedMemoryRing<T>::~SharedMemoryRing()
+	{
+		m_header->isClosed[m_role].store(1);
+		wakePeer();
+		release();
+	}
+
+	template<class T>
+	unsigned int SharedMemoryRing<T>::capacity() const
+	{
+		return m_header->capacity;
+	}
+
+	template<class T>
+	size_t SharedMemoryRing<T>::size() const
+	{
+		// Read the head first so that a concurrent pop cannot make it
+		// overtake the tail we read
+		uint64_t head = m_header->head.load(std::memory_order_acquire);
+		uint64_t tail = m_header->tail.load(std::memory_order_acquire);
+		return tail > head ? static_cast<size_t>(tail - head) : 0;
+	}
+
+	template<class T>
+	bool SharedMemoryRing<T>::isEmpty() const
+	{
+		return size() == 0;
+	}
+
+	template<class T>
+	bool SharedMemoryRing<T>::tryPush(const T& value)
+	{
+		// Each slot carries a sequence number that tells producers and the
+		// consumer whose turn it is: it equals the position for a free slot
+		// and the position plus one for a published value.
+		uint64_t position = m_header->tail.load(std::memory_order_relaxed);
+		Slot* slot = nullptr;
+
+		for (;;)
+		{
+			slot = &m_slots[position & m_mask];
+			uint64_t sequence = slot->sequence.load(std::memory_order_acquire);
+			long long difference = static_cast<long long>(sequence - position);
+
+			if (difference == 0)
+			{
+				if (m_header->tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+				{
+					break;
+				}
+			}
+			else if (difference < 0)
+			{
+				// The consumer has not freed this slot yet: the ring is full
+				return false;
+			}
+			else
+			{
+				position = m_header->tail.load(std::memory_order_relaxed);
+			}
+		}
+
+		slot->value = value;
+		slot->sequence.store(position + 1, std::memory_order_release);
+		wakePeer();
+
+		return true;
+	}
+
+	template<class T>
+	bool SharedMemoryRing<T>::tryPop(T& value)
+	{
+		uint64_t position = m_header->head.load(std::memory_order_relaxed);
+		Slot& slot = m_slots[position & m_mask];
+
+		if (slot.sequence.load(std::memory_order_acquire) != position + 1)
+		{
+			return false;
+		}
+
+		value = slot.value;
+		slot.sequence.store(position + m_mask + 1, std::memory_order_release);
+		m_header->head.store(position + 1, std::memory_order_release);
+		wakePeer();
+
+		return true;
+	}
+
+	template<class T>
+	unsigned long long SharedMemoryRing<T>::requestFlush()
+	{
+		unsigned long long flush = m_header->flushesRequested.fetch_add(1) + 1;
+		wakePeer();
+
+		return flush;
+	}
+
+	template<class T>
+	bool SharedMemoryRing<T>::isFlushComplete(unsigned long long flush) const
+	{
+		return m_header->flushesCompleted.load(std::memory_order_acquire) >= flush;
+	}
+
+	template<class T>
+	unsigned long long SharedMemoryRing<T>::pendingFlush() const
+	{
+		unsigned long long requested = m_header->flushesRequested.load(std::memory_order_acquire);
+		return requested > m_header->flushesCompleted.load(std::memory_order_relaxed) ? requested : 0;
+	}
+
+	template<class T>
+	void SharedMemoryRing<T>::completeFlush(unsigned long long flush)
+	{
+		m_header->flushesCompleted.store(flush, std::memory_order_release);
+		wakePeer();
+	}
+
+	template<class T>
+	bool SharedMemoryRing<T>::hasPeer() const
+	{
+		return m_header->processIds[peerRole()].load(std::memory_order_acquire) != 0 && !isPeerClosed();
+	}
+
+	template<class T>
+	template<class Predicate>
+	typename SharedMemoryRing<T>::WaitResult SharedMemoryRing<T>::waitUntil(Predicate isReady, unsigned int timeoutMilliseconds)
+	{
+		if (isReady())
+		{
+			return Ready;
+		}
+
+		// Announce the waiter before checking again. Together with the fence
+		// in wakePeer this guarantees that the other side either sees the
+		// waiter and signals, or made its change before our second check.
+		m_header->waiters[m_role].fetch_add(1);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+
+		WaitResult result = NotReady;
+		try
+		{
+			if (isReady())
+			{
+				result = Ready;
+			}
+			else if (isPeerClosed())
+			{
+				result = PeerClosed;
+			}
+			else if (waitForPeer(timeoutMilliseconds) == PeerExited)
+			{
+				result = PeerExited;
+			}
+			else if (isReady())
+			{
+				result = Ready;
+			}
+		}
+		catch (...)
+		{
+			m_header->waiters[m_role].fetch_sub(1, std::memory_order_relaxed);
+			throw;
+		}
+
+		m_header->waiters[m_role].fetch_sub(1, std::memory_order_relaxed);
+		return result;
+	}
+
+	template<class T>
+	void SharedMemoryRing<T>::wake()
+	{
+		SetEvent(m_event);
+	}
+
+	template<class T>
+	std::wstring SharedMemoryRing<T>::eventName(const std::wstring& name, Role role)
+	{
+		return name + (role == Producer ? L".Producer" : L".Consumer");
+	}
+
+	template<class T>
+	void SharedMemoryRing<T>::throwLastError(const char* message)
+	{
+		throw std::system_error(static_cast<int>(GetLastError()), std::system_category(), message);
+	}
+
+	template<class T>
+	typename SharedMemoryRing<T>::Role SharedMemoryRing<T>::peerRole() const
+	{
+		return m_role == Producer ? Consumer : Producer;
+	}
+
+	template<class T>
+	void SharedMemoryRing<T>::initialize(unsigned int capacity)
+	{
+		// The section is zero-filled when it is created, which is a valid
+		// value for every atomic in it. Whichever side gets here first lays
+		// out the slots; the other waits until it has.
+		uint32_t state = 0;
+		if (m_header->state.compare_exchange_strong(state, c_sectionInitializing))
+		{
+			m_header->capacity = capacity;
+			m_header->valueSize = sizeof(T);
+			for (unsigned int i = 0; i < capacity; ++i)
+			{
+				m_slots[i].sequence.store(i, std::memory_order_relaxed);
+			}
+
+			m_header->state.store(c_sectionReady, std::memory_order_release);
+		}
+		else
+		{
+			while (m_header->state.load(std::memory_order_acquire) != c_sectionReady)
+			{
+				concurrency::wait(0);
+			}
+		}
+
+		if (m_header->capacity != capacity || m_header->valueSize != sizeof(T))
+		{
+			throw std::invalid_argument("SharedMemoryRing was created with a different capacity or value type.");
+		}
+	}
+
+	template<class T>
+	void SharedMemoryRing<T>::attach()
+	{
+		uint32_t processId = 0;
+		if (!m_header->processIds[m_role].compare_exchange_strong(processId, GetCurrentProcessId()))
+		{
+			throw std::invalid_argument(m_role == Producer
+				? "SharedMemoryRing already has a producer."
+				: "SharedMemoryRing already has a consumer.");
+		}
+
+		wakePeer();
+	}
+
+	template<class T>
+	void SharedMemoryRing<T>::release()
+	{
+		if (m_peerProcess != nullptr)
+		{
+			CloseHandle(m_peerProcess);
+		}
+
+		if (m_peerEvent != nullptr)
+		{
+			CloseHandle(m_peerEvent);
+		}
+
+		if (m_event != nullptr)
+		{
+			CloseHandle(m_event);
+		}
+
+		if (m_header != nullptr)
+		{
+			UnmapViewOfFile(m_header);
+		}
+
+		if (m_section != nullptr)
+		{
+			CloseHandle(m_section);
+		}
+	}
+
+	template<class T>
+	bool SharedMemoryRing<T>::isPeerClosed() const
+	{
+		return m_header->isClosed[peerRole()].load(std::memory_order_acquire) != 0;
+	}
+
+	template<class T>
+	typename SharedMemoryRing<T>::WaitResult SharedMemoryRing<T>::waitForPeer(unsigned int timeoutMilliseconds)
+	{
+		HANDLE peerProcess = nullptr;
+		{
+			concurrency::critical_section::scoped_lock lock(m_peerProcessLock);
+			DWORD processId = m_header->processIds[peerRole()].load(std::memory_order_acquire);
+
+			if (m_peerProcess == nullptr && !m_hasPeerExited && processId != 0)
+			{
+				// Holding the handle also keeps the id from being reused
+				m_peerProcess = OpenProcess(SYNCHRONIZE, FALSE, processId);
+				m_hasPeerExited = (m_peerProcess == nullptr);
+			}
+
+			if (m_hasPeerExited)
+			{
+				return PeerExited;
+			}
+
+			peerProcess = m_peerProcess;
+		}
+
+		HANDLE handles[] = { m_event, peerProcess };
+		DWORD result = WaitForMultipleObjects(peerProcess != nullptr ? 2 : 1, handles, FALSE /*waitAll*/, timeoutMilliseconds);
+
+		if (result == WAIT_FAILED)
+		{
+			throwLastError("Cannot wait for the shared-memory ring.");
+		}
+
+		return result == WAIT_OBJECT_0 + 1 ? PeerExited : NotReady;
+	}
+
+	template<class T>
+	void SharedMemoryRing<T>::wakePeer()
+	{
+		// Pairs with the fence in waitUntil
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (m_header->waiters[peerRole()].load(std::memory_order_relaxed) > 0)
+		{
+			SetEvent(m_peerEvent);
+		}
+	}
+
+}}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include "IConsumerStage.h"
+#include "IInspectableStage.h"
+#include "SharedMemoryRing.h"
+
+#include <concrt.h>
+#include <ppltasks.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <typeinfo>
+#include <vector>
+
+
+namespace Tools { namespace Parallel {
+
+	/*
+	 * SharedMemorySink is the producing end of a pipeline edge that crosses
+	 * a process boundary. Its inputs are copied into a SharedMemoryRing,
+	 * from which a SharedMemorySource in the other process passes them on to
+	 * its consumers. addInput blocks while the ring is full, so a slow
+	 * consuming process holds back the producing pipeline.
+	 *
+	 * flushOne completes once the consuming process has taken every input
+	 * out of the ring; flushAll also waits until the source there has
+	 * flushed its own consumers.
+	 *
+	 * If the consuming process exits or closes the ring, the error handler
+	 * is called once, the stage deactivates and any further inputs are
+	 * dropped. A flush that the consuming process does not complete within
+	 * the flush timeout, if one is set, is reported to the error handler
+	 * and given up. The destructor cancels outstanding flushes and waits
+	 * for them to end.
+	 */
+	template<class T>
+	class SharedMemorySink
+		: public IConsumerStage<T>
+		, public IInspectableStage
+	{
+	public:
+#pragma region Constructors and Destructor
+
+		SharedMemorySink(
+			int stageId,
+			const std::wstring& ringName,
+			unsigned int capacity);
+
+		SharedMemorySink(
+			int stageId,
+			const std::wstring& ringName,
+			unsigned int capacity,
+			const std::function<void(int, std::exception_ptr)>& handleErrorFunction);
+
+		SharedMemorySink(const SharedMemorySink<T>& other) = delete;
+
+		~SharedMemorySink();
+
+#pragma endregion
+
+		/*
+		 * Sets how long a flush waits for the consuming process. Zero, the
+		 * default, waits until it answers or goes away.
+		 */
+		void setFlushTimeout(std::chrono::milliseconds flushTimeout);
+
+#pragma region IPipelineStage implementations
+
+		int stageId() const override;
+		bool isActive() override;
+		bool isFlushing() override;
+		void activate() override;
+		concurrency::task<void> deactivate() override;
+		concurrency::task<void> flushOne() override;
+		concurrency::task<void> flushAll() override;
+
+#pragma endregion
+
+#pragma region IConsumerStage implementations
+
+		bool hasInputs() const override;
+		void addInput(T& input) override;
+
+#pragma endregion
+
+#pragma region IInspectableStage implementations
+
+		StageSnapshot snapshot() override;
+		std::vector<std::shared_ptr<IPipelineStage>> consumerStages() override;
+
+#pragma endregion
+
+	private:
+		concurrency::task<void> startFlush(const std::function<bool(std::chrono::steady_clock::time_point)>& waitForFlush);
+
+		template<class Predicate>
+		bool waitForConsumer(Predicate isReady, std::chrono::steady_clock::time_point deadline);
+		void onConsumerLost(typename SharedMemoryRing<T>::WaitResult result);
+		void onError(std::exception_ptr error);
+
+		int m_stageId;
+		std::function<void(int, std::exception_ptr)> m_handleError;
+		SharedMemoryRing<T> m_ring;
+		std::atomic<bool> m_isActive;
+		std::atomic<unsigned int> m_flushes;
+		std::atomic<bool> m_hasLostConsumer;
+		std::atomic<bool> m_isClosing;
+		std::atomic<long long> m_flushTimeoutMilliseconds;
+		std::vector<concurrency::task<void>> m_flushTasks;
+		concurrency::critical_section m_flushTasksLock;
+	};
+
+}}
+
+#include "SharedMemorySink.hpp"
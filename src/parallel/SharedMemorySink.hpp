@@ -0,0 +1,252 @@
+namespace Tools { namespace Parallel {
+
+	template<class T>
+	SharedMemorySink<T>::SharedMemorySink(
+		int stageId,
+		const std::wstring& ringName,
+		unsigned int capacity)
+		: SharedMemorySink<T>(
+			stageId,
+			ringName,
+			capacity,
+			nullptr /*handleErrorFunction*/)
+	{
+	}
+
+	template<class T>
+	SharedMemorySink<T>::SharedMemorySink(
+		int stageId,
+		const std::wstring& ringName,
+		unsigned int capacity,
+		const std::function<void(int, std::exception_ptr)>& handleErrorFunction)
+		: m_stageId(stageId)
+		, m_handleError(handleErrorFunction)
+		, m_ring(ringName, capacity, SharedMemoryRing<T>::Producer)
+		, m_isActive(false)
+		, m_flushes(0)
+		, m_hasLostConsumer(false)
+		, m_isClosing(false)
+		, m_flushTimeoutMilliseconds(0)
+	{
+	}
+
+	template<class T>
+	SharedMemorySink<T>::~SharedMemorySink()
+	{
+		// Flushes run on tasks that use this sink, so they are stopped and
+		// waited for before it goes away
+		m_isClosing = true;
+		m_ring.wake();
+
+		std::vector<concurrency::task<void>> flushTasks;
+		{
+			concurrency::critical_section::scoped_lock lock(m_flushTasksLock);
+			flushTasks.swap(m_flushTasks);
+		}
+
+		for (auto& flushTask : flushTasks)
+		{
+			flushTask.wait();
+		}
+	}
+
+	template<class T>
+	void SharedMemorySink<T>::setFlushTimeout(std::chrono::milliseconds flushTimeout)
+	{
+		if (flushTimeout.count() < 0)
+		{
+			throw std::invalid_argument("A sink requires a flush timeout that is not negative.");
+		}
+
+		m_flushTimeoutMilliseconds.store(flushTimeout.count());
+	}
+
+	template<class T>
+	int SharedMemorySink<T>::stageId() const
+	{
+		return m_stageId;
+	}
+
+	template<class T>
+	bool SharedMemorySink<T>::isActive()
+	{
+		return m_isActive.load();
+	}
+
+	template<class T>
+	bool SharedMemorySink<T>::isFlushing()
+	{
+		return m_flushes.load() > 0;
+	}
+
+	template<class T>
+	void SharedMemorySink<T>::activate()
+	{
+		m_isActive = !m_hasLostConsumer.load();
+	}
+
+	template<class T>
+	concurrency::task<void> SharedMemorySink<T>::deactivate()
+	{
+		m_isActive = false;
+		return concurrency::task_from_result();
+	}
+
+	template<class T>
+	concurrency::task<void> SharedMemorySink<T>::flushOne()
+	{
+		return startFlush([this](std::chrono::steady_clock::time_point deadline)
+		{
+			return waitForConsumer([this]() { return m_ring.isEmpty(); }, deadline);
+		});
+	}
+
+	template<class T>
+	concurrency::task<void> SharedMemorySink<T>::flushAll()
+	{
+		return startFlush([this](std::chrono::steady_clock::time_point deadline)
+		{
+			// The source answers only once it has drained the ring and
+			// flushed its consumers
+			unsigned long long flush = m_ring.requestFlush();
+			return waitForConsumer([this, flush]() { return m_ring.isFlushComplete(flush); }, deadline);
+		});
+	}
+
+	template<class T>
+	bool SharedMemorySink<T>::hasInputs() const
+	{
+		return !m_ring.isEmpty();
+	}
+
+	template<class T>
+	void SharedMemorySink<T>::addInput(T& input)
+	{
+		if (isFlushing() || m_hasLostConsumer.load(std::memory_order_relaxed))
+		{
+			return;
+		}
+
+		if (!m_ring.tryPush(input))
+		{
+			waitForConsumer([this, &input]() { return m_ring.tryPush(input); }, std::chrono::steady_clock::time_point::max());
+		}
+	}
+
+	template<class T>
+	StageSnapshot SharedMemorySink<T>::snapshot()
+	{
+		StageSnapshot snapshot;
+		snapshot.stageId = m_stageId;
+		snapshot.type = typeid(*this).name();
+		snapshot.isActive = isActive();
+		snapshot.isFlushing = isFlushing();
+		snapshot.queueDepth = m_ring.size();
+
+		return snapshot;
+	}
+
+	template<class T>
+	std::vector<std::shared_ptr<IPipelineStage>> SharedMemorySink<T>::consumerStages()
+	{
+		// Its consumer lives in another process
+		return std::vector<std::shared_ptr<IPipelineStage>>();
+	}
+
+	template<class T>
+	concurrency::task<void> SharedMemorySink<T>::startFlush(
+		const std::function<bool(std::chrono::steady_clock::time_point)>& waitForFlush)
+	{
+		long long flushTimeoutMilliseconds = m_flushTimeoutMilliseconds.load();
+		auto deadline = flushTimeoutMilliseconds > 0
+			? std::chrono::steady_clock::now() + std::chrono::milliseconds(flushTimeoutMilliseconds)
+			: std::chrono::steady_clock::time_point::max();
+
+		++m_flushes;
+
+		concurrency::critical_section::scoped_lock lock(m_flushTasksLock);
+
+		// Forget flushes that have already ended
+		m_flushTasks.erase(
+			std::remove_if(m_flushTasks.begin(), m_flushTasks.end(), [](const concurrency::task<void>& flushTask)
+			{
+				return flushTask.is_done();
+			}),
+			m_flushTasks.end());
+
+		auto flushTask = concurrency::create_task([this, waitForFlush, deadline]()
+		{
+			if (!waitForFlush(deadline) && !m_hasLostConsumer.load() && !m_isClosing.load())
+			{
+				onError(std::make_exception_ptr(std::runtime_error("The consuming process did not complete the flush in time.")));
+			}
+
+			--m_flushes;
+		});
+
+		m_flushTasks.push_back(flushTask);
+		return flushTask;
+	}
+
+	template<class T>
+	template<class Predicate>
+	bool SharedMemorySink<T>::waitForConsumer(Predicate isReady, std::chrono::steady_clock::time_point deadline)
+	{
+		while (!m_hasLostConsumer.load() && !m_isClosing.load())
+		{
+			auto now = std::chrono::steady_clock::now();
+			if (now >= deadline)
+			{
+				return false;
+			}
+
+			unsigned int waitMilliseconds = c_sharedMemoryWaitMilliseconds;
+			if (deadline != std::chrono::steady_clock::time_point::max())
+			{
+				long long untilDeadline = static_cast<long long>(std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now).count()) + 1;
+				waitMilliseconds = static_cast<unsigned int>((std::min)(untilDeadline, static_cast<long long>(waitMilliseconds)));
+			}
+
+			auto result = m_ring.waitUntil(isReady, waitMilliseconds);
+
+			if (result == SharedMemoryRing<T>::Ready)
+			{
+				return true;
+			}
+			else if (result != SharedMemoryRing<T>::NotReady)
+			{
+				onConsumerLost(result);
+			}
+		}
+
+		return false;
+	}
+
+	template<class T>
+	void SharedMemorySink<T>::onConsumerLost(typename SharedMemoryRing<T>::WaitResult result)
+	{
+		if (m_hasLostConsumer.exchange(true))
+		{
+			return;
+		}
+
+		m_isActive = false;
+		onError(std::make_exception_ptr(std::runtime_error(result == SharedMemoryRing<T>::PeerExited
+			? "The consuming process has exited."
+			: "The consuming process has closed the ring.")));
+	}
+
+	template<class T>
+	void SharedMemorySink<T>::onError(std::exception_ptr error)
+	{
+		try
+		{
+			if (m_handleError)
+			{
+				m_handleError(m_stageId, error);
+			}
+		}
+		catch (...) {}
+	}
+
+}}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "ConnectableBase.h"
+#include "IInspectableStage.h"
+#include "IPipelineStage.h"
+#include "SharedMemoryRing.h"
+
+#include <concrt.h>
+#include <ppltasks.h>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <typeinfo>
+
+
+namespace Tools { namespace Parallel {
+
+	/*
+	 * SharedMemorySource is the consuming end of a pipeline edge that
+	 * crosses a process boundary. While active it takes the values that a
+	 * SharedMemorySink in the other process puts into the ring and passes
+	 * them to its consumers on a single task.
+	 *
+	 * A flushAll of the sink is carried across the edge: once the ring is
+	 * drained, the source flushes its consumers and then lets the sink's
+	 * flush complete.
+	 *
+	 * When the producing process closes the ring, the source drains it,
+	 * flushes its consumers and deactivates. If the producing process exits
+	 * instead, the error handler is called and the source deactivates.
+	 */
+	template<class T>
+	class SharedMemorySource
+		: public IPipelineStage
+		, public IInspectableStage
+		, public ConnectableBase<T>
+		, public std::enable_shared_from_this<SharedMemorySource<T>>
+	{
+	public:
+#pragma region Constructors and Destructor
+
+		SharedMemorySource(
+			int stageId,
+			const std::wstring& ringName,
+			unsigned int capacity);
+
+		SharedMemorySource(
+			int stageId,
+			const std::wstring& ringName,
+			unsigned int capacity,
+			const std::function<void(int, std::exception_ptr)>& handleErrorFunction);
+
+		~SharedMemorySource();
+
+		SharedMemorySource(const SharedMemorySource<T>& other) = delete;
+
+#pragma endregion
+
+#pragma region IPipelineStage implementations
+
+		int stageId() const override;
+		bool isActive() override;
+		bool isFlushing() override;
+		void activate() override;
+		concurrency::task<void> deactivate() override;
+		concurrency::task<void> flushOne() override;
+		concurrency::task<void> flushAll() override;
+
+#pragma endregion
+
+#pragma region IInspectableStage implementations
+
+		StageSnapshot snapshot() override;
+		std::vector<std::shared_ptr<IPipelineStage>> consumerStages() override;
+
+#pragma endregion
+
+	private:
+		void readValues();
+		bool tryStopReading();
+		void onProducerExited();
+		void onError(std::exception_ptr error);
+
+		int m_stageId;
+		std::function<void(int, std::exception_ptr)> m_handleError;
+		SharedMemoryRing<T> m_ring;
+		std::atomic<bool> m_isScheduled;
+		std::atomic<bool> m_isFlushing;
+		std::atomic<bool> m_isReading;
+		concurrency::task<void> m_readerTask;
+		concurrency::critical_section m_readerTaskLock;
+	};
+
+}}
+
+#include "SharedMemorySource.hpp"
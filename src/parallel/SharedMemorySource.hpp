@@ -0,0 +1,246 @@
+namespace Tools { namespace Parallel {
+
+	template<class T>
+	SharedMemorySource<T>::SharedMemorySource(
+		int stageId,
+		const std::wstring& ringName,
+		unsigned int capacity)
+		: SharedMemorySource<T>(
+			stageId,
+			ringName,
+			capacity,
+			nullptr /*handleErrorFunction*/)
+	{
+	}
+
+	template<class T>
+	SharedMemorySource<T>::SharedMemorySource(
+		int stageId,
+		const std::wstring& ringName,
+		unsigned int capacity,
+		const std::function<void(int, std::exception_ptr)>& handleErrorFunction)
+		: m_stageId(stageId)
+		, m_handleError(handleErrorFunction)
+		, m_ring(ringName, capacity, SharedMemoryRing<T>::Consumer)
+		, m_isScheduled(false)
+		, m_isFlushing(false)
+		, m_isReading(false)
+		, m_readerTask(concurrency::task_from_result())
+	{
+	}
+
+	template<class T>
+	SharedMemorySource<T>::~SharedMemorySource()
+	{
+		deactivate().wait();
+	}
+
+	template<class T>
+	int SharedMemorySource<T>::stageId() const
+	{
+		return m_stageId;
+	}
+
+	template<class T>
+	bool SharedMemorySource<T>::isActive()
+	{
+		return m_isReading.load();
+	}
+
+	template<class T>
+	bool SharedMemorySource<T>::isFlushing()
+	{
+		return m_isFlushing.load();
+	}
+
+	template<class T>
+	void SharedMemorySource<T>::activate()
+	{
+		concurrency::critical_section::scoped_lock lock(m_readerTaskLock);
+		m_isScheduled = true;
+
+		// A reader that is winding down sees the flag again before it stops
+		if (!m_isReading)
+		{
+			m_isReading = true;
+			m_readerTask = concurrency::create_task([this]() { readValues(); });
+		}
+	}
+
+	template<class T>
+	concurrency::task<void> SharedMemorySource<T>::deactivate()
+	{
+		m_isScheduled = false;
+		m_ring.wake();
+
+		concurrency::critical_section::scoped_lock lock(m_readerTaskLock);
+		return m_readerTask;
+	}
+
+	template<class T>
+	concurrency::task<void> SharedMemorySource<T>::flushOne()
+	{
+		concurrency::critical_section::scoped_lock lock(m_readerTaskLock);
+		if (!m_isReading)
+		{
+			return concurrency::task_from_result();
+		}
+
+		m_isFlushing = true;
+		m_ring.wake();
+
+		return m_readerTask;
+	}
+
+	template<class T>
+	concurrency::task<void> SharedMemorySource<T>::flushAll()
+	{
+		auto flushOneTask = flushOne();
+		std::weak_ptr<SharedMemorySource<T>> wpThis(this->shared_from_this());
+
+		auto flushAllTask = flushOneTask.then([wpThis]()
+		{
+			auto spThis = wpThis.lock();
+			if (spThis != nullptr)
+			{
+				return spThis->flushConsumers();
+			}
+			else
+			{
+				return concurrency::task_from_result();
+			}
+		});
+
+		return flushAllTask;
+	}
+
+	template<class T>
+	StageSnapshot SharedMemorySource<T>::snapshot()
+	{
+		StageSnapshot snapshot;
+		snapshot.stageId = m_stageId;
+		snapshot.type = typeid(*this).name();
+		snapshot.isActive = isActive();
+		snapshot.isFlushing = isFlushing();
+		snapshot.queueDepth = m_ring.size();
+		snapshot.workerCount = 1;
+		snapshot.runningWorkers = snapshot.isActive ? 1 : 0;
+
+		return snapshot;
+	}
+
+	template<class T>
+	std::vector<std::shared_ptr<IPipelineStage>> SharedMemorySource<T>::consumerStages()
+	{
+		return ConnectableBase<T>::consumerStages();
+	}
+
+	template<class T>
+	void SharedMemorySource<T>::readValues()
+	{
+		auto hasWork = [this]()
+		{
+			return !m_ring.isEmpty() || m_ring.pendingFlush() != 0 || !m_isScheduled || m_isFlushing;
+		};
+
+		for (;;)
+		{
+			try
+			{
+				T value;
+				unsigned long long flush = 0;
+
+				if (m_ring.tryPop(value))
+				{
+					this->pushToConsumers(value);
+				}
+				else if ((flush = m_ring.pendingFlush()) != 0)
+				{
+					// The sink is flushing past this edge and everything it
+					// sent before has been passed on
+					this->flushConsumers().wait();
+					m_ring.completeFlush(flush);
+				}
+				else if (tryStopReading())
+				{
+					break;
+				}
+				else
+				{
+					auto result = m_ring.waitUntil(hasWork, c_sharedMemoryWaitMilliseconds);
+
+					if (result == SharedMemoryRing<T>::PeerClosed && m_ring.isEmpty())
+					{
+						// Every value the producer pushed is visible once it
+						// has closed, so this is the end of the stream
+						this->flushConsumers().wait();
+						m_isScheduled = false;
+					}
+					else if (result == SharedMemoryRing<T>::PeerExited)
+					{
+						onProducerExited();
+					}
+				}
+			}
+			catch (const DeliveryFailure& failure)
+			{
+				// A source does not retry, so only the consumer's error is reported
+				onError(failure.error());
+			}
+			catch (...)
+			{
+				onError(std::current_exception());
+			}
+		}
+	}
+
+	template<class T>
+	bool SharedMemorySource<T>::tryStopReading()
+	{
+		if (m_isScheduled && !m_isFlushing)
+		{
+			return false;
+		}
+
+		concurrency::critical_section::scoped_lock lock(m_readerTaskLock);
+		if (m_isScheduled && !m_isFlushing)
+		{
+			return false;
+		}
+
+		m_isScheduled = false;
+		m_isFlushing = false;
+		m_isReading = false;
+
+		return true;
+	}
+
+	template<class T>
+	void SharedMemorySource<T>::onProducerExited()
+	{
+		// Pass on whatever the producer published before it went away; a
+		// value it was in the middle of writing is lost
+		T value;
+		while (m_ring.tryPop(value))
+		{
+			this->pushToConsumers(value);
+		}
+
+		m_isScheduled = false;
+		onError(std::make_exception_ptr(std::runtime_error("The producing process has exited.")));
+	}
+
+	template<class T>
+	void SharedMemorySource<T>::onError(std::exception_ptr error)
+	{
+		try
+		{
+			if (m_handleError)
+			{
+				m_handleError(m_stageId, error);
+			}
+		}
+		catch (...) {}
+	}
+
+}}
@@ -0,0 +1,160 @@
+#pragma once
+
+#include <stdexcept>
+
+
+namespace Tools { namespace Parallel {
+
+	/*
+	 * The lifecycle of a pipeline stage, packed into one word so that it can
+	 * be read with a single load and changed with a single compare-and-swap.
+	 *
+	 *   bit 0        scheduled: workers keep running (set by activate,
+	 *                cleared by deactivate and by the last worker to retire)
+	 *   bit 1        flushing: new inputs are refused and workers retire
+	 *                once the queue drains
+	 *   bits 16-31   number of running workers
+	 *   bits 32-47   number of workers the stage should run
+	 *
+	 * The phases idle, running, flushing and stopping are all derived from
+	 * these fields; see phase().
+	 */
+	class StageLifecycle
+	{
+	public:
+		typedef unsigned long long Word;
+
+		enum Phase
+		{
+			Idle,
+			Running,
+			Flushing,
+			Stopping
+		};
+
+		static const unsigned int MaxWorkers = 0xFFFF;
+
+		explicit StageLifecycle(Word word)
+			: m_word(word)
+		{
+		}
+
+		static StageLifecycle initial(unsigned int workerCount)
+		{
+			return StageLifecycle(0).withWorkerCount(workerCount);
+		}
+
+		Word word() const
+		{
+			return m_word;
+		}
+
+		bool isScheduled() const
+		{
+			return (m_word & c_scheduled) != 0;
+		}
+
+		bool isFlushing() const
+		{
+			return (m_word & c_flushing) != 0;
+		}
+
+		unsigned int runningWorkers() const
+		{
+			return static_cast<unsigned int>((m_word >> c_runningWorkersShift) & MaxWorkers);
+		}
+
+		unsigned int workerCount() const
+		{
+			return static_cast<unsigned int>((m_word >> c_workerCountShift) & MaxWorkers);
+		}
+
+		bool isActive() const
+		{
+			return isScheduled() || runningWorkers() > 0;
+		}
+
+		bool shouldWorkerContinue() const
+		{
+			return isScheduled() && runningWorkers() <= workerCount();
+		}
+
+		Phase phase() const
+		{
+			if (isFlushing())
+			{
+				return Flushing;
+			}
+			else if (isScheduled())
+			{
+				return Running;
+			}
+			else
+			{
+				return runningWorkers() > 0 ? Stopping : Idle;
+			}
+		}
+
+		StageLifecycle withScheduled(bool isScheduled) const
+		{
+			return StageLifecycle(isScheduled ? (m_word | c_scheduled) : (m_word & ~c_scheduled));
+		}
+
+		StageLifecycle withFlushing(bool isFlushing) const
+		{
+			return StageLifecycle(isFlushing ? (m_word | c_flushing) : (m_word & ~c_flushing));
+		}
+
+		StageLifecycle withRunningWorkers(unsigned int runningWorkers) const
+		{
+			return withField(c_runningWorkersShift, runningWorkers);
+		}
+
+		StageLifecycle withWorkerCount(unsigned int workerCount) const
+		{
+			return withField(c_workerCountShift, workerCount);
+		}
+
+		/*
+		 * The state after one worker retires. The last worker out returns the
+		 * stage to idle, which also ends any flush.
+		 */
+		StageLifecycle withWorkerRetired() const
+		{
+			StageLifecycle retired = withRunningWorkers(runningWorkers() - 1);
+			return retired.runningWorkers() == 0
+				? retired.withScheduled(false).withFlushing(false)
+				: retired;
+		}
+
+		/*
+		 * The state after an idle worker of a lazy stage parks. Unlike
+		 * retiring, this leaves the stage scheduled even when no worker is
+		 * left, so that the next input starts the workers again.
+		 */
+		StageLifecycle withWorkerParked() const
+		{
+			return withRunningWorkers(runningWorkers() - 1);
+		}
+
+	private:
+		static const Word c_scheduled = 0x1;
+		static const Word c_flushing = 0x2;
+		static const unsigned int c_runningWorkersShift = 16;
+		static const unsigned int c_workerCountShift = 32;
+
+		StageLifecycle withField(unsigned int shift, unsigned int value) const
+		{
+			if (value > MaxWorkers)
+			{
+				throw std::invalid_argument("Too many workers.");
+			}
+
+			Word mask = static_cast<Word>(MaxWorkers) << shift;
+			return StageLifecycle((m_word & ~mask) | (static_cast<Word>(value) << shift));
+		}
+
+		Word m_word;
+	};
+
+}}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+
+namespace Tools { namespace Parallel {
+
+	/*
+	 * A point-in-time view of one stage of a pipeline, as collected by
+	 * inspectPipeline. consumerIds lists the stages its outputs go to.
+	 */
+	struct StageSnapshot
+	{
+		StageSnapshot()
+			: stageId(0)
+			, isActive(false)
+			, isFlushing(false)
+			, queueDepth(0)
+			, workerCount(0)
+			, runningWorkers(0)
+		{
+		}
+
+		int stageId;
+		std::string type;
+		bool isActive;
+		bool isFlushing;
+		size_t queueDepth;
+		unsigned int workerCount;
+		unsigned int runningWorkers;
+		std::vector<int> consumerIds;
+	};
+
+}}
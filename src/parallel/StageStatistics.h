@@ -0,0 +1,45 @@
+#pragma once
+
+#include <chrono>
+
+
+namespace Tools { namespace Parallel {
+
+	/*
+	 * A point-in-time sample of a pipeline stage's load. The counters are
+	 * cumulative since the stage was created; consumers compute rates from
+	 * the difference between two samples.
+	 */
+	struct StageStatistics
+	{
+		StageStatistics()
+			: stageId(0)
+			, queueDepth(0)
+			, workerCount(0)
+			, runningWorkers(0)
+			, inputsAdded(0)
+			, inputsProcessed(0)
+			, processingTime(std::chrono::nanoseconds::zero())
+			, countedInputs(0)
+			, processorCycles(0)
+			, processorTime(std::chrono::nanoseconds::zero())
+		{
+		}
+
+		int stageId;
+		size_t queueDepth;
+		unsigned int workerCount;
+		unsigned int runningWorkers;
+		unsigned long long inputsAdded;
+		unsigned long long inputsProcessed;
+		std::chrono::nanoseconds processingTime;
+
+		// Only stages with processor counters enabled fill these in. They
+		// cover countedInputs of the processed inputs, which may be fewer
+		// than inputsProcessed if a worker could not read its counters.
+		unsigned long long countedInputs;
+		unsigned long long processorCycles;
+		std::chrono::nanoseconds processorTime;
+	};
+
+}}
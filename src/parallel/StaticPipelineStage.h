@@ -0,0 +1,123 @@
+#pragma once
+
+#include "PipelineStageCore.h"
+
+#include <functional>
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+
+namespace Tools { namespace Parallel {
+
+	/*
+	 * StaticPipelineStage is a header-only alternative to PipelineStage for
+	 * pipelines whose topology never changes at runtime. The process function
+	 * is stored by value and the consumers are held by their concrete types,
+	 * so the whole pipeline is a single compile-time type and no call on the
+	 * per-item path goes through a virtual function or std::function.
+	 *
+	 * Each stage still buffers its inputs and processes them on its own task
+	 * using the same machinery as PipelineStageBase.
+	 *
+	 * Stages are built leaf-first with makeStaticStage. A stage whose process
+	 * function returns void is a final stage and cannot have consumers.
+	 */
+	template<class Input, class Function, class... Consumers>
+	class StaticPipelineStage
+		: private PipelineStageCore<StaticPipelineStage<Input, Function, Consumers...>, Input>
+		, public std::enable_shared_from_this<StaticPipelineStage<Input, Function, Consumers...>>
+	{
+		typedef PipelineStageCore<StaticPipelineStage<Input, Function, Consumers...>, Input> Core;
+		friend class PipelineStageCore<StaticPipelineStage<Input, Function, Consumers...>, Input>;
+
+	public:
+		typedef Input InputType;
+		typedef decltype(std::declval<Function&>()(std::declval<Input&>())) OutputType;
+
+#pragma region Constructors and Destructor
+
+		StaticPipelineStage(
+			int stageId,
+			const Function& processInputFunction,
+			const std::function<void(int, std::exception_ptr)>& handleErrorFunction,
+			const std::shared_ptr<Consumers>&... consumers);
+
+		~StaticPipelineStage();
+
+		StaticPipelineStage(const StaticPipelineStage<Input, Function, Consumers...>& other) = delete;
+
+#pragma endregion
+
+#pragma region Stage lifetime
+
+		using Core::stageId;
+		using Core::isActive;
+		using Core::isFlushing;
+		using Core::activate;
+		using Core::deactivate;
+		using Core::flushOne;
+		using Core::workerCount;
+		using Core::setWorkerCount;
+		using Core::setIdleTimeout;
+		using Core::setIdleStrategy;
+		using Core::setProcessorAffinity;
+		using Core::setTracer;
+		using Core::setProcessorCounters;
+		using Core::statistics;
+		using Core::hasInputs;
+		using Core::addInput;
+		using Core::setRetryPolicy;
+		using Core::setDeadLetterStage;
+
+		concurrency::task<void> flushAll();
+		void activateAll();
+		concurrency::task<void> deactivateAll();
+
+#pragma endregion
+
+	private:
+		typedef std::index_sequence_for<Consumers...> ConsumerIndices;
+
+		void processInput(Input& input);
+		void processInput(Input& input, std::true_type /*isFinalStage*/);
+		void processInput(Input& input, std::false_type /*isFinalStage*/);
+
+		template<class Output, size_t... Indices>
+		void passToConsumers(Output& output, std::index_sequence<Indices...>);
+
+		template<size_t... Indices>
+		void activateConsumers(std::index_sequence<Indices...>);
+
+		template<size_t... Indices>
+		std::vector<concurrency::task<void>> flushConsumers(std::index_sequence<Indices...>);
+
+		template<size_t... Indices>
+		std::vector<concurrency::task<void>> deactivateConsumers(std::index_sequence<Indices...>);
+
+		Function m_processInput;
+		std::tuple<std::shared_ptr<Consumers>...> m_consumers;
+	};
+
+	/*
+	 * Creates a StaticPipelineStage that passes its outputs to the given
+	 * consumers. The input type must be given explicitly; everything else is
+	 * deduced.
+	 */
+	template<class Input, class Function, class... Consumers>
+	std::shared_ptr<StaticPipelineStage<Input, typename std::decay<Function>::type, Consumers...>> makeStaticStage(
+		int stageId,
+		Function&& processInputFunction,
+		const std::shared_ptr<Consumers>&... consumers);
+
+	template<class Input, class Function, class... Consumers>
+	std::shared_ptr<StaticPipelineStage<Input, typename std::decay<Function>::type, Consumers...>> makeStaticStage(
+		int stageId,
+		Function&& processInputFunction,
+		const std::function<void(int, std::exception_ptr)>& handleErrorFunction,
+		const std::shared_ptr<Consumers>&... consumers);
+
+}}
+
+#include "StaticPipelineStage.hpp"
@@ -0,0 +1,174 @@
+namespace Tools { namespace Parallel {
+
+	namespace Details
+	{
+		template<bool... Values>
+		struct AllTrue : std::is_same<AllTrue<Values...>, AllTrue<(Values || true)...>>
+		{
+		};
+	}
+
+	template<class Input, class Function, class... Consumers>
+	StaticPipelineStage<Input, Function, Consumers...>::StaticPipelineStage(
+		int stageId,
+		const Function& processInputFunction,
+		const std::function<void(int, std::exception_ptr)>& handleErrorFunction,
+		const std::shared_ptr<Consumers>&... consumers)
+		: Core(stageId, handleErrorFunction)
+		, m_processInput(processInputFunction)
+		, m_consumers(consumers...)
+	{
+		static_assert(!std::is_void<OutputType>::value || sizeof...(Consumers) == 0,
+			"A final StaticPipelineStage cannot have consumers.");
+		static_assert(Details::AllTrue<std::is_same<typename Consumers::InputType, OutputType>::value...>::value,
+			"Every consumer must take the output type of the stage as its input type.");
+
+		bool hasNullConsumer = false;
+		int expand[] = { 0, (hasNullConsumer = hasNullConsumer || consumers == nullptr, 0)... };
+		(void)expand;
+
+		if (hasNullConsumer)
+		{
+			throw std::invalid_argument("Invalid consumer.");
+		}
+	}
+
+	template<class Input, class Function, class... Consumers>
+	StaticPipelineStage<Input, Function, Consumers...>::~StaticPipelineStage()
+	{
+		deactivate().wait();
+	}
+
+	template<class Input, class Function, class... Consumers>
+	concurrency::task<void> StaticPipelineStage<Input, Function, Consumers...>::flushAll()
+	{
+		auto flushOneTask = flushOne();
+		std::weak_ptr<StaticPipelineStage<Input, Function, Consumers...>> wpThis(this->shared_from_this());
+
+		// The dead-letter stage is flushed along with the consumers, once
+		// this stage has drained, since its last inputs may still fail
+		auto deadLetterStage = Core::deadLetterStage();
+		auto flushAllTask = flushOneTask.then([wpThis, deadLetterStage]()
+		{
+			std::vector<concurrency::task<void>> flushTasks;
+			auto spThis = wpThis.lock();
+			if (spThis != nullptr)
+			{
+				flushTasks = spThis->flushConsumers(ConsumerIndices());
+			}
+
+			if (deadLetterStage != nullptr)
+			{
+				flushTasks.push_back(deadLetterStage->flushAll());
+			}
+
+			return concurrency::when_all(flushTasks.begin(), flushTasks.end());
+		});
+
+		return flushAllTask;
+	}
+
+	template<class Input, class Function, class... Consumers>
+	void StaticPipelineStage<Input, Function, Consumers...>::activateAll()
+	{
+		auto deadLetterStage = Core::deadLetterStage();
+		if (deadLetterStage != nullptr)
+		{
+			deadLetterStage->activate();
+		}
+
+		activateConsumers(ConsumerIndices());
+		activate();
+	}
+
+	template<class Input, class Function, class... Consumers>
+	concurrency::task<void> StaticPipelineStage<Input, Function, Consumers...>::deactivateAll()
+	{
+		auto deactivateTasks = deactivateConsumers(ConsumerIndices());
+		deactivateTasks.push_back(deactivate());
+
+		return concurrency::when_all(deactivateTasks.begin(), deactivateTasks.end());
+	}
+
+	template<class Input, class Function, class... Consumers>
+	void StaticPipelineStage<Input, Function, Consumers...>::processInput(Input& input)
+	{
+		processInput(input, std::is_void<OutputType>());
+	}
+
+	template<class Input, class Function, class... Consumers>
+	void StaticPipelineStage<Input, Function, Consumers...>::processInput(Input& input, std::true_type /*isFinalStage*/)
+	{
+		m_processInput(input);
+	}
+
+	template<class Input, class Function, class... Consumers>
+	void StaticPipelineStage<Input, Function, Consumers...>::processInput(Input& input, std::false_type /*isFinalStage*/)
+	{
+		OutputType output = m_processInput(input);
+		passToConsumers(output, ConsumerIndices());
+	}
+
+	template<class Input, class Function, class... Consumers>
+	template<class Output, size_t... Indices>
+	void StaticPipelineStage<Input, Function, Consumers...>::passToConsumers(
+		Output& output,
+		std::index_sequence<Indices...>)
+	{
+		// Pass output to each of the consumers
+		int expand[] = { 0, (std::get<Indices>(m_consumers)->addInput(output), 0)... };
+		(void)expand;
+	}
+
+	template<class Input, class Function, class... Consumers>
+	template<size_t... Indices>
+	void StaticPipelineStage<Input, Function, Consumers...>::activateConsumers(std::index_sequence<Indices...>)
+	{
+		int expand[] = { 0, (std::get<Indices>(m_consumers)->activateAll(), 0)... };
+		(void)expand;
+	}
+
+	template<class Input, class Function, class... Consumers>
+	template<size_t... Indices>
+	std::vector<concurrency::task<void>> StaticPipelineStage<Input, Function, Consumers...>::flushConsumers(
+		std::index_sequence<Indices...>)
+	{
+		return std::vector<concurrency::task<void>> { concurrency::task_from_result(), std::get<Indices>(m_consumers)->flushAll()... };
+	}
+
+	template<class Input, class Function, class... Consumers>
+	template<size_t... Indices>
+	std::vector<concurrency::task<void>> StaticPipelineStage<Input, Function, Consumers...>::deactivateConsumers(
+		std::index_sequence<Indices...>)
+	{
+		return std::vector<concurrency::task<void>> { concurrency::task_from_result(), std::get<Indices>(m_consumers)->deactivateAll()... };
+	}
+
+	template<class Input, class Function, class... Consumers>
+	std::shared_ptr<StaticPipelineStage<Input, typename std::decay<Function>::type, Consumers...>> makeStaticStage(
+		int stageId,
+		Function&& processInputFunction,
+		const std::shared_ptr<Consumers>&... consumers)
+	{
+		return makeStaticStage<Input>(
+			stageId,
+			std::forward<Function>(processInputFunction),
+			nullptr /*handleErrorFunction*/,
+			consumers...);
+	}
+
+	template<class Input, class Function, class... Consumers>
+	std::shared_ptr<StaticPipelineStage<Input, typename std::decay<Function>::type, Consumers...>> makeStaticStage(
+		int stageId,
+		Function&& processInputFunction,
+		const std::function<void(int, std::exception_ptr)>& handleErrorFunction,
+		const std::shared_ptr<Consumers>&... consumers)
+	{
+		return std::make_shared<StaticPipelineStage<Input, typename std::decay<Function>::type, Consumers...>>(
+			stageId,
+			std::forward<Function>(processInputFunction),
+			handleErrorFunction,
+			consumers...);
+	}
+
+}}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "LatencyHistogram.h"
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+
+
+namespace Tools { namespace Parallel {
+
+	/*
+	 * An envelope that carries a value through a pipeline together with the
+	 * time it was ingested and the time it was handed to its current stage.
+	 * Only sampled values carry times; the others skip every clock read.
+	 */
+	template<class T>
+	struct Tracked
+	{
+		Tracked()
+			: value()
+			, isSampled(false)
+		{
+		}
+
+		T value;
+		bool isSampled;
+		std::chrono::steady_clock::time_point ingestTime;
+		std::chrono::steady_clock::time_point enqueueTime;
+	};
+
+	/*
+	 * The latencies recorded by one tracked stage: how long sampled inputs
+	 * waited in its queue and how long it took to process them. A final
+	 * stage also records the end-to-end latency from ingestion.
+	 */
+	struct StageLatency
+	{
+		LatencyHistogram queueWait;
+		LatencyHistogram processing;
+		LatencyHistogram endToEnd;
+	};
+
+	/*
+	 * IngestSampler wraps values in a Tracked envelope as they enter a
+	 * pipeline, stamping one in every samplingInterval of them.
+	 */
+	class IngestSampler
+	{
+	public:
+		explicit IngestSampler(unsigned int samplingInterval)
+			: m_samplingInterval(samplingInterval)
+			, m_ingested(0)
+		{
+			if (samplingInterval == 0)
+			{
+				throw std::invalid_argument("IngestSampler requires a sampling interval of at least one.");
+			}
+		}
+
+		IngestSampler(const IngestSampler& other) = delete;
+
+		template<class T>
+		Tracked<T> track(const T& value)
+		{
+			Tracked<T> tracked;
+			tracked.value = value;
+			tracked.isSampled = m_ingested.fetch_add(1, std::memory_order_relaxed) % m_samplingInterval == 0;
+
+			if (tracked.isSampled)
+			{
+				tracked.ingestTime = std::chrono::steady_clock::now();
+				tracked.enqueueTime = tracked.ingestTime;
+			}
+
+			return tracked;
+		}
+
+	private:
+		unsigned int m_samplingInterval;
+		std::atomic<unsigned long long> m_ingested;
+	};
+
+}}
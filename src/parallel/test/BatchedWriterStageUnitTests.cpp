@@ -0,0 +1,293 @@
+#include "stdafx.h"
+
+#include "..\BatchedWriterStage.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Tools::Parallel;
+using namespace std;
+
+
+namespace Test
+{
+	TEST_CLASS(BatchedWriterStageUnitTests)
+	{
+	public:
+#pragma region constructor
+
+		TEST_METHOD(constructor_WithNullSerializeFunction_ThrowsInvalidArgumentException)
+		{
+			// Arrange
+			TemporaryFile file;
+
+			// Act
+			auto action = [&file]()
+			{
+				BatchedWriterStage<int> stage(0, file.path(), nullptr /*serializeFunction*/);
+			};
+
+			// Assert
+			Assert::ExpectException<invalid_argument>(action);
+		}
+
+#pragma endregion
+
+#pragma region setWorkerCount
+
+		TEST_METHOD(setWorkerCount_WithTwoWorkers_ThrowsInvalidArgumentException)
+		{
+			// Arrange
+			TemporaryFile file;
+			auto stage = make_shared<BatchedWriterStage<int>>(0, file.path(), GetSerializeFunction());
+
+			// Act
+			auto action = [&stage]()
+			{
+				stage->setWorkerCount(2);
+			};
+
+			// Assert
+			Assert::ExpectException<invalid_argument>(action);
+		}
+
+#pragma endregion
+
+#pragma region flushOne
+
+		TEST_METHOD(flushOne_AfterInputs_WritesEveryInputInOrder)
+		{
+			// Arrange
+			TemporaryFile file;
+			auto stage = make_shared<BatchedWriterStage<int>>(0, file.path(), GetSerializeFunction());
+			AddInputs(stage, 100);
+
+			// Act
+			stage->activate();
+			stage->flushOne().wait();
+
+			// Assert
+			Assert::AreEqual(GetExpectedContents(100), file.contents(), L"Every input must be written once the flush completes.");
+		}
+
+		TEST_METHOD(flushOne_SerializeThrowsPartwayOnce_RetriedInputWrittenOnce)
+		{
+			// Arrange
+			TemporaryFile file;
+			bool hasThrown = false;
+			auto serialize = GetSerializeFunction();
+			auto stage = make_shared<BatchedWriterStage<int>>(
+				0,
+				file.path(),
+				[&hasThrown, serialize](int& input, vector<char>& batch)
+				{
+					serialize(input, batch);
+					if (input == 5 && !hasThrown)
+					{
+						hasThrown = true;
+						throw runtime_error("transient");
+					}
+				},
+				c_defaultBatchBytes,
+				FsyncPolicy(),
+				nullptr /*handleErrorFunction*/);
+			stage->setRetryPolicy(RetryPolicy(3 /*maxAttempts*/, chrono::milliseconds(1), chrono::milliseconds(1), 1.0, 0.0));
+			AddInputs(stage, 10);
+
+			// Act
+			stage->activate();
+			stage->flushOne().wait();
+
+			// Assert
+			Assert::IsTrue(hasThrown, L"The serialize function must have failed once.");
+			Assert::AreEqual(GetExpectedContents(10), GetSortedContents(file), L"A retried input must be written exactly once.");
+		}
+
+		TEST_METHOD(flushOne_WithBatchesSmallerThanInputs_WritesEveryInputInOrder)
+		{
+			// Arrange
+			TemporaryFile file;
+			auto stage = make_shared<BatchedWriterStage<int>>(
+				0,
+				file.path(),
+				GetSerializeFunction(),
+				4 /*batchBytes*/,
+				FsyncPolicy(FsyncPolicy::EveryBatch, chrono::milliseconds::zero()),
+				nullptr /*handleErrorFunction*/);
+			AddInputs(stage, 100);
+
+			// Act
+			stage->activate();
+			stage->flushOne().wait();
+
+			// Assert
+			Assert::AreEqual(GetExpectedContents(100), file.contents(), L"Every batch must be written in order.");
+		}
+
+		TEST_METHOD(flushOne_WriteFailsWhileNextBatchFills_WritesEveryInputInOrder)
+		{
+			// Arrange
+			TemporaryFile file;
+			HANDLE lockingFile = CreateFileW(
+				file.path().c_str(),
+				GENERIC_READ,
+				FILE_SHARE_READ | FILE_SHARE_WRITE,
+				nullptr,
+				OPEN_ALWAYS,
+				FILE_ATTRIBUTE_NORMAL,
+				nullptr);
+			OVERLAPPED lockedRange = {};
+			LockFileEx(lockingFile, LOCKFILE_FAIL_IMMEDIATELY, 0, MAXDWORD, MAXDWORD, &lockedRange);
+
+			// The first batch fails as it is written, again while the second
+			// batch fills and once more when the flush starts
+			int errorsCount = 0;
+			auto stage = make_shared<BatchedWriterStage<int>>(
+				0,
+				file.path(),
+				GetSerializeFunction(),
+				2 /*batchBytes*/,
+				FsyncPolicy(),
+				[&errorsCount, lockingFile, &lockedRange](int, exception_ptr)
+				{
+					if (++errorsCount == 3)
+					{
+						UnlockFileEx(lockingFile, 0, MAXDWORD, MAXDWORD, &lockedRange);
+					}
+				});
+			AddInputs(stage, 2);
+
+			// Act
+			stage->activate();
+			stage->flushOne().wait();
+			CloseHandle(lockingFile);
+
+			// Assert
+			Assert::AreEqual(3, errorsCount, L"Every failed write must be reported.");
+			Assert::AreEqual(GetExpectedContents(2), file.contents(), L"A flush must write the inputs held back behind a failed batch.");
+		}
+
+#pragma endregion
+
+#pragma region Destructor
+
+		TEST_METHOD(destructor_AfterInputsProcessed_WritesThem)
+		{
+			// Arrange
+			TemporaryFile file;
+			auto stage = make_shared<BatchedWriterStage<int>>(0, file.path(), GetSerializeFunction());
+			AddInputs(stage, 10);
+			stage->activate();
+			while (stage->hasInputs())
+			{
+				concurrency::wait(1);
+			}
+
+			// Act
+			stage.reset();
+
+			// Assert
+			Assert::AreEqual(GetExpectedContents(10), file.contents(), L"Destroying the stage must write what it has serialized.");
+		}
+
+#pragma endregion
+
+	private:
+#pragma region Test language
+
+		/*
+		 * A file in the working directory that is deleted when it goes out of
+		 * scope, which must be after the stage that writes it.
+		 */
+		class TemporaryFile
+		{
+		public:
+			TemporaryFile()
+			{
+				static atomic<int> s_fileCount(0);
+				m_path = "BatchedWriterStageUnitTests." + to_string(++s_fileCount) + ".tmp";
+				remove(m_path.c_str());
+			}
+
+			~TemporaryFile()
+			{
+				remove(m_path.c_str());
+			}
+
+			wstring path() const
+			{
+				return wstring(m_path.begin(), m_path.end());
+			}
+
+			string contents() const
+			{
+				ostringstream contents;
+				contents << ifstream(m_path, ios::binary).rdbuf();
+				return contents.str();
+			}
+
+		private:
+			string m_path;
+		};
+
+		function<void(int&, vector<char>&)> GetSerializeFunction()
+		{
+			return [](int& input, vector<char>& batch)
+			{
+				auto line = to_string(input) + "\n";
+				batch.insert(batch.end(), line.begin(), line.end());
+			};
+		}
+
+		string GetExpectedContents(int inputsCount)
+		{
+			string contents;
+			for (int i = 0; i < inputsCount; ++i)
+			{
+				contents += to_string(i) + "\n";
+			}
+
+			return contents;
+		}
+
+		/*
+		 * The contents with their lines in input order, since a retried
+		 * input is written after those that were added behind it.
+		 */
+		string GetSortedContents(const TemporaryFile& file)
+		{
+			vector<int> inputs;
+			istringstream lines(file.contents());
+			for (int input; lines >> input;)
+			{
+				inputs.push_back(input);
+			}
+
+			sort(inputs.begin(), inputs.end());
+
+			string contents;
+			for (int input : inputs)
+			{
+				contents += to_string(input) + "\n";
+			}
+
+			return contents;
+		}
+
+		void AddInputs(const shared_ptr<IConsumerStage<int>>& stage, int inputsCount)
+		{
+			for (int i = 0; i < inputsCount; ++i)
+			{
+				stage->addInput(i);
+			}
+		}
+
+#pragma endregion
+	};
+}
@@ -0,0 +1,173 @@
+#include "stdafx.h"
+
+#include "..\BroadcastStage.h"
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <vector>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Tools::Parallel;
+using namespace std;
+
+
+namespace Test
+{
+	TEST_CLASS(BroadcastStageUnitTests)
+	{
+	public:
+#pragma region constructor
+
+		TEST_METHOD(constructor_WithCapacityNotPowerOfTwo_ThrowsInvalidArgumentException)
+		{
+			// Act
+			auto action = []()
+			{
+				BroadcastStage<int> stage(0, 6 /*capacity*/);
+			};
+
+			// Assert
+			Assert::ExpectException<invalid_argument>(action);
+		}
+
+#pragma endregion
+
+#pragma region subscribe
+
+		TEST_METHOD(subscribe_AfterActivate_ThrowsLogicError)
+		{
+			// Arrange
+			auto stage = make_shared<BroadcastStage<int>>(0, 8 /*capacity*/);
+			stage->activate();
+
+			// Act
+			auto action = [&stage]()
+			{
+				stage->subscribe(1, [](const int&) {});
+			};
+
+			// Assert
+			Assert::ExpectException<logic_error>(action);
+			stage->deactivate().wait();
+		}
+
+#pragma endregion
+
+#pragma region addInput
+
+		TEST_METHOD(addInput_ThenFlush_EveryReaderSeesEveryInputInOrder)
+		{
+			// Arrange
+			const int readersCount = 3;
+			vector<vector<int>> received(readersCount);
+			auto stage = make_shared<BroadcastStage<int>>(0, 8 /*capacity*/);
+			for (int reader = 0; reader < readersCount; ++reader)
+			{
+				auto& inputs = received[reader];
+				stage->subscribe(reader, [&inputs](const int& input) { inputs.push_back(input); });
+			}
+
+			stage->activate();
+
+			// Act
+			for (int i = 0; i < 100; ++i)
+			{
+				stage->addInput(i);
+			}
+
+			stage->flushOne().wait();
+
+			// Assert
+			for (int reader = 0; reader < readersCount; ++reader)
+			{
+				Assert::AreEqual(size_t(100), received[reader].size(), L"Every reader must see every input, even when the ring wraps.");
+				for (int i = 0; i < 100; ++i)
+				{
+					Assert::AreEqual(i, received[reader][i], L"Every reader must see the inputs in order.");
+				}
+			}
+
+			Assert::IsFalse(stage->hasInputs(), L"A flushed stage must have no inputs left.");
+			Assert::IsFalse(stage->isActive(), L"A flushed stage must be inactive.");
+		}
+
+		TEST_METHOD(addInput_RingFull_WaitsForSlowestReader)
+		{
+			// Arrange
+			atomic<bool> isReleased(false);
+			atomic<int> fastCount(0);
+			atomic<int> slowCount(0);
+			auto stage = make_shared<BroadcastStage<int>>(0, 4 /*capacity*/);
+			stage->subscribe(1, [&fastCount](const int&) { ++fastCount; });
+			stage->subscribe(2, [&isReleased, &slowCount](const int&)
+			{
+				while (!isReleased)
+				{
+					concurrency::wait(1);
+				}
+
+				++slowCount;
+			});
+			stage->activate();
+
+			// Act
+			auto producer = concurrency::create_task([&stage]()
+			{
+				for (int i = 0; i < 10; ++i)
+				{
+					stage->addInput(i);
+				}
+			});
+
+			concurrency::wait(50);
+			bool isProducerDoneBeforeRelease = producer.is_done();
+			int fastCountBeforeRelease = fastCount;
+
+			isReleased = true;
+			producer.wait();
+			stage->flushOne().wait();
+
+			// Assert
+			Assert::IsFalse(isProducerDoneBeforeRelease, L"A producer must wait while the slowest reader holds the ring full.");
+			Assert::IsTrue(fastCountBeforeRelease <= 4, L"A fast reader cannot run further ahead than the ring allows.");
+			Assert::AreEqual(10, slowCount.load(), L"The slow reader must see every input once released.");
+			Assert::AreEqual(10, fastCount.load(), L"The fast reader must see every input.");
+		}
+
+		TEST_METHOD(addInput_ReaderThrows_ReportsReaderIdAndContinues)
+		{
+			// Arrange
+			int failedReaderId = -1;
+			vector<int> processed;
+			auto stage = make_shared<BroadcastStage<int>>(
+				0,
+				8 /*capacity*/,
+				[&failedReaderId](int readerId, exception_ptr) { failedReaderId = readerId; });
+			stage->subscribe(7, [&processed](const int& input)
+			{
+				if (input == 1)
+				{
+					throw runtime_error("Cannot process input.");
+				}
+
+				processed.push_back(input);
+			});
+			stage->activate();
+
+			// Act
+			for (int i = 0; i < 3; ++i)
+			{
+				stage->addInput(i);
+			}
+
+			stage->flushOne().wait();
+
+			// Assert
+			Assert::AreEqual(7, failedReaderId, L"An error must be reported with the id of the reader that failed.");
+			Assert::AreEqual(size_t(2), processed.size(), L"A reader must move on after an error.");
+		}
+
+#pragma endregion
+	};
+}
@@ -0,0 +1,149 @@
+#include "stdafx.h"
+
+#include "..\ConcurrentLruCache.h"
+
+#include <atomic>
+#include <stdexcept>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Tools::Parallel;
+using namespace std;
+
+
+namespace Test
+{
+	TEST_CLASS(ConcurrentLruCacheUnitTests)
+	{
+	public:
+#pragma region constructor
+
+		TEST_METHOD(constructor_WithZeroCapacity_ThrowsInvalidArgumentException)
+		{
+			// Act
+			auto action = []()
+			{
+				ConcurrentLruCache<int, int> cache(0 /*capacity*/);
+			};
+
+			// Assert
+			Assert::ExpectException<invalid_argument>(action);
+		}
+
+#pragma endregion
+
+#pragma region getOrAdd
+
+		TEST_METHOD(getOrAdd_SameKeyTwice_ComputesOnceAndCountsHit)
+		{
+			// Arrange
+			ConcurrentLruCache<int, int> cache(16 /*capacity*/);
+			int computations = 0;
+			auto compute = [&computations]() { ++computations; return 42; };
+
+			// Act
+			cache.getOrAdd(1, compute);
+			int value = cache.getOrAdd(1, compute);
+
+			// Assert
+			Assert::AreEqual(42, value, L"A cached value must be returned.");
+			Assert::AreEqual(1, computations, L"A cached value must not be computed again.");
+			Assert::AreEqual<unsigned long long>(1, cache.hits(), L"The second lookup must count as a hit.");
+			Assert::AreEqual<unsigned long long>(1, cache.misses(), L"The first lookup must count as a miss.");
+		}
+
+		TEST_METHOD(getOrAdd_BeyondCapacity_EvictsLeastRecentlyUsed)
+		{
+			// Arrange
+			ConcurrentLruCache<int, int> cache(2 /*capacity*/, 1 /*shardCount*/);
+			cache.getOrAdd(1, []() { return 1; });
+			cache.getOrAdd(2, []() { return 2; });
+			cache.getOrAdd(1, []() { return 1; });
+
+			// Act
+			cache.getOrAdd(3, []() { return 3; });
+
+			// Assert
+			int value = 0;
+			Assert::IsTrue(cache.tryGet(1, value), L"A recently used value must be kept.");
+			Assert::IsFalse(cache.tryGet(2, value), L"The least recently used value must be evicted.");
+			Assert::AreEqual<unsigned long long>(1, cache.evictions(), L"The eviction must be counted.");
+			Assert::AreEqual<size_t>(2, cache.size(), L"The cache must not grow beyond its capacity.");
+		}
+
+		TEST_METHOD(getOrAdd_CapacityNotDividedEvenlyByShards_SizeStaysWithinCapacity)
+		{
+			// Arrange
+			ConcurrentLruCache<int, int> cache(10 /*capacity*/, 4 /*shardCount*/);
+
+			// Act
+			for (int key = 0; key < 1000; ++key)
+			{
+				cache.getOrAdd(key, [key]() { return key; });
+			}
+
+			// Assert
+			Assert::IsTrue(cache.size() <= cache.capacity(), L"The cache must not grow beyond its capacity.");
+		}
+
+		TEST_METHOD(getOrAdd_ComputeThrows_RethrowsAndDoesNotCache)
+		{
+			// Arrange
+			ConcurrentLruCache<int, int> cache(16 /*capacity*/);
+			auto action = [&cache]()
+			{
+				cache.getOrAdd(1, []() -> int { throw runtime_error("lookup failed"); });
+			};
+
+			// Act
+			Assert::ExpectException<runtime_error>(action);
+			int value = cache.getOrAdd(1, []() { return 7; });
+
+			// Assert
+			Assert::AreEqual(7, value, L"A failed computation must not be cached.");
+		}
+
+		TEST_METHOD(getOrAdd_SameKeyConcurrently_ComputesOnceAndCoalescesTheOthers)
+		{
+			// Arrange
+			const int callersCount = 8;
+			ConcurrentLruCache<int, int> cache(16 /*capacity*/);
+			atomic<int> computations(0);
+			atomic<bool> isReleased(false);
+			auto compute = [&computations, &isReleased]()
+			{
+				++computations;
+				while (!isReleased)
+				{
+					concurrency::wait(1);
+				}
+
+				return 42;
+			};
+
+			// Act
+			vector<concurrency::task<int>> callers;
+			for (int i = 0; i < callersCount; ++i)
+			{
+				callers.push_back(concurrency::create_task([&cache, compute]() { return cache.getOrAdd(1, compute); }));
+			}
+
+			while (cache.misses() + cache.coalesced() < callersCount)
+			{
+				concurrency::wait(1);
+			}
+
+			isReleased = true;
+
+			// Assert
+			for (auto& caller : callers)
+			{
+				Assert::AreEqual(42, caller.get(), L"Every caller must get the computed value.");
+			}
+
+			Assert::AreEqual(1, computations.load(), L"Concurrent requests for a key must be computed once.");
+			Assert::AreEqual<unsigned long long>(callersCount - 1, cache.coalesced(), L"The other requests must be coalesced.");
+		}
+
+#pragma endregion
+	};
+}
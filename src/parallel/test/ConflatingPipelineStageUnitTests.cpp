@@ -0,0 +1,239 @@
+#include "stdafx.h"
+
+#include "..\ConflatingPipelineStage.h"
+
+#include <atomic>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Tools::Parallel;
+using namespace std;
+
+
+namespace Test
+{
+	typedef pair<int, int> Update;
+
+	TEST_CLASS(ConflatingPipelineStageUnitTests)
+	{
+	public:
+#pragma region constructor
+
+		TEST_METHOD(constructor_WithZeroMaxKeys_ThrowsInvalidArgumentException)
+		{
+			// Act
+			auto keyFunction = GetKeyFunction();
+			auto action = [&keyFunction]()
+			{
+				ConflatingPipelineStage<Update, void, int> stage(0, keyFunction, 0 /*maxKeys*/, [](Update&) {});
+			};
+
+			// Assert
+			Assert::ExpectException<invalid_argument>(action);
+		}
+
+#pragma endregion
+
+#pragma region addInput
+
+		TEST_METHOD(addInput_KeyAlreadyQueued_ReplacesPendingInputInPlace)
+		{
+			// Arrange
+			vector<Update> processed;
+			auto stage = make_shared<ConflatingPipelineStage<Update, void, int>>(
+				0,
+				GetKeyFunction(),
+				16 /*maxKeys*/,
+				[&processed](Update& update) { processed.push_back(update); });
+
+			// Act
+			AddUpdate(stage, 1, 10);
+			AddUpdate(stage, 2, 20);
+			AddUpdate(stage, 1, 11);
+			AddUpdate(stage, 1, 12);
+
+			stage->activate();
+			stage->flushOne().wait();
+
+			// Assert
+			Assert::AreEqual(size_t(2), processed.size(), L"Only the latest input of each key must be processed.");
+			Assert::AreEqual(1, processed[0].first, L"A replaced input must keep its key's place in the queue.");
+			Assert::AreEqual(12, processed[0].second, L"The latest input of a key must win.");
+			Assert::AreEqual(20, processed[1].second, L"An input of another key must be kept.");
+			Assert::AreEqual(2ULL, stage->conflatedCount(), L"Every replaced input must be counted.");
+		}
+
+		TEST_METHOD(addInput_KeyAlreadyQueued_QueueDepthCountsKeyOnce)
+		{
+			// Arrange
+			auto stage = make_shared<ConflatingPipelineStage<Update, void, int>>(
+				0,
+				GetKeyFunction(),
+				16 /*maxKeys*/,
+				[](Update&) {});
+
+			// Act
+			AddUpdate(stage, 1, 10);
+			AddUpdate(stage, 1, 11);
+			AddUpdate(stage, 2, 20);
+
+			// Assert
+			Assert::AreEqual(size_t(2), stage->statistics().queueDepth, L"A replaced input must not count towards the queue depth.");
+		}
+
+		TEST_METHOD(addInput_AfterKeyTaken_QueuesKeyAgain)
+		{
+			// Arrange
+			vector<Update> processed;
+			auto stage = make_shared<ConflatingPipelineStage<Update, void, int>>(
+				0,
+				GetKeyFunction(),
+				16 /*maxKeys*/,
+				[&processed](Update& update) { processed.push_back(update); });
+			AddUpdate(stage, 1, 10);
+			stage->activate();
+			stage->flushOne().wait();
+
+			// Act
+			AddUpdate(stage, 1, 11);
+			stage->activate();
+			stage->flushOne().wait();
+
+			// Assert
+			Assert::AreEqual(size_t(2), processed.size(), L"A key must be queued again once its input was taken.");
+			Assert::AreEqual(0ULL, stage->conflatedCount(), L"An input of a taken key must not count as replaced.");
+		}
+
+		TEST_METHOD(addInput_EveryEntryPendingWhileActive_WaitsForFreeEntry)
+		{
+			// Arrange
+			atomic<bool> isFirstInputTaken(false);
+			atomic<bool> isWorkerReleased(false);
+			vector<Update> processed;
+			auto stage = make_shared<ConflatingPipelineStage<Update, void, int>>(
+				0,
+				GetKeyFunction(),
+				1 /*maxKeys*/,
+				[&](Update& update)
+				{
+					isFirstInputTaken = true;
+					while (!isWorkerReleased)
+					{
+						concurrency::wait(1);
+					}
+
+					processed.push_back(update);
+				});
+			stage->activate();
+			AddUpdate(stage, 0, 0);
+			while (!isFirstInputTaken)
+			{
+				concurrency::wait(1);
+			}
+
+			// Act
+			auto producer = concurrency::create_task([&stage]()
+			{
+				AddUpdate(stage, 1, 1);
+				AddUpdate(stage, 2, 2);
+			});
+
+			concurrency::wait(50);
+			bool isProducerDoneBeforeRelease = producer.is_done();
+
+			isWorkerReleased = true;
+			producer.wait();
+			stage->flushOne().wait();
+
+			// Assert
+			Assert::IsFalse(isProducerDoneBeforeRelease, L"A new key must wait while every entry is pending and the stage is active.");
+			Assert::AreEqual(size_t(3), processed.size(), L"Every key must be processed once an entry is free.");
+			Assert::AreEqual(0ULL, stage->droppedCount(), L"No input must be dropped while the stage is active.");
+		}
+
+		TEST_METHOD(addInput_StageFlushedWhileWaitingForEntry_CountsDroppedInput)
+		{
+			// Arrange
+			atomic<bool> isFirstInputTaken(false);
+			atomic<bool> isWorkerReleased(false);
+			auto stage = make_shared<ConflatingPipelineStage<Update, void, int>>(
+				0,
+				GetKeyFunction(),
+				1 /*maxKeys*/,
+				[&](Update&)
+				{
+					isFirstInputTaken = true;
+					while (!isWorkerReleased)
+					{
+						concurrency::wait(1);
+					}
+				});
+			stage->activate();
+			AddUpdate(stage, 0, 0);
+			while (!isFirstInputTaken)
+			{
+				concurrency::wait(1);
+			}
+
+			AddUpdate(stage, 1, 1);
+			auto producer = concurrency::create_task([&stage]()
+			{
+				AddUpdate(stage, 2, 2);
+			});
+			concurrency::wait(50);
+
+			// Act
+			auto flushed = stage->flushOne();
+			producer.wait();
+			isWorkerReleased = true;
+			flushed.wait();
+
+			// Assert
+			Assert::AreEqual(1ULL, stage->droppedCount(), L"An input still waiting for an entry when the stage starts flushing must be counted as dropped.");
+		}
+
+		TEST_METHOD(addInput_EveryEntryPendingWhileInactive_DropsInput)
+		{
+			// Arrange
+			vector<Update> processed;
+			auto stage = make_shared<ConflatingPipelineStage<Update, void, int>>(
+				0,
+				GetKeyFunction(),
+				2 /*maxKeys*/,
+				[&processed](Update& update) { processed.push_back(update); });
+
+			// Act
+			for (int key = 0; key < 3; ++key)
+			{
+				AddUpdate(stage, key, key);
+			}
+
+			stage->activate();
+			stage->flushOne().wait();
+
+			// Assert
+			Assert::AreEqual(1ULL, stage->droppedCount(), L"A new key that finds every entry pending on an inactive stage must be dropped.");
+			Assert::AreEqual(size_t(2), processed.size(), L"The keys that found an entry must be processed.");
+		}
+
+#pragma endregion
+
+	private:
+#pragma region Test language
+
+		static function<int(Update&)> GetKeyFunction()
+		{
+			return [](Update& update) { return update.first; };
+		}
+
+		static void AddUpdate(const shared_ptr<ConflatingPipelineStage<Update, void, int>>& stage, int key, int value)
+		{
+			Update update(key, value);
+			stage->addInput(update);
+		}
+
+#pragma endregion
+	};
+}
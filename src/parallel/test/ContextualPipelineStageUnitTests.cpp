@@ -0,0 +1,183 @@
+#include "stdafx.h"
+
+#include "fake\FakeConsumerStage.h"
+#include "..\ContextualPipelineStage.h"
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Tools::Parallel;
+using namespace Fake;
+using namespace std;
+
+
+namespace Test
+{
+	TEST_CLASS(ContextualPipelineStageUnitTests)
+	{
+	public:
+#pragma region constructor
+
+		TEST_METHOD(constructor_WithNullCreateContextFunction_ThrowsInvalidArgumentException)
+		{
+			// Act
+			auto action = []()
+			{
+				ContextualPipelineStage<int, int, string>(0, nullptr /*createContextFunction*/, [](int& x, string&) { return x; });
+			};
+
+			// Assert
+			Assert::ExpectException<invalid_argument>(action);
+		}
+
+		TEST_METHOD(constructor_WithNullProcessInputFunction_ThrowsInvalidArgumentException)
+		{
+			// Act
+			auto action = []()
+			{
+				ContextualPipelineStage<int, void, string>(0, []() { return string(); }, nullptr /*processInputFunction*/);
+			};
+
+			// Assert
+			Assert::ExpectException<invalid_argument>(action);
+		}
+
+#pragma endregion
+
+#pragma region processInput
+
+		TEST_METHOD(processInput_OneWorker_CreatesOneContextForEveryInput)
+		{
+			// Arrange
+			atomic<int> contextsCreated(0);
+			auto stage = make_shared<ContextualPipelineStage<int, int, vector<int>>>(
+				0,
+				[&contextsCreated]() { ++contextsCreated; return vector<int>(); },
+				[](int& x, vector<int>& seen) { seen.push_back(x); return static_cast<int>(seen.size()); });
+			auto consumer = make_shared<FakeConsumerStage<int>>(1);
+			stage->connect(consumer);
+			stage->activate();
+
+			// Act
+			for (int i = 0; i < 100; ++i)
+			{
+				stage->addInput(i);
+			}
+
+			stage->flushAll().wait();
+
+			// Assert
+			Assert::AreEqual(1, contextsCreated.load(), L"A single worker must create its context once.");
+			Assert::AreEqual(100, consumer->m_inputs.back(), L"A worker must keep its context from one input to the next.");
+		}
+
+		TEST_METHOD(processInput_SeveralWorkers_CreatesAtMostOneContextPerWorker)
+		{
+			// Arrange
+			atomic<int> contextsCreated(0);
+			atomic<int> outputsCount(0);
+			auto stage = make_shared<ContextualPipelineStage<int, void, string>>(
+				0,
+				[&contextsCreated]() { ++contextsCreated; return string(); },
+				[&outputsCount](int& x, string& buffer) { buffer.assign(static_cast<size_t>(x % 64), 'x'); ++outputsCount; });
+			stage->setWorkerCount(4);
+			stage->activate();
+
+			// Act
+			for (int i = 0; i < 1000; ++i)
+			{
+				stage->addInput(i);
+			}
+
+			stage->flushOne().wait();
+
+			// Assert
+			Assert::AreEqual(1000, outputsCount.load(), L"Every input must be processed.");
+			Assert::IsTrue(contextsCreated.load() <= 4, L"A stage must create at most one context per worker.");
+		}
+
+#pragma endregion
+
+#pragma region flushOne
+
+		TEST_METHOD(flushOne_AfterProcessing_DestroysContexts)
+		{
+			// Arrange
+			mutex contextsLock;
+			vector<weak_ptr<int>> contexts;
+			auto stage = make_shared<ContextualPipelineStage<int, void, shared_ptr<int>>>(
+				0,
+				[&contextsLock, &contexts]()
+				{
+					auto context = make_shared<int>(0);
+					lock_guard<mutex> lock(contextsLock);
+					contexts.push_back(context);
+					return context;
+				},
+				[](int&, shared_ptr<int>& context) { ++*context; });
+			stage->setWorkerCount(2);
+			stage->activate();
+			for (int i = 0; i < 100; ++i)
+			{
+				stage->addInput(i);
+			}
+
+			// Act
+			stage->flushOne().wait();
+
+			// Assert
+			Assert::IsFalse(contexts.empty(), L"Processing must create a context.");
+			for (auto& context : contexts)
+			{
+				Assert::IsTrue(context.expired(), L"A flush must destroy the stage's contexts.");
+			}
+		}
+
+#pragma endregion
+
+#pragma region deactivate
+
+		TEST_METHOD(deactivate_ThenActivate_CreatesFreshContext)
+		{
+			// Arrange
+			atomic<int> contextsCreated(0);
+			atomic<int> lastCount(0);
+			auto stage = make_shared<ContextualPipelineStage<int, void, int>>(
+				0,
+				[&contextsCreated]() { ++contextsCreated; return 0; },
+				[&lastCount](int&, int& count) { lastCount = ++count; });
+			int input = 20;
+			stage->activate();
+			stage->addInput(input);
+			WaitUntilProcessed(stage, 1);
+
+			// Act
+			stage->deactivate().wait();
+			stage->activate();
+			stage->addInput(input);
+			stage->flushOne().wait();
+
+			// Assert
+			Assert::AreEqual(2, contextsCreated.load(), L"A deactivated stage must create its contexts again.");
+			Assert::AreEqual(1, lastCount.load(), L"A fresh context must not carry state from before the deactivation.");
+		}
+
+#pragma endregion
+
+	private:
+#pragma region Test language
+
+		void WaitUntilProcessed(const shared_ptr<IScalableStage>& stage, unsigned long long inputsCount)
+		{
+			while (stage->statistics().inputsProcessed < inputsCount)
+			{
+				concurrency::wait(1);
+			}
+		}
+
+#pragma endregion
+	};
+}
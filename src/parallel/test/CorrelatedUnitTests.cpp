@@ -0,0 +1,198 @@
+#include "stdafx.h"
+
+#include "..\ConflatingPipelineStage.h"
+#include "..\Correlated.h"
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Tools::Parallel;
+using namespace std;
+
+
+namespace Test
+{
+	TEST_CLASS(CorrelatedUnitTests)
+	{
+	public:
+#pragma region Correlated
+
+		TEST_METHOD(Correlated_AnyValue_AddsOnePointerToValue)
+		{
+			// Act
+			size_t envelopeSize = sizeof(Correlated<long long, int>);
+
+			// Assert
+			Assert::AreEqual(sizeof(long long) + sizeof(void*), envelopeSize, L"An envelope must add a single pointer to its value.");
+		}
+
+#pragma endregion
+
+#pragma region submit
+
+		TEST_METHOD(submit_WithNullEntryStage_ThrowsInvalidArgumentException)
+		{
+			// Act
+			auto action = []()
+			{
+				submit<int, string>(nullptr /*entryStage*/, 1);
+			};
+
+			// Assert
+			Assert::ExpectException<invalid_argument>(action);
+		}
+
+		TEST_METHOD(submit_ThroughPipeline_CompletesWithFinalResult)
+		{
+			// Arrange
+			auto entry = makeCorrelatedStage<int, string, string>(0, [](int& x) { return to_string(x * 2); });
+			auto responder = makeRespondingStage<string>(1);
+			entry->connect(responder);
+			entry->activate();
+			responder->activate();
+
+			// Act
+			auto result = submit<int, string>(entry, 21).get();
+
+			// Assert
+			Assert::AreEqual(string("42"), result, L"A call must complete with the result that reaches the responding stage.");
+		}
+
+		TEST_METHOD(submit_ManyConcurrentCalls_EachGetsItsOwnResult)
+		{
+			// Arrange
+			auto entry = makeCorrelatedStage<int, int, int>(0, [](int& x) { return x * x; });
+			entry->setWorkerCount(4);
+			auto responder = makeRespondingStage<int>(1);
+			entry->connect(responder);
+			entry->activate();
+			responder->activate();
+
+			// Act
+			vector<concurrency::task<int>> results;
+			for (int i = 0; i < 200; ++i)
+			{
+				results.push_back(submit<int, int>(entry, i));
+			}
+
+			// Assert
+			for (int i = 0; i < 200; ++i)
+			{
+				Assert::AreEqual(i * i, results[i].get(), L"Every call must complete with the result of its own input.");
+			}
+		}
+
+		TEST_METHOD(submit_StageThrows_FailsWithTheException)
+		{
+			// Arrange
+			bool handleErrorCalled = false;
+			auto entry = makeCorrelatedStage<int, int, int>(
+				0,
+				[](int& x) -> int { if (x < 0) { throw out_of_range("Negative input."); } return x; },
+				[&handleErrorCalled](int, exception_ptr) { handleErrorCalled = true; });
+			auto responder = makeRespondingStage<int>(1);
+			entry->connect(responder);
+			entry->activate();
+			responder->activate();
+
+			// Act
+			auto result = submit<int, int>(entry, -1);
+
+			// Assert
+			Assert::ExpectException<out_of_range>([&result]() { result.get(); }, L"A call must fail with the exception its input caused.");
+			entry->flushAll().wait();
+			Assert::IsTrue(handleErrorCalled, L"The stage's error handler must still see the exception.");
+		}
+
+		TEST_METHOD(submit_StageThrowsOnceWithRetryPolicy_CompletesWithResult)
+		{
+			// Arrange
+			atomic<int> attempts(0);
+			auto entry = makeCorrelatedStage<int, int, int>(
+				0,
+				[&attempts](int& x) -> int { if (attempts++ == 0) { throw runtime_error("Transient failure."); } return x; },
+				[](int, exception_ptr) { });
+			entry->setRetryPolicy(RetryPolicy(2 /*maxAttempts*/, chrono::milliseconds(1), chrono::milliseconds(1), 1.0, 0.0));
+			auto responder = makeRespondingStage<int>(1);
+			entry->connect(responder);
+			entry->activate();
+			responder->activate();
+
+			// Act
+			int result = submit<int, int>(entry, 7).get();
+
+			// Assert
+			Assert::AreEqual(7, result, L"A call must complete with the result of a retry that succeeds.");
+		}
+
+		TEST_METHOD(submit_ToSeveralRespondingStages_CompletesWithFirstResult)
+		{
+			// Arrange
+			auto entry = makeCorrelatedStage<int, int, int>(0, [](int& x) { return x + 1; });
+			auto firstResponder = makeRespondingStage<int>(1);
+			auto secondResponder = makeRespondingStage<int>(2);
+			entry->connect(firstResponder);
+			entry->connect(secondResponder);
+			entry->activate();
+			firstResponder->activate();
+			secondResponder->activate();
+
+			// Act
+			int result = submit<int, int>(entry, 1).get();
+			entry->flushAll().wait();
+
+			// Assert
+			Assert::AreEqual(2, result, L"A call answered by several stages must complete with the first answer.");
+		}
+
+		TEST_METHOD(submit_InputConflatedAway_FailsTheCall)
+		{
+			// Arrange
+			typedef Correlated<int, int> Call;
+			auto entry = make_shared<ConflatingPipelineStage<Call, Call, int>>(
+				0,
+				[](Call&) { return 0; },
+				16 /*maxKeys*/,
+				CorrelatingFunction<int, int, int>([](int& x) { return x; }));
+			auto responder = makeRespondingStage<int>(1);
+			entry->connect(responder);
+			responder->activate();
+
+			// Act
+			auto replacedResult = submit<int, int>(entry, 1);
+			auto latestResult = submit<int, int>(entry, 2);
+			entry->activate();
+
+			// Assert
+			Assert::ExpectException<runtime_error>([&replacedResult]() { replacedResult.get(); }, L"A call whose input was dropped must fail.");
+			Assert::AreEqual(2, latestResult.get(), L"The input that replaced it must still be answered.");
+		}
+
+#pragma endregion
+
+#pragma region makeRespondingStage
+
+		TEST_METHOD(makeRespondingStage_ProcessFunctionThrows_FailsTheCall)
+		{
+			// Arrange
+			auto responder = makeRespondingStage<int>(
+				0,
+				[](int&) { throw runtime_error("Cannot store the result."); },
+				[](int, exception_ptr) { });
+			responder->activate();
+
+			// Act
+			auto result = submit<int, int>(responder, 5);
+
+			// Assert
+			Assert::ExpectException<runtime_error>([&result]() { result.get(); }, L"A call must fail if the responding stage's function throws.");
+		}
+
+#pragma endregion
+
+	};
+}
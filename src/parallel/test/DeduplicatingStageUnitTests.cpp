@@ -0,0 +1,101 @@
+#include "stdafx.h"
+
+#include "fake\FakeConsumerStage.h"
+#include "..\DeduplicatingStage.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Tools::Parallel;
+using namespace Fake;
+using namespace std;
+
+
+namespace Test
+{
+	TEST_CLASS(DeduplicatingStageUnitTests)
+	{
+	public:
+#pragma region constructor
+
+		TEST_METHOD(constructor_WithNullKeyFunction_ThrowsInvalidArgumentException)
+		{
+			// Act
+			auto action = []()
+			{
+				DeduplicatingStage<int, int> stage(0, nullptr /*keyFunction*/, DedupPolicy::exact(DedupPolicy::LastInputs, 10));
+			};
+
+			// Assert
+			Assert::ExpectException<invalid_argument>(action);
+		}
+
+#pragma endregion
+
+#pragma region processInput
+
+		TEST_METHOD(processInput_ExactWithDuplicates_PassesEachKeyOnce)
+		{
+			// Arrange
+			auto stage = GetStage(DedupPolicy::exact(DedupPolicy::LastInputs, 1000));
+			auto consumer = make_shared<FakeConsumerStage<int>>(1);
+			stage->connect(consumer);
+
+			// Act
+			ProcessInputs(stage, { 1, 2, 1, 3, 2, 1 });
+
+			// Assert
+			Assert::AreEqual(3, static_cast<int>(consumer->m_inputs.size()), L"Only the first input of each key may pass.");
+			Assert::AreEqual<unsigned long long>(3, stage->droppedCount(), L"Every duplicate must be counted.");
+		}
+
+		TEST_METHOD(processInput_ExactWithDuplicateBeyondHorizon_PassesItAgain)
+		{
+			// Arrange
+			auto stage = GetStage(DedupPolicy::exact(DedupPolicy::LastInputs, 2));
+			auto consumer = make_shared<FakeConsumerStage<int>>(1);
+			stage->connect(consumer);
+
+			// Act
+			ProcessInputs(stage, { 1, 2, 3, 1 });
+
+			// Assert
+			Assert::AreEqual(4, static_cast<int>(consumer->m_inputs.size()), L"A key last seen before the horizon must pass again.");
+		}
+
+		TEST_METHOD(processInput_ApproximateWithDuplicates_DropsEveryDuplicate)
+		{
+			// Arrange
+			auto stage = GetStage(DedupPolicy::approximate(DedupPolicy::LastPeriod, 60000, 10000, 0.01));
+			auto consumer = make_shared<FakeConsumerStage<int>>(1);
+			stage->connect(consumer);
+
+			// Act
+			ProcessInputs(stage, { 5, 6, 5, 5, 6 });
+
+			// Assert
+			Assert::AreEqual<unsigned long long>(3, stage->droppedCount(), L"A duplicate within the horizon must always be dropped.");
+		}
+
+#pragma endregion
+
+	private:
+#pragma region Test language
+
+		shared_ptr<DeduplicatingStage<int, int>> GetStage(const DedupPolicy& policy)
+		{
+			return make_shared<DeduplicatingStage<int, int>>(0, [](int& x) { return x; }, policy);
+		}
+
+		void ProcessInputs(const shared_ptr<DeduplicatingStage<int, int>>& stage, const vector<int>& inputs)
+		{
+			for (auto input : inputs)
+			{
+				stage->addInput(input);
+			}
+
+			stage->activate();
+			stage->flushOne().wait();
+		}
+
+#pragma endregion
+	};
+}
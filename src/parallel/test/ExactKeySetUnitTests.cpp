@@ -0,0 +1,75 @@
+#include "stdafx.h"
+
+#include "..\ExactKeySet.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Tools::Parallel;
+using namespace std;
+
+
+namespace Test
+{
+	TEST_CLASS(ExactKeySetUnitTests)
+	{
+	public:
+#pragma region insert
+
+		TEST_METHOD(insert_KeyWithinHorizon_ReturnsFalse)
+		{
+			// Arrange
+			ExactKeySet<int> keys(10 /*horizon*/);
+			keys.insert(7, 7 /*hash*/, 0 /*stamp*/);
+
+			// Act
+			bool isInserted = keys.insert(7, 7 /*hash*/, 9 /*stamp*/);
+
+			// Assert
+			Assert::IsFalse(isInserted, L"A key recorded within the horizon must be reported.");
+		}
+
+		TEST_METHOD(insert_KeyBeyondHorizon_ReturnsTrue)
+		{
+			// Arrange
+			ExactKeySet<int> keys(10 /*horizon*/);
+			keys.insert(7, 7 /*hash*/, 0 /*stamp*/);
+
+			// Act
+			bool isInserted = keys.insert(7, 7 /*hash*/, 10 /*stamp*/);
+
+			// Assert
+			Assert::IsTrue(isInserted, L"A key recorded before the horizon must be forgotten.");
+		}
+
+		TEST_METHOD(insert_KeysWithSameHash_TellsThemApart)
+		{
+			// Arrange
+			ExactKeySet<int> keys(10 /*horizon*/);
+			keys.insert(1, 42 /*hash*/, 0 /*stamp*/);
+
+			// Act
+			bool isInserted = keys.insert(2, 42 /*hash*/, 1 /*stamp*/);
+
+			// Assert
+			Assert::IsTrue(isInserted, L"Keys that only share a hash must not be confused.");
+			Assert::IsFalse(keys.insert(1, 42 /*hash*/, 2 /*stamp*/), L"The first key must still be found.");
+		}
+
+		TEST_METHOD(insert_ManyKeysOverSlidingHorizon_StaysProportionalToLiveKeys)
+		{
+			// Arrange
+			const unsigned long long horizon = 100;
+			ExactKeySet<unsigned long long> keys(horizon);
+
+			// Act
+			for (unsigned long long i = 0; i < 100000; ++i)
+			{
+				keys.insert(i, i * 0x9e3779b97f4a7c15ULL /*hash*/, i /*stamp*/);
+			}
+
+			// Assert
+			Assert::IsTrue(keys.capacity() <= 8 * horizon, L"Expired keys must not make the table grow.");
+		}
+
+#pragma endregion
+	};
+}
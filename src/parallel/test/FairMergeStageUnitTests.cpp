@@ -0,0 +1,188 @@
+#include "stdafx.h"
+
+#include "..\FairMergeStage.h"
+
+#include <atomic>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Tools::Parallel;
+using namespace std;
+
+
+namespace Test
+{
+	TEST_CLASS(FairMergeStageUnitTests)
+	{
+	public:
+#pragma region makeSourceLane
+
+		TEST_METHOD(makeSourceLane_WithZeroShare_ThrowsInvalidArgumentException)
+		{
+			// Arrange
+			auto stage = make_shared<FairMergeStage<int, void>>(0, [](int&) {});
+
+			// Act
+			auto action = [&stage]()
+			{
+				makeSourceLane(stage, 1 /*sourceId*/, 0 /*share*/);
+			};
+
+			// Assert
+			Assert::ExpectException<invalid_argument>(action);
+		}
+
+		TEST_METHOD(makeSourceLane_SameSourceTwice_ThrowsInvalidArgumentException)
+		{
+			// Arrange
+			auto stage = make_shared<FairMergeStage<int, void>>(0, [](int&) {});
+			makeSourceLane(stage, 1 /*sourceId*/, 1 /*share*/);
+
+			// Act
+			auto action = [&stage]()
+			{
+				makeSourceLane(stage, 1 /*sourceId*/, 1 /*share*/);
+			};
+
+			// Assert
+			Assert::ExpectException<invalid_argument>(action);
+		}
+
+#pragma endregion
+
+#pragma region addInput
+
+		TEST_METHOD(addInput_BusyLanes_DrainsThemInProportionToShares)
+		{
+			// Arrange
+			string order;
+			auto stage = make_shared<FairMergeStage<char, void>>(0, [&order](char& input) { order.push_back(input); });
+			auto heavyLane = makeSourceLane(stage, 1 /*sourceId*/, 3 /*share*/);
+			auto lightLane = makeSourceLane(stage, 2 /*sourceId*/, 1 /*share*/);
+			AddInputs(heavyLane, 'H', 30);
+			AddInputs(lightLane, 'L', 30);
+
+			// Act
+			stage->activate();
+			stage->flushOne().wait();
+
+			// Assert
+			Assert::AreEqual(size_t(60), order.size(), L"Every input of every lane must be processed.");
+			Assert::AreEqual(string("HHHLHHHLHHHLHHHL"), order.substr(0, 16), L"Busy lanes must take turns in proportion to their shares.");
+		}
+
+		TEST_METHOD(addInput_ChattySource_DoesNotHoldBackQuietSource)
+		{
+			// Arrange
+			string order;
+			auto stage = make_shared<FairMergeStage<char, void>>(0, [&order](char& input) { order.push_back(input); });
+			auto chattyLane = makeSourceLane(stage, 1 /*sourceId*/, 1 /*share*/);
+			auto quietLane = makeSourceLane(stage, 2 /*sourceId*/, 1 /*share*/);
+			AddInputs(chattyLane, 'C', 1000);
+			AddInputs(quietLane, 'Q', 2);
+
+			// Act
+			stage->activate();
+			stage->flushOne().wait();
+
+			// Assert
+			Assert::AreEqual(size_t(1002), order.size(), L"Every input must be processed.");
+			Assert::IsTrue(order.find_last_of('Q') < 4, L"A quiet source must not wait behind a chatty one.");
+		}
+
+		TEST_METHOD(addInput_FromUpstreamStagesAndDirectly_ReachesMergeStage)
+		{
+			// Arrange
+			vector<int> processed;
+			auto stage = make_shared<FairMergeStage<int, void>>(0, [&processed](int& input) { processed.push_back(input); });
+			auto first = make_shared<PipelineStage<int, int>>(1, [](int& input) { return input; });
+			auto second = make_shared<PipelineStage<int, int>>(2, [](int& input) { return input + 100; });
+			first->connect(makeSourceLane(stage, first->stageId(), 1 /*share*/));
+			second->connect(makeSourceLane(stage, second->stageId(), 1 /*share*/));
+
+			// Act
+			for (int i = 0; i < 10; ++i)
+			{
+				first->addInput(i);
+				second->addInput(i);
+			}
+
+			int input = 1000;
+			stage->addInput(input);
+
+			first->activate();
+			second->activate();
+			stage->activate();
+			first->flushOne().wait();
+			second->flushOne().wait();
+			stage->flushOne().wait();
+
+			// Assert
+			Assert::AreEqual(size_t(21), processed.size(), L"Inputs from every lane and from the stage itself must be processed.");
+		}
+
+		TEST_METHOD(addInput_ManyWorkers_ProcessesEveryInputOnce)
+		{
+			// Arrange
+			atomic<int> processedCount(0);
+			atomic<int> processedSum(0);
+			auto stage = make_shared<FairMergeStage<int, void>>(0, [&](int& input)
+			{
+				++processedCount;
+				processedSum += input;
+			});
+			auto firstLane = makeSourceLane(stage, 1 /*sourceId*/, 2 /*share*/);
+			auto secondLane = makeSourceLane(stage, 2 /*sourceId*/, 1 /*share*/);
+			stage->setWorkerCount(4);
+
+			// Act
+			stage->activate();
+			for (int i = 1; i <= 100; ++i)
+			{
+				firstLane->addInput(i);
+				secondLane->addInput(i);
+			}
+
+			stage->flushOne().wait();
+
+			// Assert
+			Assert::AreEqual(200, processedCount.load(), L"Every input must be processed once.");
+			Assert::AreEqual(2 * 5050, processedSum.load(), L"No input must be lost or processed twice.");
+			Assert::IsFalse(stage->hasInputs(), L"A drained stage must have no inputs.");
+		}
+
+#pragma endregion
+
+#pragma region hasInputs
+
+		TEST_METHOD(hasInputs_InputInSourceLane_ReturnsTrue)
+		{
+			// Arrange
+			auto stage = make_shared<FairMergeStage<char, void>>(0, [](char&) {});
+			auto lane = makeSourceLane(stage, 1 /*sourceId*/, 1 /*share*/);
+
+			// Act
+			AddInputs(lane, 'A', 1);
+
+			// Assert
+			Assert::IsTrue(lane->hasInputs(), L"An input waiting in a source lane must be seen.");
+		}
+
+#pragma endregion
+
+	private:
+#pragma region Test language
+
+		static void AddInputs(const shared_ptr<SourceLane<char, void>>& lane, char input, int count)
+		{
+			for (int i = 0; i < count; ++i)
+			{
+				lane->addInput(input);
+			}
+		}
+
+#pragma endregion
+	};
+}
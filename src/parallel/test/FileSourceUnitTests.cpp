@@ -0,0 +1,152 @@
+#include "stdafx.h"
+
+#include "fake\FakeConsumerStage.h"
+#include "..\FileSource.h"
+
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Tools::Parallel;
+using namespace Fake;
+using namespace std;
+
+
+namespace Test
+{
+	TEST_CLASS(FileSourceUnitTests)
+	{
+	public:
+#pragma region constructor
+
+		TEST_METHOD(constructor_WithMissingFile_ThrowsSystemError)
+		{
+			// Act
+			auto action = []()
+			{
+				FileSource<string> source(0, L"FileSourceUnitTests.missing");
+			};
+
+			// Assert
+			Assert::ExpectException<system_error>(action);
+		}
+
+#pragma endregion
+
+#pragma region activate
+
+		TEST_METHOD(activate_WithNewlineFraming_PassesEachLineToConsumers)
+		{
+			// Arrange
+			TemporaryFile file("first\nsecond\r\n\nlast");
+			auto source = make_shared<FileSource<string>>(0, file.path());
+			auto consumer = make_shared<FakeConsumerStage<string>>(1);
+			source->connect(consumer);
+
+			// Act
+			source->activate();
+			source->whenComplete().wait();
+
+			// Assert
+			Assert::AreEqual<size_t>(4, consumer->m_inputs.size(), L"Every line must be passed on, including empty ones.");
+			Assert::AreEqual(string("first"), consumer->m_inputs[0], L"A line must not include its line break.");
+			Assert::AreEqual(string("second"), consumer->m_inputs[1], L"A line must not include its carriage return.");
+			Assert::AreEqual(string(""), consumer->m_inputs[2], L"An empty line must be passed on as an empty record.");
+			Assert::AreEqual(string("last"), consumer->m_inputs[3], L"The last line need not end with a line break.");
+		}
+
+		TEST_METHOD(activate_WithLengthPrefixedFraming_PassesViewsOfEachRecord)
+		{
+			// Arrange
+			TemporaryFile file(string("\x03\0\0\0" "abc" "\x02\0\0\0" "de", 13));
+			auto source = make_shared<FileSource<RecordView, LengthPrefixedFraming>>(0, file.path(), LengthPrefixedFraming(), nullptr);
+			auto consumer = make_shared<FakeConsumerStage<RecordView>>(1);
+			source->connect(consumer);
+
+			// Act
+			source->activate();
+			source->whenComplete().wait();
+
+			// Assert
+			Assert::AreEqual<size_t>(2, consumer->m_inputs.size(), L"Every record must be passed on.");
+			Assert::AreEqual(string("abc"), string(consumer->m_inputs[0].data, consumer->m_inputs[0].size), L"A view must cover its record.");
+			Assert::AreEqual(string("de"), string(consumer->m_inputs[1].data, consumer->m_inputs[1].size), L"A view must cover its record.");
+		}
+
+		TEST_METHOD(activate_WithTruncatedFixedSizeRecord_CallsErrorHandlerAndFlushes)
+		{
+			// Arrange
+			TemporaryFile file("aaaabbbbcc");
+			int errorsCount = 0;
+			auto handleError = [&errorsCount](int, exception_ptr) { ++errorsCount; };
+			auto source = make_shared<FileSource<string, FixedSizeFraming>>(0, file.path(), FixedSizeFraming(4), handleError);
+			auto consumer = make_shared<FakeConsumerStage<string>>(1);
+			source->connect(consumer);
+
+			// Act
+			source->activate();
+			source->whenComplete().wait();
+
+			// Assert
+			Assert::AreEqual<size_t>(2, consumer->m_inputs.size(), L"The complete records must be passed on.");
+			Assert::AreEqual(1, errorsCount, L"The truncated record must be reported.");
+			Assert::IsTrue(consumer->m_isFlushingAll, L"The consumers must still be flushed.");
+		}
+
+		TEST_METHOD(activate_AtEndOfFile_ActivatesAndFlushesConsumers)
+		{
+			// Arrange
+			TemporaryFile file("");
+			auto source = make_shared<FileSource<string>>(0, file.path());
+			auto consumer = make_shared<FakeConsumerStage<string>>(1);
+			source->connect(consumer);
+
+			// Act
+			source->activate();
+			source->whenComplete().wait();
+
+			// Assert
+			Assert::IsTrue(consumer->m_isActive, L"Activating the source must activate its consumers.");
+			Assert::IsTrue(consumer->m_isFlushingAll, L"Reaching the end of the file must flush the consumers.");
+			Assert::IsTrue(source->isAtEndOfFile(), L"The source must report the end of the file.");
+			Assert::IsFalse(source->isActive(), L"The source must deactivate at the end of the file.");
+		}
+
+#pragma endregion
+
+	private:
+#pragma region Test language
+
+		/*
+		 * A file in the working directory that is deleted when it goes out of
+		 * scope, which must be after the source that reads it.
+		 */
+		class TemporaryFile
+		{
+		public:
+			explicit TemporaryFile(const string& contents)
+			{
+				static atomic<int> s_fileCount(0);
+				m_path = "FileSourceUnitTests." + to_string(++s_fileCount) + ".tmp";
+				ofstream(m_path, ios::binary) << contents;
+			}
+
+			~TemporaryFile()
+			{
+				remove(m_path.c_str());
+			}
+
+			wstring path() const
+			{
+				return wstring(m_path.begin(), m_path.end());
+			}
+
+		private:
+			string m_path;
+		};
+
+#pragma endregion
+	};
+}
@@ -0,0 +1,102 @@
+#include "stdafx.h"
+
+#include "..\IdleStrategy.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Tools::Parallel;
+using namespace std;
+
+
+namespace Test
+{
+	TEST_CLASS(IdleStrategyUnitTests)
+	{
+	public:
+#pragma region pause
+
+		TEST_METHOD(pause_Default_NeverPauses)
+		{
+			// Arrange
+			IdleStrategy idleStrategy;
+
+			// Act
+			bool paused = idleStrategy.pause(0);
+
+			// Assert
+			Assert::IsFalse(paused, L"The default strategy must wait on the first idle attempt.");
+		}
+
+		TEST_METHOD(pause_BusySpin_AlwaysPauses)
+		{
+			// Arrange
+			auto idleStrategy = IdleStrategy::busySpin();
+
+			// Act
+			bool paused = idleStrategy.pause(0) && idleStrategy.pause(1000000);
+
+			// Assert
+			Assert::IsTrue(paused, L"A busy-spinning worker must never wait.");
+		}
+
+		TEST_METHOD(pause_SpinThenYield_AlwaysPauses)
+		{
+			// Arrange
+			auto idleStrategy = IdleStrategy::spinThenYield(10);
+
+			// Act
+			bool paused = idleStrategy.pause(0) && idleStrategy.pause(10) && idleStrategy.pause(1000000);
+
+			// Assert
+			Assert::IsTrue(paused, L"A worker that yields after spinning must never wait.");
+		}
+
+		TEST_METHOD(pause_SpinThenPark_WaitsAfterSpinsAndYields)
+		{
+			// Arrange
+			auto idleStrategy = IdleStrategy::spinThenPark(10, 5, 1);
+
+			// Act
+			int pausesCount = 0;
+			for (unsigned int attempt = 0; attempt < 100; ++attempt)
+			{
+				pausesCount += idleStrategy.pause(attempt) ? 1 : 0;
+			}
+
+			// Assert
+			Assert::AreEqual(15, pausesCount, L"The worker must pause for its spins and yields and then wait.");
+			Assert::IsFalse(idleStrategy.pause(15), L"The worker must wait once it has spun and yielded.");
+		}
+
+#pragma endregion
+
+#pragma region parkMilliseconds
+
+		TEST_METHOD(parkMilliseconds_SpinThenPark_CappedByStage)
+		{
+			// Arrange
+			auto idleStrategy = IdleStrategy::spinThenPark(0, 0, 50);
+
+			// Act
+			unsigned int parkMilliseconds = idleStrategy.parkMilliseconds(10);
+
+			// Assert
+			Assert::AreEqual(10U, parkMilliseconds, L"A worker must not wait longer than its stage allows.");
+			Assert::AreEqual(1U, IdleStrategy::spinThenPark(0, 0, 1).parkMilliseconds(10), L"A worker must wait as long as the strategy asks.");
+		}
+
+		TEST_METHOD(parkMilliseconds_Default_WaitsAsLongAsStageAllows)
+		{
+			// Arrange
+			IdleStrategy idleStrategy;
+
+			// Act
+			unsigned int parkMilliseconds = idleStrategy.parkMilliseconds(10);
+
+			// Assert
+			Assert::AreEqual(10U, parkMilliseconds, L"The default strategy must wait as long as the stage allows.");
+		}
+
+#pragma endregion
+
+	};
+}
@@ -0,0 +1,177 @@
+#include "stdafx.h"
+
+#include "fake\FakeConsumerStage.h"
+#include "..\JournalReplayer.h"
+#include "..\JournalingStage.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Tools::Parallel;
+using namespace Fake;
+using namespace std;
+
+
+namespace Test
+{
+	TEST_CLASS(JournalReplayerUnitTests)
+	{
+	public:
+#pragma region constructor
+
+		TEST_METHOD(constructor_WithNullDeserializeFunction_ThrowsInvalidArgumentException)
+		{
+			// Act
+			auto action = []()
+			{
+				JournalReplayer<int> replayer(L"any.journal", nullptr /*deserializeFunction*/);
+			};
+
+			// Assert
+			Assert::ExpectException<invalid_argument>(action);
+		}
+
+#pragma endregion
+
+#pragma region replay
+
+		TEST_METHOD(replay_AsFastAsPossible_FeedsJournaledInputsInOrder)
+		{
+			// Arrange
+			TemporaryFile file;
+			{
+				auto journaling = make_shared<JournalingStage<int>>(make_shared<FakeConsumerStage<int>>(0), file.path(), GetSerializeFunction());
+				journaling->activate();
+				for (int i = 0; i < 100; ++i)
+				{
+					journaling->addInput(i);
+				}
+
+				journaling->flushOne().wait();
+			}
+
+			auto target = make_shared<FakeConsumerStage<int>>(1);
+			JournalReplayer<int> replayer(file.path(), GetDeserializeFunction());
+
+			// Act
+			auto report = replayer.replay(target, JournalReplayer<int>::AsFastAsPossible).get();
+
+			// Assert
+			Assert::AreEqual(100ULL, report.inputsReplayed, L"Every journaled input must be replayed.");
+			Assert::AreEqual(100, static_cast<int>(target->m_inputs.size()), L"Every journaled input must reach the target.");
+			for (int i = 0; i < 100; ++i)
+			{
+				Assert::AreEqual(i, target->m_inputs[i], L"Inputs must be replayed in the order they were journaled.");
+			}
+
+			Assert::IsTrue(target->m_isFlushingAll, L"The target must be flushed once the journal is replayed.");
+			Assert::IsTrue(report.throughput() > 0.0, L"A replay must report its throughput.");
+		}
+
+		TEST_METHOD(replay_AtRecordedPace_KeepsInterArrivalTimes)
+		{
+			// Arrange
+			TemporaryFile file;
+			string journal;
+			AppendRecord(journal, 1000000000LL, 1);
+			AppendRecord(journal, 1000000000LL + 60000000LL, 2);
+			AppendRecord(journal, 1000000000LL + 60000000LL, 3);
+			file.write(journal);
+
+			auto target = make_shared<FakeConsumerStage<int>>(1);
+			JournalReplayer<int> replayer(file.path(), GetDeserializeFunction());
+
+			// Act
+			auto report = replayer.replay(target, JournalReplayer<int>::Recorded).get();
+
+			// Assert
+			Assert::AreEqual(3, static_cast<int>(target->m_inputs.size()), L"Every journaled input must reach the target.");
+			Assert::IsTrue(report.elapsed >= chrono::milliseconds(60), L"A paced replay must keep the recorded gaps between inputs.");
+			Assert::AreEqual(3ULL, report.lateness->count(), L"A paced replay must record the lateness of every input.");
+		}
+
+		TEST_METHOD(replay_EmptyJournal_ReportsNothingReplayed)
+		{
+			// Arrange
+			TemporaryFile file;
+			file.write(string());
+			auto target = make_shared<FakeConsumerStage<int>>(1);
+			JournalReplayer<int> replayer(file.path(), GetDeserializeFunction());
+
+			// Act
+			auto report = replayer.replay(target, JournalReplayer<int>::Recorded).get();
+
+			// Assert
+			Assert::AreEqual(0ULL, report.inputsReplayed, L"An empty journal has nothing to replay.");
+			Assert::AreEqual(0.0, report.throughput(), L"An empty replay must report no throughput.");
+		}
+
+#pragma endregion
+
+	private:
+#pragma region Test language
+
+		class TemporaryFile
+		{
+		public:
+			TemporaryFile()
+			{
+				static atomic<int> s_fileCount(0);
+				m_path = "JournalReplayerUnitTests." + to_string(++s_fileCount) + ".tmp";
+				remove(m_path.c_str());
+			}
+
+			~TemporaryFile()
+			{
+				remove(m_path.c_str());
+			}
+
+			wstring path() const
+			{
+				return wstring(m_path.begin(), m_path.end());
+			}
+
+			void write(const string& contents) const
+			{
+				ofstream(m_path, ios::binary) << contents;
+			}
+
+		private:
+			string m_path;
+		};
+
+		void AppendRecord(string& journal, long long arrivalNanoseconds, int input)
+		{
+			uint32_t size = sizeof(input);
+			journal.append(reinterpret_cast<const char*>(&arrivalNanoseconds), sizeof(arrivalNanoseconds));
+			journal.append(reinterpret_cast<const char*>(&size), sizeof(size));
+			journal.append(reinterpret_cast<const char*>(&input), sizeof(input));
+		}
+
+		function<void(int&, vector<char>&)> GetSerializeFunction()
+		{
+			return [](int& input, vector<char>& buffer)
+			{
+				const char* bytes = reinterpret_cast<const char*>(&input);
+				buffer.insert(buffer.end(), bytes, bytes + sizeof(input));
+			};
+		}
+
+		function<int(const RecordView&)> GetDeserializeFunction()
+		{
+			return [](const RecordView& record)
+			{
+				int input = 0;
+				memcpy(&input, record.data, (min)(record.size, sizeof(input)));
+				return input;
+			};
+		}
+
+#pragma endregion
+	};
+}
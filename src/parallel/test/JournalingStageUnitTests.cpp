@@ -0,0 +1,167 @@
+#include "stdafx.h"
+
+#include "fake\FakeConsumerStage.h"
+#include "..\JournalingStage.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Tools::Parallel;
+using namespace Fake;
+using namespace std;
+
+
+namespace Test
+{
+	TEST_CLASS(JournalingStageUnitTests)
+	{
+	public:
+#pragma region constructor
+
+		TEST_METHOD(constructor_WithNullStage_ThrowsInvalidArgumentException)
+		{
+			// Arrange
+			TemporaryFile file;
+
+			// Act
+			auto serializeFunction = GetSerializeFunction();
+			auto action = [&file, &serializeFunction]()
+			{
+				JournalingStage<int> stage(nullptr /*stage*/, file.path(), serializeFunction);
+			};
+
+			// Assert
+			Assert::ExpectException<invalid_argument>(action);
+		}
+
+#pragma endregion
+
+#pragma region addInput
+
+		TEST_METHOD(addInput_ThenFlush_PassesInputsOnAndJournalsThemInOrder)
+		{
+			// Arrange
+			TemporaryFile file;
+			auto consumer = make_shared<FakeConsumerStage<int>>(7);
+			auto stage = make_shared<JournalingStage<int>>(consumer, file.path(), GetSerializeFunction());
+			stage->activate();
+
+			// Act
+			for (int i = 0; i < 50; ++i)
+			{
+				stage->addInput(i);
+			}
+
+			stage->flushOne().wait();
+
+			// Assert
+			Assert::AreEqual(50, static_cast<int>(consumer->m_inputs.size()), L"Every input must reach the wrapped stage.");
+			Assert::AreEqual(7, stage->stageId(), L"A journaling stage must stand in for the stage it wraps.");
+
+			string journal = file.contents();
+			Assert::AreEqual(size_t(50 * (12 + sizeof(int))), journal.size(), L"Each input must be journaled with its arrival time and size.");
+
+			long long previousArrival = 0;
+			for (int i = 0; i < 50; ++i)
+			{
+				const char* record = journal.data() + i * (12 + sizeof(int));
+				long long arrival = 0;
+				uint32_t size = 0;
+				int input = 0;
+				memcpy(&arrival, record, sizeof(arrival));
+				memcpy(&size, record + 8, sizeof(size));
+				memcpy(&input, record + 12, sizeof(input));
+
+				Assert::AreEqual(uint32_t(sizeof(int)), size, L"A record must carry the size of its input.");
+				Assert::AreEqual(i, input, L"Inputs must be journaled in the order they arrived.");
+				Assert::IsTrue(arrival >= previousArrival, L"Arrival times must not go backwards.");
+				previousArrival = arrival;
+			}
+		}
+
+		TEST_METHOD(addInput_SerializerThrows_LeavesNoPartialRecord)
+		{
+			// Arrange
+			TemporaryFile file;
+			auto consumer = make_shared<FakeConsumerStage<int>>(0);
+			auto stage = make_shared<JournalingStage<int>>(consumer, file.path(), [](int& input, vector<char>& buffer)
+			{
+				buffer.push_back('x');
+				if (input == 1)
+				{
+					throw runtime_error("Cannot serialize.");
+				}
+			});
+			stage->activate();
+
+			// Act
+			for (int i = 0; i < 3; ++i)
+			{
+				stage->addInput(i);
+			}
+
+			stage->flushOne().wait();
+
+			// Assert
+			Assert::AreEqual(size_t(2 * 13), file.contents().size(), L"An input that fails to serialize must be left out of the journal.");
+			Assert::AreEqual(3, static_cast<int>(consumer->m_inputs.size()), L"An input that fails to serialize must still reach the wrapped stage.");
+		}
+
+#pragma endregion
+
+	private:
+#pragma region Test language
+
+		/*
+		 * A file in the working directory that is deleted when it goes out of
+		 * scope, which must be after the stage that writes it.
+		 */
+		class TemporaryFile
+		{
+		public:
+			TemporaryFile()
+			{
+				static atomic<int> s_fileCount(0);
+				m_path = "JournalingStageUnitTests." + to_string(++s_fileCount) + ".tmp";
+				remove(m_path.c_str());
+			}
+
+			~TemporaryFile()
+			{
+				remove(m_path.c_str());
+			}
+
+			wstring path() const
+			{
+				return wstring(m_path.begin(), m_path.end());
+			}
+
+			string contents() const
+			{
+				ostringstream contents;
+				contents << ifstream(m_path, ios::binary).rdbuf();
+				return contents.str();
+			}
+
+		private:
+			string m_path;
+		};
+
+		function<void(int&, vector<char>&)> GetSerializeFunction()
+		{
+			return [](int& input, vector<char>& buffer)
+			{
+				const char* bytes = reinterpret_cast<const char*>(&input);
+				buffer.insert(buffer.end(), bytes, bytes + sizeof(input));
+			};
+		}
+
+#pragma endregion
+	};
+}
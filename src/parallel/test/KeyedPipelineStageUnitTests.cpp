@@ -0,0 +1,141 @@
+#include "stdafx.h"
+
+#include "fake\FakeConsumerStage.h"
+#include "..\KeyedPipelineStage.h"
+
+#include <algorithm>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Tools::Parallel;
+using namespace Fake;
+using namespace std;
+
+
+namespace Test
+{
+	TEST_CLASS(KeyedPipelineStageUnitTests)
+	{
+	public:
+#pragma region constructor
+
+		TEST_METHOD(constructor_WithZeroPartitions_ThrowsInvalidArgumentException)
+		{
+			// Act
+			auto action = [this]()
+			{
+				GetCountingStage(0 /*partitionCount*/);
+			};
+
+			// Assert
+			Assert::ExpectException<invalid_argument>(action);
+		}
+
+#pragma endregion
+
+#pragma region processInput
+
+		TEST_METHOD(processInput_ManyInputsPerKey_CountsEachKeyWithoutLosingUpdates)
+		{
+			// Arrange
+			const int keysCount = 10;
+			const int inputsCount = 10000;
+			auto stage = GetCountingStage(4 /*partitionCount*/);
+			auto consumer = make_shared<FakeConsumerStage<int>>(1);
+			stage->connect(consumer);
+			stage->activate();
+
+			// Act
+			for (int i = 0; i < inputsCount; ++i)
+			{
+				int input = i % keysCount;
+				stage->addInput(input);
+			}
+
+			stage->flushAll().wait();
+			auto states = stage->snapshotState().get();
+
+			// Assert
+			Assert::AreEqual<size_t>(keysCount, states.size(), L"Every key must have a state.");
+			for (auto& state : states)
+			{
+				Assert::AreEqual(inputsCount / keysCount, state.second, L"Every input must update the state of its key.");
+			}
+
+			Assert::AreEqual(inputsCount, static_cast<int>(consumer->m_inputs.size()), L"Every input must produce an output.");
+		}
+
+		TEST_METHOD(snapshotState_WhileActive_CompletesBetweenInputs)
+		{
+			// Arrange
+			auto stage = GetCountingStage(2 /*partitionCount*/);
+			auto consumer = make_shared<FakeConsumerStage<int>>(1);
+			stage->connect(consumer);
+			stage->activate();
+			int input = 7;
+			stage->addInput(input);
+			while (stage->hasInputs() || consumer->m_inputs.empty())
+			{
+				concurrency::wait(1);
+			}
+
+			// Act
+			auto states = stage->snapshotState().get();
+			stage->flushOne().wait();
+
+			// Assert
+			Assert::AreEqual<size_t>(1, states.size(), L"The snapshot must hold the key seen so far.");
+			Assert::AreEqual(7, states[0].first, L"The snapshot must hold the key of the input.");
+			Assert::AreEqual(1, states[0].second, L"The snapshot must hold the state after the input.");
+		}
+
+		TEST_METHOD(snapshotState_InactiveWithQueuedInputs_AnswersWithoutProcessingThem)
+		{
+			// Arrange
+			auto stage = GetCountingStage(2 /*partitionCount*/);
+			for (int input = 0; input < 10; ++input)
+			{
+				stage->addInput(input);
+			}
+
+			// Act
+			auto states = stage->snapshotState().get();
+
+			// Assert
+			Assert::IsTrue(states.empty(), L"An inactive stage must answer with the states it has so far.");
+			Assert::IsTrue(stage->hasInputs(), L"Answering a snapshot must not process queued inputs.");
+			Assert::IsFalse(stage->isActive(), L"Answering a snapshot must leave the stage inactive.");
+		}
+
+#pragma endregion
+
+#pragma region snapshot
+
+		TEST_METHOD(snapshot_WithPartitions_ReportsOneWorkerPerPartition)
+		{
+			// Arrange
+			auto stage = GetCountingStage(3 /*partitionCount*/);
+
+			// Act
+			auto snapshot = stage->snapshot();
+
+			// Assert
+			Assert::AreEqual(3U, snapshot.workerCount, L"Each partition must have a single worker.");
+		}
+
+#pragma endregion
+
+	private:
+#pragma region Test language
+
+		shared_ptr<KeyedPipelineStage<int, int, int, int>> GetCountingStage(unsigned int partitionCount)
+		{
+			return make_shared<KeyedPipelineStage<int, int, int, int>>(
+				0,
+				[](int& x) { return x; },
+				[](int&, int& count) { return ++count; },
+				partitionCount);
+		}
+
+#pragma endregion
+	};
+}
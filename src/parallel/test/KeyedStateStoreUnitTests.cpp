@@ -0,0 +1,119 @@
+#include "stdafx.h"
+
+#include "..\KeyedStateStore.h"
+
+#include <concrt.h>
+
+#include <algorithm>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Tools::Parallel;
+using namespace std;
+
+
+namespace Test
+{
+	TEST_CLASS(KeyedStateStoreUnitTests)
+	{
+	public:
+#pragma region get
+
+		TEST_METHOD(get_NewKey_ReturnsDefaultState)
+		{
+			// Arrange
+			KeyedStateStore<int, int> states;
+
+			// Act
+			int& state = states.get(1);
+
+			// Assert
+			Assert::AreEqual(0, state, L"A new key must start from a default state.");
+			Assert::AreEqual<size_t>(1, states.size(), L"The new key must be stored.");
+		}
+
+		TEST_METHOD(get_ManyKeys_KeepsEachState)
+		{
+			// Arrange
+			const int keysCount = 10000;
+			KeyedStateStore<int, int> states;
+
+			// Act
+			for (int i = 0; i < 3 * keysCount; ++i)
+			{
+				states.get(i % keysCount) += 1;
+			}
+
+			// Assert
+			Assert::AreEqual<size_t>(keysCount, states.size(), L"Every key must be stored once.");
+			for (int i = 0; i < keysCount; ++i)
+			{
+				Assert::AreEqual(3, *states.tryGet(i), L"Every key must keep its own state.");
+			}
+		}
+
+		TEST_METHOD(get_WithTimeToLive_EvictsIdleStates)
+		{
+			// Arrange
+			KeyedStateStore<int, int> states(chrono::milliseconds(20));
+			states.get(1) = 5;
+			concurrency::wait(40);
+
+			// Act
+			int& state = states.get(2);
+
+			// Assert
+			Assert::AreEqual(0, state, L"A new key must start from a default state.");
+			Assert::IsNull(states.tryGet(1), L"A state idle for longer than its time to live must be evicted.");
+		}
+
+#pragma endregion
+
+#pragma region erase
+
+		TEST_METHOD(erase_KeyInCollidingRun_KeepsOtherKeysReachable)
+		{
+			// Arrange
+			KeyedStateStore<int, int> states;
+			for (int i = 0; i < 8; ++i)
+			{
+				states.get(i) = i;
+			}
+
+			// Act
+			bool isErased = states.erase(3);
+
+			// Assert
+			Assert::IsTrue(isErased, L"A stored key must be erased.");
+			Assert::IsNull(states.tryGet(3), L"An erased key must not be found.");
+			for (int i = 0; i < 8; ++i)
+			{
+				if (i != 3)
+				{
+					Assert::AreEqual(i, *states.tryGet(i), L"Erasing a key must not lose the others.");
+				}
+			}
+		}
+
+#pragma endregion
+
+#pragma region snapshot
+
+		TEST_METHOD(snapshot_WithStates_ReturnsEveryKeyAndState)
+		{
+			// Arrange
+			KeyedStateStore<int, int> states;
+			states.get(1) = 10;
+			states.get(2) = 20;
+
+			// Act
+			auto snapshot = states.snapshot();
+
+			// Assert
+			sort(snapshot.begin(), snapshot.end());
+			Assert::AreEqual<size_t>(2, snapshot.size(), L"Every key must be in the snapshot.");
+			Assert::AreEqual(20, snapshot[1].second, L"Each key must carry its state.");
+		}
+
+#pragma endregion
+	};
+}
@@ -0,0 +1,107 @@
+#include "stdafx.h"
+
+#include "..\LatencyHistogram.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Tools::Parallel;
+using namespace std;
+
+
+namespace Test
+{
+	TEST_CLASS(LatencyHistogramUnitTests)
+	{
+	public:
+#pragma region percentile
+
+		TEST_METHOD(percentile_NothingRecorded_ReturnsZero)
+		{
+			// Arrange
+			LatencyHistogram histogram;
+
+			// Act
+			auto latency = histogram.percentile(99.0);
+
+			// Assert
+			Assert::AreEqual(0LL, static_cast<long long>(latency.count()), L"An empty histogram must report zero.");
+		}
+
+		TEST_METHOD(percentile_OutOfRange_ThrowsInvalidArgumentException)
+		{
+			// Arrange
+			LatencyHistogram histogram;
+
+			// Act
+			auto action = [&histogram]()
+			{
+				histogram.percentile(101.0);
+			};
+
+			// Assert
+			Assert::ExpectException<invalid_argument>(action);
+		}
+
+		TEST_METHOD(percentile_UniformLatencies_IsWithinBucketPrecision)
+		{
+			// Arrange
+			LatencyHistogram histogram;
+			for (long long i = 1; i <= 10000; ++i)
+			{
+				histogram.record(chrono::microseconds(i));
+			}
+
+			// Act
+			auto median = histogram.percentile(50.0);
+			auto tail = histogram.percentile(99.0);
+
+			// Assert
+			AssertWithinPrecision(chrono::microseconds(5000), median);
+			AssertWithinPrecision(chrono::microseconds(9900), tail);
+			Assert::IsTrue(histogram.percentile(100.0) == histogram.maximum(), L"The 100th percentile must be the maximum.");
+		}
+
+		TEST_METHOD(percentile_SmallLatencies_AreExact)
+		{
+			// Arrange
+			LatencyHistogram histogram;
+			histogram.record(chrono::nanoseconds(3));
+			histogram.record(chrono::nanoseconds(40));
+
+			// Act & Assert
+			Assert::AreEqual(3LL, static_cast<long long>(histogram.percentile(50.0).count()), L"Small latencies must be counted exactly.");
+			Assert::AreEqual(40LL, static_cast<long long>(histogram.percentile(100.0).count()), L"Small latencies must be counted exactly.");
+		}
+
+#pragma endregion
+
+#pragma region mean
+
+		TEST_METHOD(mean_AfterRecording_ReturnsAverage)
+		{
+			// Arrange
+			LatencyHistogram histogram;
+			histogram.record(chrono::nanoseconds(100));
+			histogram.record(chrono::nanoseconds(300));
+
+			// Act
+			auto mean = histogram.mean();
+
+			// Assert
+			Assert::AreEqual(200LL, static_cast<long long>(mean.count()), L"The mean must be the average of the recorded latencies.");
+			Assert::AreEqual(2ULL, histogram.count(), L"Every latency must be counted.");
+		}
+
+#pragma endregion
+
+	private:
+#pragma region Test language
+
+		void AssertWithinPrecision(chrono::nanoseconds expected, chrono::nanoseconds actual)
+		{
+			double error = abs(static_cast<double>(actual.count() - expected.count())) / expected.count();
+			Assert::IsTrue(error <= 1.0 / LatencyHistogram::SubBucketCount, L"A percentile must be within the precision of a bucket.");
+		}
+
+#pragma endregion
+	};
+}
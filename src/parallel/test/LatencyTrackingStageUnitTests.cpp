@@ -0,0 +1,86 @@
+#include "stdafx.h"
+
+#include "..\LatencyTrackingStage.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Tools::Parallel;
+using namespace std;
+
+
+namespace Test
+{
+	TEST_CLASS(LatencyTrackingStageUnitTests)
+	{
+	public:
+#pragma region makeTrackedStage
+
+		TEST_METHOD(makeTrackedStage_WithNullLatency_ThrowsInvalidArgumentException)
+		{
+			// Act
+			auto action = []()
+			{
+				makeTrackedStage<int, int>(0, [](int& x) { return x; }, nullptr /*latency*/);
+			};
+
+			// Assert
+			Assert::ExpectException<invalid_argument>(action);
+		}
+
+		TEST_METHOD(makeTrackedStage_EverySampled_RecordsEachHopAndEndToEnd)
+		{
+			// Arrange
+			const int inputsCount = 100;
+			auto firstLatency = make_shared<StageLatency>();
+			auto finalLatency = make_shared<StageLatency>();
+			auto stage = makeTrackedStage<int, int>(0, [](int& x) { return x + 1; }, firstLatency);
+			auto finalStage = makeTrackedStage<int, void>(1, [](int&) { }, finalLatency);
+			stage->connect(finalStage);
+			stage->activate();
+			finalStage->activate();
+			IngestSampler sampler(1 /*samplingInterval*/);
+
+			// Act
+			AddInputs(stage, sampler, inputsCount);
+			stage->flushAll().wait();
+
+			// Assert
+			Assert::AreEqual<unsigned long long>(inputsCount, firstLatency->queueWait.count(), L"Every sampled input must record its queue wait.");
+			Assert::AreEqual<unsigned long long>(inputsCount, firstLatency->processing.count(), L"Every sampled input must record its processing time.");
+			Assert::AreEqual<unsigned long long>(0, firstLatency->endToEnd.count(), L"Only a final stage may record end-to-end latency.");
+			Assert::AreEqual<unsigned long long>(inputsCount, finalLatency->endToEnd.count(), L"The final stage must record every end-to-end latency.");
+			Assert::IsTrue(finalLatency->endToEnd.maximum() >= firstLatency->processing.maximum(), L"The end-to-end latency must cover every hop.");
+		}
+
+		TEST_METHOD(makeTrackedStage_OneInTenSampled_RecordsOnlySampledInputs)
+		{
+			// Arrange
+			auto latency = make_shared<StageLatency>();
+			auto finalStage = makeTrackedStage<int, void>(0, [](int&) { }, latency);
+			finalStage->activate();
+			IngestSampler sampler(10 /*samplingInterval*/);
+
+			// Act
+			AddInputs(finalStage, sampler, 100);
+			finalStage->flushAll().wait();
+
+			// Assert
+			Assert::AreEqual<unsigned long long>(10, latency->endToEnd.count(), L"Only sampled inputs may be recorded.");
+		}
+
+#pragma endregion
+
+	private:
+#pragma region Test language
+
+		void AddInputs(const shared_ptr<IConsumerStage<Tracked<int>>>& stage, IngestSampler& sampler, int inputsCount)
+		{
+			for (int i = 0; i < inputsCount; ++i)
+			{
+				auto input = sampler.track(i);
+				stage->addInput(input);
+			}
+		}
+
+#pragma endregion
+	};
+}
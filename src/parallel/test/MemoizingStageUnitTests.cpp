@@ -0,0 +1,66 @@
+#include "stdafx.h"
+
+#include "fake\FakeConsumerStage.h"
+#include "..\MemoizingStage.h"
+
+#include <atomic>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Tools::Parallel;
+using namespace Fake;
+using namespace std;
+
+
+namespace Test
+{
+	TEST_CLASS(MemoizingStageUnitTests)
+	{
+	public:
+#pragma region makeMemoizingStage
+
+		TEST_METHOD(makeMemoizingStage_WithNullCache_ThrowsInvalidArgumentException)
+		{
+			// Act
+			auto action = []()
+			{
+				makeMemoizingStage<int, int, int>(0, [](int& x) { return x; }, [](int& x) { return x; }, nullptr /*cache*/);
+			};
+
+			// Assert
+			Assert::ExpectException<invalid_argument>(action);
+		}
+
+		TEST_METHOD(makeMemoizingStage_RepeatedKeys_ProcessesEachKeyOnceAndPassesEveryOutput)
+		{
+			// Arrange
+			const int inputsCount = 100;
+			const int keysCount = 5;
+			atomic<int> calls(0);
+			auto cache = make_shared<ConcurrentLruCache<int, int>>(16 /*capacity*/, 1 /*shardCount*/);
+			auto stage = makeMemoizingStage<int, int, int>(
+				0,
+				[](int& x) { return x % keysCount; },
+				[&calls](int& x) { ++calls; return (x % keysCount) * 10; },
+				cache);
+			auto consumer = make_shared<FakeConsumerStage<int>>(1);
+			stage->connect(consumer);
+			stage->activate();
+
+			// Act
+			for (int i = 0; i < inputsCount; ++i)
+			{
+				stage->addInput(i);
+			}
+
+			stage->flushAll().wait();
+
+			// Assert
+			Assert::AreEqual(keysCount, calls.load(), L"The process function must run once per key.");
+			Assert::AreEqual(inputsCount, static_cast<int>(consumer->m_inputs.size()), L"Every input must produce an output.");
+			Assert::AreEqual(30, consumer->m_inputs[3], L"A cached output must be the one computed for its key.");
+			Assert::AreEqual<unsigned long long>(inputsCount - keysCount, cache->hits(), L"Every repeated key must be a hit.");
+		}
+
+#pragma endregion
+	};
+}
@@ -0,0 +1,150 @@
+#include "stdafx.h"
+
+#include "..\ObjectPool.h"
+
+#include <ppltasks.h>
+
+#include <string>
+#include <vector>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Tools::Parallel;
+using namespace std;
+
+
+namespace Test
+{
+	TEST_CLASS(ObjectPoolUnitTests)
+	{
+	public:
+#pragma region constructor
+
+		TEST_METHOD(constructor_ZeroBatchSize_ThrowsInvalidArgumentException)
+		{
+			// Act
+			auto action = []()
+			{
+				ObjectPool<string> pool(0 /*batchSize*/);
+			};
+
+			// Assert
+			Assert::ExpectException<invalid_argument>(action);
+		}
+
+#pragma endregion
+
+#pragma region acquire
+
+		TEST_METHOD(acquire_EmptyPool_CreatesOneBatch)
+		{
+			// Arrange
+			ObjectPool<string> pool(8 /*batchSize*/);
+
+			// Act
+			auto object = pool.acquire();
+
+			// Assert
+			Assert::IsTrue(static_cast<bool>(object), L"An acquired object must be valid.");
+			Assert::AreEqual(size_t(8), pool.size(), L"An empty pool must create a whole batch at once.");
+		}
+
+		TEST_METHOD(acquire_AfterBatchReleasedOnOtherThread_RecyclesObjects)
+		{
+			// Arrange
+			ObjectPool<string> pool(4 /*batchSize*/);
+			vector<Pooled<string>> objects;
+			for (int i = 0; i < 4; ++i)
+			{
+				objects.push_back(pool.acquire());
+				objects.back()->assign(100, 'x');
+			}
+
+			concurrency::create_task([&pool, &objects]()
+			{
+				for (auto& object : objects)
+				{
+					pool.release(object);
+				}
+			}).wait();
+
+			// Act
+			pool.acquire();
+			auto object = pool.acquire();
+
+			// Assert
+			Assert::AreEqual(size_t(4), pool.size(), L"A full batch released on another thread must be recycled.");
+			Assert::AreEqual(size_t(100), object->size(), L"A recycled object must keep its contents.");
+		}
+
+		TEST_METHOD(acquire_SteadyStateAcrossThreads_StopsCreatingObjects)
+		{
+			// Arrange
+			ObjectPool<string> pool(16 /*batchSize*/);
+			auto cycle = [&pool]()
+			{
+				vector<Pooled<string>> objects;
+				for (int i = 0; i < 64; ++i)
+				{
+					objects.push_back(pool.acquire());
+				}
+
+				concurrency::create_task([&pool, &objects]()
+				{
+					for (auto& object : objects)
+					{
+						object.release();
+					}
+				}).wait();
+			};
+
+			cycle();
+			size_t warmedUpSize = pool.size();
+
+			// Act
+			for (int i = 0; i < 20; ++i)
+			{
+				cycle();
+			}
+
+			// Assert
+			Assert::IsTrue(pool.size() <= warmedUpSize + 2 * pool.batchSize(), L"Once warmed up, a pool must stop creating objects.");
+		}
+
+#pragma endregion
+
+#pragma region release
+
+		TEST_METHOD(release_ToOtherPool_ThrowsInvalidArgumentException)
+		{
+			// Arrange
+			ObjectPool<string> pool;
+			ObjectPool<string> otherPool;
+			auto object = pool.acquire();
+
+			// Act
+			auto action = [&otherPool, &object]()
+			{
+				otherPool.release(object);
+			};
+
+			// Assert
+			Assert::ExpectException<invalid_argument>(action);
+		}
+
+		TEST_METHOD(release_Released_ClearsHandle)
+		{
+			// Arrange
+			ObjectPool<string> pool;
+			auto object = pool.acquire();
+
+			// Act
+			object.release();
+
+			// Assert
+			Assert::IsFalse(static_cast<bool>(object), L"A released handle must no longer refer to the object.");
+		}
+
+#pragma endregion
+
+	};
+}
@@ -0,0 +1,210 @@
+#include "stdafx.h"
+
+#include "fake\FakeScalableStage.h"
+#include "..\PipelineAutoscaler.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Tools::Parallel;
+using namespace Fake;
+using namespace std;
+
+
+namespace Test
+{
+	const unsigned int c_anyCoreBudget = 16;
+	const chrono::milliseconds c_anySampleInterval(100);
+	const int c_manySamples = 20;
+
+	TEST_CLASS(PipelineAutoscalerUnitTests)
+	{
+	public:
+#pragma region constructor
+
+		TEST_METHOD(constructor_WithZeroCoreBudget_ThrowsInvalidArgumentException)
+		{
+			// Act
+			auto action = []()
+			{
+				PipelineAutoscaler autoscaler(0 /*coreBudget*/, c_anySampleInterval);
+			};
+
+			// Assert
+			Assert::ExpectException<invalid_argument>(action);
+		}
+
+#pragma endregion
+
+#pragma region addStage
+
+		TEST_METHOD(addStage_WithNullStage_ThrowsInvalidArgumentException)
+		{
+			// Arrange
+			PipelineAutoscaler autoscaler(c_anyCoreBudget, c_anySampleInterval);
+
+			// Act
+			auto action = [&autoscaler]()
+			{
+				autoscaler.addStage(nullptr /*stage*/, 1, 2);
+			};
+
+			// Assert
+			Assert::ExpectException<invalid_argument>(action);
+		}
+
+		TEST_METHOD(addStage_WithMaxWorkersBelowMinWorkers_ThrowsInvalidArgumentException)
+		{
+			// Arrange
+			PipelineAutoscaler autoscaler(c_anyCoreBudget, c_anySampleInterval);
+			auto stage = make_shared<FakeScalableStage>(1, 1);
+
+			// Act
+			auto action = [&autoscaler, &stage]()
+			{
+				autoscaler.addStage(stage, 4 /*minWorkers*/, 2 /*maxWorkers*/);
+			};
+
+			// Assert
+			Assert::ExpectException<invalid_argument>(action);
+		}
+
+		TEST_METHOD(addStage_MinWorkersBeyondRemainingBudget_ThrowsInvalidArgumentException)
+		{
+			// Arrange
+			PipelineAutoscaler autoscaler(4 /*coreBudget*/, c_anySampleInterval);
+			auto stage1 = make_shared<FakeScalableStage>(1, 3);
+			auto stage2 = make_shared<FakeScalableStage>(2, 2);
+			autoscaler.addStage(stage1, 3 /*minWorkers*/, 4 /*maxWorkers*/);
+
+			// Act
+			auto action = [&autoscaler, &stage2]()
+			{
+				autoscaler.addStage(stage2, 2 /*minWorkers*/, 4 /*maxWorkers*/);
+			};
+
+			// Assert
+			Assert::ExpectException<invalid_argument>(action);
+		}
+
+#pragma endregion
+
+#pragma region sample
+
+		TEST_METHOD(sample_OnceWithSaturatedStage_WorkerCountUnchanged)
+		{
+			// Arrange
+			PipelineAutoscaler autoscaler(c_anyCoreBudget, c_anySampleInterval);
+			auto stage = GetSaturatedStage(1);
+			autoscaler.addStage(stage, 1, 8);
+
+			// Act
+			autoscaler.sample();
+
+			// Assert
+			Assert::AreEqual(1u, stage->m_workerCount, L"A single sample must not resize a stage.");
+		}
+
+		TEST_METHOD(sample_RepeatedlyWithSaturatedStage_GrowsToMaxWorkers)
+		{
+			// Arrange
+			unsigned int maxWorkers = 8;
+			PipelineAutoscaler autoscaler(c_anyCoreBudget, c_anySampleInterval);
+			auto stage = GetSaturatedStage(1);
+			autoscaler.addStage(stage, 1, maxWorkers);
+
+			// Act
+			SampleMany(autoscaler);
+
+			// Assert
+			Assert::AreEqual(maxWorkers, stage->m_workerCount, L"A saturated stage must grow to its maximum worker count.");
+		}
+
+		TEST_METHOD(sample_RepeatedlyWithIdleStage_ShrinksToMinWorkers)
+		{
+			// Arrange
+			unsigned int minWorkers = 2;
+			PipelineAutoscaler autoscaler(c_anyCoreBudget, c_anySampleInterval);
+			auto stage = make_shared<FakeScalableStage>(1, 6);
+			autoscaler.addStage(stage, minWorkers, 8);
+
+			// Act
+			SampleMany(autoscaler);
+
+			// Assert
+			Assert::AreEqual(minWorkers, stage->m_workerCount, L"An idle stage must shrink to its minimum worker count.");
+		}
+
+		TEST_METHOD(sample_SaturatedStagesExceedCoreBudget_TotalWorkersWithinBudget)
+		{
+			// Arrange
+			unsigned int coreBudget = 6;
+			PipelineAutoscaler autoscaler(coreBudget, c_anySampleInterval);
+			auto stage1 = GetSaturatedStage(1);
+			auto stage2 = GetSaturatedStage(2);
+			autoscaler.addStage(stage1, 1, 8);
+			autoscaler.addStage(stage2, 1, 8);
+
+			// Act
+			SampleMany(autoscaler);
+
+			// Assert
+			Assert::AreEqual(coreBudget, stage1->m_workerCount + stage2->m_workerCount, L"The stages must share the whole core budget and no more.");
+		}
+
+		TEST_METHOD(sample_IdleStageAndSaturatedStage_IdleStageCoresGoToSaturatedStage)
+		{
+			// Arrange
+			unsigned int coreBudget = 8;
+			PipelineAutoscaler autoscaler(coreBudget, c_anySampleInterval);
+			auto idleStage = make_shared<FakeScalableStage>(1, 6);
+			auto saturatedStage = GetSaturatedStage(2);
+			autoscaler.addStage(idleStage, 1, 8);
+			autoscaler.addStage(saturatedStage, 1, 8);
+
+			// Act
+			SampleMany(autoscaler);
+
+			// Assert
+			Assert::AreEqual(1u, idleStage->m_workerCount, L"The idle stage must give up its workers.");
+			Assert::AreEqual(coreBudget - 1, saturatedStage->m_workerCount, L"The saturated stage must receive the released cores.");
+		}
+
+		TEST_METHOD(sample_StageDestroyed_RemainingStagesStillScaled)
+		{
+			// Arrange
+			unsigned int maxWorkers = 8;
+			PipelineAutoscaler autoscaler(c_anyCoreBudget, c_anySampleInterval);
+			auto destroyedStage = GetSaturatedStage(1);
+			auto stage = GetSaturatedStage(2);
+			autoscaler.addStage(destroyedStage, 1, maxWorkers);
+			autoscaler.addStage(stage, 1, maxWorkers);
+
+			// Act
+			destroyedStage.reset();
+			SampleMany(autoscaler);
+
+			// Assert
+			Assert::AreEqual(maxWorkers, stage->m_workerCount, L"A destroyed stage must be forgotten without disturbing the others.");
+		}
+
+#pragma endregion
+
+	private:
+		void SampleMany(PipelineAutoscaler& autoscaler)
+		{
+			for (int i = 0; i < c_manySamples; ++i)
+			{
+				autoscaler.sample();
+			}
+		}
+
+		shared_ptr<FakeScalableStage> GetSaturatedStage(int stageId)
+		{
+			auto stage = make_shared<FakeScalableStage>(stageId, 1);
+			stage->m_queueDepth = 1000000;
+			stage->m_inputsPerSample = 100;
+			stage->m_serviceTime = chrono::milliseconds(10);
+
+			return stage;
+		}
+	};
+}
@@ -0,0 +1,126 @@
+#include "stdafx.h"
+
+#include "fake\FakeConsumerStage.h"
+#include "..\PipelineInspector.h"
+#include "..\PipelineStage.h"
+
+#include <string>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Tools::Parallel;
+using namespace Fake;
+using namespace std;
+
+
+namespace Test
+{
+	TEST_CLASS(PipelineInspectorUnitTests)
+	{
+	public:
+#pragma region inspectPipeline
+
+		TEST_METHOD(inspectPipeline_WithNullRoot_ThrowsInvalidArgumentException)
+		{
+			// Act
+			auto action = []()
+			{
+				inspectPipeline(nullptr /*root*/);
+			};
+
+			// Assert
+			Assert::ExpectException<invalid_argument>(action);
+		}
+
+		TEST_METHOD(inspectPipeline_ConnectedStages_ReturnsEveryStageAndConnection)
+		{
+			// Arrange
+			auto stage = GetStage(0);
+			auto finalStage = make_shared<FakeConsumerStage<int>>(1);
+			stage->connect(finalStage);
+			stage->addInput(s_anyInspectedInput);
+
+			// Act
+			auto snapshots = inspectPipeline(stage);
+
+			// Assert
+			Assert::AreEqual<size_t>(2, snapshots.size(), L"Every reachable stage must be inspected.");
+			Assert::AreEqual(0, snapshots[0].stageId, L"The root must be inspected first.");
+			Assert::AreEqual<size_t>(1, snapshots[0].queueDepth, L"The queue depth of a stage must be reported.");
+			Assert::AreEqual<size_t>(1, snapshots[0].consumerIds.size(), L"The connections of a stage must be reported.");
+			Assert::AreEqual(1, snapshots[0].consumerIds[0], L"The connections of a stage must be reported.");
+			Assert::AreEqual(1, snapshots[1].stageId, L"A stage that is not inspectable must still be reported.");
+		}
+
+		TEST_METHOD(inspectPipeline_StageWithTwoProducers_InspectsItOnce)
+		{
+			// Arrange
+			auto stage = GetStage(0);
+			auto left = GetStage(1);
+			auto right = GetStage(2);
+			auto join = GetStage(3);
+			stage->connect(left);
+			stage->connect(right);
+			left->connect(join);
+			right->connect(join);
+
+			// Act
+			auto snapshots = inspectPipeline(stage);
+
+			// Assert
+			Assert::AreEqual<size_t>(4, snapshots.size(), L"A stage reached along two paths must be inspected once.");
+		}
+
+#pragma endregion
+
+#pragma region toJson
+
+		TEST_METHOD(toJson_ConnectedStages_ListsStagesAndConsumers)
+		{
+			// Arrange
+			auto stage = GetStage(0);
+			stage->connect(GetStage(1));
+
+			// Act
+			auto json = toJson(inspectPipeline(stage));
+
+			// Assert
+			Assert::IsTrue(json.find("\"id\":0") != string::npos, L"Every stage must be serialized.");
+			Assert::IsTrue(json.find("\"consumers\":[1]") != string::npos, L"The connections must be serialized.");
+			Assert::IsTrue(json.find("\"active\":false") != string::npos, L"The activity must be serialized.");
+		}
+
+#pragma endregion
+
+#pragma region toGraphviz
+
+		TEST_METHOD(toGraphviz_ConnectedStages_HasAnEdgePerConnection)
+		{
+			// Arrange
+			auto stage = GetStage(0);
+			stage->connect(GetStage(1));
+
+			// Act
+			auto dot = toGraphviz(inspectPipeline(stage));
+
+			// Assert
+			Assert::AreEqual<size_t>(0, dot.find("digraph"), L"The output must be a Graphviz digraph.");
+			Assert::IsTrue(dot.find("0 -> 1;") != string::npos, L"Every connection must be an edge.");
+		}
+
+#pragma endregion
+
+	private:
+		static int s_anyInspectedInput;
+
+#pragma region Test language
+
+		shared_ptr<PipelineStage<int, int>> GetStage(int stageId)
+		{
+			return make_shared<PipelineStage<int, int>>(stageId, [](int& x) { return x; });
+		}
+
+#pragma endregion
+	};
+
+	int PipelineInspectorUnitTests::s_anyInspectedInput = 3;
+}
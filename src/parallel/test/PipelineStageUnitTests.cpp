@@ -3,6 +3,9 @@
 #include "fake\FakeConsumerStage.h"
 #include "..\PipelineStage.h"
 
+#include <atomic>
+#include <string>
+
 using namespace Microsoft::VisualStudio::CppUnitTestFramework;
 using namespace Tools::Parallel;
 using namespace Fake;
@@ -217,6 +220,20 @@ namespace Test
 			stage->flushOne().wait(); // wait for the stage to finish processing its inputs
 		}
 
+		TEST_METHOD(activate_WithDeadLetterStage_DeadLetterStageIsAlsoActivated)
+		{
+			// Arrange
+			auto stage = GetStandardPipelineStage();
+			auto deadLetterStage = make_shared<FakeConsumerStage<DeadLetter<int>>>(c_anyStageId);
+			stage->setDeadLetterStage(deadLetterStage);
+
+			// Act
+			stage->activate();
+
+			// Assert
+			Assert::IsTrue(deadLetterStage->isActive(), L"activate must activate the dead-letter stage.");
+		}
+
 #pragma endregion
 
 #pragma region deactivate
@@ -421,6 +438,20 @@ namespace Test
 			Assert::IsTrue(stage2->isFlushing(), L"flushAll must flush all consumers.");
 		}
 
+		TEST_METHOD(flushAll_WithDeadLetterStage_DeadLetterStageIsAlsoFlushed)
+		{
+			// Arrange
+			auto stage = GetStandardPipelineStage();
+			auto deadLetterStage = make_shared<FakeConsumerStage<DeadLetter<int>>>(c_anyStageId);
+			stage->setDeadLetterStage(deadLetterStage);
+
+			// Act
+			stage->flushAll().wait();
+
+			// Assert
+			Assert::IsTrue(deadLetterStage->m_isFlushingAll, L"flushAll must flush the dead-letter stage.");
+		}
+
 		TEST_METHOD(flushAll_FirstStageInChain_AllOutputsReachFinalStage)
 		{
 			// Arrange
@@ -444,6 +475,293 @@ namespace Test
 
 #pragma endregion
 
+#pragma region setWorkerCount
+
+		TEST_METHOD(setWorkerCount_WithZero_ThrowsInvalidArgumentException)
+		{
+			// Arrange
+			auto stage = GetStandardPipelineStage();
+
+			// Act
+			auto action = [&stage]()
+			{
+				stage->setWorkerCount(0);
+			};
+
+			// Assert
+			Assert::ExpectException<invalid_argument>(action);
+		}
+
+		TEST_METHOD(setWorkerCount_StageIsActive_StatisticsReportRunningWorkers)
+		{
+			// Arrange
+			unsigned int expectedWorkerCount = 4;
+			auto stage = GetStandardPipelineStage();
+			stage->activate();
+
+			// Act
+			stage->setWorkerCount(expectedWorkerCount);
+
+			// Assert
+			auto statistics = stage->statistics();
+			Assert::AreEqual(expectedWorkerCount, statistics.workerCount, L"The statistics must report the new worker count.");
+			Assert::AreEqual(expectedWorkerCount, statistics.runningWorkers, L"Workers must be started as soon as the worker count grows.");
+		}
+
+		TEST_METHOD(setWorkerCount_WithManyWorkers_QueueDepthIsZeroOnceFlushed)
+		{
+			// Arrange
+			auto stage = GetStandardPipelineStage();
+			AddAnyInputs(stage, 1000);
+			stage->setWorkerCount(4);
+			size_t depthBeforeActivate = stage->statistics().queueDepth;
+
+			// Act
+			stage->activate();
+			stage->flushOne().wait();
+
+			// Assert
+			Assert::AreEqual(size_t(1000), depthBeforeActivate, L"Every added input must count towards the queue depth.");
+			Assert::AreEqual(size_t(0), stage->statistics().queueDepth, L"Inputs taken by retired workers must no longer count.");
+		}
+
+		TEST_METHOD(setWorkerCount_WithManyWorkers_ProcessesAllInputsBeforeFlushCompletes)
+		{
+			// Arrange
+			atomic<int> outputsCount(0);
+			auto stage = make_shared<PipelineStage<int, void>>(c_anyStageId, [&outputsCount](int&){ ++outputsCount; });
+			stage->setWorkerCount(4);
+
+			int expectedOutputsCount = 500;
+			AddAnyInputs(stage, expectedOutputsCount);
+			stage->activate();
+
+			// Act
+			stage->flushOne().wait();
+
+			// Assert
+			Assert::AreEqual(expectedOutputsCount, outputsCount.load(), L"All inputs must be processed.");
+			Assert::IsFalse(stage->isActive(), L"Every worker must retire after flushing completes.");
+		}
+
+#pragma endregion
+
+#pragma region setIdleTimeout
+
+		TEST_METHOD(setIdleTimeout_Negative_ThrowsInvalidArgumentException)
+		{
+			// Arrange
+			auto stage = GetStandardPipelineStage();
+
+			// Act
+			auto action = [&stage]()
+			{
+				stage->setIdleTimeout(chrono::milliseconds(-1));
+			};
+
+			// Assert
+			Assert::ExpectException<invalid_argument>(action);
+		}
+
+		TEST_METHOD(setIdleTimeout_ActivatedWithoutInputs_StartsNoWorkers)
+		{
+			// Arrange
+			auto stage = GetStandardPipelineStage();
+			stage->setIdleTimeout(chrono::milliseconds(1));
+
+			// Act
+			stage->activate();
+
+			// Assert
+			Assert::IsTrue(stage->isActive(), L"A lazy stage must be active once activated.");
+			Assert::AreEqual(0U, stage->statistics().runningWorkers, L"A lazy stage must not start workers before its first input.");
+		}
+
+		TEST_METHOD(setIdleTimeout_IdleForLongerThanTimeout_WorkersPark)
+		{
+			// Arrange
+			auto stage = GetStandardPipelineStage();
+			stage->setIdleTimeout(chrono::milliseconds(1));
+			stage->activate();
+
+			// Act
+			AddAnyInputs(stage, 1);
+			WaitUntilProcessed(stage, 1);
+			WaitUntilParked(stage);
+
+			// Assert
+			Assert::IsTrue(stage->isActive(), L"A stage whose workers park must stay active.");
+			Assert::AreEqual(0U, stage->statistics().runningWorkers, L"An idle worker must park after the idle timeout.");
+		}
+
+		TEST_METHOD(setIdleTimeout_InputsWhileWorkersPark_ProcessesEveryInput)
+		{
+			// Arrange
+			atomic<int> outputsCount(0);
+			auto stage = make_shared<PipelineStage<int, void>>(c_anyStageId, [&outputsCount](int&){ ++outputsCount; });
+			stage->setWorkerCount(2);
+			stage->setIdleTimeout(chrono::milliseconds(1));
+			stage->activate();
+
+			// Act
+			for (int burst = 0; burst < 20; ++burst)
+			{
+				AddAnyInputs(stage, 10);
+				concurrency::wait(burst % 4);
+			}
+
+			WaitUntilProcessed(stage, 200);
+
+			// Assert
+			Assert::AreEqual(200, outputsCount.load(), L"An input added as the workers park must start them again.");
+		}
+
+		TEST_METHOD(setIdleTimeout_FlushWhileWorkersParked_Completes)
+		{
+			// Arrange
+			auto stage = GetStandardPipelineStage();
+			stage->setIdleTimeout(chrono::milliseconds(1));
+			stage->activate();
+			AddAnyInputs(stage, 1);
+			WaitUntilProcessed(stage, 1);
+			WaitUntilParked(stage);
+
+			// Act
+			stage->flushOne().wait();
+
+			// Assert
+			Assert::IsFalse(stage->isActive(), L"A flush must return a lazy stage to idle.");
+			Assert::IsFalse(stage->isFlushing(), L"A flush must complete without running workers.");
+		}
+
+#pragma endregion
+
+#pragma region setIdleStrategy
+
+		TEST_METHOD(setIdleStrategy_BusySpin_ProcessesEveryInput)
+		{
+			// Arrange
+			atomic<int> outputsCount(0);
+			auto stage = make_shared<PipelineStage<int, void>>(c_anyStageId, [&outputsCount](int&){ ++outputsCount; });
+			stage->setIdleStrategy(IdleStrategy::busySpin());
+			stage->activate();
+
+			// Act
+			for (int burst = 0; burst < 10; ++burst)
+			{
+				AddAnyInputs(stage, 10);
+				concurrency::wait(1);
+			}
+
+			stage->flushOne().wait();
+
+			// Assert
+			Assert::AreEqual(100, outputsCount.load(), L"A spinning worker must process every input.");
+		}
+
+		TEST_METHOD(setIdleStrategy_SpinThenParkWithIdleTimeout_WorkersPark)
+		{
+			// Arrange
+			auto stage = GetStandardPipelineStage();
+			stage->setIdleStrategy(IdleStrategy::spinThenPark(100, 10, 1));
+			stage->setIdleTimeout(chrono::milliseconds(1));
+			stage->activate();
+
+			// Act
+			AddAnyInputs(stage, 1);
+			WaitUntilProcessed(stage, 1);
+			WaitUntilParked(stage);
+
+			// Assert
+			Assert::AreEqual(0U, stage->statistics().runningWorkers, L"A spinning worker must still park after the idle timeout.");
+		}
+
+#pragma endregion
+
+#pragma region setProcessorAffinity
+
+		TEST_METHOD(setProcessorAffinity_WithoutProcessors_ThrowsInvalidArgumentException)
+		{
+			// Arrange
+			auto stage = GetStandardPipelineStage();
+
+			// Act
+			auto action = [&stage]()
+			{
+				stage->setProcessorAffinity(ProcessorAffinity(0, 0));
+			};
+
+			// Assert
+			Assert::ExpectException<invalid_argument>(action);
+		}
+
+		TEST_METHOD(setProcessorAffinity_FirstProcessor_ProcessesEveryInputWithoutError)
+		{
+			// Arrange
+			bool handleErrorCalled = false;
+			atomic<int> outputsCount(0);
+			auto stage = make_shared<PipelineStage<int, void>>(
+				c_anyStageId,
+				[&outputsCount](int&){ ++outputsCount; },
+				[&handleErrorCalled](int, exception_ptr){ handleErrorCalled = true; });
+			stage->setProcessorAffinity(ProcessorAffinity::processor(0));
+			stage->setIdleStrategy(IdleStrategy::spinThenYield(100));
+			AddAnyInputs(stage, 100);
+
+			// Act
+			stage->activate();
+			stage->flushOne().wait();
+
+			// Assert
+			Assert::AreEqual(100, outputsCount.load(), L"A pinned worker must process every input.");
+			Assert::IsFalse(handleErrorCalled, L"Pinning to an existing processor must not fail.");
+		}
+
+#pragma endregion
+
+#pragma region setProcessorCounters
+
+		TEST_METHOD(setProcessorCounters_Enabled_CountsEveryInput)
+		{
+			// Arrange
+			auto stage = make_shared<PipelineStage<int, void>>(c_anyStageId, [](int& x)
+			{
+				volatile int sum = 0;
+				for (int i = 0; i < 100000; ++i)
+				{
+					sum += i * x;
+				}
+			});
+			stage->setProcessorCounters(true);
+			AddAnyInputs(stage, 200);
+
+			// Act
+			stage->activate();
+			stage->flushOne().wait();
+
+			// Assert
+			auto statistics = stage->statistics();
+			Assert::AreEqual(200ULL, statistics.countedInputs, L"Every input must be counted when the counters can be read.");
+			Assert::IsTrue(statistics.processorCycles > 0, L"Counted inputs must report the cycles they took.");
+			Assert::IsTrue(statistics.processorTime > chrono::nanoseconds::zero(), L"Counted inputs must report the processor time they took.");
+		}
+
+		TEST_METHOD(setProcessorCounters_NotEnabled_CountsNothing)
+		{
+			// Arrange
+			auto stage = GetStandardPipelineStage();
+			AddAnyInputs(stage, 10);
+
+			// Act
+			stage->activate();
+			stage->flushOne().wait();
+
+			// Assert
+			Assert::AreEqual(0ULL, stage->statistics().countedInputs, L"A stage must not read processor counters unless asked to.");
+		}
+
+#pragma endregion
+
 #pragma region connect
 
 		TEST_METHOD(connect_WithNullConsumer_ThrowsInvalidArgumentException)
@@ -694,6 +1012,144 @@ namespace Test
 
 #pragma endregion
 
+#pragma region swapAsync
+
+		TEST_METHOD(swapAsync_WithNullReplacementStage_ThrowsInvalidArgumentException)
+		{
+			// Arrange
+			auto stage = GetStandardPipelineStage();
+			auto anyConsumer = GetFakeStage();
+
+			// Act
+			auto action = [&]()
+			{
+				stage->swapAsync(anyConsumer, nullptr /*replacement*/, false /*drainCurrent*/);
+			};
+
+			// Assert
+			Assert::ExpectException<invalid_argument>(action);
+		}
+
+		TEST_METHOD(swapAsync_WithCurrentStageConnected_DisconnectsCurrentStageAndConnectsReplacementStage)
+		{
+			// Arrange
+			auto stage = GetStandardPipelineStage();
+			auto current = GetFakeStage(2);
+			auto replacement = GetFakeStage(4);
+			stage->connect(current);
+
+			// Act
+			stage->swapAsync(current, replacement, false /*drainCurrent*/).wait();
+
+			// Assert
+			AssertNotConnected(stage, current);
+			AssertConnected(stage, replacement);
+		}
+
+		TEST_METHOD(swapAsync_WithDrainCurrent_FlushesCurrentStage)
+		{
+			// Arrange
+			auto stage = GetStandardPipelineStage();
+			auto current = GetFakeStage(2);
+			auto replacement = GetFakeStage(4);
+			stage->connect(current);
+
+			// Act
+			stage->swapAsync(current, replacement, true /*drainCurrent*/).wait();
+
+			// Assert
+			Assert::IsTrue(current->m_isFlushingOne, L"The current stage must be drained.");
+			Assert::IsFalse(current->m_isFlushingAll, L"The stages after the current stage must not be flushed.");
+		}
+
+		TEST_METHOD(swapAsync_WithCurrentStageNotConnected_CurrentStageNotDrained)
+		{
+			// Arrange
+			auto stage = GetStandardPipelineStage();
+			auto current = GetFakeStage(2);
+			auto replacement = GetFakeStage(4);
+
+			// Act
+			stage->swapAsync(current, replacement, true /*drainCurrent*/).wait();
+
+			// Assert
+			Assert::IsFalse(current->m_isFlushingOne, L"A stage that was not swapped must not be drained.");
+			AssertNotConnected(stage, replacement);
+		}
+
+		TEST_METHOD(swapAsync_WhileProcessingInputs_EachOutputReachesExactlyOneConsumer)
+		{
+			// Arrange
+			int inputsCount = 20000;
+			atomic<int> currentOutputs(0);
+			atomic<int> replacementOutputs(0);
+			auto stage = GetStandardPipelineStage();
+			auto current = make_shared<PipelineStage<int, void>>(2, [&currentOutputs](int&){ ++currentOutputs; });
+			auto replacement = make_shared<PipelineStage<int, void>>(4, [&replacementOutputs](int&){ ++replacementOutputs; });
+			stage->setWorkerCount(4);
+			stage->connect(current);
+			stage->activate();
+			replacement->activate();
+
+			// Act
+			auto producer = concurrency::create_task([this, &stage, inputsCount]()
+			{
+				AddAnyInputs(stage, inputsCount);
+			});
+			while (!stage->hasInputs() && !producer.is_done())
+			{
+				concurrency::wait(0);
+			}
+			stage->swapAsync(current, replacement, true /*drainCurrent*/).wait();
+			int currentOutputsAfterSwap = currentOutputs;
+			producer.wait();
+			stage->flushAll().wait();
+
+			// Assert
+			Assert::AreEqual(currentOutputsAfterSwap, currentOutputs.load(), L"No output may reach the current stage once the swap has completed.");
+			Assert::AreEqual(inputsCount, currentOutputs + replacementOutputs, L"Each output must reach exactly one of the consumers.");
+		}
+
+		TEST_METHOD(swapAsync_WhileOutputBeingPassedToCurrent_CompletesOnlyOncePassReturns)
+		{
+			// Arrange
+			atomic<bool> isPassing(false);
+			atomic<bool> isPassReleased(false);
+			auto stage = GetStandardPipelineStage();
+			auto current = make_shared<FakeConsumerStage<int>>(2);
+			auto replacement = make_shared<FakeConsumerStage<int>>(4);
+			current->m_onAddInput = [&isPassing, &isPassReleased](int&)
+			{
+				isPassing = true;
+				while (!isPassReleased)
+				{
+					concurrency::wait(1);
+				}
+			};
+			stage->connect(current);
+			stage->activate();
+			AddAnyInputs(stage, 1);
+			while (!isPassing)
+			{
+				concurrency::wait(1);
+			}
+
+			// Act
+			auto swapped = stage->swapAsync(current, replacement, false /*drainCurrent*/);
+			concurrency::wait(50);
+			bool isSwappedWhilePassing = swapped.is_done();
+
+			isPassReleased = true;
+			swapped.wait();
+			stage->flushOne().wait();
+
+			// Assert
+			Assert::IsFalse(isSwappedWhilePassing, L"A swap must not complete while an output is still being passed to the current stage.");
+			Assert::AreEqual(size_t(1), current->m_inputs.size(), L"The output being passed must still reach the current stage.");
+		}
+
+#pragma endregion
+
 #pragma region Error handling
 
 		TEST_METHOD(ProcessInputFunctionThrows_WithNullHandleErrorFunction_Passes)
@@ -753,6 +1209,117 @@ namespace Test
 			Assert::IsTrue(testPassed, L"The error must not propagate out of the stage.");
 		}
 
+		TEST_METHOD(ProcessInputFunctionThrowsOnce_WithRetryPolicy_InputIsProcessedOnRetry)
+		{
+			// Arrange
+			int attempts = 0;
+			vector<int> outputs;
+			auto stage = make_shared<PipelineStage<int, void>>(c_anyStageId, [&attempts, &outputs](int& input)
+			{
+				if (++attempts == 1)
+				{
+					throw runtime_error("transient");
+				}
+
+				outputs.push_back(input);
+			});
+			stage->setRetryPolicy(GetAnyRetryPolicy(3 /*maxAttempts*/));
+
+			// Act
+			ProcessAnyInput(stage);
+
+			// Assert
+			Assert::AreEqual(2, attempts, L"The input must be retried after the first failure.");
+			Assert::AreEqual(1, static_cast<int>(outputs.size()), L"The input must be processed once the retry succeeds.");
+		}
+
+		TEST_METHOD(ProcessInputFunctionAlwaysThrows_WithDeadLetterStage_InputRoutedToDeadLetterStageAfterMaxAttempts)
+		{
+			// Arrange
+			unsigned int expectedAttempts = 3;
+			auto anyException = exception("error");
+			auto stage = GetPipelineStage(GetProcessInputFunctionThatThrows(anyException));
+			auto deadLetterStage = make_shared<FakeConsumerStage<DeadLetter<int>>>(c_anyStageId);
+			stage->setRetryPolicy(GetAnyRetryPolicy(expectedAttempts));
+			stage->setDeadLetterStage(deadLetterStage);
+
+			// Act
+			ProcessAnyInput(stage);
+
+			// Assert
+			Assert::AreEqual(1, static_cast<int>(deadLetterStage->m_inputs.size()), L"The failed input must be routed to the dead-letter stage once.");
+			Assert::AreEqual(s_anyInput, deadLetterStage->m_inputs[0].input, L"The dead letter must carry the failed input.");
+			Assert::AreEqual(expectedAttempts, deadLetterStage->m_inputs[0].attempts, L"The input must be attempted as many times as the retry policy allows.");
+			Assert::IsTrue(deadLetterStage->m_inputs[0].error != nullptr, L"The dead letter must carry the error.");
+		}
+
+		TEST_METHOD(ProcessInputFunctionThrows_WithDeadLetterStage_HandleErrorFunctionNotCalled)
+		{
+			// Arrange
+			bool handleErrorCalled = false;
+			auto anyException = exception("error");
+			auto processInput = GetProcessInputFunctionThatThrows(anyException);
+			auto handleError = [&handleErrorCalled](int, exception_ptr){ handleErrorCalled = true; };
+			auto stage = make_shared<PipelineStage<int, int>>(c_anyStageId, processInput, handleError);
+			stage->setDeadLetterStage(make_shared<FakeConsumerStage<DeadLetter<int>>>(c_anyStageId));
+
+			// Act
+			ProcessAnyInput(stage);
+
+			// Assert
+			Assert::IsFalse(handleErrorCalled, L"Failed inputs routed to a dead-letter stage must not reach the error handler.");
+		}
+
+		TEST_METHOD(ConsumerRefusesOutputOnce_WithRetryPolicy_OutputIsRedeliveredWithoutDuplicates)
+		{
+			// Arrange
+			int attempts = 0;
+			auto stage = GetPipelineStage([&attempts](int& input) { ++attempts; return input; });
+			auto acceptingConsumer = GetFakeStage(2);
+			auto refusingConsumer = GetFakeStage(3);
+			refusingConsumer->m_inputsToRefuse = 1;
+			stage->connect(acceptingConsumer);
+			stage->connect(refusingConsumer);
+			stage->setRetryPolicy(GetAnyRetryPolicy(3 /*maxAttempts*/));
+
+			// Act
+			ProcessAnyInput(stage);
+
+			// Assert
+			Assert::AreEqual(1, attempts, L"An input whose output was refused must not be processed again.");
+			Assert::AreEqual(1, static_cast<int>(acceptingConsumer->m_inputs.size()), L"A consumer that accepted the output must not receive it again.");
+			Assert::AreEqual(1, static_cast<int>(refusingConsumer->m_inputs.size()), L"A consumer that refused the output must receive it on retry.");
+		}
+
+		TEST_METHOD(ConsumerAlwaysRefusesOutput_WithHandleErrorFunction_ConsumerErrorIsReported)
+		{
+			// Arrange
+			exception_ptr reportedError;
+			auto stage = make_shared<PipelineStage<int, int>>(
+				c_anyStageId,
+				GetStandardProcessInputFunction(),
+				[&reportedError](int, exception_ptr error) { reportedError = error; });
+			auto refusingConsumer = GetFakeStage();
+			refusingConsumer->m_inputsToRefuse = 1;
+			stage->connect(refusingConsumer);
+
+			// Act
+			ProcessAnyInput(stage);
+
+			// Assert
+			string message;
+			try
+			{
+				rethrow_exception(reportedError);
+			}
+			catch (const runtime_error& error)
+			{
+				message = error.what();
+			}
+
+			Assert::AreEqual(string("The fake consumer refused the input."), message, L"The consumer's own error must be reported.");
+		}
+
 #pragma endregion
 
 	private:
@@ -782,6 +1349,22 @@ namespace Test
 			}
 		}
 
+		void WaitUntilProcessed(const shared_ptr<IScalableStage>& stage, unsigned long long inputsCount)
+		{
+			while (stage->statistics().inputsProcessed < inputsCount)
+			{
+				concurrency::wait(1);
+			}
+		}
+
+		void WaitUntilParked(const shared_ptr<IScalableStage>& stage)
+		{
+			while (stage->statistics().runningWorkers > 0)
+			{
+				concurrency::wait(1);
+			}
+		}
+
 		void ProcessAnyInput(const shared_ptr<IConsumerStage<int>>& stage)
 		{
 			stage->addInput(s_anyInput);
@@ -827,6 +1410,11 @@ namespace Test
 			};
 		}
 
+		RetryPolicy GetAnyRetryPolicy(unsigned int maxAttempts)
+		{
+			return RetryPolicy(maxAttempts, chrono::milliseconds(1), chrono::milliseconds(5), 2.0, 0.5);
+		}
+
 		function<int(int&)> GetProcessInputFunctionThatThrows(exception& e)
 		{
 			return [e](int&) -> int { throw e; };
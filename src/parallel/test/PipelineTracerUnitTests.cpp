@@ -0,0 +1,161 @@
+#include "stdafx.h"
+
+#include "..\PipelineStage.h"
+#include "..\PipelineTracer.h"
+
+#include <algorithm>
+#include <chrono>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Tools::Parallel;
+using namespace std;
+
+
+namespace Test
+{
+	TEST_CLASS(PipelineTracerUnitTests)
+	{
+	public:
+#pragma region constructor
+
+		TEST_METHOD(constructor_ZeroSamplingInterval_ThrowsInvalidArgumentException)
+		{
+			// Act
+			auto action = []()
+			{
+				PipelineTracer tracer(0 /*samplingInterval*/);
+			};
+
+			// Assert
+			Assert::ExpectException<invalid_argument>(action);
+		}
+
+#pragma endregion
+
+#pragma region events
+
+		TEST_METHOD(events_MoreThanRingHolds_KeepsMostRecent)
+		{
+			// Arrange
+			PipelineTracer tracer(1 /*samplingInterval*/, 8 /*eventsPerThread*/);
+
+			// Act
+			for (unsigned long long position = 0; position < 20; ++position)
+			{
+				tracer.recordEnqueued(1, position);
+			}
+
+			auto events = tracer.events();
+
+			// Assert
+			Assert::AreEqual(size_t(8), events.size(), L"A ring must keep as many events as it holds.");
+			Assert::AreEqual(12ULL, events.front().position, L"A full ring must overwrite its oldest events.");
+			Assert::AreEqual(19ULL, events.back().position, L"A ring must keep the most recent event.");
+		}
+
+		TEST_METHOD(events_TracedStage_RecordsEnqueueAndProcessingOfEverySampledInput)
+		{
+			// Arrange
+			auto tracer = make_shared<PipelineTracer>(10 /*samplingInterval*/);
+			auto stage = make_shared<PipelineStage<int, void>>(3, [](int&) { });
+			stage->setTracer(tracer);
+			stage->activate();
+
+			// Act
+			for (int i = 0; i < 100; ++i)
+			{
+				stage->addInput(i);
+			}
+
+			stage->flushOne().wait();
+			auto events = tracer->events();
+
+			// Assert
+			auto enqueuedCount = count_if(events.begin(), events.end(), [](const TraceEvent& event) { return event.kind == TraceEvent::Enqueued; });
+			auto processedCount = count_if(events.begin(), events.end(), [](const TraceEvent& event) { return event.kind == TraceEvent::Processed; });
+			Assert::AreEqual(10, static_cast<int>(enqueuedCount), L"One input in every sampling interval must be traced as it is added.");
+			Assert::AreEqual(10, static_cast<int>(processedCount), L"One input in every sampling interval must be traced as it is processed.");
+			Assert::AreEqual(3, events.back().stageId, L"Events must carry the id of their stage.");
+		}
+
+		TEST_METHOD(events_TracerSetAfterUntracedInputs_ProcessedPositionsMatchEnqueuedOnes)
+		{
+			// Arrange
+			auto tracer = make_shared<PipelineTracer>(1 /*samplingInterval*/);
+			auto stage = make_shared<PipelineStage<int, void>>(0, [](int&) { });
+			for (int i = 0; i < 5; ++i)
+			{
+				stage->addInput(i);
+			}
+
+			stage->activate();
+			stage->flushOne().wait();
+
+			// Act
+			stage->setTracer(tracer);
+			stage->activate();
+			for (int i = 0; i < 5; ++i)
+			{
+				stage->addInput(i);
+			}
+
+			stage->flushOne().wait();
+			auto events = tracer->events();
+
+			// Assert
+			for (auto& event : events)
+			{
+				Assert::IsTrue(event.position >= 5 && event.position < 10, L"Positions must continue from the inputs added before tracing started.");
+			}
+
+			auto processedCount = count_if(events.begin(), events.end(), [](const TraceEvent& event) { return event.kind == TraceEvent::Processed; });
+			Assert::AreEqual(5, static_cast<int>(processedCount), L"Every traced input must be recorded as processed.");
+		}
+
+		TEST_METHOD(events_TracerRemoved_StopsRecording)
+		{
+			// Arrange
+			auto tracer = make_shared<PipelineTracer>(1 /*samplingInterval*/);
+			auto stage = make_shared<PipelineStage<int, void>>(0, [](int&) { });
+			stage->setTracer(tracer);
+			stage->setTracer(nullptr);
+			stage->activate();
+
+			// Act
+			for (int i = 0; i < 10; ++i)
+			{
+				stage->addInput(i);
+			}
+
+			stage->flushOne().wait();
+
+			// Assert
+			Assert::IsTrue(tracer->events().empty(), L"A stage without a tracer must not record events.");
+		}
+
+#pragma endregion
+
+#pragma region toChromeTrace
+
+		TEST_METHOD(toChromeTrace_ProcessedInput_WritesSliceAndFlow)
+		{
+			// Arrange
+			PipelineTracer tracer(1 /*samplingInterval*/);
+			auto startTime = chrono::steady_clock::now();
+			tracer.recordEnqueued(7, 0);
+			tracer.recordProcessed(7, 0, startTime, startTime + chrono::microseconds(5));
+
+			// Act
+			string json = tracer.toChromeTrace();
+
+			// Assert
+			Assert::IsTrue(json.find("\"traceEvents\":[") != string::npos, L"The trace must be a Chrome trace event object.");
+			Assert::IsTrue(json.find("\"ph\":\"X\",\"dur\":5.000,\"name\":\"stage 7\"") != string::npos, L"Processing must be written as a complete slice.");
+			Assert::IsTrue(json.find("\"ph\":\"s\"") != string::npos && json.find("\"ph\":\"f\"") != string::npos, L"An enqueue must be linked to its processing by a flow.");
+			Assert::IsTrue(json.find("\"id\":\"7:0\"") != string::npos, L"A flow must be identified by stage and position.");
+		}
+
+#pragma endregion
+
+	};
+}
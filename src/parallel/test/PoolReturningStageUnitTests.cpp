@@ -0,0 +1,72 @@
+#include "stdafx.h"
+
+#include "..\PoolReturningStage.h"
+
+#include <atomic>
+#include <string>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Tools::Parallel;
+using namespace std;
+
+
+namespace Test
+{
+	TEST_CLASS(PoolReturningStageUnitTests)
+	{
+	public:
+#pragma region makePoolReturningStage
+
+		TEST_METHOD(makePoolReturningStage_WithNullFunction_ThrowsInvalidArgumentException)
+		{
+			// Act
+			auto action = []()
+			{
+				makePoolReturningStage<string>(0, nullptr /*processInputFunction*/);
+			};
+
+			// Assert
+			Assert::ExpectException<invalid_argument>(action);
+		}
+
+		TEST_METHOD(makePoolReturningStage_ThroughPipeline_RecyclesInputs)
+		{
+			// Arrange
+			auto pool = make_shared<ObjectPool<string>>(8 /*batchSize*/);
+			atomic<int> totalLength(0);
+			auto first = make_shared<PipelineStage<Pooled<string>, Pooled<string>>>(0, [](Pooled<string>& input)
+			{
+				input->append("!");
+				return input;
+			});
+			auto last = makePoolReturningStage<string>(1, [&totalLength](string& input)
+			{
+				totalLength += static_cast<int>(input.size());
+			});
+			first->connect(last);
+
+			// Act
+			for (int round = 0; round < 10; ++round)
+			{
+				first->activate();
+				last->activate();
+
+				for (int i = 0; i < 32; ++i)
+				{
+					auto input = pool->acquire();
+					input->assign("abc");
+					first->addInput(input);
+				}
+
+				first->flushAll().wait();
+			}
+
+			// Assert
+			Assert::AreEqual(10 * 32 * 4, totalLength.load(), L"Every input must reach the final stage.");
+			Assert::IsTrue(pool->size() < 10 * 32, L"Inputs completed by the final stage must be recycled.");
+		}
+
+#pragma endregion
+
+	};
+}
@@ -0,0 +1,296 @@
+#include "stdafx.h"
+
+#include "fake\FakeConsumerStage.h"
+#include "..\ProducerBufferingStage.h"
+
+#include <chrono>
+#include <map>
+#include <stdexcept>
+#include <vector>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Tools::Parallel;
+using namespace Fake;
+using namespace std;
+
+
+namespace Test
+{
+	TEST_CLASS(ProducerBufferingStageUnitTests)
+	{
+	public:
+#pragma region constructor
+
+		TEST_METHOD(constructor_WithZeroBatchSize_ThrowsInvalidArgumentException)
+		{
+			// Arrange
+			auto batchStage = make_shared<FakeConsumerStage<InputBatch<int>>>(0);
+
+			// Act
+			auto action = [&batchStage]()
+			{
+				ProducerBufferingStage<int> stage(batchStage, 0 /*batchSize*/, chrono::milliseconds(10));
+			};
+
+			// Assert
+			Assert::ExpectException<invalid_argument>(action);
+		}
+
+#pragma endregion
+
+#pragma region addInput
+
+		TEST_METHOD(addInput_BelowBatchSize_KeepsInputsBuffered)
+		{
+			// Arrange
+			auto batchStage = make_shared<FakeConsumerStage<InputBatch<int>>>(0);
+			ProducerBufferingStage<int> stage(batchStage, 4 /*batchSize*/, c_longDelay);
+
+			// Act
+			for (int i = 0; i < 3; ++i)
+			{
+				stage.addInput(i);
+			}
+
+			// Assert
+			Assert::AreEqual(size_t(0), batchStage->m_inputs.size(), L"A buffer below the batch size must not be published.");
+			Assert::IsTrue(stage.hasInputs(), L"Buffered inputs must count as inputs of the stage.");
+		}
+
+		TEST_METHOD(addInput_ReachingBatchSize_PublishesOneBatchInOrder)
+		{
+			// Arrange
+			auto batchStage = make_shared<FakeConsumerStage<InputBatch<int>>>(0);
+			ProducerBufferingStage<int> stage(batchStage, 4 /*batchSize*/, c_longDelay);
+
+			// Act
+			for (int i = 0; i < 9; ++i)
+			{
+				stage.addInput(i);
+			}
+
+			// Assert
+			Assert::AreEqual(size_t(2), batchStage->m_inputs.size(), L"Each full buffer must be published as one batch.");
+			Assert::AreEqual(2ULL, stage.publishedBatches(), L"Published batches must be counted.");
+			for (int i = 0; i < 8; ++i)
+			{
+				Assert::AreEqual(i, (*batchStage->m_inputs[i / 4])[i % 4], L"Batches must keep the order inputs were added in.");
+			}
+		}
+
+		TEST_METHOD(addInput_WhileActive_PublishesPartialBatchAfterMaxDelay)
+		{
+			// Arrange
+			auto batchStage = make_shared<FakeConsumerStage<InputBatch<int>>>(0);
+			ProducerBufferingStage<int> stage(batchStage, 100 /*batchSize*/, chrono::milliseconds(10));
+			stage.activate();
+
+			// Act
+			int input = 5;
+			stage.addInput(input);
+
+			auto deadline = chrono::steady_clock::now() + chrono::seconds(5);
+			while (stage.publishedBatches() == 0 && chrono::steady_clock::now() < deadline)
+			{
+				concurrency::wait(1);
+			}
+
+			stage.deactivate().wait();
+
+			// Assert
+			Assert::AreEqual(size_t(1), batchStage->m_inputs.size(), L"A partial buffer must be published once it is older than the maximum delay.");
+			Assert::AreEqual(size_t(1), batchStage->m_inputs[0]->size(), L"The partial batch must hold the buffered input.");
+		}
+
+		TEST_METHOD(addInput_ManyProducers_DeliversEveryInputInProducerOrder)
+		{
+			// Arrange
+			const int producersCount = 8;
+			const int inputsPerProducer = 1000;
+			concurrency::critical_section lock;
+			map<int, vector<int>> received;
+			auto batchStage = makeBatchDrainingStage<int>(0, [&lock, &received](int& input)
+			{
+				concurrency::critical_section::scoped_lock scopedLock(lock);
+				received[input / inputsPerProducer].push_back(input % inputsPerProducer);
+			});
+			auto stage = make_shared<ProducerBufferingStage<int>>(batchStage, 64 /*batchSize*/, chrono::milliseconds(5));
+			stage->activate();
+
+			// Act
+			vector<concurrency::task<void>> producers;
+			for (int producer = 0; producer < producersCount; ++producer)
+			{
+				producers.push_back(concurrency::create_task([&stage, producer]()
+				{
+					for (int i = 0; i < inputsPerProducer; ++i)
+					{
+						int input = producer * inputsPerProducer + i;
+						stage->addInput(input);
+					}
+				}));
+			}
+
+			concurrency::when_all(producers.begin(), producers.end()).wait();
+			stage->flushAll().wait();
+
+			// Assert
+			Assert::AreEqual(size_t(producersCount), received.size(), L"Every producer's inputs must arrive.");
+			for (auto iter = received.begin(); iter != received.end(); ++iter)
+			{
+				Assert::AreEqual(size_t(inputsPerProducer), iter->second.size(), L"Every input must arrive exactly once.");
+				for (int i = 0; i < inputsPerProducer; ++i)
+				{
+					Assert::AreEqual(i, iter->second[i], L"A producer's inputs must arrive in the order it added them.");
+				}
+			}
+
+			Assert::IsTrue(stage->publishedBatches() < static_cast<unsigned long long>(producersCount * inputsPerProducer), L"Inputs must be queued in batches.");
+		}
+
+#pragma endregion
+
+#pragma region activate
+
+		TEST_METHOD(activate_RightAfterDeactivate_PublishesOnDeadlineAgain)
+		{
+			// Arrange
+			auto batchStage = make_shared<FakeConsumerStage<InputBatch<int>>>(0);
+			ProducerBufferingStage<int> stage(batchStage, 100 /*batchSize*/, chrono::milliseconds(10));
+			stage.activate();
+			auto deactivateTask = stage.deactivate();
+
+			// Act
+			stage.activate();
+			int input = 5;
+			stage.addInput(input);
+
+			auto deadline = chrono::steady_clock::now() + chrono::seconds(5);
+			while (stage.publishedBatches() == 0 && chrono::steady_clock::now() < deadline)
+			{
+				concurrency::wait(1);
+			}
+
+			deactivateTask.wait();
+			stage.deactivate().wait();
+
+			// Assert
+			Assert::AreEqual(size_t(1), batchStage->m_inputs.size(), L"A stage activated again must publish on the deadline.");
+		}
+
+#pragma endregion
+
+#pragma region destructor
+
+		TEST_METHOD(destructor_WithBufferedInputs_PublishesThem)
+		{
+			// Arrange
+			auto batchStage = make_shared<FakeConsumerStage<InputBatch<int>>>(0);
+			auto stage = make_shared<ProducerBufferingStage<int>>(batchStage, 100 /*batchSize*/, c_longDelay);
+			for (int i = 0; i < 3; ++i)
+			{
+				stage->addInput(i);
+			}
+
+			// Act
+			stage.reset();
+
+			// Assert
+			Assert::AreEqual(size_t(1), batchStage->m_inputs.size(), L"Destroying the stage must publish its buffered inputs.");
+			Assert::AreEqual(size_t(3), batchStage->m_inputs[0]->size(), L"The published batch must hold every buffered input.");
+		}
+
+#pragma endregion
+
+#pragma region flushOne
+
+		TEST_METHOD(flushOne_WithBufferedInputs_PublishesThemBeforeFlushing)
+		{
+			// Arrange
+			auto batchStage = make_shared<FakeConsumerStage<InputBatch<int>>>(0);
+			ProducerBufferingStage<int> stage(batchStage, 100 /*batchSize*/, c_longDelay);
+			for (int i = 0; i < 3; ++i)
+			{
+				stage.addInput(i);
+			}
+
+			// Act
+			stage.flushOne().wait();
+
+			// Assert
+			Assert::AreEqual(size_t(1), batchStage->m_inputs.size(), L"A flush must publish buffered inputs.");
+			Assert::AreEqual(size_t(3), batchStage->m_inputs[0]->size(), L"The published batch must hold every buffered input.");
+			Assert::IsTrue(batchStage->m_isFlushingOne, L"A flush must flush the wrapped stage.");
+		}
+
+#pragma endregion
+
+#pragma region makeBatchDrainingStage
+
+		TEST_METHOD(makeBatchDrainingStage_WithFailingInput_ProcessesRestOfBatchAndReportsError)
+		{
+			// Arrange
+			vector<int> processed;
+			int errorsCount = 0;
+			auto stage = makeBatchDrainingStage<int>(
+				0,
+				[&processed](int& input)
+				{
+					if (input == 1)
+					{
+						throw runtime_error("Cannot process input.");
+					}
+
+					processed.push_back(input);
+				},
+				[&errorsCount](int, exception_ptr) { ++errorsCount; });
+			stage->activate();
+
+			// Act
+			auto batch = make_shared<vector<int>>(vector<int>{ 0, 1, 2 });
+			stage->addInput(batch);
+			stage->flushOne().wait();
+
+			// Assert
+			Assert::AreEqual(size_t(2), processed.size(), L"A failing input must not stop the rest of its batch.");
+			Assert::AreEqual(1, errorsCount, L"A failing batch must be reported once.");
+		}
+
+		TEST_METHOD(makeBatchDrainingStage_InputFailsOnceWithRetryPolicy_RetriesOnlyThatInput)
+		{
+			// Arrange
+			map<int, int> attempts;
+			auto stage = makeBatchDrainingStage<int>(
+				0,
+				[&attempts](int& input)
+				{
+					if (++attempts[input] == 1 && input == 1)
+					{
+						throw runtime_error("Cannot process input yet.");
+					}
+				},
+				[](int, exception_ptr) { });
+			stage->setRetryPolicy(RetryPolicy(2 /*maxAttempts*/, chrono::milliseconds(1), chrono::milliseconds(1), 1.0, 0.0));
+			stage->activate();
+
+			// Act
+			auto batch = make_shared<vector<int>>(vector<int>{ 0, 1, 2 });
+			stage->addInput(batch);
+			stage->flushOne().wait();
+
+			// Assert
+			Assert::AreEqual(1, attempts[0], L"An input that succeeded must not be processed again.");
+			Assert::AreEqual(2, attempts[1], L"The failed input must be retried.");
+			Assert::AreEqual(1, attempts[2], L"An input that succeeded must not be processed again.");
+		}
+
+#pragma endregion
+
+	private:
+#pragma region Test language
+
+		const chrono::milliseconds c_longDelay = chrono::minutes(10);
+
+#pragma endregion
+	};
+}
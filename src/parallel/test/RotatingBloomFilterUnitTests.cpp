@@ -0,0 +1,96 @@
+#include "stdafx.h"
+
+#include "..\RotatingBloomFilter.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Tools::Parallel;
+using namespace std;
+
+
+namespace Test
+{
+	TEST_CLASS(RotatingBloomFilterUnitTests)
+	{
+	public:
+#pragma region constructor
+
+		TEST_METHOD(constructor_WithZeroExpectedKeys_ThrowsInvalidArgumentException)
+		{
+			// Act
+			auto action = []()
+			{
+				RotatingBloomFilter filter(100 /*horizon*/, 0 /*expectedKeys*/, 0.01 /*falsePositiveRate*/);
+			};
+
+			// Assert
+			Assert::ExpectException<invalid_argument>(action);
+		}
+
+#pragma endregion
+
+#pragma region insert
+
+		TEST_METHOD(insert_HashWithinHorizon_ReturnsFalse)
+		{
+			// Arrange
+			RotatingBloomFilter filter(300 /*horizon*/, 1000 /*expectedKeys*/, 0.01 /*falsePositiveRate*/);
+			filter.insert(AnyHash(1), 0 /*stamp*/);
+
+			// Act
+			bool isInserted = filter.insert(AnyHash(1), 299 /*stamp*/);
+
+			// Assert
+			Assert::IsFalse(isInserted, L"A hash recorded within the horizon must never be forgotten.");
+		}
+
+		TEST_METHOD(insert_HashWellBeyondHorizon_ReturnsTrue)
+		{
+			// Arrange
+			RotatingBloomFilter filter(300 /*horizon*/, 1000 /*expectedKeys*/, 0.01 /*falsePositiveRate*/);
+			filter.insert(AnyHash(1), 0 /*stamp*/);
+
+			// Act
+			bool isInserted = filter.insert(AnyHash(1), 400 /*stamp*/);
+
+			// Assert
+			Assert::IsTrue(isInserted, L"A hash recorded over a third of a horizon before the horizon must be forgotten.");
+		}
+
+		TEST_METHOD(insert_ExpectedKeys_FalsePositivesNearConfiguredRate)
+		{
+			// Arrange
+			const int keysCount = 100000;
+			const int keysPerStamp = 100;
+			const int probesCount = 10000;
+			RotatingBloomFilter filter(keysCount / keysPerStamp /*horizon*/, keysCount /*expectedKeys*/, 0.01 /*falsePositiveRate*/);
+			for (int i = 0; i < keysCount; ++i)
+			{
+				filter.insert(AnyHash(i), i / keysPerStamp /*stamp*/);
+			}
+
+			// Act
+			int falsePositives = 0;
+			for (int i = keysCount; i < keysCount + probesCount; ++i)
+			{
+				falsePositives += filter.insert(AnyHash(i), keysCount / keysPerStamp - 1 /*stamp*/) ? 0 : 1;
+			}
+
+			// Assert
+			Assert::IsTrue(falsePositives < probesCount / 50, L"False positives must stay near the configured rate.");
+		}
+
+#pragma endregion
+
+	private:
+#pragma region Test language
+
+		uint64_t AnyHash(uint64_t key)
+		{
+			key = (key ^ (key >> 30)) * 0xbf58476d1ce4e5b9ULL;
+			key = (key ^ (key >> 27)) * 0x94d049bb133111ebULL;
+			return key ^ (key >> 31);
+		}
+
+#pragma endregion
+	};
+}
@@ -0,0 +1,162 @@
+#include "stdafx.h"
+
+#include "..\SharedMemoryRing.h"
+
+#include <atomic>
+#include <string>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Tools::Parallel;
+using namespace std;
+
+
+namespace Test
+{
+	const unsigned int c_anyRingCapacity = 8;
+
+	TEST_CLASS(SharedMemoryRingUnitTests)
+	{
+	public:
+#pragma region constructor
+
+		TEST_METHOD(constructor_WithCapacityNotPowerOfTwo_ThrowsInvalidArgumentException)
+		{
+			// Act
+			auto action = [this]()
+			{
+				SharedMemoryRing<int> ring(GetUniqueRingName(), 6 /*capacity*/, SharedMemoryRing<int>::Producer);
+			};
+
+			// Assert
+			Assert::ExpectException<invalid_argument>(action);
+		}
+
+		TEST_METHOD(constructor_WithDifferentCapacity_ThrowsInvalidArgumentException)
+		{
+			// Arrange
+			auto name = GetUniqueRingName();
+			SharedMemoryRing<int> consumer(name, c_anyRingCapacity, SharedMemoryRing<int>::Consumer);
+
+			// Act
+			auto action = [&name]()
+			{
+				SharedMemoryRing<int> producer(name, c_anyRingCapacity / 2, SharedMemoryRing<int>::Producer);
+			};
+
+			// Assert
+			Assert::ExpectException<invalid_argument>(action);
+		}
+
+		TEST_METHOD(constructor_WithSecondConsumer_ThrowsInvalidArgumentException)
+		{
+			// Arrange
+			auto name = GetUniqueRingName();
+			SharedMemoryRing<int> consumer(name, c_anyRingCapacity, SharedMemoryRing<int>::Consumer);
+
+			// Act
+			auto action = [&name]()
+			{
+				SharedMemoryRing<int> otherConsumer(name, c_anyRingCapacity, SharedMemoryRing<int>::Consumer);
+			};
+
+			// Assert
+			Assert::ExpectException<invalid_argument>(action);
+		}
+
+#pragma endregion
+
+#pragma region tryPush
+
+		TEST_METHOD(tryPush_RingFull_ReturnsFalse)
+		{
+			// Arrange
+			auto name = GetUniqueRingName();
+			SharedMemoryRing<int> producer(name, c_anyRingCapacity, SharedMemoryRing<int>::Producer);
+			for (unsigned int i = 0; i < c_anyRingCapacity; ++i)
+			{
+				producer.tryPush(i);
+			}
+
+			// Act
+			bool isPushed = producer.tryPush(0);
+
+			// Assert
+			Assert::IsFalse(isPushed, L"A full ring must refuse values.");
+			Assert::AreEqual<size_t>(c_anyRingCapacity, producer.size(), L"A full ring must hold as many values as its capacity.");
+		}
+
+#pragma endregion
+
+#pragma region tryPop
+
+		TEST_METHOD(tryPop_AfterPushes_ReturnsValuesInOrder)
+		{
+			// Arrange
+			auto name = GetUniqueRingName();
+			SharedMemoryRing<int> producer(name, c_anyRingCapacity, SharedMemoryRing<int>::Producer);
+			SharedMemoryRing<int> consumer(name, c_anyRingCapacity, SharedMemoryRing<int>::Consumer);
+
+			// Wrap around the ring a few times
+			for (int i = 0; i < 3 * static_cast<int>(c_anyRingCapacity); ++i)
+			{
+				producer.tryPush(i);
+
+				// Act
+				int value = -1;
+				bool isPopped = consumer.tryPop(value);
+
+				// Assert
+				Assert::IsTrue(isPopped, L"A pushed value must be available to the consumer.");
+				Assert::AreEqual(i, value, L"Values must come out of the ring in the order they were pushed.");
+			}
+
+			Assert::IsTrue(consumer.isEmpty(), L"The ring must be empty once every value has been popped.");
+		}
+
+		TEST_METHOD(tryPop_RingEmpty_ReturnsFalse)
+		{
+			// Arrange
+			SharedMemoryRing<int> consumer(GetUniqueRingName(), c_anyRingCapacity, SharedMemoryRing<int>::Consumer);
+			int value = 0;
+
+			// Act
+			bool isPopped = consumer.tryPop(value);
+
+			// Assert
+			Assert::IsFalse(isPopped, L"An empty ring must not return a value.");
+		}
+
+#pragma endregion
+
+#pragma region waitUntil
+
+		TEST_METHOD(waitUntil_ProducerClosed_ReturnsPeerClosed)
+		{
+			// Arrange
+			auto name = GetUniqueRingName();
+			SharedMemoryRing<int> consumer(name, c_anyRingCapacity, SharedMemoryRing<int>::Consumer);
+			{
+				SharedMemoryRing<int> producer(name, c_anyRingCapacity, SharedMemoryRing<int>::Producer);
+			}
+
+			// Act
+			auto result = consumer.waitUntil([&consumer]() { return !consumer.isEmpty(); }, 0 /*timeoutMilliseconds*/);
+
+			// Assert
+			Assert::IsTrue(result == SharedMemoryRing<int>::PeerClosed, L"Waiting on a ring whose producer has closed must report it.");
+		}
+
+#pragma endregion
+
+	private:
+#pragma region Test language
+
+		wstring GetUniqueRingName()
+		{
+			static atomic<int> s_ringCount(0);
+			return L"Local\\Tools.Parallel.Test." + to_wstring(GetCurrentProcessId()) + L"." + to_wstring(++s_ringCount);
+		}
+
+#pragma endregion
+	};
+}
@@ -0,0 +1,163 @@
+#include "stdafx.h"
+
+#include "fake\FakeConsumerStage.h"
+#include "..\SharedMemorySink.h"
+#include "..\SharedMemorySource.h"
+
+#include <atomic>
+#include <string>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Tools::Parallel;
+using namespace Fake;
+using namespace std;
+
+
+namespace Test
+{
+	const unsigned int c_anySharedMemoryCapacity = 16;
+
+	TEST_CLASS(SharedMemorySourceUnitTests)
+	{
+	public:
+#pragma region flushAll
+
+		TEST_METHOD(flushAll_FromSink_PassesEveryInputToSourceConsumers)
+		{
+			// Arrange
+			const int inputsCount = 4 * c_anySharedMemoryCapacity;
+			auto name = GetUniqueRingName();
+			auto source = make_shared<SharedMemorySource<int>>(0, name, c_anySharedMemoryCapacity);
+			auto sink = make_shared<SharedMemorySink<int>>(1, name, c_anySharedMemoryCapacity);
+			auto consumer = make_shared<FakeConsumerStage<int>>(2);
+			source->connect(consumer);
+			source->activate();
+			sink->activate();
+
+			// Act
+			for (int i = 0; i < inputsCount; ++i)
+			{
+				sink->addInput(i);
+			}
+
+			sink->flushAll().wait();
+
+			// Assert
+			Assert::AreEqual<size_t>(inputsCount, consumer->m_inputs.size(), L"Every input must cross the edge.");
+			for (int i = 0; i < inputsCount; ++i)
+			{
+				Assert::AreEqual(i, consumer->m_inputs[i], L"Inputs must cross the edge in order.");
+			}
+
+			Assert::IsTrue(consumer->m_isFlushingAll, L"A flushAll of the sink must flush the consumers of the source.");
+		}
+
+		TEST_METHOD(flushAll_NoSourceWithFlushTimeout_CompletesAndCallsErrorHandler)
+		{
+			// Arrange
+			atomic<int> errorsCount(0);
+			auto handleError = [&errorsCount](int, exception_ptr) { ++errorsCount; };
+			auto sink = make_shared<SharedMemorySink<int>>(1, GetUniqueRingName(), c_anySharedMemoryCapacity, handleError);
+			sink->setFlushTimeout(chrono::milliseconds(50));
+			sink->activate();
+
+			// Act
+			sink->flushAll().wait();
+
+			// Assert
+			Assert::AreEqual(1, errorsCount.load(), L"A flush that is not answered in time must be reported.");
+			Assert::IsFalse(sink->isFlushing(), L"A flush that timed out must end.");
+		}
+
+		TEST_METHOD(flushAll_SinkDestroyedWhileWaiting_FlushIsCancelled)
+		{
+			// Arrange
+			auto sink = make_shared<SharedMemorySink<int>>(1, GetUniqueRingName(), c_anySharedMemoryCapacity);
+			sink->activate();
+			auto flushTask = sink->flushAll();
+
+			// Act
+			sink.reset();
+
+			// Assert
+			Assert::IsTrue(flushTask.is_done(), L"Destroying the sink must end its outstanding flushes.");
+		}
+
+#pragma endregion
+
+#pragma region Sink closed
+
+		TEST_METHOD(activate_SinkDestroyed_FlushesConsumersAndDeactivates)
+		{
+			// Arrange
+			auto name = GetUniqueRingName();
+			auto source = make_shared<SharedMemorySource<int>>(0, name, c_anySharedMemoryCapacity);
+			auto consumer = make_shared<FakeConsumerStage<int>>(2);
+			source->connect(consumer);
+			{
+				SharedMemorySink<int> sink(1, name, c_anySharedMemoryCapacity);
+				sink.addInput(s_anyInput);
+			}
+
+			// Act
+			source->activate();
+			WaitUntilInactive(source);
+
+			// Assert
+			Assert::AreEqual<size_t>(1, consumer->m_inputs.size(), L"Inputs added before the sink closed must still be delivered.");
+			Assert::IsTrue(consumer->m_isFlushingAll, L"The consumers must be flushed at the end of the stream.");
+		}
+
+#pragma endregion
+
+#pragma region Source closed
+
+		TEST_METHOD(addInput_SourceDestroyed_CallsErrorHandlerOnce)
+		{
+			// Arrange
+			auto name = GetUniqueRingName();
+			int errorsCount = 0;
+			auto handleError = [&errorsCount](int, exception_ptr) { ++errorsCount; };
+			SharedMemorySink<int> sink(1, name, 2 /*capacity*/, handleError);
+			sink.activate();
+			{
+				SharedMemorySource<int> source(0, name, 2 /*capacity*/);
+			}
+
+			// Act
+			for (int i = 0; i < 4; ++i)
+			{
+				sink.addInput(s_anyInput);
+			}
+
+			// Assert
+			Assert::AreEqual(1, errorsCount, L"Losing the consumer must be reported exactly once.");
+			Assert::IsFalse(sink.isActive(), L"A sink that lost its consumer must deactivate.");
+		}
+
+#pragma endregion
+
+	private:
+		static int s_anyInput;
+
+#pragma region Test language
+
+		wstring GetUniqueRingName()
+		{
+			static atomic<int> s_ringCount(0);
+			return L"Local\\Tools.Parallel.Test.Source." + to_wstring(GetCurrentProcessId()) + L"." + to_wstring(++s_ringCount);
+		}
+
+		void WaitUntilInactive(const shared_ptr<IPipelineStage>& stage)
+		{
+			while (stage->isActive())
+			{
+				concurrency::wait(1);
+			}
+		}
+
+#pragma endregion
+	};
+
+	int SharedMemorySourceUnitTests::s_anyInput = 7;
+}
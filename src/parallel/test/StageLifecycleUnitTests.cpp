@@ -0,0 +1,116 @@
+#include "stdafx.h"
+
+#include "..\StageLifecycle.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Tools::Parallel;
+using namespace std;
+
+
+namespace Test
+{
+	TEST_CLASS(StageLifecycleUnitTests)
+	{
+	public:
+#pragma region phase
+
+		TEST_METHOD(phase_Initial_ReturnsIdle)
+		{
+			// Arrange
+			auto lifecycle = StageLifecycle::initial(1);
+
+			// Act & Assert
+			Assert::IsTrue(lifecycle.phase() == StageLifecycle::Idle, L"A new stage must be idle.");
+			Assert::IsFalse(lifecycle.isActive(), L"A new stage must not be active.");
+		}
+
+		TEST_METHOD(phase_Scheduled_ReturnsRunning)
+		{
+			// Arrange
+			auto lifecycle = StageLifecycle::initial(1).withScheduled(true);
+
+			// Act & Assert
+			Assert::IsTrue(lifecycle.phase() == StageLifecycle::Running, L"A scheduled stage must be running.");
+		}
+
+		TEST_METHOD(phase_ScheduledAndFlushing_ReturnsFlushing)
+		{
+			// Arrange
+			auto lifecycle = StageLifecycle::initial(1).withScheduled(true).withFlushing(true);
+
+			// Act & Assert
+			Assert::IsTrue(lifecycle.phase() == StageLifecycle::Flushing, L"A flushing stage must be flushing.");
+		}
+
+		TEST_METHOD(phase_NotScheduledWithRunningWorkers_ReturnsStopping)
+		{
+			// Arrange
+			auto lifecycle = StageLifecycle::initial(1).withRunningWorkers(1);
+
+			// Act & Assert
+			Assert::IsTrue(lifecycle.phase() == StageLifecycle::Stopping, L"A deactivated stage with running workers must be stopping.");
+			Assert::IsTrue(lifecycle.isActive(), L"A stopping stage must still be active.");
+		}
+
+#pragma endregion
+
+#pragma region shouldWorkerContinue
+
+		TEST_METHOD(shouldWorkerContinue_MoreRunningWorkersThanWorkerCount_ReturnsFalse)
+		{
+			// Arrange
+			auto lifecycle = StageLifecycle::initial(2).withScheduled(true).withRunningWorkers(3);
+
+			// Act & Assert
+			Assert::IsFalse(lifecycle.shouldWorkerContinue(), L"Surplus workers must retire.");
+		}
+
+#pragma endregion
+
+#pragma region withWorkerRetired
+
+		TEST_METHOD(withWorkerRetired_LastWorkerOfFlushingStage_ReturnsToIdle)
+		{
+			// Arrange
+			auto lifecycle = StageLifecycle::initial(1).withScheduled(true).withFlushing(true).withRunningWorkers(1);
+
+			// Act
+			auto retired = lifecycle.withWorkerRetired();
+
+			// Assert
+			Assert::IsTrue(retired.phase() == StageLifecycle::Idle, L"The last worker to retire must return the stage to idle.");
+			Assert::AreEqual(1u, retired.workerCount(), L"Retiring must not change the worker count.");
+		}
+
+		TEST_METHOD(withWorkerRetired_OtherWorkersStillRunning_StaysScheduled)
+		{
+			// Arrange
+			auto lifecycle = StageLifecycle::initial(1).withScheduled(true).withRunningWorkers(2);
+
+			// Act
+			auto retired = lifecycle.withWorkerRetired();
+
+			// Assert
+			Assert::IsTrue(retired.isScheduled(), L"The stage must stay scheduled while other workers run.");
+			Assert::AreEqual(1u, retired.runningWorkers(), L"Exactly one worker must retire.");
+		}
+
+#pragma endregion
+
+#pragma region withWorkerCount
+
+		TEST_METHOD(withWorkerCount_AboveMaxWorkers_ThrowsInvalidArgumentException)
+		{
+			// Act
+			auto action = []()
+			{
+				StageLifecycle::initial(1).withWorkerCount(StageLifecycle::MaxWorkers + 1);
+			};
+
+			// Assert
+			Assert::ExpectException<invalid_argument>(action);
+		}
+
+#pragma endregion
+	};
+}
@@ -0,0 +1,182 @@
+#include "stdafx.h"
+
+#include "fake\FakeConsumerStage.h"
+#include "..\StaticPipelineStage.h"
+
+#include <atomic>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Tools::Parallel;
+using namespace Fake;
+using namespace std;
+
+
+namespace Test
+{
+	TEST_CLASS(StaticPipelineStageUnitTests)
+	{
+	public:
+#pragma region constructor
+
+		TEST_METHOD(constructor_WithNullConsumer_ThrowsInvalidArgumentException)
+		{
+			// Arrange
+			auto nullConsumer = shared_ptr<StaticPipelineStage<int, function<void(int&)>>>();
+
+			// Act
+			auto action = [&nullConsumer]()
+			{
+				auto stage = makeStaticStage<int>(0, [](int& x){ return x; }, nullConsumer);
+			};
+
+			// Assert
+			Assert::ExpectException<invalid_argument>(action);
+		}
+
+#pragma endregion
+
+#pragma region activateAll
+
+		TEST_METHOD(activateAll_WithConsumers_AllStagesAreActive)
+		{
+			// Arrange
+			auto final1 = makeStaticStage<int>(1, [](int&){});
+			auto final2 = makeStaticStage<int>(2, [](int&){});
+			auto stage = makeStaticStage<int>(0, [](int& x){ return x; }, final1, final2);
+
+			// Act
+			stage->activateAll();
+
+			// Assert
+			Assert::IsTrue(stage->isActive(), L"The root stage must be active after activateAll.");
+			Assert::IsTrue(final1->isActive(), L"Every consumer must be active after activateAll.");
+			Assert::IsTrue(final2->isActive(), L"Every consumer must be active after activateAll.");
+		}
+
+		TEST_METHOD(activateAll_WithDeadLetterStage_DeadLetterStageIsAlsoActivated)
+		{
+			// Arrange
+			auto stage = makeStaticStage<int>(0, [](int&){});
+			auto deadLetterStage = make_shared<FakeConsumerStage<DeadLetter<int>>>(1);
+			stage->setDeadLetterStage(deadLetterStage);
+
+			// Act
+			stage->activateAll();
+
+			// Assert
+			Assert::IsTrue(deadLetterStage->isActive(), L"activateAll must activate the dead-letter stage.");
+		}
+
+#pragma endregion
+
+#pragma region deactivateAll
+
+		TEST_METHOD(deactivateAll_AfterActivateAll_NoStageIsActive)
+		{
+			// Arrange
+			auto end = makeStaticStage<int>(1, [](int&){});
+			auto stage = makeStaticStage<int>(0, [](int& x){ return x; }, end);
+			stage->activateAll();
+
+			// Act
+			stage->deactivateAll().wait();
+
+			// Assert
+			Assert::IsFalse(stage->isActive(), L"The root stage must not be active after deactivateAll completes.");
+			Assert::IsFalse(end->isActive(), L"No consumer may be active after deactivateAll completes.");
+		}
+
+#pragma endregion
+
+#pragma region flushAll
+
+		TEST_METHOD(flushAll_FirstStageInChain_AllOutputsReachFinalStage)
+		{
+			// Arrange
+			atomic<int> outputsCount(0);
+			auto end = makeStaticStage<double>(2, [&outputsCount](double&){ ++outputsCount; });
+			auto middle = makeStaticStage<int>(1, [](int& x){ return x * 3.14; }, end);
+			auto stage = makeStaticStage<int>(0, [](int& x){ return x + 1; }, middle);
+
+			int expectedOutputsCount = 100;
+			AddAnyInputs(stage, expectedOutputsCount);
+			stage->activateAll();
+
+			// Act
+			stage->flushAll().wait();
+
+			// Assert
+			Assert::AreEqual(expectedOutputsCount, outputsCount.load(), L"When flushAll is called on a stage, all outputs of that stage must reach the final stage.");
+		}
+
+		TEST_METHOD(flushAll_StageFansOut_EveryConsumerReceivesEveryOutput)
+		{
+			// Arrange
+			atomic<int> outputsCount1(0);
+			atomic<int> outputsCount2(0);
+			auto end1 = makeStaticStage<int>(1, [&outputsCount1](int&){ ++outputsCount1; });
+			auto end2 = makeStaticStage<int>(2, [&outputsCount2](int&){ ++outputsCount2; });
+			auto stage = makeStaticStage<int>(0, [](int& x){ return x * x; }, end1, end2);
+
+			int expectedOutputsCount = 50;
+			AddAnyInputs(stage, expectedOutputsCount);
+			stage->activateAll();
+
+			// Act
+			stage->flushAll().wait();
+
+			// Assert
+			Assert::AreEqual(expectedOutputsCount, outputsCount1.load(), L"Every consumer must receive every output.");
+			Assert::AreEqual(expectedOutputsCount, outputsCount2.load(), L"Every consumer must receive every output.");
+		}
+
+		TEST_METHOD(flushAll_WithDeadLetterStage_DeadLetterStageIsAlsoFlushed)
+		{
+			// Arrange
+			auto stage = makeStaticStage<int>(0, [](int&){});
+			auto deadLetterStage = make_shared<FakeConsumerStage<DeadLetter<int>>>(1);
+			stage->setDeadLetterStage(deadLetterStage);
+
+			// Act
+			stage->flushAll().wait();
+
+			// Assert
+			Assert::IsTrue(deadLetterStage->m_isFlushingAll, L"flushAll must flush the dead-letter stage.");
+		}
+
+#pragma endregion
+
+#pragma region Error handling
+
+		TEST_METHOD(ProcessInputFunctionThrows_WithValidHandleErrorFunction_HandleErrorFunctionCalledWithStageId)
+		{
+			// Arrange
+			int expectedStageId = 7;
+			atomic<int> actualStageId(-1);
+			auto stage = makeStaticStage<int>(
+				expectedStageId,
+				[](int&) { throw runtime_error("error"); },
+				[&actualStageId](int stageId, exception_ptr) { actualStageId = stageId; });
+
+			// Act
+			AddAnyInputs(stage, 1);
+			stage->activate();
+			stage->flushOne().wait();
+
+			// Assert
+			Assert::AreEqual(expectedStageId, actualStageId.load(), L"The error handler must be called with the ID of the stage.");
+		}
+
+#pragma endregion
+
+	private:
+		template<class Stage>
+		void AddAnyInputs(const shared_ptr<Stage>& stage, int inputsCount)
+		{
+			for (int i = 0; i < inputsCount; ++i)
+			{
+				stage->addInput(i);
+			}
+		}
+	};
+}
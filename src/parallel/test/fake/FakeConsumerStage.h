@@ -2,6 +2,8 @@
 
 #include "..\..\IConsumerStage.h"
 
+#include <functional>
+
 
 namespace Fake
 {
@@ -14,6 +16,7 @@ namespace Fake
 			, m_isActive(false)
 			, m_isFlushingOne(false)
 			, m_isFlushingAll(false)
+			, m_inputsToRefuse(0)
 		{
 		}
 
@@ -62,6 +65,17 @@ namespace Fake
 
 		virtual void addInput(Input& input) override
 		{
+			if (m_onAddInput != nullptr)
+			{
+				m_onAddInput(input);
+			}
+
+			if (m_inputsToRefuse > 0)
+			{
+				--m_inputsToRefuse;
+				throw std::runtime_error("The fake consumer refused the input.");
+			}
+
 			m_inputs.push_back(input);
 		}
 
@@ -69,6 +83,8 @@ namespace Fake
 		bool m_isActive;
 		bool m_isFlushingOne;
 		bool m_isFlushingAll;
+		int m_inputsToRefuse;
+		std::function<void(Input&)> m_onAddInput;
 		std::vector<Input> m_inputs;
 
 	private:
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "..\..\IScalableStage.h"
+
+
+namespace Fake
+{
+	/*
+	 * A scalable stage whose statistics advance by a fixed amount of work
+	 * every time they are read.
+	 */
+	class FakeScalableStage : public Tools::Parallel::IScalableStage
+	{
+	public:
+		FakeScalableStage(int stageId, unsigned int workerCount)
+			: m_stageId(stageId)
+			, m_workerCount(workerCount)
+			, m_queueDepth(0)
+			, m_inputsPerSample(0)
+			, m_serviceTime(std::chrono::nanoseconds::zero())
+		{
+		}
+
+		virtual int stageId() const override
+		{
+			return m_stageId;
+		}
+
+		virtual unsigned int workerCount() override
+		{
+			return m_workerCount;
+		}
+
+		virtual void setWorkerCount(unsigned int workerCount) override
+		{
+			m_workerCount = workerCount;
+		}
+
+		virtual Tools::Parallel::StageStatistics statistics() override
+		{
+			m_statistics.stageId = m_stageId;
+			m_statistics.workerCount = m_workerCount;
+			m_statistics.runningWorkers = m_workerCount;
+			m_statistics.queueDepth = m_queueDepth;
+			m_statistics.inputsAdded += m_inputsPerSample;
+			m_statistics.inputsProcessed += m_inputsPerSample;
+			m_statistics.processingTime += m_serviceTime * m_inputsPerSample;
+
+			return m_statistics;
+		}
+
+
+		unsigned int m_workerCount;
+		size_t m_queueDepth;
+		unsigned long long m_inputsPerSample;
+		std::chrono::nanoseconds m_serviceTime;
+
+	private:
+		int m_stageId;
+		Tools::Parallel::StageStatistics m_statistics;
+	};
+}